@@ -0,0 +1,856 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "bplus_tree.hpp"
+
+namespace
+{
+using Cell = TreeNode::Cell;
+
+constexpr std::size_t HEADER_SIZE = TreeNode::HEADER_SIZE;
+constexpr std::size_t SLOT_SIZE = TreeNode::SLOT_SIZE;
+
+std::size_t footprint(const std::vector<Cell>& cells) noexcept
+{
+  std::size_t bytes = 0;
+  for (const Cell& cell : cells) {
+    bytes += cell.size() + SLOT_SIZE;
+  }
+  return bytes;
+}
+
+// Index of the first cell of the right half that best balances the bytes
+// of the two halves
+std::size_t balanced_split(const std::vector<Cell>& cells) noexcept
+{
+  const std::size_t total = footprint(cells);
+  std::size_t best = 1;
+  std::size_t best_gap = std::numeric_limits<std::size_t>::max();
+  std::size_t left = 0;
+  for (std::size_t split = 1; split < cells.size(); split++) {
+    left += cells[split - 1].size() + SLOT_SIZE;
+    const std::size_t right = total - left;
+    const std::size_t gap = left > right ? left - right : right - left;
+    if (gap < best_gap) {
+      best = split;
+      best_gap = gap;
+    }
+  }
+  return best;
+}
+
+// Index of the interior cell to move up that best balances the bytes of
+// the cells left on either side of it
+std::size_t promoted_split(const std::vector<Cell>& cells) noexcept
+{
+  const std::size_t total = footprint(cells);
+  std::size_t best = 1;
+  std::size_t best_gap = std::numeric_limits<std::size_t>::max();
+  std::size_t left = cells[0].size() + SLOT_SIZE;
+  for (std::size_t split = 1; split + 1 < cells.size(); split++) {
+    const std::size_t right = total - left - cells[split].size() - SLOT_SIZE;
+    const std::size_t gap = left > right ? left - right : right - left;
+    if (gap < best_gap) {
+      best = split;
+      best_gap = gap;
+    }
+    left += cells[split].size() + SLOT_SIZE;
+  }
+  return best;
+}
+
+std::vector<std::byte> copy_of(KeyView key)
+{
+  return std::vector<std::byte>(key.data, key.data + key.size);
+}
+}  // namespace
+
+// --- NodeFormat ---
+
+NodeFormat::NodeFormat(std::uint8_t leaf_kind,
+                       std::uint8_t interior_kind,
+                       std::size_t array_key_size,
+                       const char* name) noexcept
+    : m_leaf_kind(leaf_kind)
+    , m_interior_kind(interior_kind)
+    , m_array_key_size(array_key_size)
+    , m_name(name)
+{
+}
+
+std::size_t NodeFormat::lower_bound(const TreeNode& node,
+                                    KeyView key) const noexcept
+{
+  std::size_t low = 0;
+  std::size_t high = node.count();
+  while (low < high) {
+    const std::size_t middle = low + (high - low) / 2;
+    if (compare(node.key(middle), key) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+const char* NodeFormat::check_leaf_cell(Pager& /*pager*/,
+                                        std::size_t /*capacity*/,
+                                        const std::byte* /*cell*/) const
+{
+  return nullptr;
+}
+
+// --- TreeNode ---
+
+TreeNode::TreeNode(PageHandle handle,
+                   std::size_t usable,
+                   const NodeFormat& format) noexcept
+    : m_handle(std::move(handle))
+    , m_usable(usable)
+    , m_format(&format)
+    , m_max_keys(format.array_key_size() == 0
+                     ? 0
+                     : (usable - HEADER_SIZE)
+                         / (format.array_key_size() + sizeof(PageId)))
+{
+}
+
+KeyView TreeNode::key(std::size_t index) const noexcept
+{
+  if (arrays()) {
+    const std::size_t size = m_format->array_key_size();
+    return {keys() + index * size, size};
+  }
+  return leaf() ? m_format->leaf_key(cell(index))
+                : m_format->interior_key(cell(index));
+}
+
+PageId TreeNode::child(std::size_t index) const noexcept
+{
+  if (index == count()) {
+    return right();
+  }
+  return arrays()
+      ? load_u32(data() + children_offset() + index * sizeof(PageId))
+      : m_format->interior_child(cell(index));
+}
+
+std::size_t TreeNode::free_space() const noexcept
+{
+  if (arrays()) {
+    return (m_max_keys - count()) * entry_size();
+  }
+  return content() - HEADER_SIZE - count() * SLOT_SIZE + fragmented();
+}
+
+bool TreeNode::holds(const std::vector<Cell>& cells) const noexcept
+{
+  return arrays() ? cells.size() <= m_max_keys
+                  : ::footprint(cells) <= m_usable - HEADER_SIZE;
+}
+
+std::vector<Cell> TreeNode::cells() const
+{
+  std::vector<Cell> copies;
+  copies.reserve(count());
+  for (std::size_t i = 0; i < count(); i++) {
+    if (arrays()) {
+      copies.push_back(m_format->interior_cell(key(i), child(i)));
+    } else {
+      copies.emplace_back(cell(i), cell(i) + cell_size(i));
+    }
+  }
+  return copies;
+}
+
+void TreeNode::init(std::uint8_t kind) noexcept
+{
+  std::memset(bytes(), 0, HEADER_SIZE);
+  bytes()[KIND_OFFSET] = static_cast<std::byte>(kind);
+  if (!arrays()) {
+    set_content(m_usable);
+  }
+}
+
+void TreeNode::set_child(std::size_t index, PageId child) noexcept
+{
+  if (index == count()) {
+    set_right(child);
+  } else if (arrays()) {
+    store_u32(bytes() + children_offset() + index * sizeof(PageId), child);
+  } else {
+    m_format->set_interior_child(bytes() + (cell(index) - data()), child);
+  }
+}
+
+void TreeNode::insert_cell(std::size_t index, const Cell& cell)
+{
+  if (arrays()) {
+    shift_entries(index, index + 1);
+    set_count(count() + 1);
+    const KeyView key = m_format->interior_key(cell.data());
+    std::memcpy(bytes() + HEADER_SIZE + index * key.size, key.data, key.size);
+    set_child(index, m_format->interior_child(cell.data()));
+    return;
+  }
+  const std::size_t slots_end = HEADER_SIZE + (count() + 1) * SLOT_SIZE;
+  if (content() < slots_end + cell.size()) {
+    defragment();
+  }
+  const std::size_t offset = content() - cell.size();
+  std::memcpy(bytes() + offset, cell.data(), cell.size());
+  set_content(offset);
+
+  std::byte* slot = bytes() + HEADER_SIZE + index * SLOT_SIZE;
+  std::memmove(slot + SLOT_SIZE, slot, (count() - index) * SLOT_SIZE);
+  store_u16(slot, static_cast<std::uint16_t>(offset));
+  set_count(count() + 1);
+}
+
+void TreeNode::remove_cell(std::size_t index) noexcept
+{
+  if (arrays()) {
+    shift_entries(index + 1, index);
+    set_count(count() - 1);
+    return;
+  }
+  const std::size_t offset = static_cast<std::size_t>(cell(index) - data());
+  const std::size_t size = cell_size(index);
+  if (offset == content()) {
+    set_content(offset + size);
+  } else {
+    store_u16(bytes() + FRAGMENTED_OFFSET,
+              static_cast<std::uint16_t>(fragmented() + size));
+  }
+  std::byte* slot = bytes() + HEADER_SIZE + index * SLOT_SIZE;
+  std::memmove(slot, slot + SLOT_SIZE, (count() - index - 1) * SLOT_SIZE);
+  set_count(count() - 1);
+}
+
+void TreeNode::assign(std::vector<Cell>::const_iterator first,
+                      std::vector<Cell>::const_iterator last)
+{
+  set_count(0);
+  if (!arrays()) {
+    set_content(m_usable);
+    store_u16(bytes() + FRAGMENTED_OFFSET, 0);
+  }
+  for (; first != last; ++first) {
+    insert_cell(count(), *first);
+  }
+}
+
+void TreeNode::copy_from(const TreeNode& other) noexcept
+{
+  std::memcpy(bytes(), other.data(), m_usable);
+}
+
+// Move the interior entries from `from` on to start at `to`
+void TreeNode::shift_entries(std::size_t from, std::size_t to) noexcept
+{
+  const std::size_t moved = count() - from;
+  const std::size_t key_size = m_format->array_key_size();
+  std::byte* key_array = bytes() + HEADER_SIZE;
+  std::memmove(
+      key_array + to * key_size, key_array + from * key_size, moved * key_size);
+  std::byte* child_array = bytes() + children_offset();
+  std::memmove(child_array + to * sizeof(PageId),
+               child_array + from * sizeof(PageId),
+               moved * sizeof(PageId));
+}
+
+// Pack the cells at the end of the page, reclaiming fragmented space
+void TreeNode::defragment()
+{
+  const std::vector<Cell> copies = cells();
+  assign(copies.begin(), copies.end());
+}
+
+// --- BPlusTree ---
+
+/**
+ * @brief Allocate the root of an empty tree
+ *
+ * @param pager Pager of a file with a header, see Pager::allocate_page()
+ * @return PageId Root page to open the tree with
+ */
+PageId BPlusTree::create_root(Pager& pager, const NodeFormat& format)
+{
+  TreeNode node(pager.allocate_page(), pager.get_usable_size(), format);
+  node.init(format.leaf_kind());
+  return node.id();
+}
+
+BPlusTree::BPlusTree(Pager& pager, PageId root, const NodeFormat& format)
+    : m_pager(pager)
+    , m_root(root)
+    , m_capacity(pager.get_usable_size() - HEADER_SIZE)
+    , m_format(format)
+{
+}
+
+TreeNode BPlusTree::load(PageId page) const
+{
+  TreeNode node(m_pager.pin(page), m_capacity + HEADER_SIZE, m_format);
+  if (node.kind() != m_format.leaf_kind()
+      && node.kind() != m_format.interior_kind())
+  {
+    throw std::runtime_error(std::string("Corrupt ") + m_format.name()
+                             + " page");
+  }
+  return node;
+}
+
+TreeNode BPlusTree::allocate(std::uint8_t kind)
+{
+  TreeNode node(m_pager.allocate_page(), m_capacity + HEADER_SIZE, m_format);
+  lock(node);
+  node.init(kind);
+  return node;
+}
+
+// Latch a node until the insert or erase ends, and mark it dirty; comes
+// before any change to the node
+void BPlusTree::lock(TreeNode& node)
+{
+  PageLatch& latch = m_pager.latches().of(node.id());
+  if (std::find(m_locked.begin(), m_locked.end(), &latch) == m_locked.end())
+  {
+    latch.lock();
+    m_locked.push_back(&latch);
+  }
+  node.mark_dirty();
+}
+
+// Walk down to the leaf that holds or would hold a key
+TreeNode BPlusTree::descend(KeyView key, std::vector<Level>& path) const
+{
+  TreeNode node = load(m_root);
+  while (!node.leaf()) {
+    const std::size_t index = node.lower_bound(key);
+    const PageId child = node.child(index);
+    path.push_back({std::move(node), index});
+    node = load(child);
+  }
+  return node;
+}
+
+// Insert a cell into a node, splitting it and its ancestors as needed
+void BPlusTree::insert_cell(std::vector<Level>& path,
+                            TreeNode node,
+                            std::size_t index,
+                            Cell cell)
+{
+  for (;;) {
+    lock(node);
+    if (node.fits(cell.size())) {
+      node.insert_cell(index, cell);
+      return;
+    }
+
+    std::vector<Cell> cells = node.cells();
+    cells.insert(cells.begin() + static_cast<std::ptrdiff_t>(index),
+                 std::move(cell));
+    if (path.empty()) {
+      node = grow_root(std::move(node), path);
+    }
+    TreeNode right = allocate(node.kind());
+    Key separator;
+    if (node.leaf()) {
+      // Appending past the last key starts a new leaf with just that cell
+      const bool append = node.right() == 0 && index + 1 == cells.size();
+      const std::size_t split = append ? index : balanced_split(cells);
+      const auto middle = cells.begin() + static_cast<std::ptrdiff_t>(split);
+      node.assign(cells.begin(), middle);
+      right.assign(middle, cells.end());
+      separator = copy_of(node.key(node.count() - 1));
+      right.set_prev(node.id());
+      link_next(right, node.right());
+      node.set_right(right.id());
+    } else {
+      // The promoted cell moves up; its child becomes the left rightmost
+      const std::size_t split = promoted_split(cells);
+      const auto middle = cells.begin() + static_cast<std::ptrdiff_t>(split);
+      node.assign(cells.begin(), middle);
+      right.assign(middle + 1, cells.end());
+      right.set_right(node.right());
+      node.set_right(m_format.interior_child(middle->data()));
+      separator = copy_of(m_format.interior_key(middle->data()));
+    }
+
+    // The parent pointer moves to the right half; the left half is added
+    Level parent = std::move(path.back());
+    path.pop_back();
+    lock(parent.node);
+    parent.node.set_child(parent.index, right.id());
+    cell = m_format.interior_cell(view_of(separator), node.id());
+    index = parent.index;
+    node = std::move(parent.node);
+  }
+}
+
+// Move the cells of the root into a new child, which is returned
+TreeNode BPlusTree::grow_root(TreeNode root, std::vector<Level>& path)
+{
+  TreeNode child = allocate(root.kind());
+  child.copy_from(root);
+  root.init(m_format.interior_kind());
+  root.set_right(child.id());
+  path.push_back({std::move(root), 0});
+  return child;
+}
+
+// Point a leaf at its next leaf, and that one back
+void BPlusTree::link_next(TreeNode& leaf, PageId next)
+{
+  leaf.set_right(next);
+  if (next != 0) {
+    TreeNode after = load(next);
+    lock(after);
+    after.set_prev(leaf.id());
+  }
+}
+
+// Merge or refill underfull nodes from a node up to the root
+void BPlusTree::rebalance(std::vector<Level>& path, TreeNode node)
+{
+  while (!path.empty() && node.used() < min_fill()) {
+    Level& parent = path.back();
+    lock(parent.node);
+    // The node and its right sibling, or its left one for the last child
+    const bool has_right = parent.index < parent.node.count();
+    const std::size_t between = has_right ? parent.index : parent.index - 1;
+    TreeNode left =
+        has_right ? std::move(node) : load(parent.node.child(between));
+    TreeNode right =
+        has_right ? load(parent.node.child(between + 1)) : std::move(node);
+    lock(left);
+    lock(right);
+
+    // Interior cells are joined by the separator pulled down from the parent
+    std::vector<Cell> cells = left.cells();
+    if (!left.leaf()) {
+      cells.push_back(
+          m_format.interior_cell(parent.node.key(between), left.right()));
+    }
+    std::vector<Cell> right_cells = right.cells();
+    cells.insert(cells.end(),
+                 std::make_move_iterator(right_cells.begin()),
+                 std::make_move_iterator(right_cells.end()));
+
+    if (!left.holds(cells)) {
+      // Too much for one node: share the cells out evenly instead
+      Key separator;
+      if (left.leaf()) {
+        const auto middle = cells.begin()
+            + static_cast<std::ptrdiff_t>(balanced_split(cells));
+        left.assign(cells.begin(), middle);
+        right.assign(middle, cells.end());
+        separator = copy_of(left.key(left.count() - 1));
+      } else {
+        const auto middle = cells.begin()
+            + static_cast<std::ptrdiff_t>(promoted_split(cells));
+        left.assign(cells.begin(), middle);
+        right.assign(middle + 1, cells.end());
+        left.set_right(m_format.interior_child(middle->data()));
+        separator = copy_of(m_format.interior_key(middle->data()));
+      }
+      // A separator of another size may split the parent or leave it
+      // underfull
+      parent.node.remove_cell(between);
+      Cell cell = m_format.interior_cell(view_of(separator), left.id());
+      if (!parent.node.fits(cell.size())) {
+        TreeNode full = std::move(parent.node);
+        path.pop_back();
+        insert_cell(path, std::move(full), between, std::move(cell));
+        return;
+      }
+      parent.node.insert_cell(between, cell);
+    } else {
+      left.assign(cells.begin(), cells.end());
+      if (left.leaf()) {
+        link_next(left, right.right());
+      } else {
+        left.set_right(right.right());
+      }
+      parent.node.remove_cell(between);
+      parent.node.set_child(between, left.id());
+      const PageId freed = right.id();
+      right.release();
+      m_pager.free_page(freed);
+    }
+
+    node = std::move(parent.node);
+    path.pop_back();
+  }
+  if (path.empty()) {
+    shrink_root(std::move(node));
+  }
+}
+
+// A root left with one child takes over its cells
+void BPlusTree::shrink_root(TreeNode root)
+{
+  while (!root.leaf() && root.count() == 0) {
+    TreeNode child = load(root.right());
+    lock(root);
+    lock(child);
+    root.copy_from(child);
+    const PageId freed = child.id();
+    child.release();
+    m_pager.free_page(freed);
+  }
+}
+
+void BPlusTree::broken(PageId page, const char* what) const
+{
+  throw std::logic_error(std::string(m_format.name()) + " page "
+                         + std::to_string(page) + ": " + what);
+}
+
+std::size_t BPlusTree::depth() const
+{
+  std::size_t levels = 1;
+  for (TreeNode node = load(m_root); !node.leaf();
+       node = load(node.child(0)))
+  {
+    levels++;
+  }
+  return levels;
+}
+
+struct BPlusTree::VerifyWalk
+{
+  std::size_t cells {0};
+  std::size_t leaf_depth {0};
+  // Last leaf visited, and the next leaf it links to
+  PageId last_leaf {0};
+  PageId next_leaf {0};
+};
+
+/**
+ * @brief Check the structure of the whole tree
+ *
+ * Checks the layout of every node and, through the format, the leaf cells,
+ * that keys ascend within and across nodes, that all leaves are at the
+ * same depth and linked in order, and that every node but the root is
+ * non-empty. Nodes off the rightmost path must also be at least a quarter
+ * full; the rightmost leaf is exempt because appends start it with a
+ * single cell.
+ *
+ * @return std::size_t Number of leaf cells
+ */
+std::size_t BPlusTree::verify() const
+{
+  VerifyWalk walk;
+  verify_node(m_root, std::nullopt, std::nullopt, 1, true, walk);
+  if (walk.next_leaf != 0) {
+    broken(walk.last_leaf, "last leaf links to a next leaf");
+  }
+  return walk.cells;
+}
+
+// Keys of the subtree must lie in (low, high]
+void BPlusTree::verify_node(PageId page,
+                            const std::optional<Key>& low,
+                            const std::optional<Key>& high,
+                            std::size_t depth,
+                            bool rightmost,
+                            VerifyWalk& walk) const
+{
+  const TreeNode node = load(page);
+  const std::size_t usable = m_capacity + HEADER_SIZE;
+  const std::size_t count = node.count();
+  if (node.arrays()) {
+    if (count > node.max_keys()) {
+      broken(page, "more keys than fit");
+    }
+  } else {
+    if (node.content() > usable
+        || node.content() < HEADER_SIZE + count * SLOT_SIZE)
+    {
+      broken(page, "cell content area overlaps the header");
+    }
+    std::size_t cell_bytes = node.fragmented();
+    for (std::size_t i = 0; i < count; i++) {
+      const auto offset =
+          static_cast<std::size_t>(node.cell(i) - node.data());
+      if (offset < node.content() || offset + node.cell_size(i) > usable) {
+        broken(page, "cell outside the content area");
+      }
+      cell_bytes += node.cell_size(i);
+      if (node.leaf()) {
+        const char* what =
+            m_format.check_leaf_cell(m_pager, m_capacity, node.cell(i));
+        if (what != nullptr) {
+          broken(page, what);
+        }
+      }
+    }
+    if (cell_bytes != usable - node.content()) {
+      broken(page, "free space does not add up");
+    }
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    const KeyView key = node.key(i);
+    if ((i > 0 && m_format.compare(key, node.key(i - 1)) <= 0)
+        || (low && m_format.compare(key, view_of(*low)) <= 0)
+        || (high && m_format.compare(key, view_of(*high)) > 0))
+    {
+      broken(page, "keys out of order");
+    }
+  }
+
+  if (page != m_root) {
+    if (count == 0) {
+      broken(page, "empty node");
+    }
+    if (!rightmost && node.used() < min_fill()) {
+      broken(page, "node under a quarter full");
+    }
+  }
+
+  if (node.leaf()) {
+    if (walk.leaf_depth == 0) {
+      walk.leaf_depth = depth;
+    } else if (walk.leaf_depth != depth) {
+      broken(page, "leaves at different depths");
+    }
+    if (node.prev() != walk.last_leaf
+        || (walk.last_leaf != 0 && walk.next_leaf != page))
+    {
+      broken(page, "leaf links out of order");
+    }
+    walk.cells += count;
+    walk.last_leaf = page;
+    walk.next_leaf = node.right();
+    return;
+  }
+
+  for (std::size_t i = 0; i <= count; i++) {
+    verify_node(node.child(i),
+                i == 0 ? low : copy_of(node.key(i - 1)),
+                i == count ? high : copy_of(node.key(i)),
+                depth + 1,
+                rightmost && i == count,
+                walk);
+  }
+}
+
+// --- TreeCursor ---
+
+TreeCursor::TreeCursor(const BPlusTree& tree) noexcept
+    : m_tree(&tree)
+{
+}
+
+bool TreeCursor::first()
+{
+  TreeNode node = m_tree->load(m_tree->m_root);
+  while (!node.leaf()) {
+    node = m_tree->load(node.child(0));
+  }
+  return enter(node.take(), 0);
+}
+
+bool TreeCursor::last()
+{
+  TreeNode node = m_tree->load(m_tree->m_root);
+  while (!node.leaf()) {
+    node = m_tree->load(node.right());
+  }
+  if (node.count() == 0) {
+    m_leaf.release();
+    return false;
+  }
+  const std::size_t cell = node.count() - 1;
+  return enter(node.take(), cell);
+}
+
+bool TreeCursor::seek_key(KeyView key)
+{
+  TreeNode node = m_tree->load(m_tree->m_root);
+  while (!node.leaf()) {
+    node = m_tree->load(node.child(node.lower_bound(key)));
+  }
+  const std::size_t cell = node.lower_bound(key);
+  return enter(node.take(), cell);
+}
+
+bool TreeCursor::next()
+{
+  if (!valid()) {
+    return false;
+  }
+  return enter(std::move(m_leaf), m_cell + 1);
+}
+
+bool TreeCursor::prev()
+{
+  if (!valid()) {
+    return false;
+  }
+  if (m_cell > 0) {
+    m_cell--;
+    return true;
+  }
+  const PageId prev = load_u32(m_leaf.bytes() + TreeNode::PREV_OFFSET);
+  if (prev == 0) {
+    m_leaf.release();
+    return false;
+  }
+  m_leaf = m_tree->load(prev).take();
+  m_cell = TreeNode::count_of(m_leaf.bytes()) - 1;
+  return true;
+}
+
+// Stand on a cell of a leaf, or on the first cell after the leaf's end
+bool TreeCursor::enter(PageHandle leaf, std::size_t cell)
+{
+  m_leaf = std::move(leaf);
+  m_cell = cell;
+  while (m_cell >= TreeNode::count_of(m_leaf.bytes())) {
+    const PageId next = load_u32(m_leaf.bytes() + TreeNode::RIGHT_OFFSET);
+    if (next == 0) {
+      m_leaf.release();
+      return false;
+    }
+    m_leaf = m_tree->load(next).take();
+    m_cell = 0;
+  }
+  return true;
+}
+
+// --- TreeLoader ---
+
+/**
+ * @param pager Pager of a file with a header; the tree goes to new pages
+ * @param options Fill factor; throws invalid_argument outside 50-100
+ */
+TreeLoader::TreeLoader(Pager& pager,
+                       const NodeFormat& format,
+                       BulkLoadOptions options)
+    : m_pager(pager)
+    , m_capacity(pager.get_usable_size() - HEADER_SIZE)
+    , m_format(format)
+    , m_target(m_capacity * options.fill_percent / 100)
+{
+  if (options.fill_percent < 50 || options.fill_percent > 100) {
+    throw std::invalid_argument("Fill factor must be 50 to 100 percent");
+  }
+}
+
+TreeLoader::~TreeLoader() = default;
+
+TreeNode TreeLoader::open(std::uint8_t kind)
+{
+  TreeNode node(m_pager.allocate_page(), m_capacity + HEADER_SIZE, m_format);
+  node.init(kind);
+  return node;
+}
+
+void TreeLoader::check_order(KeyView key) const
+{
+  if (m_levels.empty()) {
+    return;
+  }
+  const TreeNode& leaf = m_levels.front();
+  if (m_format.compare(key, leaf.key(leaf.count() - 1)) <= 0) {
+    throw std::invalid_argument("Keys must come in ascending order");
+  }
+}
+
+void TreeLoader::add_cell(const Cell& cell)
+{
+  if (m_levels.empty()) {
+    m_levels.push_back(open(m_format.leaf_kind()));
+  }
+
+  TreeNode& leaf = m_levels.front();
+  if (leaf.count() > 0
+      && leaf.used() + leaf.footprint(cell.size()) > m_target)
+  {
+    TreeNode next = open(m_format.leaf_kind());
+    next.set_prev(leaf.id());
+    leaf.set_right(next.id());
+    const std::vector<std::byte> separator =
+        copy_of(leaf.key(leaf.count() - 1));
+    const PageId full = leaf.id();
+    leaf = std::move(next);
+    add_child(1, view_of(separator), full);
+  }
+  TreeNode& last = m_levels.front();
+  last.insert_cell(last.count(), cell);
+  m_cells++;
+}
+
+// Hand a full node up to the level above
+void TreeLoader::add_child(std::size_t level, KeyView key, PageId child)
+{
+  if (level == m_levels.size()) {
+    m_levels.push_back(open(m_format.interior_kind()));
+  }
+  const Cell cell = m_format.interior_cell(key, child);
+
+  // The last child becomes the rightmost one and its key moves up, once
+  // the cells before it fill a quarter of a page; until then the cell
+  // fits, the node being under half full
+  TreeNode& node = m_levels[level];
+  if (node.count() > 0
+      && node.used() + node.footprint(cell.size()) > m_target
+      && node.used() - node.footprint_of(node.count() - 1) >= m_capacity / 4)
+  {
+    const std::size_t last = node.count() - 1;
+    const std::vector<std::byte> separator = copy_of(node.key(last));
+    node.set_right(node.child(last));
+    node.remove_cell(last);
+    const PageId full = node.id();
+    node = open(m_format.interior_kind());
+    add_child(level + 1, view_of(separator), full);
+  }
+  TreeNode& open_node = m_levels[level];
+  open_node.insert_cell(open_node.count(), cell);
+}
+
+/**
+ * @brief Close the open nodes
+ *
+ * The open node of each level becomes the rightmost child of the one
+ * above; the top one is the root. An empty load yields an empty leaf.
+ *
+ * @return PageId Root page to open the tree with
+ */
+PageId TreeLoader::finish()
+{
+  if (m_levels.empty()) {
+    m_levels.push_back(open(m_format.leaf_kind()));
+  }
+  PageId child = m_levels.front().id();
+  for (std::size_t level = 1; level < m_levels.size(); level++) {
+    m_levels[level].set_right(child);
+    child = m_levels[level].id();
+  }
+  m_levels.clear();
+  return child;
+}
+
+void TreeLoader::finish(PageId root)
+{
+  const PageId top = finish();
+  TreeNode source(m_pager.pin(top), m_capacity + HEADER_SIZE, m_format);
+  TreeNode target(m_pager.pin(root), m_capacity + HEADER_SIZE, m_format);
+  PageLatch& latch = m_pager.latches().of(root);
+  latch.lock();
+  target.mark_dirty();
+  target.copy_from(source);
+  latch.unlock();
+  source.release();
+  m_pager.free_page(top);
+}
@@ -0,0 +1,471 @@
+#ifndef BPLUS_TREE_HPP
+#define BPLUS_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "byte_order.hpp"
+#include "page_latch.hpp"
+#include "pager.hpp"
+
+class TreeNode;
+
+// A key inside a cell or a caller's buffer
+struct KeyView
+{
+  const std::byte* data;
+  std::size_t size;
+};
+
+inline KeyView view_of(const std::vector<std::byte>& key) noexcept
+{
+  return {key.data(), key.size()};
+}
+
+/**
+ * @brief Cells and key order of one kind of B+tree
+ *
+ * TreeNode and BPlusTree move cells around whole and only ask the format
+ * for their sizes, keys and children. A leaf cell holds a key and what
+ * goes with it; an interior cell holds a key and the child page holding
+ * the keys up to it.
+ *
+ * A format whose interior keys all have the same size may have interior
+ * nodes keep them in two arrays, keys then children, instead of slotted
+ * cells; the interior cell is then only their interchange format.
+ */
+class NodeFormat
+{
+public:
+  // `array_key_size` is the size of every interior key for interior nodes
+  // of arrays, 0 for slotted ones; `name` names the tree in errors
+  NodeFormat(std::uint8_t leaf_kind,
+             std::uint8_t interior_kind,
+             std::size_t array_key_size,
+             const char* name) noexcept;
+  virtual ~NodeFormat() = default;
+
+  std::uint8_t leaf_kind() const noexcept { return m_leaf_kind; }
+  std::uint8_t interior_kind() const noexcept { return m_interior_kind; }
+  std::size_t array_key_size() const noexcept { return m_array_key_size; }
+  const char* name() const noexcept { return m_name; }
+
+  virtual std::size_t leaf_cell_size(const std::byte* cell) const noexcept = 0;
+  virtual KeyView leaf_key(const std::byte* cell) const noexcept = 0;
+  virtual std::size_t interior_cell_size(
+      const std::byte* cell) const noexcept = 0;
+  virtual KeyView interior_key(const std::byte* cell) const noexcept = 0;
+  virtual PageId interior_child(const std::byte* cell) const noexcept = 0;
+  virtual void set_interior_child(std::byte* cell,
+                                  PageId child) const noexcept = 0;
+  virtual std::vector<std::byte> interior_cell(KeyView key,
+                                               PageId child) const = 0;
+  // Negative, zero or positive as `a` sorts before, with or after `b`
+  virtual int compare(KeyView a, KeyView b) const noexcept = 0;
+
+  // First cell of a node whose key is not below `key`; count() if none. A
+  // binary search with compare() unless overridden.
+  virtual std::size_t lower_bound(const TreeNode& node,
+                                  KeyView key) const noexcept;
+  // What is wrong with a leaf cell, or nullptr; called by verify()
+  virtual const char* check_leaf_cell(Pager& pager,
+                                      std::size_t capacity,
+                                      const std::byte* cell) const;
+
+private:
+  std::uint8_t m_leaf_kind;
+  std::uint8_t m_interior_kind;
+  std::size_t m_array_key_size;
+  const char* m_name;
+};
+
+/**
+ * @brief Pinned node page of a BPlusTree with accessors for its layout
+ *
+ * Leaves, and interior nodes of formats without fixed-size keys, are
+ * slotted pages of variable-size cells. Interior nodes of arrays hold
+ * fixed-size entries in two arrays, keys then children, so that the keys
+ * are contiguous for a vectorised search. Call mark_dirty() before any of
+ * the modifiers; BPlusTree calls BPlusTree::lock() instead.
+ */
+class TreeNode
+{
+public:
+  using Cell = std::vector<std::byte>;
+
+  static constexpr std::size_t KIND_OFFSET = 0;
+  static constexpr std::size_t COUNT_OFFSET = 2;
+  static constexpr std::size_t CONTENT_OFFSET = 4;
+  static constexpr std::size_t FRAGMENTED_OFFSET = 6;
+  static constexpr std::size_t RIGHT_OFFSET = 8;
+  static constexpr std::size_t PREV_OFFSET = 12;
+  static constexpr std::size_t HEADER_SIZE = 16;
+  // Cell offset of a slotted node
+  static constexpr std::size_t SLOT_SIZE = 2;
+
+  // Readers of a node page, for cursors and readers that take no latch
+  static std::size_t count_of(const std::byte* page) noexcept
+  {
+    return load_u16(page + COUNT_OFFSET);
+  }
+  static const std::byte* cell_of(const std::byte* page,
+                                  std::size_t index) noexcept
+  {
+    return page + load_u16(page + HEADER_SIZE + index * SLOT_SIZE);
+  }
+
+  TreeNode() noexcept = default;
+  TreeNode(PageHandle handle,
+           std::size_t usable,
+           const NodeFormat& format) noexcept;
+
+  PageId id() const noexcept { return m_handle.id(); }
+  std::uint8_t kind() const noexcept
+  {
+    return std::to_integer<std::uint8_t>(data()[KIND_OFFSET]);
+  }
+  bool leaf() const noexcept { return kind() == m_format->leaf_kind(); }
+  // Interior node keeping its entries in arrays rather than slots
+  bool arrays() const noexcept { return m_max_keys != 0 && !leaf(); }
+  std::size_t count() const noexcept { return count_of(data()); }
+  // Slotted nodes only
+  const std::byte* cell(std::size_t index) const noexcept
+  {
+    return cell_of(data(), index);
+  }
+  std::size_t cell_size(std::size_t index) const noexcept
+  {
+    return leaf() ? m_format->leaf_cell_size(cell(index))
+                  : m_format->interior_cell_size(cell(index));
+  }
+  KeyView key(std::size_t index) const noexcept;
+  // Child left of key(index); count() gives the rightmost child
+  PageId child(std::size_t index) const noexcept;
+  // Interior: rightmost child; leaf: next leaf
+  PageId right() const noexcept { return load_u32(data() + RIGHT_OFFSET); }
+  PageId prev() const noexcept { return load_u32(data() + PREV_OFFSET); }
+  // Nodes of arrays only
+  std::size_t max_keys() const noexcept { return m_max_keys; }
+  const std::byte* keys() const noexcept { return data() + HEADER_SIZE; }
+  // Slotted nodes only
+  std::size_t content() const noexcept
+  {
+    const std::size_t start = load_u16(data() + CONTENT_OFFSET);
+    return start == 0 ? 65536 : start;
+  }
+  std::size_t fragmented() const noexcept
+  {
+    return load_u16(data() + FRAGMENTED_OFFSET);
+  }
+  std::size_t free_space() const noexcept;
+  // Bytes taken by the cells and their offsets
+  std::size_t used() const noexcept
+  {
+    return arrays() ? count() * entry_size()
+                    : m_usable - HEADER_SIZE - free_space();
+  }
+  // Bytes a cell takes in the node
+  std::size_t footprint(std::size_t cell_bytes) const noexcept
+  {
+    return arrays() ? entry_size() : cell_bytes + SLOT_SIZE;
+  }
+  // Bytes cell `index` takes in the node
+  std::size_t footprint_of(std::size_t index) const noexcept
+  {
+    return arrays() ? entry_size() : cell_size(index) + SLOT_SIZE;
+  }
+  bool fits(std::size_t cell_bytes) const noexcept
+  {
+    return footprint(cell_bytes) <= free_space();
+  }
+  // Whether an empty node of this kind takes all the cells
+  bool holds(const std::vector<Cell>& cells) const noexcept;
+
+  // First cell whose key is not below `key`; count() if none
+  std::size_t lower_bound(KeyView key) const noexcept
+  {
+    return m_format->lower_bound(*this, key);
+  }
+
+  std::vector<Cell> cells() const;
+
+  void mark_dirty() { m_handle.mark_dirty(); }
+
+  void init(std::uint8_t kind) noexcept;
+  void set_child(std::size_t index, PageId child) noexcept;
+  void set_right(PageId page) noexcept
+  {
+    store_u32(bytes() + RIGHT_OFFSET, page);
+  }
+  void set_prev(PageId page) noexcept
+  {
+    store_u32(bytes() + PREV_OFFSET, page);
+  }
+
+  // The cell must fit
+  void insert_cell(std::size_t index, const Cell& cell);
+  void remove_cell(std::size_t index) noexcept;
+  // Replace every cell; the links are kept
+  void assign(std::vector<Cell>::const_iterator first,
+              std::vector<Cell>::const_iterator last);
+  // Take over the cells and links of another node of the same page size
+  void copy_from(const TreeNode& other) noexcept;
+
+  const std::byte* data() const noexcept { return m_handle.bytes(); }
+  PageHandle take() noexcept { return std::move(m_handle); }
+  void release() noexcept { m_handle.release(); }
+
+private:
+  PageHandle m_handle;
+  std::size_t m_usable {0};
+  const NodeFormat* m_format {nullptr};
+  // Entries an interior node of arrays has room for; 0 if slotted
+  std::size_t m_max_keys {0};
+
+  std::byte* bytes() noexcept { return m_handle.bytes(); }
+  std::size_t entry_size() const noexcept
+  {
+    return m_format->array_key_size() + sizeof(PageId);
+  }
+  std::size_t children_offset() const noexcept
+  {
+    return HEADER_SIZE + m_max_keys * m_format->array_key_size();
+  }
+  void shift_entries(std::size_t from, std::size_t to) noexcept;
+  void set_count(std::size_t cells) noexcept
+  {
+    store_u16(bytes() + COUNT_OFFSET, static_cast<std::uint16_t>(cells));
+  }
+  void set_content(std::size_t start) noexcept
+  {
+    store_u16(bytes() + CONTENT_OFFSET, static_cast<std::uint16_t>(start));
+  }
+  void defragment();
+};
+
+/**
+ * @brief Node, split and merge machinery shared by BTree and IndexTree
+ *
+ * Every node starts with the same header (little-endian):
+ *
+ *   header  offset  size  field
+ *                0     1  kind, see the NodeFormat of the tree
+ *                2     2  number of cells
+ *                4     2  slotted: start of the cell content area; 0 = 65536
+ *                6     2  slotted: bytes of free space inside the content area
+ *                8     4  interior: rightmost child; leaf: next leaf
+ *               12     4  leaf: previous leaf
+ *
+ * A slotted node has cell offsets, 2 bytes each in key order, after the
+ * header, and the cells packed from the end of the usable area down. The
+ * child of interior cell i holds the keys up to key i; the rightmost child
+ * holds those past the last one. Leaves are linked both ways in key order.
+ *
+ * A node that overflows splits in two halves of about equal bytes and
+ * inserts a cell for the left half into its parent; appending past the
+ * last key instead starts a new leaf, so rising keys leave full leaves. An
+ * interior node splits around the cell that best balances the bytes of its
+ * halves, which moves up. A node that drops under a quarter of a page
+ * merges with a sibling, or shares the cells of both out evenly when they
+ * do not fit in one page; the new separator may then split the parent. The
+ * root never moves: it grows by moving its cells down into a new child and
+ * shrinks by taking over its only child.
+ *
+ * The writer locks every node it changes, the latches coming from the
+ * Pager (see PageLatch), and holds them all until its insert or erase
+ * ends, so readers that validate their reads never see half a split or
+ * merge.
+ */
+class BPlusTree
+{
+public:
+  PageId root() const noexcept { return m_root; }
+  Pager& pager() const noexcept { return m_pager; }
+  // Levels from the root down to the leaves, 1 for a lone leaf
+  std::size_t depth() const;
+  // Walk the whole tree and return its number of leaf cells; throws
+  // logic_error naming the first broken invariant
+  std::size_t verify() const;
+
+protected:
+  using Cell = TreeNode::Cell;
+
+  // An interior node on the way down and the index of the child taken
+  struct Level
+  {
+    TreeNode node;
+    std::size_t index;
+  };
+
+  // Holds the latches of an insert or erase until it ends, even by an
+  // exception, so that readers see none of its writes half done
+  class WriteScope
+  {
+  public:
+    explicit WriteScope(BPlusTree& tree) noexcept
+        : m_tree(tree)
+    {
+    }
+    ~WriteScope()
+    {
+      for (PageLatch* latch : m_tree.m_locked) {
+        latch->unlock();
+      }
+      m_tree.m_locked.clear();
+    }
+
+    WriteScope(const WriteScope&) = delete;
+    WriteScope& operator=(const WriteScope&) = delete;
+    WriteScope(WriteScope&&) = delete;
+    WriteScope& operator=(WriteScope&&) = delete;
+
+  private:
+    BPlusTree& m_tree;
+  };
+
+  Pager& m_pager;
+  PageId m_root;
+  // Bytes of a page available to cells and their offsets
+  std::size_t m_capacity;
+  const NodeFormat& m_format;
+  // Latches taken by the running insert or erase
+  std::vector<PageLatch*> m_locked;
+
+  static PageId create_root(Pager& pager, const NodeFormat& format);
+
+  BPlusTree(Pager& pager, PageId root, const NodeFormat& format);
+
+  TreeNode load(PageId page) const;
+  TreeNode allocate(std::uint8_t kind);
+  void lock(TreeNode& node);
+  TreeNode descend(KeyView key, std::vector<Level>& path) const;
+  void insert_cell(std::vector<Level>& path,
+                   TreeNode node,
+                   std::size_t index,
+                   Cell cell);
+  void rebalance(std::vector<Level>& path, TreeNode node);
+  std::size_t min_fill() const noexcept { return m_capacity / 4; }
+  [[noreturn]] void broken(PageId page, const char* what) const;
+
+private:
+  friend class TreeCursor;
+
+  struct VerifyWalk;
+  using Key = std::vector<std::byte>;
+
+  TreeNode grow_root(TreeNode root, std::vector<Level>& path);
+  void shrink_root(TreeNode root);
+  void link_next(TreeNode& leaf, PageId next);
+  void verify_node(PageId page,
+                   const std::optional<Key>& low,
+                   const std::optional<Key>& high,
+                   std::size_t depth,
+                   bool rightmost,
+                   VerifyWalk& walk) const;
+};
+
+/**
+ * @brief Position on a leaf cell of a BPlusTree
+ *
+ * The cursor keeps the leaf it stands on pinned and moves between leaves
+ * along their sibling links, so a scan never climbs back into the interior
+ * nodes. Any insert or erase invalidates the cursors of the tree; place
+ * them again with first(), last() or a seek.
+ */
+class TreeCursor
+{
+public:
+  // Each returns valid()
+  bool first();
+  bool last();
+  bool next();
+  bool prev();
+
+  bool valid() const noexcept { return static_cast<bool>(m_leaf); }
+
+protected:
+  explicit TreeCursor(const BPlusTree& tree) noexcept;
+
+  const BPlusTree& tree() const noexcept { return *m_tree; }
+  // The current leaf cell
+  const std::byte* cell() const noexcept
+  {
+    return TreeNode::cell_of(m_leaf.bytes(), m_cell);
+  }
+  // Stand on the first cell whose key is not below `key`
+  bool seek_key(KeyView key);
+
+private:
+  const BPlusTree* m_tree;
+  PageHandle m_leaf;
+  std::size_t m_cell {0};
+
+  bool enter(PageHandle leaf, std::size_t cell);
+};
+
+struct BulkLoadOptions
+{
+  // How full the loader packs each node, from 50 to 100 percent; room left
+  // over takes later inserts without splitting
+  unsigned fill_percent {90};
+};
+
+/**
+ * @brief Builds a new BPlusTree bottom-up from leaf cells in ascending key
+ * order
+ *
+ * Cells are appended to a leaf until it reaches the fill factor; the leaf
+ * is then linked to a fresh one and its last key handed up to the level
+ * above, which fills and hands up the same way. A full interior node keeps
+ * a quarter of a page whatever the size of its keys. Only one node per
+ * level is pinned and pages are allocated in the order they fill, so
+ * write-back of the leaves is sequential. No node is split or visited
+ * twice. See BTreeLoader and IndexLoader.
+ */
+class TreeLoader
+{
+public:
+  ~TreeLoader();
+
+  TreeLoader(const TreeLoader&) = delete;
+  TreeLoader& operator=(const TreeLoader&) = delete;
+  TreeLoader(TreeLoader&&) = delete;
+  TreeLoader& operator=(TreeLoader&&) = delete;
+
+  // Close the open nodes; returns the root of the tree. Call once.
+  PageId finish();
+  // Close the open nodes and move the top one into `root`, the root of an
+  // empty tree, so that the tree keeps a root allocated beforehand
+  void finish(PageId root);
+
+protected:
+  using Cell = TreeNode::Cell;
+
+  TreeLoader(Pager& pager, const NodeFormat& format, BulkLoadOptions options);
+
+  Pager& m_pager;
+  // Bytes of a page available to cells and their offsets
+  std::size_t m_capacity;
+  // Leaf cells added so far
+  std::size_t m_cells {0};
+
+  // Throws invalid_argument unless `key` sorts after the last key added
+  void check_order(KeyView key) const;
+  // Append a leaf cell, whose key check_order() accepted
+  void add_cell(const Cell& cell);
+
+private:
+  const NodeFormat& m_format;
+  // Bytes of cells a node is filled to
+  std::size_t m_target;
+  // The node being filled on each level, leaves first
+  std::vector<TreeNode> m_levels;
+
+  TreeNode open(std::uint8_t kind);
+  void add_child(std::size_t level, KeyView key, PageId child);
+};
+
+#endif  // BPLUS_TREE_HPP
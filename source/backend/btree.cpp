@@ -0,0 +1,483 @@
+#include <array>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "btree.hpp"
+
+#include "byte_order.hpp"
+#include "key_search.hpp"
+#include "overflow.hpp"
+
+namespace
+{
+constexpr std::uint8_t LEAF = 0x0D;
+constexpr std::uint8_t INTERIOR = 0x05;
+
+constexpr std::size_t KIND_OFFSET = TreeNode::KIND_OFFSET;
+constexpr std::size_t RIGHT_OFFSET = TreeNode::RIGHT_OFFSET;
+constexpr std::size_t HEADER_SIZE = TreeNode::HEADER_SIZE;
+constexpr std::size_t SLOT_SIZE = TreeNode::SLOT_SIZE;
+
+constexpr std::size_t ROWID_SIZE = 8;
+// Rowid and payload size
+constexpr std::size_t LEAF_CELL_HEADER = ROWID_SIZE + 2;
+// Flags a spilled cell in its payload size, which is then that of the head
+constexpr std::uint16_t SPILLED = 0x8000;
+// Whole payload size and first overflow page of a spilled cell
+constexpr std::size_t SPILL_SIZE = 8;
+// Rowid and child page
+constexpr std::size_t INTERIOR_CELL_SIZE = ROWID_SIZE + 4;
+
+using Cell = TreeNode::Cell;
+
+std::int64_t cell_rowid(const std::byte* cell) noexcept
+{
+  return static_cast<std::int64_t>(load_u64(cell));
+}
+
+bool spilled(const std::byte* leaf_cell) noexcept
+{
+  return (load_u16(leaf_cell + ROWID_SIZE) & SPILLED) != 0;
+}
+
+// Payload bytes inside the cell
+std::size_t local_size(const std::byte* leaf_cell) noexcept
+{
+  return load_u16(leaf_cell + ROWID_SIZE) & (SPILLED - 1U);
+}
+
+std::size_t payload_size(const std::byte* leaf_cell) noexcept
+{
+  return spilled(leaf_cell) ? load_u32(leaf_cell + LEAF_CELL_HEADER)
+                            : local_size(leaf_cell);
+}
+
+const std::byte* local_payload(const std::byte* leaf_cell) noexcept
+{
+  return leaf_cell + LEAF_CELL_HEADER + (spilled(leaf_cell) ? SPILL_SIZE : 0);
+}
+
+PageId overflow_page(const std::byte* leaf_cell) noexcept
+{
+  return load_u32(leaf_cell + LEAF_CELL_HEADER + 4);
+}
+
+std::size_t leaf_cell_size(const std::byte* leaf_cell) noexcept
+{
+  return static_cast<std::size_t>(local_payload(leaf_cell) - leaf_cell)
+      + local_size(leaf_cell);
+}
+
+// Leaf cells are kept under a quarter of a page, so that every leaf holds
+// at least four rows and a split always leaves two halves that fit
+std::size_t max_payload_of(std::size_t capacity) noexcept
+{
+  return capacity / 4 - SLOT_SIZE - LEAF_CELL_HEADER;
+}
+
+// A payload over max_payload_of() keeps a head that leaves the cell the
+// same size, and spills the rest into overflow pages
+Cell leaf_cell(Pager& pager,
+               std::size_t capacity,
+               std::int64_t rowid,
+               const std::vector<std::byte>& payload)
+{
+  if (payload.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("Payload too large for a B+tree row");
+  }
+  const std::size_t max_payload = max_payload_of(capacity);
+  const bool spill = payload.size() > max_payload;
+  const std::size_t local = spill ? max_payload - SPILL_SIZE : payload.size();
+  const std::size_t header = LEAF_CELL_HEADER + (spill ? SPILL_SIZE : 0);
+
+  Cell cell(header + local);
+  store_u64(cell.data(), static_cast<std::uint64_t>(rowid));
+  store_u16(cell.data() + ROWID_SIZE,
+            static_cast<std::uint16_t>(local | (spill ? SPILLED : 0U)));
+  if (spill) {
+    store_u32(cell.data() + LEAF_CELL_HEADER,
+              static_cast<std::uint32_t>(payload.size()));
+    store_u32(
+        cell.data() + LEAF_CELL_HEADER + 4,
+        write_overflow(pager, payload.data() + local, payload.size() - local));
+  }
+  if (local > 0) {
+    std::memcpy(cell.data() + header, payload.data(), local);
+  }
+  return cell;
+}
+
+// A rowid as a key: its 8 bytes as stored
+class RowidKey
+{
+public:
+  explicit RowidKey(std::int64_t rowid) noexcept
+  {
+    store_u64(m_bytes.data(), static_cast<std::uint64_t>(rowid));
+  }
+
+  KeyView view() const noexcept { return {m_bytes.data(), m_bytes.size()}; }
+
+private:
+  std::array<std::byte, ROWID_SIZE> m_bytes {};
+};
+
+std::int64_t key_rowid(KeyView key) noexcept
+{
+  return cell_rowid(key.data);
+}
+
+/**
+ * @brief Rows keyed by rowid; interior nodes keep arrays of rowids
+ *
+ * An interior cell, the interchange format of an entry, is the rowid (8)
+ * and child page (4).
+ */
+class RowidFormat final : public NodeFormat
+{
+public:
+  RowidFormat() noexcept
+      : NodeFormat(LEAF, INTERIOR, ROWID_SIZE, "B+tree")
+  {
+  }
+
+  std::size_t leaf_cell_size(const std::byte* cell) const noexcept override
+  {
+    return ::leaf_cell_size(cell);
+  }
+  KeyView leaf_key(const std::byte* cell) const noexcept override
+  {
+    return {cell, ROWID_SIZE};
+  }
+  std::size_t interior_cell_size(
+      const std::byte* /*cell*/) const noexcept override
+  {
+    return INTERIOR_CELL_SIZE;
+  }
+  KeyView interior_key(const std::byte* cell) const noexcept override
+  {
+    return {cell, ROWID_SIZE};
+  }
+  PageId interior_child(const std::byte* cell) const noexcept override
+  {
+    return load_u32(cell + ROWID_SIZE);
+  }
+  void set_interior_child(std::byte* cell,
+                          PageId child) const noexcept override
+  {
+    store_u32(cell + ROWID_SIZE, child);
+  }
+  Cell interior_cell(KeyView key, PageId child) const override
+  {
+    Cell cell(INTERIOR_CELL_SIZE);
+    std::memcpy(cell.data(), key.data, ROWID_SIZE);
+    store_u32(cell.data() + ROWID_SIZE, child);
+    return cell;
+  }
+  int compare(KeyView a, KeyView b) const noexcept override
+  {
+    const std::int64_t left = key_rowid(a);
+    const std::int64_t right = key_rowid(b);
+    return left < right ? -1 : (left > right ? 1 : 0);
+  }
+
+  std::size_t lower_bound(const TreeNode& node,
+                          KeyView key) const noexcept override
+  {
+    const std::int64_t rowid = key_rowid(key);
+    if (node.arrays()) {
+      return key_lower_bound(node.keys(), node.count(), rowid);
+    }
+    std::size_t low = 0;
+    std::size_t high = node.count();
+    while (low < high) {
+      const std::size_t middle = low + (high - low) / 2;
+      if (cell_rowid(node.cell(middle)) < rowid) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low;
+  }
+
+  const char* check_leaf_cell(Pager& pager,
+                              std::size_t capacity,
+                              const std::byte* cell) const override
+  {
+    if (!spilled(cell)) {
+      return nullptr;
+    }
+    const std::size_t max_payload = max_payload_of(capacity);
+    if (payload_size(cell) <= max_payload
+        || local_size(cell) != max_payload - SPILL_SIZE)
+    {
+      return "spilled cell of the wrong size";
+    }
+    verify_overflow(
+        pager, overflow_page(cell), payload_size(cell) - local_size(cell));
+    return nullptr;
+  }
+};
+
+const NodeFormat& rowid_format()
+{
+  static const RowidFormat format;
+  return format;
+}
+}  // namespace
+
+/**
+ * @brief Allocate the root of an empty tree
+ *
+ * @param pager Pager of a file with a header, see Pager::allocate_page()
+ * @return PageId Root page to open the tree with
+ */
+PageId BTree::create(Pager& pager)
+{
+  return create_root(pager, rowid_format());
+}
+
+BTree::BTree(Pager& pager, PageId root)
+    : BPlusTree(pager, root, rowid_format())
+{
+}
+
+std::size_t BTree::max_payload() const noexcept
+{
+  return max_payload_of(m_capacity);
+}
+
+/**
+ * @brief Insert a row
+ *
+ * @param rowid Key of the row; must not be in the tree yet
+ * @param payload Row bytes; past max_payload() the tail goes to overflow
+ * pages
+ */
+void BTree::insert(std::int64_t rowid, const std::vector<std::byte>& payload)
+{
+  const WriteScope scope(*this);
+  std::vector<Level> path;
+  const RowidKey key(rowid);
+  TreeNode leaf = descend(key.view(), path);
+  const std::size_t index = leaf.lower_bound(key.view());
+  if (index < leaf.count() && cell_rowid(leaf.cell(index)) == rowid) {
+    throw std::invalid_argument("Duplicate rowid");
+  }
+  insert_cell(path,
+              std::move(leaf),
+              index,
+              leaf_cell(m_pager, m_capacity, rowid, payload));
+}
+
+/**
+ * @brief Remove a row and free its overflow pages
+ *
+ * @return bool False if no row has the rowid
+ */
+bool BTree::erase(std::int64_t rowid)
+{
+  const WriteScope scope(*this);
+  std::vector<Level> path;
+  const RowidKey key(rowid);
+  TreeNode leaf = descend(key.view(), path);
+  const std::size_t index = leaf.lower_bound(key.view());
+  if (index == leaf.count() || cell_rowid(leaf.cell(index)) != rowid) {
+    return false;
+  }
+  // Latched before the overflow pages go, which readers of the row check
+  // the leaf for
+  lock(leaf);
+  const std::byte* cell = leaf.cell(index);
+  if (spilled(cell)) {
+    free_overflow(m_pager,
+                  overflow_page(cell),
+                  payload_size(cell) - local_size(cell));
+  }
+  leaf.remove_cell(index);
+  rebalance(path, std::move(leaf));
+  return true;
+}
+
+/**
+ * @brief Look a row up, alongside a writer on another thread
+ *
+ * Descends with optimistic latches: each node is read unlatched, then
+ * validated once the child to go to is pinned, and the lookup restarts
+ * from the root whenever a writer got in the way.
+ *
+ * @return The whole payload, reassembled from its overflow pages
+ */
+std::optional<std::vector<std::byte>> BTree::find(std::int64_t rowid) const
+{
+  std::optional<std::vector<std::byte>> payload;
+  while (!find_once(rowid, payload)) {
+  }
+  return payload;
+}
+
+// One optimistic attempt at find(); false if a writer got in the way
+bool BTree::find_once(std::int64_t rowid,
+                      std::optional<std::vector<std::byte>>& payload) const
+{
+  const std::size_t usable = m_capacity + HEADER_SIZE;
+  const std::size_t max_keys = m_capacity / INTERIOR_CELL_SIZE;
+  PageHandle node = m_pager.pin(m_root);
+  const PageLatch* latch = &m_pager.latches().of(m_root);
+  std::uint64_t version = latch->read_begin();
+  // Bytes no writer leaves behind: a torn read, unless the node is stable
+  const auto torn = [&]
+  {
+    if (latch->validate(version)) {
+      throw std::runtime_error("Corrupt B+tree page");
+    }
+    return false;
+  };
+
+  const std::byte* page = node.bytes();
+  while (std::to_integer<std::uint8_t>(page[KIND_OFFSET]) == INTERIOR) {
+    const std::size_t count = TreeNode::count_of(page);
+    if (count > max_keys) {
+      return torn();
+    }
+    const std::size_t index =
+        key_lower_bound(page + HEADER_SIZE, count, rowid);
+    const PageId child = index == count
+        ? load_u32(page + RIGHT_OFFSET)
+        : load_u32(page + HEADER_SIZE + max_keys * ROWID_SIZE
+                   + index * sizeof(PageId));
+    if (!latch->validate(version)) {
+      return false;
+    }
+    PageHandle next = m_pager.pin(child);
+    const PageLatch* next_latch = &m_pager.latches().of(child);
+    const std::uint64_t next_version = next_latch->read_begin();
+    // The node still leads to the child once its version is known
+    if (!latch->validate(version)) {
+      return false;
+    }
+    node = std::move(next);
+    latch = next_latch;
+    version = next_version;
+    page = node.bytes();
+  }
+  if (std::to_integer<std::uint8_t>(page[KIND_OFFSET]) != LEAF
+      || TreeNode::count_of(page) > (usable - HEADER_SIZE) / SLOT_SIZE)
+  {
+    return torn();
+  }
+
+  const std::size_t count = TreeNode::count_of(page);
+  const auto offset_of = [&](std::size_t index)
+  { return std::size_t {load_u16(page + HEADER_SIZE + index * SLOT_SIZE)}; };
+  std::size_t low = 0;
+  std::size_t high = count;
+  while (low < high) {
+    const std::size_t middle = low + (high - low) / 2;
+    if (offset_of(middle) + LEAF_CELL_HEADER > usable) {
+      return torn();
+    }
+    if (cell_rowid(page + offset_of(middle)) < rowid) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == count || offset_of(low) + LEAF_CELL_HEADER > usable
+      || cell_rowid(page + offset_of(low)) != rowid)
+  {
+    payload.reset();
+    return latch->validate(version);
+  }
+  const std::byte* cell = page + offset_of(low);
+  if (offset_of(low) + leaf_cell_size(cell) > usable) {
+    return torn();
+  }
+  const std::byte* head = local_payload(cell);
+  const std::size_t local = local_size(cell);
+  std::vector<std::byte> bytes(head, head + local);
+  const std::size_t size = payload_size(cell);
+  const PageId first = spilled(cell) ? overflow_page(cell) : 0;
+  if (!latch->validate(version)) {
+    return false;
+  }
+  if (size > local) {
+    // An erase latches the leaf before it frees the overflow pages, so the
+    // tail is sound if the leaf is still unchanged after reading it
+    bytes.resize(size);
+    try {
+      PayloadReader(m_pager, bytes.data(), local, size, first)
+          .read(local, size - local, bytes.data() + local);
+    } catch (const std::exception&) {
+      if (latch->validate(version)) {
+        throw;
+      }
+      return false;
+    }
+    if (!latch->validate(version)) {
+      return false;
+    }
+  }
+  payload = std::move(bytes);
+  return true;
+}
+
+/**
+ * @param pager Pager of a file with a header; the tree goes to new pages
+ * @param options Fill factor; throws invalid_argument outside 50-100
+ */
+BTreeLoader::BTreeLoader(Pager& pager, BulkLoadOptions options)
+    : TreeLoader(pager, rowid_format(), options)
+{
+}
+
+void BTreeLoader::add(std::int64_t rowid, const std::vector<std::byte>& payload)
+{
+  // Checked before the payload can spill into overflow pages
+  check_order(RowidKey(rowid).view());
+  add_cell(leaf_cell(m_pager, m_capacity, rowid, payload));
+}
+
+BTreeCursor::BTreeCursor(const BTree& tree) noexcept
+    : TreeCursor(tree)
+{
+}
+
+bool BTreeCursor::seek(std::int64_t rowid)
+{
+  return seek_key(RowidKey(rowid).view());
+}
+
+std::int64_t BTreeCursor::rowid() const noexcept
+{
+  return cell_rowid(cell());
+}
+
+const std::byte* BTreeCursor::payload() const noexcept
+{
+  return local_payload(cell());
+}
+
+std::size_t BTreeCursor::local_size() const noexcept
+{
+  return ::local_size(cell());
+}
+
+std::size_t BTreeCursor::payload_size() const noexcept
+{
+  return ::payload_size(cell());
+}
+
+PayloadReader BTreeCursor::payload_reader() const noexcept
+{
+  const std::byte* leaf_cell = cell();
+  return {tree().pager(),
+          local_payload(leaf_cell),
+          ::local_size(leaf_cell),
+          ::payload_size(leaf_cell),
+          spilled(leaf_cell) ? overflow_page(leaf_cell) : 0};
+}
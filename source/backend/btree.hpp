@@ -0,0 +1,108 @@
+#ifndef BTREE_HPP
+#define BTREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "bplus_tree.hpp"
+#include "overflow.hpp"
+#include "pager.hpp"
+
+class BTree;
+
+/**
+ * @brief Position on a row of a BTree
+ *
+ * See TreeCursor for how it moves and when it goes stale.
+ */
+class BTreeCursor : public TreeCursor
+{
+public:
+  explicit BTreeCursor(const BTree& tree) noexcept;
+
+  // Stand on the first row whose rowid is not below `rowid`; returns
+  // valid()
+  bool seek(std::int64_t rowid);
+
+  std::int64_t rowid() const noexcept;
+  // Head of the payload of the current row, in the pinned leaf: the whole
+  // payload unless it spilled into overflow pages
+  const std::byte* payload() const noexcept;
+  std::size_t local_size() const noexcept;
+  std::size_t payload_size() const noexcept;
+  // The whole payload, overflow pages included; see PayloadReader
+  PayloadReader payload_reader() const noexcept;
+};
+
+/**
+ * @brief B+tree of rows keyed by rowid, stored in Pager pages
+ *
+ * Rows live in the leaves; interior nodes only route. Nodes have the
+ * header, layout and split and merge rules of a BPlusTree, with kinds 0x0D
+ * for a leaf and 0x05 for an interior node.
+ *
+ * A leaf cell is the rowid (8), payload size (2) and payload. A payload
+ * over max_payload() spills: the top bit of its size is set and the size
+ * is that of the head kept in the cell, which follows the whole size (4)
+ * and the first page of the tail (4); see overflow.hpp. The cell is then
+ * as large as one of max_payload().
+ *
+ * An interior node has room for N = (usable size - 16) / 12 entries: N
+ * rowids of 8 bytes from offset 16, then N child pages of 4 bytes. Keeping
+ * the rowids contiguous lets key_lower_bound() search them with vector
+ * compares.
+ *
+ * Any number of threads may find() rows while one thread inserts and
+ * erases, through this or any other BTree on the same pages. The writer
+ * latches the nodes it changes, see BPlusTree. find() takes no latch at
+ * all: it reads each node optimistically, validates the node's version
+ * once it holds the child to go to and restarts from the root if a write
+ * got in the way. Readers never write to shared memory on the way down
+ * beyond their page pins. Cursors, depth() and verify() read unvalidated
+ * and need the writer to keep out.
+ */
+class BTree : public BPlusTree
+{
+public:
+  // Allocate the root of an empty tree
+  static PageId create(Pager& pager);
+
+  BTree(Pager& pager, PageId root);
+
+  // Can throw invalid_argument for a taken rowid and length_error for a
+  // payload over 4 GiB
+  void insert(std::int64_t rowid, const std::vector<std::byte>& payload);
+  // False if no row has the rowid
+  bool erase(std::int64_t rowid);
+  // The whole payload, reassembled from its overflow pages; safe alongside
+  // the writer
+  std::optional<std::vector<std::byte>> find(std::int64_t rowid) const;
+
+  // Largest payload kept whole in its cell
+  std::size_t max_payload() const noexcept;
+
+private:
+  bool find_once(std::int64_t rowid,
+                 std::optional<std::vector<std::byte>>& payload) const;
+};
+
+/**
+ * @brief Builds a new BTree bottom-up from rows in ascending rowid order
+ *
+ * See TreeLoader.
+ */
+class BTreeLoader : public TreeLoader
+{
+public:
+  explicit BTreeLoader(Pager& pager, BulkLoadOptions options = {});
+
+  // Can throw invalid_argument for a rowid not above the last one and
+  // length_error for a payload over 4 GiB
+  void add(std::int64_t rowid, const std::vector<std::byte>& payload);
+
+  std::size_t rows() const noexcept { return m_cells; }
+};
+
+#endif  // BTREE_HPP
@@ -0,0 +1,55 @@
+#ifndef BYTE_ORDER_HPP
+#define BYTE_ORDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-width little-endian integers for on-disk structures. Byte-wise
+// access keeps them independent of host endianness and alignment.
+
+inline void store_u16(std::byte* dst, std::uint16_t value) noexcept
+{
+  dst[0] = static_cast<std::byte>(value & 0xFFU);
+  dst[1] = static_cast<std::byte>(value >> 8U);
+}
+
+inline std::uint16_t load_u16(const std::byte* src) noexcept
+{
+  return static_cast<std::uint16_t>(std::to_integer<std::uint16_t>(src[0])
+                                    | std::to_integer<std::uint16_t>(src[1])
+                                        << 8U);
+}
+
+inline void store_u32(std::byte* dst, std::uint32_t value) noexcept
+{
+  for (int i = 0; i < 4; i++) {
+    dst[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFFU);
+  }
+}
+
+inline std::uint32_t load_u32(const std::byte* src) noexcept
+{
+  std::uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    value |= std::to_integer<std::uint32_t>(src[i]) << (8 * i);
+  }
+  return value;
+}
+
+inline void store_u64(std::byte* dst, std::uint64_t value) noexcept
+{
+  for (int i = 0; i < 8; i++) {
+    dst[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFFU);
+  }
+}
+
+inline std::uint64_t load_u64(const std::byte* src) noexcept
+{
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= std::to_integer<std::uint64_t>(src[i]) << (8 * i);
+  }
+  return value;
+}
+
+#endif  // BYTE_ORDER_HPP
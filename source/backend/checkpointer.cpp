@@ -0,0 +1,113 @@
+#include <utility>
+
+#include "checkpointer.hpp"
+
+#include "wal.hpp"
+
+/**
+ * @brief Start the checkpoint thread of a log
+ *
+ * @param wal Log to watch; must outlive the Checkpointer
+ * @param options Triggers and I/O budget
+ * @param checkpoint Runs one checkpoint; exceptions are swallowed and the
+ * next trigger retries
+ */
+Checkpointer::Checkpointer(const Wal& wal,
+                           CheckpointOptions options,
+                           std::function<void()> checkpoint)
+    : m_wal(wal)
+    , m_options(options)
+    , m_checkpoint(std::move(checkpoint))
+    , m_thread(&Checkpointer::run, this)
+{
+}
+
+Checkpointer::~Checkpointer()
+{
+  {
+    std::lock_guard lock(m_latch);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+/**
+ * @brief Wake the thread if the log outgrew CheckpointOptions::wal_bytes
+ */
+void Checkpointer::notify_commit()
+{
+  if (m_options.wal_bytes == 0 || m_wal.size() < m_options.wal_bytes) {
+    return;
+  }
+  {
+    std::lock_guard lock(m_latch);
+    m_requested = true;
+  }
+  m_wake.notify_all();
+}
+
+/**
+ * @brief Account for bytes copied by the running checkpoint, sleeping
+ * until the I/O budget allows them
+ *
+ * @param bytes Bytes just written to the database file
+ * @return bool False once the Checkpointer is stopping; the checkpoint
+ * should give up
+ */
+bool Checkpointer::pace(std::uint64_t bytes)
+{
+  std::unique_lock lock(m_latch);
+  if (m_options.io_budget == 0) {
+    return !m_stop;
+  }
+  m_copied += bytes;
+  const std::chrono::duration<double> allowed(
+      static_cast<double>(m_copied) / static_cast<double>(m_options.io_budget));
+  m_wake.wait_until(
+      lock,
+      m_started
+          + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              allowed),
+      [this] { return m_stop; });
+  return !m_stop;
+}
+
+void Checkpointer::run()
+{
+  const bool idle_trigger = m_options.idle_time.count() > 0;
+  const auto woken = [this] { return m_stop || m_requested; };
+
+  std::unique_lock lock(m_latch);
+  std::uint64_t seen = m_wal.last_commit();
+  while (!m_stop) {
+    if (idle_trigger) {
+      m_wake.wait_for(lock, m_options.idle_time, woken);
+    } else {
+      m_wake.wait(lock, woken);
+    }
+    if (m_stop) {
+      break;
+    }
+    // Idle: no commit for a whole interval, yet some left to copy
+    const std::uint64_t last = m_wal.last_commit();
+    const bool idle =
+        idle_trigger && last == seen && last > m_wal.backfilled();
+    seen = last;
+    if (!m_requested && !idle) {
+      continue;
+    }
+
+    m_requested = false;
+    m_started = std::chrono::steady_clock::now();
+    m_copied = 0;
+    lock.unlock();
+    try {
+      m_checkpoint();
+    } catch (...) {
+      // Counted by the checkpoint; the log is intact and the next one
+      // copies the same frames again
+    }
+    lock.lock();
+  }
+}
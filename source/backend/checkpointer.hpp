@@ -0,0 +1,77 @@
+#ifndef CHECKPOINTER_HPP
+#define CHECKPOINTER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class Wal;
+
+struct CheckpointOptions
+{
+  // Checkpoint on a background thread; otherwise only Pager::checkpoint()
+  bool background {true};
+  // Start once the log holds this many bytes; 0 disables the trigger
+  std::uint64_t wal_bytes {4U << 20U};
+  // Start once no commit came for this long; 0 disables the trigger
+  std::chrono::milliseconds idle_time {500};
+  // Most bytes per second a background checkpoint copies; 0 is unlimited
+  std::uint64_t io_budget {0};
+  // Pages copied per batched write
+  std::size_t batch_pages {64};
+  // A log file larger than this is truncated when it restarts, rather than
+  // overwritten from the start
+  std::uint64_t wal_size_limit {64U << 20U};
+};
+
+/**
+ * @brief Background thread running the checkpoints of a log
+ *
+ * A checkpoint starts when a commit leaves the log larger than
+ * CheckpointOptions::wal_bytes, or when the log has commits left to copy
+ * and none came for CheckpointOptions::idle_time. The checkpoint itself is
+ * a callback, which calls pace() after each batch to keep within the I/O
+ * budget.
+ */
+class Checkpointer
+{
+public:
+  Checkpointer(const Wal& wal,
+               CheckpointOptions options,
+               std::function<void()> checkpoint);
+  // Stops the thread, abandoning a checkpoint at its next pace()
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer&) = delete;
+  Checkpointer& operator=(const Checkpointer&) = delete;
+  Checkpointer(Checkpointer&&) = delete;
+  Checkpointer& operator=(Checkpointer&&) = delete;
+
+  // Called after every commit
+  void notify_commit();
+  // Wait until copying bytes more keeps within the budget; false on stop
+  bool pace(std::uint64_t bytes);
+
+private:
+  const Wal& m_wal;
+  CheckpointOptions m_options;
+  std::function<void()> m_checkpoint;
+
+  std::mutex m_latch;
+  std::condition_variable m_wake;
+  bool m_stop {false};
+  bool m_requested {false};
+  // Pacing of the running checkpoint
+  std::chrono::steady_clock::time_point m_started;
+  std::uint64_t m_copied {0};
+
+  // Last, so that the thread starts with everything else constructed
+  std::thread m_thread;
+
+  void run();
+};
+
+#endif  // CHECKPOINTER_HPP
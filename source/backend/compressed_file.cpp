@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "compressed_file.hpp"
+
+#include "byte_order.hpp"
+#include "lz_codec.hpp"
+
+namespace
+{
+// Stored length of the LZ stream at the start of a compressed slot
+constexpr std::size_t LENGTH_SIZE = 4;
+constexpr std::size_t MAP_ENTRY_SIZE = 8;
+// Entries written back together by sync(), 4 KiB of the map
+constexpr std::size_t MAP_BLOCK_ENTRIES = 512;
+constexpr unsigned UNITS_SHIFT = 56;
+constexpr std::uint64_t OFFSET_MASK = (std::uint64_t {1} << UNITS_SHIFT) - 1;
+
+std::runtime_error corrupt_page(std::uint64_t page_number)
+{
+  return std::runtime_error("Corrupt compressed page "
+                            + std::to_string(page_number));
+}
+
+void sort_by_offset(std::vector<IoRequest>& requests)
+{
+  std::sort(requests.begin(),
+            requests.end(),
+            [](const IoRequest& lhs, const IoRequest& rhs)
+            { return lhs.offset < rhs.offset; });
+}
+}  // namespace
+
+/**
+ * @brief Open the page map of a compressed database file
+ *
+ * @param data The database file, which must outlive this object
+ * @param map_path Page map file, created if missing
+ * @param page_size Page size of the database
+ * @param create Whether the database is new; any existing map is discarded
+ * @throws std::runtime_error if the map cannot be opened or is corrupt
+ */
+CompressedFile::CompressedFile(FileIo& data,
+                               const std::filesystem::path& map_path,
+                               std::uint32_t page_size,
+                               bool create)
+    : m_data(data)
+    , m_map_file(open_file_io(map_path, IoBackend::pread, true))
+    , m_page_size(page_size)
+    , m_unit(page_size / SLOT_UNITS)
+{
+  if (create) {
+    m_map_file->truncate(0);
+  } else {
+    load_map();
+  }
+}
+
+std::filesystem::path CompressedFile::map_path(
+    const std::filesystem::path& filename)
+{
+  auto path = filename;
+  path += "-pagemap";
+  return path;
+}
+
+/**
+ * @brief Read the page map and rebuild the free slots from its gaps
+ *
+ * @throws std::runtime_error if slots overlap or lie outside the data area
+ */
+void CompressedFile::load_map()
+{
+  std::vector<std::byte> raw(m_map_file->size() / MAP_ENTRY_SIZE
+                             * MAP_ENTRY_SIZE);
+  m_map_file->read(raw.data(), raw.size(), 0);
+  m_map.resize(raw.size() / MAP_ENTRY_SIZE);
+
+  std::vector<Slot> used;
+  for (std::size_t page = 0; page < m_map.size(); page++) {
+    m_map[page] = load_u64(raw.data() + page * MAP_ENTRY_SIZE);
+    const Slot slot = slot_of(page);
+    if (slot.units == 0) {
+      continue;
+    }
+    if (page == 0 || slot.units > SLOT_UNITS || slot.offset < SLOT_UNITS) {
+      throw std::runtime_error("Corrupt page map");
+    }
+    used.push_back(slot);
+  }
+  std::sort(used.begin(),
+            used.end(),
+            [](const Slot& lhs, const Slot& rhs)
+            { return lhs.offset < rhs.offset; });
+
+  // Page 0 occupies the first SLOT_UNITS units
+  std::uint64_t end = SLOT_UNITS;
+  for (const Slot& slot : used) {
+    if (slot.offset < end) {
+      throw std::runtime_error("Corrupt page map");
+    }
+    while (end < slot.offset) {
+      const auto units = static_cast<std::uint32_t>(
+          std::min<std::uint64_t>(SLOT_UNITS, slot.offset - end));
+      release(Slot {end, units});
+      end += units;
+    }
+    end = slot.offset + slot.units;
+  }
+  m_end = end;
+}
+
+/**
+ * @brief Read whole pages, decompressing those stored compressed
+ *
+ * Raw slots are read straight into the destination; compressed slots go
+ * through a scratch buffer. All slots are read with one batch.
+ *
+ * @throws std::system_error if the read fails
+ * @throws std::runtime_error if a compressed slot does not decode
+ */
+void CompressedFile::read_pages(const std::vector<IoRequest>& pages)
+{
+  struct Compressed
+  {
+    std::size_t page;  // index into pages
+    Slot slot;
+    std::size_t scratch;  // offset into the scratch buffer
+  };
+  std::vector<IoRequest> reads;
+  std::vector<Compressed> compressed;
+  reads.reserve(pages.size());
+  std::size_t scratch_size = 0;
+  {
+    std::lock_guard lock(m_latch);
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      const auto& page = pages[i];
+      const std::uint64_t page_number = page.offset / m_page_size;
+      const Slot slot = slot_of(page_number);
+      if (page_number == 0) {
+        reads.push_back(page);
+      } else if (slot.units == 0) {
+        std::memset(page.buffer, 0, m_page_size);
+      } else if (slot.units == SLOT_UNITS) {
+        reads.push_back(
+            IoRequest {page.buffer, m_page_size, slot.offset * m_unit});
+      } else {
+        compressed.push_back(Compressed {i, slot, scratch_size});
+        scratch_size += std::size_t {slot.units} * m_unit;
+      }
+    }
+  }
+
+  std::vector<std::byte> scratch(scratch_size);
+  for (const auto& entry : compressed) {
+    reads.push_back(IoRequest {scratch.data() + entry.scratch,
+                               std::size_t {entry.slot.units} * m_unit,
+                               entry.slot.offset * m_unit});
+  }
+  sort_by_offset(reads);
+  m_data.read_batch(reads);
+
+  for (const auto& entry : compressed) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::byte* slot = scratch.data() + entry.scratch;
+    const std::size_t length = load_u32(slot);
+    if (length > std::size_t {entry.slot.units} * m_unit - LENGTH_SIZE
+        || !lz_decompress(slot + LENGTH_SIZE,
+                          length,
+                          pages[entry.page].buffer,
+                          m_page_size))
+    {
+      throw corrupt_page(pages[entry.page].offset / m_page_size);
+    }
+    m_decompress_latency.record(nanoseconds_since(start));
+  }
+  m_pages_read.fetch_add(compressed.size(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Compress and write whole pages
+ *
+ * A page keeps its slot when it needs as many units as before and moves to
+ * a newly allocated one otherwise. The map points to a moved page once its
+ * write completes.
+ *
+ * @throws std::system_error if the write fails; moved pages keep their
+ * old slots
+ */
+void CompressedFile::write_pages(const std::vector<IoRequest>& pages)
+{
+  struct Encoded
+  {
+    std::uint64_t page_number;
+    const std::byte* data;
+    std::size_t length;
+    Slot slot;
+    Slot old;  // left behind by a move, else empty
+  };
+  std::vector<IoRequest> writes;
+  std::vector<Encoded> encoded;
+  encoded.reserve(pages.size());
+  std::vector<std::byte> scratch(pages.size() * m_page_size);
+  const std::size_t capacity = (SLOT_UNITS - 1) * m_unit - LENGTH_SIZE;
+  std::uint64_t raw = 0;
+
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    const auto& page = pages[i];
+    const std::uint64_t page_number = page.offset / m_page_size;
+    if (page_number == 0) {
+      writes.push_back(page);
+      continue;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::byte* out = scratch.data() + i * m_page_size;
+    const std::size_t length =
+        lz_compress(page.buffer, m_page_size, out + LENGTH_SIZE, capacity);
+    m_compress_latency.record(nanoseconds_since(start));
+    if (length == 0) {
+      encoded.push_back(
+          Encoded {page_number, page.buffer, m_page_size, {0, SLOT_UNITS}, {}});
+      raw++;
+      continue;
+    }
+    store_u32(out, static_cast<std::uint32_t>(length));
+    const std::size_t stored = LENGTH_SIZE + length;
+    const auto units = static_cast<std::uint32_t>((stored + m_unit - 1)
+                                                  / m_unit);
+    encoded.push_back(Encoded {page_number, out, stored, {0, units}, {}});
+  }
+
+  {
+    std::lock_guard lock(m_latch);
+    for (auto& entry : encoded) {
+      const Slot current = slot_of(entry.page_number);
+      if (current.units == entry.slot.units) {
+        entry.slot = current;
+      } else {
+        entry.slot.offset = allocate(entry.slot.units);
+        entry.old = current;
+      }
+    }
+  }
+
+  std::uint64_t stored = 0;
+  for (const auto& entry : encoded) {
+    writes.push_back(IoRequest {const_cast<std::byte*>(entry.data),
+                                entry.length,
+                                entry.slot.offset * m_unit});
+    stored += std::uint64_t {entry.slot.units} * m_unit;
+  }
+  sort_by_offset(writes);
+
+  try {
+    m_data.write_batch(writes);
+  } catch (...) {
+    std::lock_guard lock(m_latch);
+    for (const auto& entry : encoded) {
+      if (entry.slot.offset != slot_of(entry.page_number).offset) {
+        release(entry.slot);
+      }
+    }
+    throw;
+  }
+
+  {
+    std::lock_guard lock(m_latch);
+    for (const auto& entry : encoded) {
+      if (entry.slot.offset == slot_of(entry.page_number).offset) {
+        continue;
+      }
+      set_slot(entry.page_number, entry.slot);
+      if (entry.old.units != 0) {
+        m_retired.push_back(entry.old);
+      }
+    }
+  }
+  m_pages_written.fetch_add(encoded.size(), std::memory_order_relaxed);
+  m_pages_raw.fetch_add(raw, std::memory_order_relaxed);
+  m_bytes_in.fetch_add(encoded.size() * m_page_size,
+                       std::memory_order_relaxed);
+  m_bytes_stored.fetch_add(stored, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Make the pages durable, then the map pointing at them
+ *
+ * Only map changes and retired slots present on entry are covered; pages
+ * written meanwhile are made durable by the next call.
+ *
+ * @throws std::system_error if a write or sync fails
+ */
+void CompressedFile::sync()
+{
+  std::vector<std::size_t> blocks;
+  std::vector<std::byte> raw;
+  std::vector<Slot> retired;
+  {
+    std::lock_guard lock(m_latch);
+    blocks.assign(m_dirty_blocks.begin(), m_dirty_blocks.end());
+    raw.resize(blocks.size() * MAP_BLOCK_ENTRIES * MAP_ENTRY_SIZE);
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+      std::byte* dst = raw.data() + i * MAP_BLOCK_ENTRIES * MAP_ENTRY_SIZE;
+      for (std::size_t entry = 0; entry < MAP_BLOCK_ENTRIES; entry++) {
+        const std::size_t page = blocks[i] * MAP_BLOCK_ENTRIES + entry;
+        store_u64(dst + entry * MAP_ENTRY_SIZE,
+                  page < m_map.size() ? m_map[page] : 0);
+      }
+    }
+    m_dirty_blocks.clear();
+    retired.swap(m_retired);
+  }
+
+  std::vector<IoRequest> writes;
+  writes.reserve(blocks.size());
+  for (std::size_t i = 0; i < blocks.size(); i++) {
+    constexpr std::size_t BLOCK_SIZE = MAP_BLOCK_ENTRIES * MAP_ENTRY_SIZE;
+    writes.push_back(IoRequest {
+        raw.data() + i * BLOCK_SIZE, BLOCK_SIZE, blocks[i] * BLOCK_SIZE});
+  }
+  try {
+    m_data.sync();
+    if (!writes.empty()) {
+      m_map_file->write_batch(writes);
+    }
+    m_map_file->sync();
+  } catch (...) {
+    std::lock_guard lock(m_latch);
+    m_dirty_blocks.insert(blocks.begin(), blocks.end());
+    m_retired.insert(m_retired.end(), retired.begin(), retired.end());
+    throw;
+  }
+
+  std::lock_guard lock(m_latch);
+  for (const Slot& slot : retired) {
+    release(slot);
+  }
+}
+
+CompressionStats CompressedFile::stats() const noexcept
+{
+  CompressionStats stats;
+  stats.pages_written = m_pages_written.load(std::memory_order_relaxed);
+  stats.pages_raw = m_pages_raw.load(std::memory_order_relaxed);
+  stats.pages_read = m_pages_read.load(std::memory_order_relaxed);
+  stats.bytes_in = m_bytes_in.load(std::memory_order_relaxed);
+  stats.bytes_stored = m_bytes_stored.load(std::memory_order_relaxed);
+  stats.compress_latency = m_compress_latency.snapshot();
+  stats.decompress_latency = m_decompress_latency.snapshot();
+  return stats;
+}
+
+// Caller holds m_latch
+CompressedFile::Slot CompressedFile::slot_of(
+    std::uint64_t page_number) const noexcept
+{
+  if (page_number >= m_map.size()) {
+    return Slot {0, 0};
+  }
+  const std::uint64_t entry = m_map[page_number];
+  return Slot {entry & OFFSET_MASK,
+               static_cast<std::uint32_t>(entry >> UNITS_SHIFT)};
+}
+
+// Caller holds m_latch
+void CompressedFile::set_slot(std::uint64_t page_number, Slot slot)
+{
+  if (page_number >= m_map.size()) {
+    m_map.resize(page_number + 1);
+  }
+  m_map[page_number] = slot.offset | std::uint64_t {slot.units} << UNITS_SHIFT;
+  m_dirty_blocks.insert(page_number / MAP_BLOCK_ENTRIES);
+}
+
+/**
+ * @brief Take a free slot of units units, splitting a larger one or
+ * extending the file if none fits exactly
+ *
+ * Caller holds m_latch.
+ *
+ * @return std::uint64_t Offset of the slot in units
+ */
+std::uint64_t CompressedFile::allocate(std::uint32_t units)
+{
+  for (std::uint32_t size = units; size <= SLOT_UNITS; size++) {
+    auto& free = m_free[size];
+    if (free.empty()) {
+      continue;
+    }
+    const std::uint64_t offset = free.back();
+    free.pop_back();
+    if (size > units) {
+      m_free[size - units].push_back(offset + units);
+    }
+    return offset;
+  }
+  const std::uint64_t offset = m_end;
+  m_end += units;
+  return offset;
+}
+
+// Caller holds m_latch
+void CompressedFile::release(Slot slot)
+{
+  m_free[slot.units].push_back(slot.offset);
+}
@@ -0,0 +1,101 @@
+#ifndef COMPRESSED_FILE_HPP
+#define COMPRESSED_FILE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "file_io.hpp"
+#include "pager_stats.hpp"
+
+/**
+ * @brief Database file storing its pages compressed, in variable-size slots
+ *
+ * Page 0 holds the file header and stays uncompressed at offset 0, so the
+ * header is read before anything else is known. Every other page lives in
+ * a slot of 1 to 8 units, a unit being an eighth of a page. A slot of
+ * fewer than 8 units holds the 4-byte length of the LZ stream that
+ * follows; a page that does not save at least one unit is stored raw in a
+ * slot of 8.
+ *
+ * The page map lives next to the database in a file named by map_path().
+ * It holds one 8-byte little-endian entry per page: the slot offset in
+ * units in bits 0-55 and the slot length in units in bits 56-63. An entry
+ * of 0 is a page never written, read as zeros.
+ *
+ * A page rewritten to the same number of units stays in its slot;
+ * otherwise it moves to a free slot. Free slots are not stored but rebuilt
+ * from the gaps between mapped slots on open. The slot a page moved out of
+ * is only reused once sync() has made the map that no longer points to it
+ * durable, so the durable map never points into a reused slot.
+ *
+ * Requests have the shape the Pager gives FileIo: one whole page at a page
+ * aligned offset. All calls may be made from several threads at once,
+ * provided no page is read and written at the same time.
+ */
+class CompressedFile
+{
+public:
+  // create starts an empty page map, replacing a stale one
+  CompressedFile(FileIo& data,
+                 const std::filesystem::path& map_path,
+                 std::uint32_t page_size,
+                 bool create);  // Can throw runtime_error
+
+  void read_pages(const std::vector<IoRequest>& pages);
+  void write_pages(const std::vector<IoRequest>& pages);
+  // Make written pages, then the page map, durable
+  void sync();
+
+  CompressionStats stats() const noexcept;
+
+  // Page map of a database file: its name followed by "-pagemap"
+  static std::filesystem::path map_path(const std::filesystem::path& filename);
+
+private:
+  static constexpr std::uint32_t SLOT_UNITS = 8;
+
+  struct Slot
+  {
+    std::uint64_t offset;  // in units
+    std::uint32_t units;
+  };
+
+  FileIo& m_data;
+  std::unique_ptr<FileIo> m_map_file;
+  std::uint32_t m_page_size;
+  std::uint32_t m_unit;
+
+  // Guards everything below up to the counters
+  std::mutex m_latch;
+  std::vector<std::uint64_t> m_map;
+  // Map blocks changed since the last sync()
+  std::set<std::size_t> m_dirty_blocks;
+  // Free slot offsets by length in units; index 0 is unused
+  std::array<std::vector<std::uint64_t>, SLOT_UNITS + 1> m_free;
+  // Slots moved out of, free once the map is durable
+  std::vector<Slot> m_retired;
+  // First unit past the last slot
+  std::uint64_t m_end {SLOT_UNITS};
+
+  std::atomic<std::uint64_t> m_pages_written {0};
+  std::atomic<std::uint64_t> m_pages_raw {0};
+  std::atomic<std::uint64_t> m_pages_read {0};
+  std::atomic<std::uint64_t> m_bytes_in {0};
+  std::atomic<std::uint64_t> m_bytes_stored {0};
+  LatencyHistogram m_compress_latency;
+  LatencyHistogram m_decompress_latency;
+
+  void load_map();
+  Slot slot_of(std::uint64_t page) const noexcept;
+  void set_slot(std::uint64_t page, Slot slot);
+  std::uint64_t allocate(std::uint32_t units);
+  void release(Slot slot);
+};
+
+#endif  // COMPRESSED_FILE_HPP
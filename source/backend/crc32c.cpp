@@ -0,0 +1,170 @@
+#include <array>
+#include <cstring>
+
+#include "crc32c.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#  include <nmmintrin.h>
+#  define DIY_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__GNUC__)
+#  include <arm_acle.h>
+#  if defined(__linux__)
+#    include <asm/hwcap.h>
+#    include <sys/auxv.h>
+#  endif
+#  define DIY_CRC32C_ARMV8 1
+#endif
+
+namespace
+{
+// Reflected Castagnoli polynomial
+constexpr std::uint32_t POLYNOMIAL = 0x82F63B78U;
+
+using Table = std::array<std::array<std::uint32_t, 256>, 8>;
+
+// Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zeros
+constexpr Table make_table() noexcept
+{
+  Table table {};
+  for (std::uint32_t byte = 0; byte < 256; byte++) {
+    std::uint32_t crc = byte;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1U) ^ ((crc & 1U) != 0 ? POLYNOMIAL : 0U);
+    }
+    table[0][byte] = crc;
+  }
+  for (std::size_t k = 1; k < table.size(); k++) {
+    for (std::size_t byte = 0; byte < 256; byte++) {
+      const std::uint32_t prev = table[k - 1][byte];
+      table[k][byte] = (prev >> 8U) ^ table[0][prev & 0xFFU];
+    }
+  }
+  return table;
+}
+
+constexpr Table TABLE = make_table();
+
+std::uint64_t load_le64(const std::byte* src) noexcept
+{
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= std::to_integer<std::uint64_t>(src[i]) << (8 * i);
+  }
+  return value;
+}
+
+std::uint32_t update_table(std::uint32_t crc,
+                           const std::byte* data,
+                           std::size_t length) noexcept
+{
+  while (length >= 8) {
+    const std::uint64_t word = load_le64(data) ^ crc;
+    crc = TABLE[7][word & 0xFFU] ^ TABLE[6][(word >> 8U) & 0xFFU]
+        ^ TABLE[5][(word >> 16U) & 0xFFU] ^ TABLE[4][(word >> 24U) & 0xFFU]
+        ^ TABLE[3][(word >> 32U) & 0xFFU] ^ TABLE[2][(word >> 40U) & 0xFFU]
+        ^ TABLE[1][(word >> 48U) & 0xFFU] ^ TABLE[0][word >> 56U];
+    data += 8;
+    length -= 8;
+  }
+  for (std::size_t i = 0; i < length; i++) {
+    crc = (crc >> 8U)
+        ^ TABLE[0][(crc ^ std::to_integer<std::uint32_t>(data[i])) & 0xFFU];
+  }
+  return crc;
+}
+
+#ifdef DIY_CRC32C_SSE42
+__attribute__((target("sse4.2"))) std::uint32_t update_hardware(
+    std::uint32_t crc, const std::byte* data, std::size_t length) noexcept
+{
+  std::uint64_t crc64 = crc;
+  while (length >= 8) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    length -= 8;
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+  for (std::size_t i = 0; i < length; i++) {
+    crc = _mm_crc32_u8(crc, std::to_integer<std::uint8_t>(data[i]));
+  }
+  return crc;
+}
+
+bool has_hardware() noexcept
+{
+  return __builtin_cpu_supports("sse4.2") != 0;
+}
+
+constexpr const char* HARDWARE_NAME = "sse4.2";
+#elif defined(DIY_CRC32C_ARMV8)
+__attribute__((target("+crc"))) std::uint32_t update_hardware(
+    std::uint32_t crc, const std::byte* data, std::size_t length) noexcept
+{
+  while (length >= 8) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    length -= 8;
+  }
+  for (std::size_t i = 0; i < length; i++) {
+    crc = __crc32cb(crc, std::to_integer<std::uint8_t>(data[i]));
+  }
+  return crc;
+}
+
+bool has_hardware() noexcept
+{
+#  if defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#  elif defined(__APPLE__)
+  return true;  // every Apple ARM CPU has the CRC extension
+#  else
+  return false;
+#  endif
+}
+
+constexpr const char* HARDWARE_NAME = "armv8";
+#endif
+
+struct Implementation
+{
+  std::uint32_t (*update)(std::uint32_t, const std::byte*, std::size_t);
+  const char* name;
+};
+
+const Implementation& implementation() noexcept
+{
+  static const Implementation chosen = []() noexcept
+  {
+#if defined(DIY_CRC32C_SSE42) || defined(DIY_CRC32C_ARMV8)
+    if (has_hardware()) {
+      return Implementation {update_hardware, HARDWARE_NAME};
+    }
+#endif
+    return Implementation {update_table, "table"};
+  }();
+  return chosen;
+}
+}  // namespace
+
+std::uint32_t crc32c(const std::byte* data,
+                     std::size_t length,
+                     std::uint32_t crc) noexcept
+{
+  return ~implementation().update(~crc, data, length);
+}
+
+std::uint32_t crc32c_portable(const std::byte* data,
+                              std::size_t length,
+                              std::uint32_t crc) noexcept
+{
+  return ~update_table(~crc, data, length);
+}
+
+const char* crc32c_implementation() noexcept
+{
+  return implementation().name;
+}
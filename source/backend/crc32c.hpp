@@ -0,0 +1,29 @@
+#ifndef CRC32C_HPP
+#define CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CRC-32C (Castagnoli), the checksum of page trailers and WAL frames
+ *
+ * crc32c() uses the CPU's CRC32C instructions (SSE4.2 on x86-64, the CRC
+ * extension on ARMv8) when the running CPU has them and a table-driven
+ * implementation otherwise; the choice is made once, on first use.
+ *
+ * Checksums can be continued: crc32c(b, n, crc32c(a, m)) is the checksum
+ * of a followed by b.
+ */
+std::uint32_t crc32c(const std::byte* data,
+                     std::size_t length,
+                     std::uint32_t crc = 0) noexcept;
+
+// The table-driven implementation, whatever the CPU supports
+std::uint32_t crc32c_portable(const std::byte* data,
+                              std::size_t length,
+                              std::uint32_t crc = 0) noexcept;
+
+// Implementation crc32c() dispatches to: "sse4.2", "armv8" or "table"
+const char* crc32c_implementation() noexcept;
+
+#endif  // CRC32C_HPP
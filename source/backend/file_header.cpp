@@ -0,0 +1,60 @@
+#include <cstring>
+
+#include "file_header.hpp"
+
+#include "byte_order.hpp"
+
+namespace
+{
+constexpr std::size_t PAGE_SIZE_OFFSET = 16;
+constexpr std::size_t FORMAT_VERSION_OFFSET = 20;
+constexpr std::size_t PAGE_COUNT_OFFSET = 24;
+constexpr std::size_t FREELIST_TRUNK_OFFSET = 28;
+constexpr std::size_t FREELIST_COUNT_OFFSET = 32;
+constexpr std::size_t FLAGS_OFFSET = 36;
+}  // namespace
+
+/**
+ * @brief Serialize the header into the first FileHeader::SIZE bytes of dst
+ *
+ * @param dst Destination buffer, at least FileHeader::SIZE bytes long
+ */
+void FileHeader::encode(std::byte* dst) const noexcept
+{
+  std::memset(dst, 0, SIZE);
+  std::memcpy(dst, MAGIC.data(), MAGIC.size());
+  store_u32(dst + PAGE_SIZE_OFFSET, page_size);
+  store_u32(dst + FORMAT_VERSION_OFFSET, format_version);
+  store_u32(dst + PAGE_COUNT_OFFSET, page_count);
+  store_u32(dst + FREELIST_TRUNK_OFFSET, freelist_trunk);
+  store_u32(dst + FREELIST_COUNT_OFFSET, freelist_count);
+  store_u32(dst + FLAGS_OFFSET, flags);
+}
+
+/**
+ * @brief Parse a header from the first FileHeader::SIZE bytes of src
+ *
+ * @param src Source buffer, at least FileHeader::SIZE bytes long
+ * @return std::optional<FileHeader> The header, or std::nullopt if src does
+ * not hold one
+ */
+std::optional<FileHeader> FileHeader::decode(const std::byte* src) noexcept
+{
+  if (std::memcmp(src, MAGIC.data(), MAGIC.size()) != 0) {
+    return std::nullopt;
+  }
+  FileHeader header;
+  header.page_size = load_u32(src + PAGE_SIZE_OFFSET);
+  header.format_version = load_u32(src + FORMAT_VERSION_OFFSET);
+  header.page_count = load_u32(src + PAGE_COUNT_OFFSET);
+  header.freelist_trunk = load_u32(src + FREELIST_TRUNK_OFFSET);
+  header.freelist_count = load_u32(src + FREELIST_COUNT_OFFSET);
+  header.flags = load_u32(src + FLAGS_OFFSET);
+  return header;
+}
+
+bool is_valid_page_size(std::uint32_t page_size) noexcept
+{
+  return page_size >= 512 && page_size <= 65536
+      && (page_size & (page_size - 1)) == 0;
+}
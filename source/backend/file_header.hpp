@@ -0,0 +1,57 @@
+#ifndef FILE_HEADER_HPP
+#define FILE_HEADER_HPP
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+/**
+ * @brief Database file header stored at the start of page 0
+ *
+ * Layout (little-endian):
+ *
+ *   offset  size  field
+ *        0    16  magic "DIY-SQLite v1"
+ *       16     4  page size in bytes
+ *       20     4  format version
+ *       24     4  pages in use, including page 0
+ *       28     4  first freelist trunk page, 0 if the freelist is empty
+ *       32     4  pages on the freelist
+ *       36     4  feature flags, see PAGE_CHECKSUMS, PAGE_COMPRESSION, WAL
+ *
+ * Files written before the page count existed store 0 there; their size
+ * gives the page count instead. The file may extend past the pages in use
+ * because it grows in preallocated extents.
+ *
+ * The rest of the first 100 bytes is reserved for future fields; page 0 as a
+ * whole belongs to the header.
+ */
+struct FileHeader
+{
+  static constexpr std::size_t SIZE = 100;
+  static constexpr std::array<char, 16> MAGIC = {
+      'D', 'I', 'Y', '-', 'S', 'Q', 'L', 'i', 't', 'e', ' ', 'v', '1'};
+  static constexpr std::uint32_t FORMAT_VERSION = 1;
+  // Every page ends in a CRC-32C trailer, see Pager
+  static constexpr std::uint32_t PAGE_CHECKSUMS = 1U << 0U;
+  // Pages past page 0 are stored compressed, see CompressedFile
+  static constexpr std::uint32_t PAGE_COMPRESSION = 1U << 1U;
+  // Changes go to a write-ahead log before the file, see Wal
+  static constexpr std::uint32_t WAL = 1U << 2U;
+
+  std::uint32_t page_size {0};
+  std::uint32_t format_version {FORMAT_VERSION};
+  std::uint32_t page_count {0};
+  std::uint32_t freelist_trunk {0};
+  std::uint32_t freelist_count {0};
+  std::uint32_t flags {0};
+
+  void encode(std::byte* dst) const noexcept;
+  // std::nullopt when src does not start with the magic string
+  static std::optional<FileHeader> decode(const std::byte* src) noexcept;
+};
+
+// Page sizes must be a power of two between 512 and 65536 bytes
+bool is_valid_page_size(std::uint32_t page_size) noexcept;
+
+#endif  // FILE_HEADER_HPP
@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "file_io.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif
+
+namespace
+{
+constexpr unsigned DEFAULT_QUEUE_DEPTH = 64;
+// Largest iovec array a vectored call accepts (POSIX IOV_MAX on Linux)
+constexpr std::size_t MAX_RUN_REQUESTS = 1024;
+// Logical block size assumed when the filesystem does not report one
+constexpr std::size_t DEFAULT_DIRECT_ALIGNMENT = 4096;
+
+[[noreturn]] void throw_errno(const char* what)
+{
+  throw std::system_error(errno, std::generic_category(), what);
+}
+}  // namespace
+
+// --- FileIo ---
+
+FileIo::~FileIo()
+{
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+/**
+ * @brief Read length bytes at offset; bytes past the end of file read as zero
+ *
+ * @throws std::system_error on I/O error
+ */
+void FileIo::read(std::byte* dst, std::size_t length, std::uint64_t offset)
+{
+  while (length > 0) {
+    ssize_t n = ::pread(m_fd, dst, length, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("pread");
+    }
+    if (n == 0) {
+      std::memset(dst, 0, length);
+      return;
+    }
+    auto done = static_cast<std::size_t>(n);
+    dst += done;
+    length -= done;
+    offset += done;
+  }
+}
+
+/**
+ * @brief Write length bytes at offset, extending the file if needed
+ *
+ * @throws std::system_error on I/O error
+ */
+void FileIo::write(const std::byte* src,
+                   std::size_t length,
+                   std::uint64_t offset)
+{
+  while (length > 0) {
+    ssize_t n = ::pwrite(m_fd, src, length, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("pwrite");
+    }
+    auto done = static_cast<std::size_t>(n);
+    src += done;
+    length -= done;
+    offset += done;
+  }
+}
+
+void FileIo::read_batch(const std::vector<IoRequest>& requests)
+{
+  for (const auto& run : coalesce(requests)) {
+    transfer_run(requests, run, false);
+  }
+}
+
+void FileIo::write_batch(const std::vector<IoRequest>& requests)
+{
+  for (const auto& run : coalesce(requests)) {
+    transfer_run(requests, run, true);
+  }
+}
+
+/**
+ * @brief Group consecutive requests that continue each other in the file
+ *
+ * Requests are not reordered; a run ends where the next request does not
+ * start at the end of the previous one, or at MAX_RUN_REQUESTS requests.
+ *
+ * @param requests Requests in submission order
+ * @return std::vector<IoRun> Runs covering every request once
+ */
+std::vector<FileIo::IoRun> FileIo::coalesce(
+    const std::vector<IoRequest>& requests)
+{
+  std::vector<IoRun> runs;
+  for (std::size_t i = 0; i < requests.size(); i++) {
+    const auto& request = requests[i];
+    if (!runs.empty()) {
+      auto& run = runs.back();
+      if (run.count < MAX_RUN_REQUESTS
+          && run.offset + run.length == request.offset)
+      {
+        run.count++;
+        run.length += request.length;
+        continue;
+      }
+    }
+    runs.push_back(IoRun {i, 1, request.offset, request.length});
+  }
+  return runs;
+}
+
+/**
+ * @brief Transfer a run with one preadv()/pwritev()
+ *
+ * @throws std::system_error on I/O error
+ */
+void FileIo::transfer_run(const std::vector<IoRequest>& requests,
+                          const IoRun& run,
+                          bool write)
+{
+  if (run.count == 1) {
+    finish_run(requests, run, 0, write);
+    return;
+  }
+
+  std::vector<iovec> iovecs(run.count);
+  for (std::size_t i = 0; i < run.count; i++) {
+    const auto& request = requests[run.first + i];
+    iovecs[i] = iovec {request.buffer, request.length};
+  }
+
+  ssize_t n = 0;
+  do {
+    const auto count = static_cast<int>(iovecs.size());
+    const auto offset = static_cast<off_t>(run.offset);
+    n = write ? ::pwritev(m_fd, iovecs.data(), count, offset)
+              : ::preadv(m_fd, iovecs.data(), count, offset);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    throw_errno(write ? "pwritev" : "preadv");
+  }
+  finish_run(requests, run, static_cast<std::size_t>(n), write);
+}
+
+/**
+ * @brief Transfer whatever a short vectored call left of a run
+ *
+ * @param requests Batch the run belongs to
+ * @param run Run that was partially transferred
+ * @param done Bytes of the run already transferred
+ * @param write Whether the run is a write
+ * @throws std::system_error on I/O error
+ */
+void FileIo::finish_run(const std::vector<IoRequest>& requests,
+                        const IoRun& run,
+                        std::size_t done,
+                        bool write)
+{
+  for (std::size_t i = run.first; i < run.first + run.count; i++) {
+    const auto& request = requests[i];
+    if (done >= request.length) {
+      done -= request.length;
+      continue;
+    }
+    if (write) {
+      this->write(request.buffer + done, request.length - done,
+                  request.offset + done);
+    } else {
+      read(request.buffer + done, request.length - done,
+           request.offset + done);
+    }
+    done = 0;
+  }
+}
+
+void FileIo::sync()
+{
+#ifdef __linux__
+  if (::fdatasync(m_fd) != 0) {
+    throw_errno("fdatasync");
+  }
+#else
+  if (::fsync(m_fd) != 0) {
+    throw_errno("fsync");
+  }
+#endif
+}
+
+std::uint64_t FileIo::size() const
+{
+  struct stat st {};
+  if (::fstat(m_fd, &st) != 0) {
+    throw_errno("fstat");
+  }
+  return static_cast<std::uint64_t>(st.st_size);
+}
+
+void FileIo::truncate(std::uint64_t size)
+{
+  if (::ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+    throw_errno("ftruncate");
+  }
+}
+
+/**
+ * @brief Grow the file to size bytes with disk blocks allocated up front
+ *
+ * Later writes into the range change neither the file size nor the block
+ * map. Filesystems without fallocate() get a sparse extension instead.
+ * A file already at least size bytes long is left alone.
+ *
+ * @throws std::system_error on I/O error, including a full disk
+ */
+void FileIo::allocate(std::uint64_t size)
+{
+  const std::uint64_t current = this->size();
+  if (size <= current) {
+    return;
+  }
+#ifdef __linux__
+  const auto offset = static_cast<off_t>(current);
+  const auto length = static_cast<off_t>(size - current);
+  int result = 0;
+  do {
+    result = ::fallocate(m_fd, 0, offset, length);
+  } while (result != 0 && errno == EINTR);
+  if (result == 0) {
+    return;
+  }
+  if (errno != EOPNOTSUPP && errno != ENOSYS) {
+    throw_errno("fallocate");
+  }
+#endif
+  truncate(size);
+}
+
+/**
+ * @brief Alignment direct I/O demands of buffers, offsets and lengths
+ *
+ * Taken from statx() where the filesystem reports it, otherwise the common
+ * 4 KiB logical block size is assumed.
+ */
+std::size_t FileIo::direct_alignment() const noexcept
+{
+  if (m_alignment != 0) {
+    return m_alignment;
+  }
+  std::size_t alignment = DEFAULT_DIRECT_ALIGNMENT;
+#if defined(__linux__) && defined(STATX_DIOALIGN)
+  struct statx st {};
+  if (::statx(m_fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &st) == 0
+      && (st.stx_mask & STATX_DIOALIGN) != 0 && st.stx_dio_offset_align != 0)
+  {
+    alignment = std::max(st.stx_dio_mem_align, st.stx_dio_offset_align);
+  }
+#endif
+  return alignment;
+}
+
+/**
+ * @brief Switch the file to direct I/O, bypassing the kernel page cache
+ *
+ * Afterwards every buffer, offset and length must be a multiple of
+ * direct_alignment(). Filesystems without direct I/O support (tmpfs on
+ * older kernels, many FUSE mounts) refuse O_DIRECT or fail the first
+ * transfer; the file then stays buffered.
+ *
+ * @return bool Whether direct I/O is in effect
+ */
+bool FileIo::enable_direct_io() noexcept
+{
+#ifdef O_DIRECT
+  const int flags = ::fcntl(m_fd, F_GETFL);
+  if (flags < 0 || ::fcntl(m_fd, F_SETFL, flags | O_DIRECT) != 0) {
+    return false;
+  }
+
+  const std::size_t alignment = direct_alignment();
+  void* probe = std::aligned_alloc(alignment, alignment);
+  ssize_t n = -1;
+  if (probe != nullptr) {
+    do {
+      n = ::pread(m_fd, probe, alignment, 0);
+    } while (n < 0 && errno == EINTR);
+    std::free(probe);
+  }
+  if (n < 0) {
+    ::fcntl(m_fd, F_SETFL, flags);
+    return false;
+  }
+  m_direct = true;
+  m_alignment = alignment;
+#endif
+  return m_direct;
+}
+
+// --- AlignedBuffer ---
+
+AlignedBuffer::AlignedBuffer(std::size_t size, std::size_t alignment)
+    : m_size((size + alignment - 1) / alignment * alignment)
+{
+  m_data.reset(
+      static_cast<std::byte*>(std::aligned_alloc(alignment, m_size)));
+  if (!m_data && m_size != 0) {
+    throw std::bad_alloc();
+  }
+}
+
+void AlignedBuffer::Free::operator()(std::byte* data) const noexcept
+{
+  std::free(data);
+}
+
+// --- UringFileIo ---
+
+#ifdef __linux__
+
+struct UringFileIo::Ring
+{
+  int fd {-1};
+  unsigned entries {0};
+
+  void* sq_ring {nullptr};
+  std::size_t sq_ring_size {0};
+  void* cq_ring {nullptr};
+  std::size_t cq_ring_size {0};
+  io_uring_sqe* sqes {nullptr};
+  std::size_t sqes_size {0};
+
+  unsigned* sq_head {nullptr};
+  unsigned* sq_tail {nullptr};
+  unsigned* sq_mask {nullptr};
+  unsigned* sq_array {nullptr};
+  unsigned* cq_head {nullptr};
+  unsigned* cq_tail {nullptr};
+  unsigned* cq_mask {nullptr};
+  io_uring_cqe* cqes {nullptr};
+
+  std::vector<iovec> iovecs;
+
+  Ring() = default;
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  Ring(Ring&&) = delete;
+  Ring& operator=(Ring&&) = delete;
+
+  ~Ring()
+  {
+    if (sqes != nullptr) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_ring != nullptr && cq_ring != sq_ring) {
+      munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != nullptr) {
+      munmap(sq_ring, sq_ring_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  // Returns false if the kernel does not let us create a ring
+  bool setup(unsigned depth)
+  {
+    io_uring_params params {};
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+    if (fd < 0) {
+      return false;
+    }
+    entries = params.sq_entries;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+    if (sq_ring == nullptr) {
+      return false;
+    }
+    cq_ring = single_mmap ? sq_ring : map(cq_ring_size, IORING_OFF_CQ_RING);
+    if (cq_ring == nullptr) {
+      return false;
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+    if (sqes == nullptr) {
+      return false;
+    }
+
+    auto* sq = static_cast<std::byte*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<std::byte*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+  }
+
+  void* map(std::size_t size, std::uint64_t offset) const
+  {
+    void* addr = mmap(nullptr,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      fd,
+                      static_cast<off_t>(offset));
+    return addr == MAP_FAILED ? nullptr : addr;
+  }
+
+  int enter(unsigned to_submit, unsigned min_complete) const
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter,
+                                      fd,
+                                      to_submit,
+                                      min_complete,
+                                      IORING_ENTER_GETEVENTS,
+                                      nullptr,
+                                      0));
+  }
+};
+
+/**
+ * @brief Take ownership of fd and set up a ring of queue_depth entries
+ *
+ * @param fd Open file descriptor
+ * @param queue_depth Submission queue size; 0 selects a default
+ */
+UringFileIo::UringFileIo(int fd, unsigned queue_depth)
+    : FileIo(fd)
+    , m_ring(std::make_unique<Ring>())
+{
+  if (!m_ring->setup(queue_depth == 0 ? DEFAULT_QUEUE_DEPTH : queue_depth)) {
+    m_ring.reset();
+  }
+}
+
+UringFileIo::~UringFileIo() = default;
+
+IoBackend UringFileIo::backend() const noexcept
+{
+  return m_ring ? IoBackend::io_uring : IoBackend::pread;
+}
+
+void UringFileIo::read_batch(const std::vector<IoRequest>& requests)
+{
+  if (!m_ring) {
+    FileIo::read_batch(requests);
+    return;
+  }
+  submit(requests, false);
+}
+
+void UringFileIo::write_batch(const std::vector<IoRequest>& requests)
+{
+  if (!m_ring) {
+    FileIo::write_batch(requests);
+    return;
+  }
+  submit(requests, true);
+}
+
+/**
+ * @brief Queue every run, submit them together and wait for completion
+ *
+ * A batch that coalesces into a single run gains nothing from the ring and
+ * goes through preadv()/pwritev() instead. Short transfers are finished
+ * synchronously; the first error is rethrown once the whole chunk has
+ * completed so no buffer is left in flight. If io_uring_enter() itself
+ * fails, the entries it did not take are withdrawn from the ring and those
+ * it took are waited for before the error is thrown.
+ *
+ * @param requests Requests to perform
+ * @param write Whether the requests are writes
+ * @throws std::system_error on I/O error
+ */
+void UringFileIo::submit(const std::vector<IoRequest>& requests, bool write)
+{
+  const auto runs = coalesce(requests);
+  if (runs.size() <= 1) {
+    if (write) {
+      FileIo::write_batch(requests);
+    } else {
+      FileIo::read_batch(requests);
+    }
+    return;
+  }
+
+  std::lock_guard lock(m_submit_latch);
+  auto& ring = *m_ring;
+  ring.iovecs.resize(requests.size());
+  for (std::size_t i = 0; i < requests.size(); i++) {
+    ring.iovecs[i] = iovec {requests[i].buffer, requests[i].length};
+  }
+
+  for (std::size_t first = 0; first < runs.size(); first += ring.entries) {
+    const auto count = static_cast<unsigned>(
+        std::min<std::size_t>(ring.entries, runs.size() - first));
+
+    unsigned tail = *ring.sq_tail;
+    for (unsigned i = 0; i < count; i++) {
+      const auto& run = runs[first + i];
+      const unsigned index = tail & *ring.sq_mask;
+
+      io_uring_sqe& sqe = ring.sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe.fd = fd();
+      sqe.off = run.offset;
+      sqe.addr = reinterpret_cast<std::uint64_t>(&ring.iovecs[run.first]);
+      sqe.len = static_cast<std::uint32_t>(run.count);
+      sqe.user_data = first + i;
+      ring.sq_array[index] = index;
+      tail++;
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+    unsigned completed = 0;
+    int error = 0;
+    const auto reap = [&]
+    {
+      unsigned head = *ring.cq_head;
+      const unsigned cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != cq_tail; head++, completed++) {
+        const io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+        const auto& run = runs[cqe.user_data];
+        if (cqe.res < 0) {
+          error = error == 0 ? -cqe.res : error;
+          continue;
+        }
+        auto done = static_cast<std::size_t>(cqe.res);
+        if (done < run.length) {
+          try {
+            finish_run(requests, run, done, write);
+          } catch (const std::system_error& e) {
+            error = error == 0 ? e.code().value() : error;
+          }
+        }
+      }
+      __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    };
+
+    unsigned to_submit = count;
+    int enter_error = 0;
+    while (completed < count) {
+      int ret = ring.enter(to_submit, count - completed);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        enter_error = errno;
+        break;
+      }
+      to_submit -= std::min(to_submit, static_cast<unsigned>(ret));
+      reap();
+    }
+
+    if (enter_error != 0) {
+      // Take back the entries the kernel never consumed, then wait out the
+      // rest: they point into the caller's buffers and ring.iovecs, and
+      // their completions must not be reaped by the next batch
+      const unsigned sq_head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+      const unsigned submitted = count - (tail - sq_head);
+      __atomic_store_n(ring.sq_tail, sq_head, __ATOMIC_RELEASE);
+      reap();
+      while (completed < submitted) {
+        if (ring.enter(0, submitted - completed) < 0 && errno != EINTR) {
+          // Completions are posted whether or not anyone waits for them
+          std::this_thread::yield();
+        }
+        reap();
+      }
+      errno = enter_error;
+      throw_errno("io_uring_enter");
+    }
+    if (error != 0) {
+      throw std::system_error(error,
+                              std::generic_category(),
+                              write ? "io_uring write" : "io_uring read");
+    }
+  }
+}
+
+#else
+
+struct UringFileIo::Ring
+{
+};
+
+UringFileIo::UringFileIo(int fd, unsigned /*queue_depth*/)
+    : FileIo(fd)
+{
+}
+
+UringFileIo::~UringFileIo() = default;
+
+IoBackend UringFileIo::backend() const noexcept
+{
+  return IoBackend::pread;
+}
+
+void UringFileIo::read_batch(const std::vector<IoRequest>& requests)
+{
+  FileIo::read_batch(requests);
+}
+
+void UringFileIo::write_batch(const std::vector<IoRequest>& requests)
+{
+  FileIo::write_batch(requests);
+}
+
+void UringFileIo::submit(const std::vector<IoRequest>& /*requests*/,
+                         bool /*write*/)
+{
+}
+
+#endif
+
+/**
+ * @brief Open a file for positional I/O with the requested backend
+ *
+ * @param filename Path to the file
+ * @param backend Preferred backend
+ * @param create Create the file if it does not exist
+ * @return std::unique_ptr<FileIo> The opened file
+ * @throws std::runtime_error if the file cannot be opened
+ */
+auto open_file_io(const std::filesystem::path& filename,
+                  IoBackend backend,
+                  bool create) -> std::unique_ptr<FileIo>
+{
+  int flags = O_RDWR | O_CLOEXEC;
+  if (create) {
+    flags |= O_CREAT;
+  }
+  int fd = ::open(filename.c_str(), flags, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open file");
+  }
+
+  if (backend == IoBackend::io_uring) {
+    return std::make_unique<UringFileIo>(fd, DEFAULT_QUEUE_DEPTH);
+  }
+  return std::make_unique<FileIo>(fd);
+}
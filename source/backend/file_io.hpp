@@ -0,0 +1,159 @@
+#ifndef FILE_IO_HPP
+#define FILE_IO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class IoBackend
+{
+  pread,  // positional pread/pwrite, one syscall per request
+  io_uring  // batches submitted together; falls back to pread if unavailable
+};
+
+struct IoRequest
+{
+  std::byte* buffer;  // destination of a read, source of a write
+  std::size_t length;
+  std::uint64_t offset;
+};
+
+/**
+ * @brief Positional file I/O underneath the Pager and the WAL
+ *
+ * There is no shared file position, so independent requests never
+ * serialize on it. The batch calls submit every request before waiting,
+ * which lets an asynchronous backend keep more than one request in flight.
+ * Consecutive requests that are adjacent in the file are coalesced into a
+ * single vectored transfer, so callers should sort batches by offset.
+ * Reads past the end of the file yield zeros. Failures throw
+ * std::system_error. All calls may be made from several threads at once.
+ */
+class FileIo
+{
+public:
+  explicit FileIo(int fd) noexcept
+      : m_fd(fd)
+  {
+  }
+  virtual ~FileIo();
+
+  FileIo(const FileIo&) = delete;
+  FileIo& operator=(const FileIo&) = delete;
+  FileIo(FileIo&&) = delete;
+  FileIo& operator=(FileIo&&) = delete;
+
+  void read(std::byte* dst, std::size_t length, std::uint64_t offset);
+  void write(const std::byte* src, std::size_t length, std::uint64_t offset);
+
+  virtual void read_batch(const std::vector<IoRequest>& requests);
+  virtual void write_batch(const std::vector<IoRequest>& requests);
+
+  // Make written data durable (fdatasync)
+  void sync();
+  std::uint64_t size() const;
+  void truncate(std::uint64_t size);
+  // Grow the file to size bytes, reserving its blocks (fallocate)
+  void allocate(std::uint64_t size);
+
+  // Bypass the page cache (O_DIRECT); false if the filesystem refuses
+  bool enable_direct_io() noexcept;
+  bool is_direct() const noexcept { return m_direct; }
+  std::size_t direct_alignment() const noexcept;
+
+  int fd() const noexcept { return m_fd; }
+  virtual IoBackend backend() const noexcept { return IoBackend::pread; }
+
+protected:
+  // Consecutive requests covering one contiguous range of the file
+  struct IoRun
+  {
+    std::size_t first;  // index of the first request
+    std::size_t count;
+    std::uint64_t offset;
+    std::size_t length;  // total bytes
+  };
+
+  static std::vector<IoRun> coalesce(const std::vector<IoRequest>& requests);
+  // Complete a run of which only the first done bytes were transferred
+  void finish_run(const std::vector<IoRequest>& requests,
+                  const IoRun& run,
+                  std::size_t done,
+                  bool write);
+
+private:
+  void transfer_run(const std::vector<IoRequest>& requests,
+                    const IoRun& run,
+                    bool write);
+
+  int m_fd;
+  bool m_direct {false};
+  std::size_t m_alignment {0};  // of direct I/O, once enabled
+};
+
+/**
+ * @brief Heap buffer aligned for direct I/O
+ *
+ * For transfers that do not go through buffer pool frames, which the arena
+ * already aligns. The size is rounded up to a multiple of the alignment.
+ */
+class AlignedBuffer
+{
+public:
+  AlignedBuffer(std::size_t size,
+                std::size_t alignment);  // Can throw bad_alloc
+
+  std::byte* data() const noexcept { return m_data.get(); }
+  std::size_t size() const noexcept { return m_size; }
+
+private:
+  struct Free
+  {
+    void operator()(std::byte* data) const noexcept;
+  };
+  std::unique_ptr<std::byte, Free> m_data;
+  std::size_t m_size;
+};
+
+/**
+ * @brief io_uring backend built directly on the kernel interface
+ *
+ * Each coalesced run becomes one vectored submission entry. A batch is
+ * split into submissions of at most queue-depth runs, each pushed with a
+ * single io_uring_enter() that also waits for completion.
+ * When the kernel refuses to set up a ring (old kernel, seccomp policy) the
+ * object behaves exactly like the pread backend.
+ */
+class UringFileIo : public FileIo
+{
+public:
+  UringFileIo(int fd, unsigned queue_depth);
+  ~UringFileIo() override;
+
+  UringFileIo(const UringFileIo&) = delete;
+  UringFileIo& operator=(const UringFileIo&) = delete;
+  UringFileIo(UringFileIo&&) = delete;
+  UringFileIo& operator=(UringFileIo&&) = delete;
+
+  void read_batch(const std::vector<IoRequest>& requests) override;
+  void write_batch(const std::vector<IoRequest>& requests) override;
+  IoBackend backend() const noexcept override;
+
+private:
+  struct Ring;
+  void submit(const std::vector<IoRequest>& requests, bool write);
+
+  std::unique_ptr<Ring> m_ring;
+  // The ring is shared state; one batch is in flight at a time
+  std::mutex m_submit_latch;
+};
+
+// Open filename read-write; io_uring silently degrades to pread
+auto open_file_io(const std::filesystem::path& filename,
+                  IoBackend backend,
+                  bool create = false) -> std::unique_ptr<FileIo>;
+
+#endif  // FILE_IO_HPP
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "file_mapping.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+// Mappings reach this far past the end of the file to absorb growth
+constexpr std::size_t MAPPING_CHUNK = std::size_t {64} << 20U;
+
+int to_madvise(AccessPattern pattern) noexcept
+{
+  switch (pattern) {
+    case AccessPattern::sequential:
+      return MADV_SEQUENTIAL;
+    case AccessPattern::random:
+      return MADV_RANDOM;
+    case AccessPattern::normal:
+      break;
+  }
+  return MADV_NORMAL;
+}
+}  // namespace
+
+/**
+ * @brief Open filename for mapping; nothing is mapped until ensure_mapped()
+ *
+ * @param filename Path to the database file
+ * @throws std::runtime_error if the file cannot be opened
+ */
+FileMapping::FileMapping(const std::filesystem::path& filename)
+    : m_fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC))
+{
+  if (m_fd < 0) {
+    throw std::runtime_error("Cannot open file for mapping");
+  }
+}
+
+FileMapping::~FileMapping()
+{
+  release_retired();
+  if (m_data != nullptr) {
+    munmap(m_data, m_size);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+FileMapping::FileMapping(FileMapping&& other) noexcept
+    : m_fd(std::exchange(other.m_fd, -1))
+    , m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_pattern(other.m_pattern)
+    , m_retired(std::move(other.m_retired))
+{
+}
+
+FileMapping& FileMapping::operator=(FileMapping&& other) noexcept
+{
+  if (this != &other) {
+    std::swap(m_fd, other.m_fd);
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_pattern, other.m_pattern);
+    std::swap(m_retired, other.m_retired);
+  }
+  return *this;
+}
+
+/**
+ * @brief Grow the mapping so it covers at least file_bytes bytes
+ *
+ * The previous mapping, if any, is retired instead of unmapped because
+ * callers may still hold pointers into it.
+ *
+ * @param file_bytes Current size of the file
+ * @throws std::runtime_error if the file cannot be mapped
+ */
+void FileMapping::ensure_mapped(std::size_t file_bytes)
+{
+  if (file_bytes <= m_size) {
+    return;
+  }
+
+  const std::size_t size =
+      (file_bytes + MAPPING_CHUNK - 1) / MAPPING_CHUNK * MAPPING_CHUNK;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Cannot map database file");
+  }
+
+  if (m_data != nullptr) {
+    m_retired.push_back(Region {m_data, m_size});
+  }
+  m_data = static_cast<std::byte*>(addr);
+  m_size = size;
+  advise(m_pattern);
+}
+
+void FileMapping::release_retired() noexcept
+{
+  for (const auto& region : m_retired) {
+    munmap(region.data, region.size);
+  }
+  m_retired.clear();
+}
+
+/**
+ * @brief Tell the kernel how the mapping is about to be read
+ *
+ * Sequential enables aggressive read-ahead and early reclaim behind the
+ * reader, random disables read-ahead for point lookups.
+ *
+ * @param pattern Expected access pattern
+ */
+void FileMapping::advise(AccessPattern pattern) noexcept
+{
+  m_pattern = pattern;
+  if (m_data != nullptr) {
+    madvise(m_data, m_size, to_madvise(pattern));
+  }
+}
+
+/**
+ * @brief Ask the kernel to start reading a range of the file
+ *
+ * @param offset Byte offset into the file
+ * @param length Number of bytes
+ */
+void FileMapping::will_need(std::size_t offset, std::size_t length) noexcept
+{
+  if (m_data == nullptr || offset >= m_size) {
+    return;
+  }
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const std::size_t start = offset / page * page;
+  length = std::min(length + (offset - start), m_size - start);
+  madvise(m_data + start, length, MADV_WILLNEED);
+}
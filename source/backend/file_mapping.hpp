@@ -0,0 +1,61 @@
+#ifndef FILE_MAPPING_HPP
+#define FILE_MAPPING_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+enum class AccessPattern
+{
+  normal,
+  sequential,
+  random
+};
+
+/**
+ * @brief Read-only shared mapping of a database file
+ *
+ * The mapping is sized in large chunks beyond the end of the file so that
+ * most file growth needs no remap. When the file outgrows it a new, larger
+ * mapping is created; the old one is retired rather than unmapped while
+ * pointers into it may still be held, and released by release_retired().
+ */
+class FileMapping
+{
+public:
+  FileMapping() noexcept = default;
+  explicit FileMapping(const std::filesystem::path& filename);  // Can throw
+  ~FileMapping();
+
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+  FileMapping(FileMapping&& other) noexcept;
+  FileMapping& operator=(FileMapping&& other) noexcept;
+
+  // Make sure the first file_bytes bytes of the file are mapped
+  void ensure_mapped(std::size_t file_bytes);  // Can throw runtime_error
+  // Unmap mappings superseded by a remap; only safe with no pointers left
+  void release_retired() noexcept;
+
+  void advise(AccessPattern pattern) noexcept;
+  void will_need(std::size_t offset, std::size_t length) noexcept;
+
+  const std::byte* data() const noexcept { return m_data; }
+  std::size_t mapped_size() const noexcept { return m_size; }
+  bool is_open() const noexcept { return m_fd >= 0; }
+
+private:
+  struct Region
+  {
+    std::byte* data;
+    std::size_t size;
+  };
+
+  int m_fd {-1};
+  std::byte* m_data {nullptr};
+  std::size_t m_size {0};
+  AccessPattern m_pattern {AccessPattern::normal};
+  std::vector<Region> m_retired;
+};
+
+#endif  // FILE_MAPPING_HPP
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "frame_arena.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr std::size_t HUGE_PAGE_SIZE = std::size_t {2} << 20U;
+
+std::size_t os_page_size() noexcept
+{
+  static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+std::size_t round_up(std::size_t value, std::size_t multiple) noexcept
+{
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+void* map_anonymous(std::size_t bytes, int prot, int extra_flags) noexcept
+{
+  void* addr = mmap(
+      nullptr, bytes, prot, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+}  // namespace
+
+/**
+ * @brief Reserve address space for max_frames frames of frame_size bytes
+ *
+ * @param frame_size Size of one frame (the database page size)
+ * @param max_frames Largest number of frames the arena may ever hold
+ * @param huge_pages Whether to back the arena with huge pages
+ * @throws std::runtime_error if the address space cannot be reserved
+ */
+FrameArena::FrameArena(std::size_t frame_size,
+                       std::size_t max_frames,
+                       HugePages huge_pages)
+    : m_frame_size(frame_size)
+    , m_max_frames(max_frames)
+    , m_huge_pages(huge_pages)
+{
+  const std::size_t bytes = frame_size * max_frames;
+
+#ifdef MAP_HUGETLB
+  if (m_huge_pages == HugePages::hugetlb) {
+    // Explicit huge pages are reserved by the kernel at map time, so the
+    // whole arena is committed up front.
+    m_mapping_size = round_up(bytes, HUGE_PAGE_SIZE);
+    void* addr =
+        map_anonymous(m_mapping_size, PROT_READ | PROT_WRITE, MAP_HUGETLB);
+    if (addr != nullptr) {
+      m_mapping = static_cast<std::byte*>(addr);
+      m_base = m_mapping;
+      return;
+    }
+    m_huge_pages = HugePages::transparent;
+  }
+#else
+  if (m_huge_pages == HugePages::hugetlb) {
+    m_huge_pages = HugePages::transparent;
+  }
+#endif
+
+  const std::size_t alignment = m_huge_pages == HugePages::off
+      ? std::max(frame_size, os_page_size())
+      : HUGE_PAGE_SIZE;
+  const std::size_t reserved = round_up(bytes, alignment);
+
+  int flags = 0;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void* addr = map_anonymous(reserved + alignment, PROT_NONE, flags);
+  if (addr == nullptr) {
+    throw std::runtime_error("Cannot reserve buffer pool address space");
+  }
+
+  // Trim the mapping so the arena starts on an alignment boundary
+  auto* raw = static_cast<std::byte*>(addr);
+  auto misalignment = reinterpret_cast<std::uintptr_t>(raw) % alignment;
+  std::size_t head = misalignment == 0 ? 0 : alignment - misalignment;
+  if (head > 0) {
+    munmap(raw, head);
+  }
+  std::size_t tail = alignment - head;
+  if (tail > 0) {
+    munmap(raw + head + reserved, tail);
+  }
+  m_mapping = raw + head;
+  m_mapping_size = reserved;
+  m_base = m_mapping;
+
+  if (m_huge_pages == HugePages::transparent) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(m_base, m_mapping_size, MADV_HUGEPAGE) != 0) {
+      m_huge_pages = HugePages::off;
+    }
+#else
+    m_huge_pages = HugePages::off;
+#endif
+  }
+}
+
+FrameArena::~FrameArena()
+{
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mapping_size);
+  }
+}
+
+FrameArena::FrameArena(FrameArena&& other) noexcept
+    : m_base(std::exchange(other.m_base, nullptr))
+    , m_mapping(std::exchange(other.m_mapping, nullptr))
+    , m_mapping_size(std::exchange(other.m_mapping_size, 0))
+    , m_frame_size(other.m_frame_size)
+    , m_max_frames(other.m_max_frames)
+    , m_num_frames(std::exchange(other.m_num_frames, 0))
+    , m_huge_pages(other.m_huge_pages)
+{
+}
+
+FrameArena& FrameArena::operator=(FrameArena&& other) noexcept
+{
+  if (this != &other) {
+    std::swap(m_base, other.m_base);
+    std::swap(m_mapping, other.m_mapping);
+    std::swap(m_mapping_size, other.m_mapping_size);
+    std::swap(m_frame_size, other.m_frame_size);
+    std::swap(m_max_frames, other.m_max_frames);
+    std::swap(m_num_frames, other.m_num_frames);
+    std::swap(m_huge_pages, other.m_huge_pages);
+  }
+  return *this;
+}
+
+/**
+ * @brief Make exactly num_frames frames usable
+ *
+ * Growing commits memory after the current last frame; shrinking hands the
+ * memory of the dropped frames back to the OS. Existing frames never move.
+ *
+ * @param num_frames New number of frames
+ * @throws std::length_error if num_frames exceeds max_frames()
+ * @throws std::runtime_error if the OS refuses to commit memory
+ */
+void FrameArena::resize(std::size_t num_frames)
+{
+  if (num_frames > m_max_frames) {
+    throw std::length_error("Buffer pool budget exceeds the arena reservation");
+  }
+  if (m_huge_pages == HugePages::hugetlb) {
+    m_num_frames = num_frames;
+    return;
+  }
+
+  const std::size_t old_bytes =
+      round_up(m_num_frames * m_frame_size, os_page_size());
+  const std::size_t new_bytes =
+      round_up(num_frames * m_frame_size, os_page_size());
+
+  if (new_bytes > old_bytes) {
+    if (mprotect(m_base + old_bytes, new_bytes - old_bytes,
+                 PROT_READ | PROT_WRITE) != 0)
+    {
+      throw std::runtime_error("Cannot commit buffer pool memory");
+    }
+  } else if (new_bytes < old_bytes) {
+    madvise(m_base + new_bytes, old_bytes - new_bytes, MADV_DONTNEED);
+    mprotect(m_base + new_bytes, old_bytes - new_bytes, PROT_NONE);
+  }
+  m_num_frames = num_frames;
+}
+
+std::size_t physical_memory_bytes() noexcept
+{
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  if (pages <= 0) {
+    return std::size_t {1} << 30U;
+  }
+  return static_cast<std::size_t>(pages) * os_page_size();
+}
@@ -0,0 +1,60 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+enum class HugePages
+{
+  off,
+  transparent,  // madvise(MADV_HUGEPAGE) on the arena
+  hugetlb  // MAP_HUGETLB, falls back to transparent if none are reserved
+};
+
+/**
+ * @brief One contiguous, aligned allocation holding every buffer pool frame
+ *
+ * Address space for the largest allowed pool is reserved up front and only
+ * the frames in use are committed, so the pool can grow or shrink without
+ * ever moving a frame: pointers handed out to pinned pages stay valid.
+ */
+class FrameArena
+{
+public:
+  FrameArena() noexcept = default;
+  FrameArena(std::size_t frame_size,
+             std::size_t max_frames,
+             HugePages huge_pages);  // Can throw runtime_error
+  ~FrameArena();
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+  FrameArena(FrameArena&& other) noexcept;
+  FrameArena& operator=(FrameArena&& other) noexcept;
+
+  // Commit or release memory so that exactly num_frames frames are usable
+  void resize(std::size_t num_frames);  // Can throw length_error
+
+  std::byte* frame(std::size_t index) const noexcept
+  {
+    return m_base + index * m_frame_size;
+  }
+  std::size_t size() const noexcept { return m_num_frames; }
+  std::size_t max_frames() const noexcept { return m_max_frames; }
+  std::size_t frame_size() const noexcept { return m_frame_size; }
+  HugePages huge_pages() const noexcept { return m_huge_pages; }
+
+private:
+  std::byte* m_base {nullptr};
+  std::byte* m_mapping {nullptr};
+  std::size_t m_mapping_size {0};
+  std::size_t m_frame_size {0};
+  std::size_t m_max_frames {0};
+  std::size_t m_num_frames {0};
+  HugePages m_huge_pages {HugePages::off};
+};
+
+// Physical memory of the machine, used as the default pool ceiling
+std::size_t physical_memory_bytes() noexcept;
+
+#endif  // FRAME_ARENA_HPP
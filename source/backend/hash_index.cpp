@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "hash_index.hpp"
+
+#include "byte_order.hpp"
+#include "crc32c.hpp"
+
+namespace
+{
+constexpr std::uint8_t META = 0x10;
+constexpr std::uint8_t DIRECTORY = 0x11;
+constexpr std::uint8_t BUCKET = 0x12;
+
+constexpr std::size_t KIND_OFFSET = 0;
+
+constexpr std::size_t LEVEL_OFFSET = 4;
+constexpr std::size_t SPLIT_OFFSET = 8;
+constexpr std::size_t ENTRIES_OFFSET = 12;
+constexpr std::size_t BYTES_OFFSET = 20;
+constexpr std::size_t META_HEADER = 32;
+
+constexpr std::size_t DIRECTORY_HEADER = 8;
+
+constexpr std::size_t COUNT_OFFSET = 2;
+constexpr std::size_t END_OFFSET = 4;
+constexpr std::size_t OVERFLOW_OFFSET = 8;
+constexpr std::size_t BUCKET_HEADER = 16;
+
+// Hash, key size, payload size and rowid
+constexpr std::size_t CELL_HEADER = 16;
+constexpr std::size_t KEY_SIZE_OFFSET = 4;
+constexpr std::size_t PAYLOAD_SIZE_OFFSET = 6;
+constexpr std::size_t ROWID_OFFSET = 8;
+
+// Buckets split once their cells fill this much of the bucket pages
+constexpr std::size_t LOAD_PERCENT = 75;
+
+std::uint32_t hash_of(const std::vector<std::byte>& key) noexcept
+{
+  // CRC-32C mixes the key well but not its low bits alone, which pick the
+  // bucket; the finalizer of MurmurHash3 spreads them
+  std::uint32_t hash = crc32c(key.data(), key.size());
+  hash ^= hash >> 16U;
+  hash *= 0x85EBCA6BU;
+  hash ^= hash >> 13U;
+  hash *= 0xC2B2AE35U;
+  hash ^= hash >> 16U;
+  return hash;
+}
+
+// Slots of the meta page pointing at buckets; the rest point at directory
+// pages
+std::size_t direct_slots(std::size_t usable) noexcept
+{
+  return (usable - META_HEADER) / 4 / 2;
+}
+
+std::size_t per_directory(std::size_t usable) noexcept
+{
+  return (usable - DIRECTORY_HEADER) / 4;
+}
+
+std::uint64_t bucket_of(std::uint32_t hash,
+                        std::uint32_t level,
+                        std::uint32_t split) noexcept
+{
+  const std::uint64_t low = hash & ((std::uint64_t {1} << level) - 1);
+  if (low >= split) {
+    return low;
+  }
+  return hash & ((std::uint64_t {1} << (level + 1)) - 1);
+}
+
+std::size_t cell_size(const std::byte* cell) noexcept
+{
+  return CELL_HEADER + load_u16(cell + KEY_SIZE_OFFSET)
+      + load_u16(cell + PAYLOAD_SIZE_OFFSET);
+}
+
+bool cell_matches(const std::byte* cell,
+                  std::uint32_t hash,
+                  const std::vector<std::byte>& key) noexcept
+{
+  return load_u32(cell) == hash
+      && load_u16(cell + KEY_SIZE_OFFSET) == key.size()
+      && (key.empty()
+          || std::memcmp(cell + CELL_HEADER, key.data(), key.size()) == 0);
+}
+
+std::size_t cell_end(const std::byte* page) noexcept
+{
+  return load_u32(page + END_OFFSET);
+}
+
+PageId overflow_of(const std::byte* page) noexcept
+{
+  return load_u32(page + OVERFLOW_OFFSET);
+}
+
+void init_bucket(std::byte* page) noexcept
+{
+  std::memset(page, 0, BUCKET_HEADER);
+  page[KIND_OFFSET] = static_cast<std::byte>(BUCKET);
+  store_u32(page + END_OFFSET, BUCKET_HEADER);
+}
+
+[[noreturn]] void broken(PageId page, const std::string& what)
+{
+  throw std::logic_error("Hash index page " + std::to_string(page) + ": "
+                         + what);
+}
+}  // namespace
+
+/**
+ * @brief Allocate the meta page and first bucket of an empty table
+ *
+ * @param pager Pager of a file with a header, see Pager::allocate_page()
+ * @return PageId Meta page to open the table with
+ */
+PageId HashIndex::create(Pager& pager)
+{
+  PageHandle meta = pager.allocate_page();
+  PageHandle bucket = pager.allocate_page();
+  init_bucket(bucket.bytes());
+  meta.bytes()[KIND_OFFSET] = static_cast<std::byte>(META);
+  store_u32(meta.bytes() + META_HEADER, bucket.id());
+  return meta.id();
+}
+
+HashIndex::HashIndex(Pager& pager, PageId meta)
+    : m_pager(pager)
+    , m_meta(meta)
+    , m_usable(pager.get_usable_size())
+{
+}
+
+std::size_t HashIndex::max_entry() const noexcept
+{
+  // Like B+tree cells, under a quarter of a page
+  return (m_usable - BUCKET_HEADER) / 4 - CELL_HEADER;
+}
+
+PageHandle HashIndex::load(PageId page, std::uint8_t kind) const
+{
+  PageHandle handle = m_pager.pin(page);
+  if (std::to_integer<std::uint8_t>(handle.bytes()[KIND_OFFSET]) != kind) {
+    throw std::runtime_error("Corrupt hash index page");
+  }
+  return handle;
+}
+
+std::size_t HashIndex::buckets() const
+{
+  const PageHandle meta = load(m_meta, META);
+  return (std::size_t {1} << load_u32(meta.bytes() + LEVEL_OFFSET))
+      + load_u32(meta.bytes() + SPLIT_OFFSET);
+}
+
+// First page of a bucket, from the meta page or a directory page
+PageId HashIndex::bucket_page(const PageHandle& meta,
+                              std::uint64_t bucket) const
+{
+  const std::size_t direct = direct_slots(m_usable);
+  if (bucket < direct) {
+    return load_u32(meta.bytes() + META_HEADER + bucket * 4);
+  }
+  const std::size_t per_page = per_directory(m_usable);
+  const PageId directory_id = load_u32(
+      meta.bytes() + META_HEADER + (direct + (bucket - direct) / per_page) * 4);
+  const PageHandle directory = load(directory_id, DIRECTORY);
+  return load_u32(directory.bytes() + DIRECTORY_HEADER
+                  + ((bucket - direct) % per_page) * 4);
+}
+
+PageId HashIndex::allocate_bucket()
+{
+  PageHandle page = m_pager.allocate_page();
+  init_bucket(page.bytes());
+  return page.id();
+}
+
+// Add a cell to the first page of a bucket with room for it
+void HashIndex::append_cell(PageId bucket, const std::vector<std::byte>& cell)
+{
+  PageHandle page = load(bucket, BUCKET);
+  while (cell_end(page.bytes()) + cell.size() > m_usable) {
+    PageId next = overflow_of(page.bytes());
+    if (next == 0) {
+      next = allocate_bucket();
+      page.mark_dirty();
+      store_u32(page.bytes() + OVERFLOW_OFFSET, next);
+    }
+    page = load(next, BUCKET);
+  }
+  page.mark_dirty();
+  std::byte* bytes = page.bytes();
+  const std::size_t end = cell_end(bytes);
+  std::memcpy(bytes + end, cell.data(), cell.size());
+  store_u32(bytes + END_OFFSET, static_cast<std::uint32_t>(end + cell.size()));
+  store_u16(bytes + COUNT_OFFSET,
+            static_cast<std::uint16_t>(load_u16(bytes + COUNT_OFFSET) + 1));
+}
+
+/**
+ * @brief Insert an entry, then split the next bucket if the table is full
+ * enough
+ *
+ * @param key Encoded index columns
+ * @param rowid Row of the entry; with the key, not in the table yet
+ * @param payload Covered columns; with the key at most max_entry() bytes
+ */
+void HashIndex::insert(const std::vector<std::byte>& key,
+                       std::int64_t rowid,
+                       const std::vector<std::byte>& payload)
+{
+  if (key.size() + payload.size() > max_entry()) {
+    throw std::length_error("Index entry too large");
+  }
+  const std::uint32_t hash = hash_of(key);
+  HashCursor cursor(*this);
+  for (bool valid = cursor.find(key); valid; valid = cursor.next()) {
+    if (cursor.rowid() == rowid) {
+      throw std::invalid_argument("Duplicate index entry");
+    }
+  }
+
+  std::vector<std::byte> cell(CELL_HEADER + key.size() + payload.size());
+  store_u32(cell.data(), hash);
+  store_u16(cell.data() + KEY_SIZE_OFFSET,
+            static_cast<std::uint16_t>(key.size()));
+  store_u16(cell.data() + PAYLOAD_SIZE_OFFSET,
+            static_cast<std::uint16_t>(payload.size()));
+  store_u64(cell.data() + ROWID_OFFSET, static_cast<std::uint64_t>(rowid));
+  auto out = std::copy(key.begin(), key.end(), cell.begin() + CELL_HEADER);
+  std::copy(payload.begin(), payload.end(), out);
+
+  PageHandle meta = load(m_meta, META);
+  const std::uint32_t level = load_u32(meta.bytes() + LEVEL_OFFSET);
+  const std::uint32_t next_split = load_u32(meta.bytes() + SPLIT_OFFSET);
+  append_cell(bucket_page(meta, bucket_of(hash, level, next_split)), cell);
+
+  meta.mark_dirty();
+  std::byte* bytes = meta.bytes();
+  store_u64(bytes + ENTRIES_OFFSET, load_u64(bytes + ENTRIES_OFFSET) + 1);
+  const std::uint64_t cell_bytes = load_u64(bytes + BYTES_OFFSET) + cell.size();
+  store_u64(bytes + BYTES_OFFSET, cell_bytes);
+  const std::uint64_t buckets = (std::uint64_t {1} << level) + next_split;
+  if (cell_bytes * 100 > buckets * (m_usable - BUCKET_HEADER) * LOAD_PERCENT) {
+    split(meta);
+  }
+}
+
+// Split bucket S into itself and bucket 2^L + S; does nothing once the
+// directory is full, leaving the buckets to grow overflow pages
+void HashIndex::split(PageHandle& meta)
+{
+  const std::uint32_t level = load_u32(meta.bytes() + LEVEL_OFFSET);
+  const std::uint32_t next_split = load_u32(meta.bytes() + SPLIT_OFFSET);
+  const std::uint64_t added = (std::uint64_t {1} << level) + next_split;
+  const std::size_t direct = direct_slots(m_usable);
+  const std::size_t per_page = per_directory(m_usable);
+  const std::size_t slot = added < direct
+      ? added
+      : direct + static_cast<std::size_t>((added - direct) / per_page);
+  if (META_HEADER + (slot + 1) * 4 > m_usable || level == 31) {
+    return;
+  }
+
+  // Register the new bucket, opening a directory page if it starts one
+  const PageId added_page = allocate_bucket();
+  if (added < direct) {
+    meta.mark_dirty();
+    store_u32(meta.bytes() + META_HEADER + slot * 4, added_page);
+  } else {
+    PageId directory_id = 0;
+    if ((added - direct) % per_page == 0) {
+      PageHandle directory = m_pager.allocate_page();
+      directory.bytes()[KIND_OFFSET] = static_cast<std::byte>(DIRECTORY);
+      directory_id = directory.id();
+      meta.mark_dirty();
+      store_u32(meta.bytes() + META_HEADER + slot * 4, directory_id);
+    } else {
+      directory_id = load_u32(meta.bytes() + META_HEADER + slot * 4);
+    }
+    PageHandle directory = load(directory_id, DIRECTORY);
+    directory.mark_dirty();
+    store_u32(directory.bytes() + DIRECTORY_HEADER
+                  + ((added - direct) % per_page) * 4,
+              added_page);
+  }
+
+  // Take the cells out of the old bucket, keeping only its first page
+  const PageId first = bucket_page(meta, next_split);
+  std::vector<std::vector<std::byte>> cells;
+  PageId page_id = first;
+  while (page_id != 0) {
+    PageHandle page = load(page_id, BUCKET);
+    const std::byte* bytes = page.bytes();
+    for (std::size_t offset = BUCKET_HEADER; offset < cell_end(bytes);
+         offset += cell_size(bytes + offset))
+    {
+      const std::byte* cell = bytes + offset;
+      cells.emplace_back(cell, cell + cell_size(cell));
+    }
+    const PageId next = overflow_of(bytes);
+    if (page_id == first) {
+      page.mark_dirty();
+      init_bucket(page.bytes());
+    } else {
+      page.release();
+      m_pager.free_page(page_id);
+    }
+    page_id = next;
+  }
+
+  const std::uint64_t mask = (std::uint64_t {1} << (level + 1)) - 1;
+  for (const auto& cell : cells) {
+    append_cell((load_u32(cell.data()) & mask) == next_split ? first
+                                                             : added_page,
+                cell);
+  }
+
+  meta.mark_dirty();
+  if (next_split + 1 == (std::uint64_t {1} << level)) {
+    store_u32(meta.bytes() + LEVEL_OFFSET, level + 1);
+    store_u32(meta.bytes() + SPLIT_OFFSET, 0);
+  } else {
+    store_u32(meta.bytes() + SPLIT_OFFSET, next_split + 1);
+  }
+}
+
+/**
+ * @brief Remove an entry
+ *
+ * An overflow page left empty is unlinked and freed.
+ *
+ * @return bool False if there is no such entry
+ */
+bool HashIndex::erase(const std::vector<std::byte>& key, std::int64_t rowid)
+{
+  const std::uint32_t hash = hash_of(key);
+  PageHandle meta = load(m_meta, META);
+  const std::uint32_t level = load_u32(meta.bytes() + LEVEL_OFFSET);
+  const std::uint32_t next_split = load_u32(meta.bytes() + SPLIT_OFFSET);
+  PageId page_id = bucket_page(meta, bucket_of(hash, level, next_split));
+  PageHandle previous;
+  while (page_id != 0) {
+    PageHandle page = load(page_id, BUCKET);
+    const std::size_t end = cell_end(page.bytes());
+    for (std::size_t offset = BUCKET_HEADER; offset < end;
+         offset += cell_size(page.bytes() + offset))
+    {
+      const std::byte* cell = page.bytes() + offset;
+      if (!cell_matches(cell, hash, key)
+          || static_cast<std::int64_t>(load_u64(cell + ROWID_OFFSET)) != rowid)
+      {
+        continue;
+      }
+      const std::size_t size = cell_size(cell);
+      page.mark_dirty();
+      std::byte* bytes = page.bytes();
+      std::memmove(bytes + offset, bytes + offset + size, end - offset - size);
+      store_u32(bytes + END_OFFSET, static_cast<std::uint32_t>(end - size));
+      const std::size_t count = load_u16(bytes + COUNT_OFFSET) - 1U;
+      store_u16(bytes + COUNT_OFFSET, static_cast<std::uint16_t>(count));
+      if (count == 0 && previous) {
+        previous.mark_dirty();
+        store_u32(previous.bytes() + OVERFLOW_OFFSET, overflow_of(bytes));
+        page.release();
+        m_pager.free_page(page_id);
+      }
+
+      meta.mark_dirty();
+      std::byte* meta_bytes = meta.bytes();
+      store_u64(meta_bytes + ENTRIES_OFFSET,
+                load_u64(meta_bytes + ENTRIES_OFFSET) - 1);
+      store_u64(meta_bytes + BYTES_OFFSET,
+                load_u64(meta_bytes + BYTES_OFFSET) - size);
+      return true;
+    }
+    page_id = overflow_of(page.bytes());
+    previous = std::move(page);
+  }
+  return false;
+}
+
+/**
+ * @brief Check the structure of the whole table
+ *
+ * Checks that every page has its kind, that cells fill their pages
+ * exactly as recorded, that each entry's hash is that of its key and puts
+ * it in the bucket holding it, and that the totals match the meta page.
+ *
+ * @return std::size_t Number of entries
+ */
+std::size_t HashIndex::verify() const
+{
+  const PageHandle meta = load(m_meta, META);
+  const std::uint32_t level = load_u32(meta.bytes() + LEVEL_OFFSET);
+  const std::uint32_t next_split = load_u32(meta.bytes() + SPLIT_OFFSET);
+  if (level > 31 || next_split >= (std::uint64_t {1} << level)) {
+    broken(m_meta, "split pointer past the level");
+  }
+  const std::uint64_t buckets = (std::uint64_t {1} << level) + next_split;
+
+  std::uint64_t entries = 0;
+  std::uint64_t cell_bytes = 0;
+  for (std::uint64_t bucket = 0; bucket < buckets; bucket++) {
+    for (PageId page_id = bucket_page(meta, bucket); page_id != 0;) {
+      const PageHandle page = load(page_id, BUCKET);
+      const std::byte* bytes = page.bytes();
+      const std::size_t end = cell_end(bytes);
+      if (end < BUCKET_HEADER || end > m_usable) {
+        broken(page_id, "cells past the page");
+      }
+      std::size_t count = 0;
+      std::size_t offset = BUCKET_HEADER;
+      while (offset < end) {
+        const std::byte* cell = bytes + offset;
+        if (offset + CELL_HEADER > end || offset + cell_size(cell) > end) {
+          broken(page_id, "cell past the end of the cells");
+        }
+        const std::vector<std::byte> key(
+            cell + CELL_HEADER,
+            cell + CELL_HEADER + load_u16(cell + KEY_SIZE_OFFSET));
+        if (load_u32(cell) != hash_of(key)) {
+          broken(page_id, "hash does not match the key");
+        }
+        if (bucket_of(load_u32(cell), level, next_split) != bucket) {
+          broken(page_id, "entry in the wrong bucket");
+        }
+        offset += cell_size(cell);
+        count++;
+      }
+      if (count != load_u16(bytes + COUNT_OFFSET)) {
+        broken(page_id, "cell count does not add up");
+      }
+      entries += count;
+      cell_bytes += end - BUCKET_HEADER;
+      page_id = overflow_of(bytes);
+    }
+  }
+  if (entries != load_u64(meta.bytes() + ENTRIES_OFFSET)
+      || cell_bytes != load_u64(meta.bytes() + BYTES_OFFSET))
+  {
+    broken(m_meta, "totals do not add up");
+  }
+  return static_cast<std::size_t>(entries);
+}
+
+HashCursor::HashCursor(const HashIndex& index) noexcept
+    : m_index(&index)
+{
+}
+
+bool HashCursor::find(const std::vector<std::byte>& key)
+{
+  m_key = key;
+  m_hash = hash_of(key);
+  const PageHandle meta = m_index->load(m_index->m_meta, META);
+  const PageId first = m_index->bucket_page(
+      meta,
+      bucket_of(m_hash,
+                load_u32(meta.bytes() + LEVEL_OFFSET),
+                load_u32(meta.bytes() + SPLIT_OFFSET)));
+  return scan(m_index->load(first, BUCKET), BUCKET_HEADER);
+}
+
+bool HashCursor::next()
+{
+  if (!valid()) {
+    return false;
+  }
+  const std::size_t after = m_offset + cell_size(m_page.bytes() + m_offset);
+  return scan(std::move(m_page), after);
+}
+
+// Stand on the first matching cell from an offset of a page on
+bool HashCursor::scan(PageHandle page, std::size_t offset)
+{
+  m_page = std::move(page);
+  for (;;) {
+    const std::byte* bytes = m_page.bytes();
+    for (; offset < cell_end(bytes); offset += cell_size(bytes + offset)) {
+      if (cell_matches(bytes + offset, m_hash, m_key)) {
+        m_offset = offset;
+        return true;
+      }
+    }
+    const PageId next = overflow_of(bytes);
+    if (next == 0) {
+      m_page.release();
+      return false;
+    }
+    m_page = m_index->load(next, BUCKET);
+    offset = BUCKET_HEADER;
+  }
+}
+
+const std::byte* HashCursor::key() const noexcept
+{
+  return m_page.bytes() + m_offset + CELL_HEADER;
+}
+
+std::size_t HashCursor::key_size() const noexcept
+{
+  return load_u16(m_page.bytes() + m_offset + KEY_SIZE_OFFSET);
+}
+
+std::int64_t HashCursor::rowid() const noexcept
+{
+  return static_cast<std::int64_t>(
+      load_u64(m_page.bytes() + m_offset + ROWID_OFFSET));
+}
+
+const std::byte* HashCursor::payload() const noexcept
+{
+  return key() + key_size();
+}
+
+std::size_t HashCursor::payload_size() const noexcept
+{
+  return load_u16(m_page.bytes() + m_offset + PAYLOAD_SIZE_OFFSET);
+}
@@ -0,0 +1,124 @@
+#ifndef HASH_INDEX_HPP
+#define HASH_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pager.hpp"
+
+class HashIndex;
+
+/**
+ * @brief Position on an entry of a HashIndex with a given key
+ *
+ * Entries sharing a key come in no particular order. Any insert or erase
+ * invalidates the cursors of the index.
+ */
+class HashCursor
+{
+public:
+  explicit HashCursor(const HashIndex& index) noexcept;
+
+  // Stand on an entry with the key; returns valid()
+  bool find(const std::vector<std::byte>& key);
+  // Move to another entry with the same key; returns valid()
+  bool next();
+
+  bool valid() const noexcept { return static_cast<bool>(m_page); }
+  // Fields of the current entry; key and payload point into the pinned page
+  const std::byte* key() const noexcept;
+  std::size_t key_size() const noexcept;
+  std::int64_t rowid() const noexcept;
+  const std::byte* payload() const noexcept;
+  std::size_t payload_size() const noexcept;
+
+private:
+  const HashIndex* m_index;
+  std::vector<std::byte> m_key;
+  std::uint32_t m_hash {0};
+  PageHandle m_page;
+  std::size_t m_offset {0};
+
+  bool scan(PageHandle page, std::size_t offset);
+};
+
+/**
+ * @brief Linear hash table of index entries, stored in Pager pages
+ *
+ * The access method of hash indexes: an entry is the encoded index columns
+ * as its key, the rowid of its row and the covered columns as payload.
+ * Lookups find the entries of one key, never a range.
+ *
+ * A meta page holds the state of the table and where its buckets are
+ * (little-endian):
+ *
+ *   meta    offset  size  field
+ *                0     1  kind: 0x10
+ *                4     4  level L
+ *                8     4  next bucket to split S, below 2^L
+ *               12     8  number of entries
+ *               20     8  bytes of entry cells
+ *               32        page slots, 4 bytes each
+ *
+ * The first half of the slots hold the first page of as many buckets; the
+ * others hold directory pages (kind 0x11), each listing the first page of
+ * the following buckets, 4 bytes each from offset 8. There are 2^L + S
+ * buckets; a key whose hash h gives h mod 2^L below S lives in bucket h
+ * mod 2^(L+1), others in bucket h mod 2^L. A lookup thus reads the meta
+ * page, at most one directory page and the bucket, whatever the size of
+ * the table; with 4 KiB pages, the first 508 buckets, some 60000 short
+ * entries, need no directory page.
+ *
+ * A bucket page (kind 0x12) has a 16-byte header, the number of cells at
+ * offset 2, the end of the cells at 4 and the next page of the bucket at
+ * 8, then its cells: hash (4), key size (2), payload size (2), rowid (8),
+ * key and payload. A full bucket chains overflow pages.
+ *
+ * Whenever the cells outgrow three quarters of the bucket pages, bucket S
+ * alone splits into itself and bucket 2^L + S, and S moves on; once every
+ * bucket of the level has split, L grows and S restarts at 0. Growth thus
+ * costs one bucket split per insert at most, never a rehash of the whole
+ * table. Buckets do not merge back as entries are erased.
+ *
+ * One thread at a time may use an index and its cursors.
+ */
+class HashIndex
+{
+public:
+  // Allocate the meta page and first bucket of an empty table
+  static PageId create(Pager& pager);
+
+  HashIndex(Pager& pager, PageId meta);
+
+  // Can throw invalid_argument for an entry already in the table and
+  // length_error for a key and payload over max_entry()
+  void insert(const std::vector<std::byte>& key,
+              std::int64_t rowid,
+              const std::vector<std::byte>& payload);
+  // False if there is no such entry
+  bool erase(const std::vector<std::byte>& key, std::int64_t rowid);
+
+  PageId root() const noexcept { return m_meta; }
+  // Largest key and payload size together
+  std::size_t max_entry() const noexcept;
+  std::size_t buckets() const;
+  // Walk every bucket and return the number of entries; throws logic_error
+  // naming the first broken invariant
+  std::size_t verify() const;
+
+private:
+  friend class HashCursor;
+
+  Pager& m_pager;
+  PageId m_meta;
+  std::size_t m_usable;
+
+  PageHandle load(PageId page, std::uint8_t kind) const;
+  PageId bucket_page(const PageHandle& meta, std::uint64_t bucket) const;
+  PageId allocate_bucket();
+  void append_cell(PageId bucket, const std::vector<std::byte>& cell);
+  void split(PageHandle& meta);
+};
+
+#endif  // HASH_INDEX_HPP
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "index_tree.hpp"
+
+#include "byte_order.hpp"
+
+namespace
+{
+constexpr std::uint8_t LEAF = 0x0A;
+constexpr std::uint8_t INTERIOR = 0x02;
+
+// Key size and payload size
+constexpr std::size_t LEAF_CELL_HEADER = 4;
+// Child page and key size
+constexpr std::size_t INTERIOR_CELL_HEADER = 6;
+
+using Cell = TreeNode::Cell;
+
+std::size_t leaf_key_size(const std::byte* cell) noexcept
+{
+  return load_u16(cell);
+}
+
+std::size_t leaf_payload_size(const std::byte* cell) noexcept
+{
+  return load_u16(cell + 2);
+}
+
+const std::byte* leaf_key(const std::byte* cell) noexcept
+{
+  return cell + LEAF_CELL_HEADER;
+}
+
+std::size_t interior_key_size(const std::byte* cell) noexcept
+{
+  return load_u16(cell + 4);
+}
+
+Cell leaf_cell(const std::vector<std::byte>& key,
+               const std::vector<std::byte>& payload)
+{
+  Cell cell(LEAF_CELL_HEADER + key.size() + payload.size());
+  store_u16(cell.data(), static_cast<std::uint16_t>(key.size()));
+  store_u16(cell.data() + 2, static_cast<std::uint16_t>(payload.size()));
+  std::copy(key.begin(), key.end(), cell.begin() + LEAF_CELL_HEADER);
+  std::copy(payload.begin(),
+            payload.end(),
+            cell.begin()
+                + static_cast<std::ptrdiff_t>(LEAF_CELL_HEADER + key.size()));
+  return cell;
+}
+
+// Cells are kept under a quarter of a page, so that every node holds at
+// least four cells and a split always leaves two halves that fit
+std::size_t max_entry_of(std::size_t capacity) noexcept
+{
+  return capacity / 4 - TreeNode::SLOT_SIZE - INTERIOR_CELL_HEADER;
+}
+
+// Entries keyed by byte strings; both kinds of node are slotted
+class IndexFormat final : public NodeFormat
+{
+public:
+  IndexFormat() noexcept
+      : NodeFormat(LEAF, INTERIOR, 0, "index")
+  {
+  }
+
+  std::size_t leaf_cell_size(const std::byte* cell) const noexcept override
+  {
+    return LEAF_CELL_HEADER + leaf_key_size(cell) + leaf_payload_size(cell);
+  }
+  KeyView leaf_key(const std::byte* cell) const noexcept override
+  {
+    return {::leaf_key(cell), leaf_key_size(cell)};
+  }
+  std::size_t interior_cell_size(
+      const std::byte* cell) const noexcept override
+  {
+    return INTERIOR_CELL_HEADER + interior_key_size(cell);
+  }
+  KeyView interior_key(const std::byte* cell) const noexcept override
+  {
+    return {cell + INTERIOR_CELL_HEADER, interior_key_size(cell)};
+  }
+  PageId interior_child(const std::byte* cell) const noexcept override
+  {
+    return load_u32(cell);
+  }
+  void set_interior_child(std::byte* cell,
+                          PageId child) const noexcept override
+  {
+    store_u32(cell, child);
+  }
+  Cell interior_cell(KeyView key, PageId child) const override
+  {
+    Cell cell(INTERIOR_CELL_HEADER + key.size);
+    store_u32(cell.data(), child);
+    store_u16(cell.data() + 4, static_cast<std::uint16_t>(key.size));
+    std::copy(
+        key.data, key.data + key.size, cell.begin() + INTERIOR_CELL_HEADER);
+    return cell;
+  }
+  int compare(KeyView a, KeyView b) const noexcept override
+  {
+    const std::size_t common = std::min(a.size, b.size);
+    const int order = common == 0 ? 0 : std::memcmp(a.data, b.data, common);
+    if (order != 0) {
+      return order;
+    }
+    return a.size < b.size ? -1 : (a.size > b.size ? 1 : 0);
+  }
+};
+
+const NodeFormat& index_format()
+{
+  static const IndexFormat format;
+  return format;
+}
+}  // namespace
+
+/**
+ * @brief Allocate the root of an empty tree
+ *
+ * @param pager Pager of a file with a header, see Pager::allocate_page()
+ * @return PageId Root page to open the tree with
+ */
+PageId IndexTree::create(Pager& pager)
+{
+  return create_root(pager, index_format());
+}
+
+IndexTree::IndexTree(Pager& pager, PageId root)
+    : BPlusTree(pager, root, index_format())
+{
+}
+
+std::size_t IndexTree::max_entry() const noexcept
+{
+  return max_entry_of(m_capacity);
+}
+
+/**
+ * @brief Insert an entry
+ *
+ * @param key Key of the entry; must not be in the tree yet
+ * @param payload Covered columns; with the key at most max_entry() bytes
+ */
+void IndexTree::insert(const std::vector<std::byte>& key,
+                       const std::vector<std::byte>& payload)
+{
+  if (key.size() + payload.size() > max_entry()) {
+    throw std::length_error("Index entry too large");
+  }
+  const WriteScope scope(*this);
+  std::vector<Level> path;
+  TreeNode leaf = descend(view_of(key), path);
+  const std::size_t index = leaf.lower_bound(view_of(key));
+  if (index < leaf.count()
+      && m_format.compare(leaf.key(index), view_of(key)) == 0)
+  {
+    throw std::invalid_argument("Duplicate index key");
+  }
+  insert_cell(path, std::move(leaf), index, leaf_cell(key, payload));
+}
+
+/**
+ * @brief Remove an entry
+ *
+ * @return bool False if no entry has the key
+ */
+bool IndexTree::erase(const std::vector<std::byte>& key)
+{
+  const WriteScope scope(*this);
+  std::vector<Level> path;
+  TreeNode leaf = descend(view_of(key), path);
+  const std::size_t index = leaf.lower_bound(view_of(key));
+  if (index == leaf.count()
+      || m_format.compare(leaf.key(index), view_of(key)) != 0)
+  {
+    return false;
+  }
+  lock(leaf);
+  leaf.remove_cell(index);
+  rebalance(path, std::move(leaf));
+  return true;
+}
+
+/**
+ * @param pager Pager of a file with a header; the tree goes to new pages
+ * @param options Fill factor; throws invalid_argument outside 50-100
+ */
+IndexLoader::IndexLoader(Pager& pager, BulkLoadOptions options)
+    : TreeLoader(pager, index_format(), options)
+{
+}
+
+void IndexLoader::add(const std::vector<std::byte>& key,
+                      const std::vector<std::byte>& payload)
+{
+  if (key.size() + payload.size() > max_entry_of(m_capacity)) {
+    throw std::length_error("Index entry too large");
+  }
+  check_order(view_of(key));
+  add_cell(leaf_cell(key, payload));
+}
+
+IndexCursor::IndexCursor(const IndexTree& tree) noexcept
+    : TreeCursor(tree)
+{
+}
+
+bool IndexCursor::seek(const std::vector<std::byte>& key)
+{
+  return seek_key(view_of(key));
+}
+
+const std::byte* IndexCursor::key() const noexcept
+{
+  return leaf_key(cell());
+}
+
+std::size_t IndexCursor::key_size() const noexcept
+{
+  return leaf_key_size(cell());
+}
+
+const std::byte* IndexCursor::payload() const noexcept
+{
+  return key() + key_size();
+}
+
+std::size_t IndexCursor::payload_size() const noexcept
+{
+  return leaf_payload_size(cell());
+}
@@ -0,0 +1,90 @@
+#ifndef INDEX_TREE_HPP
+#define INDEX_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bplus_tree.hpp"
+#include "pager.hpp"
+
+class IndexTree;
+
+/**
+ * @brief Position on an entry of an IndexTree
+ *
+ * See TreeCursor for how it moves and when it goes stale.
+ */
+class IndexCursor : public TreeCursor
+{
+public:
+  explicit IndexCursor(const IndexTree& tree) noexcept;
+
+  // Stand on the first entry whose key is not below `key`; returns valid()
+  bool seek(const std::vector<std::byte>& key);
+
+  // Key and payload of the current entry; point into the pinned leaf
+  const std::byte* key() const noexcept;
+  std::size_t key_size() const noexcept;
+  const std::byte* payload() const noexcept;
+  std::size_t payload_size() const noexcept;
+};
+
+/**
+ * @brief B+tree of entries keyed by byte strings, stored in Pager pages
+ *
+ * The access method of secondary indexes: a key is the encoded index
+ * columns followed by the rowid of the row (see append_key()), which makes
+ * every key unique, and the payload holds the covered columns, if any.
+ * Keys are compared with memcmp, shorter first on a tie.
+ *
+ * Nodes have the header, layout and split and merge rules of a BPlusTree,
+ * with kinds 0x0A for a leaf and 0x02 for an interior node, and both kinds
+ * are slotted pages. A leaf cell is the key size (2), payload size (2), key
+ * and payload; an interior cell is a child page (4), key size (2) and key.
+ * Separators are whole keys of the leaves.
+ *
+ * The writer latches the nodes it changes like that of a BTree, but there
+ * is no latch-free lookup: one thread at a time may use a tree and its
+ * cursors.
+ */
+class IndexTree : public BPlusTree
+{
+public:
+  // Allocate the root of an empty tree
+  static PageId create(Pager& pager);
+
+  IndexTree(Pager& pager, PageId root);
+
+  // Can throw invalid_argument for a taken key and length_error for a key
+  // and payload over max_entry()
+  void insert(const std::vector<std::byte>& key,
+              const std::vector<std::byte>& payload);
+  // False if no entry has the key
+  bool erase(const std::vector<std::byte>& key);
+
+  // Largest key and payload size together
+  std::size_t max_entry() const noexcept;
+};
+
+/**
+ * @brief Builds a new IndexTree bottom-up from entries in ascending key
+ * order
+ *
+ * See TreeLoader. CREATE INDEX sorts the entries of the table and loads
+ * them into the root the catalog allocated with finish(root).
+ */
+class IndexLoader : public TreeLoader
+{
+public:
+  explicit IndexLoader(Pager& pager, BulkLoadOptions options = {});
+
+  // Can throw invalid_argument for a key not above the last one and
+  // length_error for a key and payload over IndexTree::max_entry()
+  void add(const std::vector<std::byte>& key,
+           const std::vector<std::byte>& payload);
+
+  std::size_t entries() const noexcept { return m_cells; }
+};
+
+#endif  // INDEX_TREE_HPP
@@ -0,0 +1,177 @@
+#include <cstring>
+#include <limits>
+
+#include "key_search.hpp"
+
+#include "byte_order.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#  include <immintrin.h>
+#  define DIY_KEY_SEARCH_X86 1
+#elif defined(__aarch64__) && defined(__GNUC__) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  include <arm_neon.h>
+#  define DIY_KEY_SEARCH_NEON 1
+#endif
+
+namespace
+{
+// Keys left for the vector compares once the binary search stops
+constexpr std::size_t WINDOW = 16;
+constexpr std::size_t KEY_SIZE = 8;
+
+std::int64_t key_at(const std::byte* keys, std::size_t index) noexcept
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // A plain load; compilers do not always fuse load_u64()'s byte loop
+  std::int64_t key = 0;
+  std::memcpy(&key, keys + index * KEY_SIZE, sizeof(key));
+  return key;
+#else
+  return static_cast<std::int64_t>(load_u64(keys + index * KEY_SIZE));
+#endif
+}
+
+// Number of keys below `key` among the first count, count <= WINDOW
+using CountLess = std::size_t (*)(const std::byte*,
+                                  std::size_t,
+                                  std::int64_t) noexcept;
+
+std::size_t count_less_scalar(const std::byte* keys,
+                              std::size_t count,
+                              std::int64_t key) noexcept
+{
+  std::size_t less = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    less += static_cast<std::size_t>(key_at(keys, i) < key);
+  }
+  return less;
+}
+
+std::size_t lower_bound_with(CountLess count_less,
+                             const std::byte* keys,
+                             std::size_t count,
+                             std::int64_t key) noexcept
+{
+  // The answer stays within [base, base + count]
+  std::size_t base = 0;
+  while (count > WINDOW) {
+    const std::size_t half = count / 2;
+    base = key_at(keys, base + half) < key ? base + half : base;
+    count -= half;
+  }
+  return base + count_less(keys + base * KEY_SIZE, count, key);
+}
+
+#ifdef DIY_KEY_SEARCH_X86
+__attribute__((target("avx2"))) std::size_t count_less_avx2(
+    const std::byte* keys, std::size_t count, std::int64_t key) noexcept
+{
+  const __m256i target = _mm256_set1_epi64x(key);
+  std::size_t less = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256i block = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(keys + i * KEY_SIZE));
+    const __m256i greater = _mm256_cmpgt_epi64(target, block);
+    less += static_cast<std::size_t>(
+        __builtin_popcount(static_cast<unsigned>(
+            _mm256_movemask_pd(_mm256_castsi256_pd(greater)))));
+  }
+  return less + count_less_scalar(keys + i * KEY_SIZE, count - i, key);
+}
+
+// SSE2 has no 64-bit compare: compare the high halves signed, and the low
+// halves unsigned (sign bit flipped) where the high halves are equal
+std::size_t count_less_sse2(const std::byte* keys,
+                            std::size_t count,
+                            std::int64_t key) noexcept
+{
+  const int low_sign = std::numeric_limits<int>::min();
+  const __m128i flip = _mm_set_epi32(0, low_sign, 0, low_sign);
+  const __m128i target = _mm_xor_si128(_mm_set1_epi64x(key), flip);
+  std::size_t less = 0;
+  std::size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m128i block = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i * KEY_SIZE)),
+        flip);
+    const __m128i greater = _mm_cmpgt_epi32(target, block);
+    const __m128i equal = _mm_cmpeq_epi32(target, block);
+    const __m128i high_greater =
+        _mm_shuffle_epi32(greater, _MM_SHUFFLE(3, 3, 1, 1));
+    const __m128i low_greater =
+        _mm_shuffle_epi32(greater, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128i high_equal =
+        _mm_shuffle_epi32(equal, _MM_SHUFFLE(3, 3, 1, 1));
+    const __m128i below =
+        _mm_or_si128(high_greater, _mm_and_si128(high_equal, low_greater));
+    less += static_cast<std::size_t>(__builtin_popcount(
+        static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(below)))));
+  }
+  return less + count_less_scalar(keys + i * KEY_SIZE, count - i, key);
+}
+#elif defined(DIY_KEY_SEARCH_NEON)
+std::size_t count_less_neon(const std::byte* keys,
+                            std::size_t count,
+                            std::int64_t key) noexcept
+{
+  const int64x2_t target = vdupq_n_s64(key);
+  // Subtracting a lane of all ones, a key below the target, adds one
+  uint64x2_t below = vdupq_n_u64(0);
+  std::size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const int64x2_t block = vreinterpretq_s64_u8(vld1q_u8(
+        reinterpret_cast<const std::uint8_t*>(keys + i * KEY_SIZE)));
+    below = vsubq_u64(below, vcgtq_s64(target, block));
+  }
+  const std::uint64_t less =
+      vgetq_lane_u64(below, 0) + vgetq_lane_u64(below, 1);
+  return static_cast<std::size_t>(less)
+      + count_less_scalar(keys + i * KEY_SIZE, count - i, key);
+}
+#endif
+
+struct Implementation
+{
+  CountLess count_less;
+  const char* name;
+};
+
+const Implementation& implementation() noexcept
+{
+  static const Implementation chosen = []() noexcept
+  {
+#if defined(DIY_KEY_SEARCH_X86)
+    if (__builtin_cpu_supports("avx2") != 0) {
+      return Implementation {count_less_avx2, "avx2"};
+    }
+    return Implementation {count_less_sse2, "sse2"};
+#elif defined(DIY_KEY_SEARCH_NEON)
+    return Implementation {count_less_neon, "neon"};
+#else
+    return Implementation {count_less_scalar, "scalar"};
+#endif
+  }();
+  return chosen;
+}
+}  // namespace
+
+std::size_t key_lower_bound(const std::byte* keys,
+                            std::size_t count,
+                            std::int64_t key) noexcept
+{
+  return lower_bound_with(implementation().count_less, keys, count, key);
+}
+
+std::size_t key_lower_bound_portable(const std::byte* keys,
+                                     std::size_t count,
+                                     std::int64_t key) noexcept
+{
+  return lower_bound_with(count_less_scalar, keys, count, key);
+}
+
+const char* key_search_implementation() noexcept
+{
+  return implementation().name;
+}
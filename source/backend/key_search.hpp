@@ -0,0 +1,33 @@
+#ifndef KEY_SEARCH_HPP
+#define KEY_SEARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Lower bound in a sorted array of 64-bit keys, the rowids of a
+ * B+tree interior node
+ *
+ * Keys are signed and stored little-endian, 8 bytes each, contiguously.
+ * A branch-free binary search narrows the range to a window of at most
+ * 16 keys, whose keys below the target are then counted with vector
+ * compares (AVX2 or SSE2 on x86-64, NEON on ARMv8) when the running CPU
+ * has them and one at a time otherwise; the choice is made once, on first
+ * use.
+ *
+ * @return Index of the first key not below `key`; count if there is none
+ */
+std::size_t key_lower_bound(const std::byte* keys,
+                            std::size_t count,
+                            std::int64_t key) noexcept;
+
+// The scalar implementation, whatever the CPU supports
+std::size_t key_lower_bound_portable(const std::byte* keys,
+                                     std::size_t count,
+                                     std::int64_t key) noexcept;
+
+// Implementation key_lower_bound() dispatches to: "avx2", "sse2", "neon"
+// or "scalar"
+const char* key_search_implementation() noexcept;
+
+#endif  // KEY_SEARCH_HPP
@@ -0,0 +1,234 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "lz_codec.hpp"
+
+namespace
+{
+constexpr std::size_t MIN_MATCH = 4;
+// The last literals and the last match start keep clear of the end
+constexpr std::size_t LAST_LITERALS = 5;
+constexpr std::size_t MATCH_FIND_LIMIT = 12;
+constexpr std::size_t MAX_OFFSET = 65535;
+constexpr unsigned HASH_BITS = 12;
+constexpr unsigned RUN_MASK = 15;
+
+std::uint32_t read32(const std::byte* src) noexcept
+{
+  std::uint32_t value = 0;
+  std::memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash(std::uint32_t sequence) noexcept
+{
+  return (sequence * 2654435761U) >> (32U - HASH_BITS);
+}
+
+// Appends the compressed stream, failing once capacity would be exceeded
+class Writer
+{
+public:
+  Writer(std::byte* dst, std::size_t capacity) noexcept
+      : m_dst(dst)
+      , m_capacity(capacity)
+  {
+  }
+
+  bool sequence(const std::byte* literals,
+                std::size_t literal_length,
+                std::size_t offset,
+                std::size_t match_length) noexcept
+  {
+    const bool last = match_length == 0;
+    const std::size_t match_code = last ? 0 : match_length - MIN_MATCH;
+    const std::size_t worst = 1 + literal_length / 255 + 1 + literal_length
+        + 2 + match_code / 255 + 1;
+    if (m_size + worst > m_capacity) {
+      return false;
+    }
+
+    auto token = static_cast<unsigned>(
+        (literal_length < RUN_MASK ? literal_length : RUN_MASK) << 4U);
+    token |= static_cast<unsigned>(match_code < RUN_MASK ? match_code
+                                                         : RUN_MASK);
+    put(static_cast<std::byte>(token));
+    if (literal_length >= RUN_MASK) {
+      put_length(literal_length - RUN_MASK);
+    }
+    if (literal_length > 0) {
+      std::memcpy(m_dst + m_size, literals, literal_length);
+      m_size += literal_length;
+    }
+    if (last) {
+      return true;
+    }
+
+    put(static_cast<std::byte>(offset & 0xFFU));
+    put(static_cast<std::byte>(offset >> 8U));
+    if (match_code >= RUN_MASK) {
+      put_length(match_code - RUN_MASK);
+    }
+    return true;
+  }
+
+  std::size_t size() const noexcept { return m_size; }
+
+private:
+  void put(std::byte value) noexcept { m_dst[m_size++] = value; }
+
+  void put_length(std::size_t length) noexcept
+  {
+    for (; length >= 255; length -= 255) {
+      put(std::byte {255});
+    }
+    put(static_cast<std::byte>(length));
+  }
+
+  std::byte* m_dst;
+  std::size_t m_capacity;
+  std::size_t m_size {0};
+};
+
+// Reads a length continued in extra bytes; false past the end of input
+bool read_length(const std::byte* src,
+                 std::size_t length,
+                 std::size_t& pos,
+                 std::size_t& value) noexcept
+{
+  while (true) {
+    if (pos >= length) {
+      return false;
+    }
+    const auto byte = std::to_integer<std::size_t>(src[pos++]);
+    value += byte;
+    if (byte != 255) {
+      return true;
+    }
+  }
+}
+}  // namespace
+
+/**
+ * @brief Compress length bytes of src into dst
+ *
+ * @param capacity Size of dst; lz_max_compressed_size() always suffices
+ * @return std::size_t Compressed size, 0 if it would exceed capacity
+ */
+std::size_t lz_compress(const std::byte* src,
+                        std::size_t length,
+                        std::byte* dst,
+                        std::size_t capacity) noexcept
+{
+  Writer out(dst, capacity);
+  std::size_t anchor = 0;
+
+  if (length > MATCH_FIND_LIMIT) {
+    // Positions plus one, so 0 marks an empty slot
+    std::array<std::uint32_t, std::size_t {1} << HASH_BITS> table {};
+    const std::size_t match_limit = length - LAST_LITERALS;
+    std::size_t pos = 0;
+    std::size_t misses = 0;
+
+    while (pos + MATCH_FIND_LIMIT < length) {
+      const std::uint32_t sequence = read32(src + pos);
+      auto& slot = table[hash(sequence)];
+      const std::size_t candidate = slot;
+      slot = static_cast<std::uint32_t>(pos + 1);
+
+      if (candidate == 0 || pos + 1 - candidate > MAX_OFFSET
+          || read32(src + candidate - 1) != sequence)
+      {
+        // Skip faster through data that does not compress
+        pos += 1 + (misses++ >> 5U);
+        continue;
+      }
+      misses = 0;
+
+      const std::size_t ref = candidate - 1;
+      std::size_t match = MIN_MATCH;
+      while (pos + match < match_limit && src[ref + match] == src[pos + match])
+      {
+        match++;
+      }
+      if (!out.sequence(src + anchor, pos - anchor, pos - ref, match)) {
+        return 0;
+      }
+      pos += match;
+      anchor = pos;
+    }
+  }
+
+  if (!out.sequence(src + anchor, length - anchor, 0, 0)) {
+    return 0;
+  }
+  return out.size();
+}
+
+/**
+ * @brief Decompress a stream produced by lz_compress()
+ *
+ * Every length and offset is checked against both buffers, so corrupt
+ * input is rejected rather than read or written out of bounds.
+ *
+ * @param size Exact decompressed size expected
+ * @return bool False if the stream is malformed or does not decode to
+ * exactly size bytes
+ */
+bool lz_decompress(const std::byte* src,
+                   std::size_t length,
+                   std::byte* dst,
+                   std::size_t size) noexcept
+{
+  if (length == 0) {
+    return false;
+  }
+  std::size_t in = 0;
+  std::size_t out = 0;
+  while (in < length) {
+    const auto token = std::to_integer<unsigned>(src[in++]);
+
+    std::size_t literals = token >> 4U;
+    if (literals == RUN_MASK && !read_length(src, length, in, literals)) {
+      return false;
+    }
+    if (literals > length - in || literals > size - out) {
+      return false;
+    }
+    if (literals > 0) {
+      std::memcpy(dst + out, src + in, literals);
+    }
+    in += literals;
+    out += literals;
+    if (in == length) {
+      return out == size;
+    }
+
+    if (length - in < 2) {
+      return false;
+    }
+    const std::size_t offset = std::to_integer<std::size_t>(src[in])
+        | std::to_integer<std::size_t>(src[in + 1]) << 8U;
+    in += 2;
+    std::size_t match = token & RUN_MASK;
+    if (match == RUN_MASK && !read_length(src, length, in, match)) {
+      return false;
+    }
+    match += MIN_MATCH;
+    if (offset == 0 || offset > out || match > size - out) {
+      return false;
+    }
+
+    if (offset >= match) {
+      std::memcpy(dst + out, dst + out - offset, match);
+    } else {
+      // Overlapping copy repeats the last offset bytes
+      for (std::size_t i = 0; i < match; i++) {
+        dst[out + i] = dst[out + i - offset];
+      }
+    }
+    out += match;
+  }
+  return false;
+}
@@ -0,0 +1,35 @@
+#ifndef LZ_CODEC_HPP
+#define LZ_CODEC_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Byte-oriented LZ77 codec for page images
+ *
+ * The stream follows the LZ4 block format: a sequence is a token (4 bits
+ * of literal length, 4 bits of match length minus 4), the literals, and a
+ * 2-byte little-endian match offset; lengths of 15 or more continue in
+ * extra bytes. The last sequence carries only literals. There is no
+ * entropy stage, so both directions run at memory speed, and matches are
+ * found with a single-probe hash table, trading ratio for speed.
+ */
+
+// Worst-case compressed size of length bytes
+constexpr std::size_t lz_max_compressed_size(std::size_t length) noexcept
+{
+  return length + length / 255 + 16;
+}
+
+// Compress src into dst; 0 if the result does not fit into capacity bytes
+std::size_t lz_compress(const std::byte* src,
+                        std::size_t length,
+                        std::byte* dst,
+                        std::size_t capacity) noexcept;
+
+// Decompress exactly size bytes into dst; false on a malformed stream
+bool lz_decompress(const std::byte* src,
+                   std::size_t length,
+                   std::byte* dst,
+                   std::size_t size) noexcept;
+
+#endif  // LZ_CODEC_HPP
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "overflow.hpp"
+
+#include "byte_order.hpp"
+
+namespace
+{
+constexpr std::uint8_t DATA = 0x0F;
+constexpr std::uint8_t LIST = 0x0E;
+
+constexpr std::size_t KIND_OFFSET = 0;
+constexpr std::size_t DATA_HEADER = 4;
+constexpr std::size_t COUNT_OFFSET = 2;
+constexpr std::size_t NEXT_OFFSET = 4;
+constexpr std::size_t LIST_HEADER = 8;
+
+std::size_t per_data_page(const Pager& pager) noexcept
+{
+  return pager.get_usable_size() - DATA_HEADER;
+}
+
+std::size_t per_list_page(const Pager& pager) noexcept
+{
+  return (pager.get_usable_size() - LIST_HEADER) / 4;
+}
+
+std::uint8_t kind_of(const PageHandle& page) noexcept
+{
+  return std::to_integer<std::uint8_t>(page.bytes()[KIND_OFFSET]);
+}
+
+PageHandle load(Pager& pager, PageId page, std::uint8_t kind)
+{
+  PageHandle handle = pager.pin(page);
+  if (kind_of(handle) != kind) {
+    throw std::runtime_error("Corrupt overflow page");
+  }
+  return handle;
+}
+
+PageId write_data_page(Pager& pager, const std::byte* data, std::size_t size)
+{
+  PageHandle page = pager.allocate_page();
+  page.bytes()[KIND_OFFSET] = static_cast<std::byte>(DATA);
+  std::memcpy(page.bytes() + DATA_HEADER, data, size);
+  return page.id();
+}
+
+[[noreturn]] void broken(PageId page, const std::string& what)
+{
+  throw std::logic_error("Overflow page " + std::to_string(page) + ": "
+                         + what);
+}
+}  // namespace
+
+/**
+ * @brief Write the tail of a payload to new pages
+ *
+ * A list page is allocated ahead of the data pages it lists, so the pages
+ * of a tail are allocated in the order they are read.
+ *
+ * @param tail The bytes past the head kept in the cell; not empty
+ * @return PageId The data page of a short tail, else the first list page
+ */
+PageId write_overflow(Pager& pager, const std::byte* tail, std::size_t size)
+{
+  const std::size_t per_page = per_data_page(pager);
+  if (size <= per_page) {
+    return write_data_page(pager, tail, size);
+  }
+  PageHandle list = pager.allocate_page();
+  list.bytes()[KIND_OFFSET] = static_cast<std::byte>(LIST);
+  const PageId first = list.id();
+  for (std::size_t offset = 0; offset < size; offset += per_page) {
+    std::size_t count = load_u16(list.bytes() + COUNT_OFFSET);
+    if (count == per_list_page(pager)) {
+      PageHandle next = pager.allocate_page();
+      next.bytes()[KIND_OFFSET] = static_cast<std::byte>(LIST);
+      store_u32(list.bytes() + NEXT_OFFSET, next.id());
+      list = std::move(next);
+      count = 0;
+    }
+    const PageId page = write_data_page(
+        pager, tail + offset, std::min(per_page, size - offset));
+    store_u32(list.bytes() + LIST_HEADER + count * 4, page);
+    store_u16(list.bytes() + COUNT_OFFSET,
+              static_cast<std::uint16_t>(count + 1));
+  }
+  return first;
+}
+
+void free_overflow(Pager& pager, PageId first, std::size_t size)
+{
+  if (size <= per_data_page(pager)) {
+    pager.free_page(first);
+    return;
+  }
+  PageId list_id = first;
+  while (list_id != 0) {
+    PageHandle list = load(pager, list_id, LIST);
+    const std::size_t count = load_u16(list.bytes() + COUNT_OFFSET);
+    std::vector<PageId> pages;
+    for (std::size_t i = 0; i < count; i++) {
+      pages.push_back(load_u32(list.bytes() + LIST_HEADER + i * 4));
+    }
+    const PageId next = load_u32(list.bytes() + NEXT_OFFSET);
+    list.release();
+    for (const PageId page : pages) {
+      pager.free_page(page);
+    }
+    pager.free_page(list_id);
+    list_id = next;
+  }
+}
+
+std::size_t verify_overflow(Pager& pager, PageId first, std::size_t size)
+{
+  const std::size_t per_page = per_data_page(pager);
+  const std::size_t expected = (size + per_page - 1) / per_page;
+  const auto check_data = [&](PageId page) {
+    if (page == 0 || page >= pager.get_num_pages()
+        || kind_of(pager.pin(page)) != DATA)
+    {
+      broken(page, "not a data page");
+    }
+  };
+  if (expected == 1) {
+    check_data(first);
+    return 1;
+  }
+
+  std::size_t pages = 0;
+  std::size_t listed = 0;
+  for (PageId list_id = first; list_id != 0;) {
+    if (list_id >= pager.get_num_pages()) {
+      broken(list_id, "past the end of the file");
+    }
+    const PageHandle list = pager.pin(list_id);
+    if (kind_of(list) != LIST) {
+      broken(list_id, "not a list page");
+    }
+    const std::size_t count = load_u16(list.bytes() + COUNT_OFFSET);
+    const PageId next = load_u32(list.bytes() + NEXT_OFFSET);
+    if (count == 0 || count > per_list_page(pager)
+        || (next != 0 && count != per_list_page(pager)))
+    {
+      broken(list_id, "list page not full");
+    }
+    for (std::size_t i = 0; i < count; i++) {
+      check_data(load_u32(list.bytes() + LIST_HEADER + i * 4));
+    }
+    listed += count;
+    pages += count + 1;
+    list_id = next;
+  }
+  if (listed != expected) {
+    broken(first, "data pages do not add up to the size");
+  }
+  return pages;
+}
+
+PayloadReader::PayloadReader(Pager& pager,
+                             const std::byte* local,
+                             std::size_t local_size,
+                             std::size_t size,
+                             PageId first) noexcept
+    : m_pager(&pager)
+    , m_local(local)
+    , m_local_size(local_size)
+    , m_size(size)
+    , m_first(first)
+{
+}
+
+PageId PayloadReader::data_page(std::size_t index)
+{
+  const std::size_t per_page = per_data_page(*m_pager);
+  if (m_size - m_local_size <= per_page) {
+    return m_first;
+  }
+  if (m_pages.empty()) {
+    for (PageId list_id = m_first; list_id != 0;) {
+      const PageHandle list = load(*m_pager, list_id, LIST);
+      const std::size_t count = load_u16(list.bytes() + COUNT_OFFSET);
+      for (std::size_t i = 0; i < count; i++) {
+        m_pages.push_back(load_u32(list.bytes() + LIST_HEADER + i * 4));
+      }
+      list_id = load_u32(list.bytes() + NEXT_OFFSET);
+    }
+    if (m_pages.size() != (m_size - m_local_size + per_page - 1) / per_page) {
+      throw std::runtime_error("Corrupt overflow page");
+    }
+  }
+  return m_pages[index];
+}
+
+std::pair<const std::byte*, std::size_t> PayloadReader::fragment(
+    std::size_t offset)
+{
+  if (offset < m_local_size) {
+    return {m_local + offset, m_local_size - offset};
+  }
+  const std::size_t per_page = per_data_page(*m_pager);
+  const std::size_t index = (offset - m_local_size) / per_page;
+  if (!m_page || m_page_index != index) {
+    m_page.release();
+    m_page = load(*m_pager, data_page(index), DATA);
+    m_page_index = index;
+  }
+  const std::size_t start = (offset - m_local_size) % per_page;
+  return {m_page.bytes() + DATA_HEADER + start,
+          std::min(per_page - start, m_size - offset)};
+}
+
+void PayloadReader::read(std::size_t offset, std::size_t size, std::byte* out)
+{
+  if (offset > m_size || size > m_size - offset) {
+    throw std::out_of_range("Read past the end of a payload");
+  }
+  while (size > 0) {
+    const auto [bytes, available] = fragment(offset);
+    const std::size_t copied = std::min(available, size);
+    std::memcpy(out, bytes, copied);
+    out += copied;
+    offset += copied;
+    size -= copied;
+  }
+}
+
+std::vector<std::byte> PayloadReader::read_all()
+{
+  std::vector<std::byte> payload(m_size);
+  read(0, m_size, payload.data());
+  return payload;
+}
@@ -0,0 +1,80 @@
+#ifndef OVERFLOW_HPP
+#define OVERFLOW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "pager.hpp"
+
+/*
+ * Overflow pages hold the tail of a payload too large for its cell; the
+ * cell keeps the head of the payload and the first overflow page.
+ *
+ * A data page (kind 0x0F) holds the next (usable size - 4) bytes of the
+ * tail from offset 4. A tail that fits one data page is stored in it
+ * alone. A longer one is listed by a chain of list pages (kind 0x0E):
+ * the number of data pages listed at offset 2, the next list page at 4,
+ * then the data page ids in payload order, 4 bytes each from offset 8.
+ * Every list page but the last is full.
+ *
+ * Reading a byte of the tail thus pins the data page holding it and, for a
+ * long tail, the list pages, never the data pages before it: a reader can
+ * skip over a large value without touching its pages.
+ */
+
+// Write a tail to new pages; returns the page for the cell
+PageId write_overflow(Pager& pager, const std::byte* tail, std::size_t size);
+// Free the pages of a tail of `size` bytes
+void free_overflow(Pager& pager, PageId first, std::size_t size);
+// Check the pages of a tail and return their number; throws logic_error
+// naming the first broken invariant
+std::size_t verify_overflow(Pager& pager, PageId first, std::size_t size);
+
+/**
+ * @brief Reads a payload in place, from its cell and its overflow pages
+ *
+ * Bytes come as fragments, each a run of the payload inside one page:
+ * the head in the cell, then one per data page. Only the pages of the
+ * bytes asked for are pinned, one data page at a time, so a payload is
+ * never copied whole unless the caller asks for it with read_all().
+ *
+ * The reader points into the cell, so it lasts only as long as the cursor
+ * it came from stands on the row.
+ */
+class PayloadReader
+{
+public:
+  // `first` is the first overflow page; no tail if size == local_size
+  PayloadReader(Pager& pager,
+                const std::byte* local,
+                std::size_t local_size,
+                std::size_t size,
+                PageId first) noexcept;
+
+  std::size_t size() const noexcept { return m_size; }
+
+  // The payload from `offset`, below size(), to the end of the page
+  // holding it; valid until the next call. Can throw runtime_error for a
+  // corrupt overflow page.
+  std::pair<const std::byte*, std::size_t> fragment(std::size_t offset);
+  // Copy `size` bytes from `offset`; throws out_of_range past the end
+  void read(std::size_t offset, std::size_t size, std::byte* out);
+  std::vector<std::byte> read_all();
+
+private:
+  Pager* m_pager;
+  const std::byte* m_local;
+  std::size_t m_local_size;
+  std::size_t m_size;
+  PageId m_first;
+  // Data pages of a listed tail, read from the list pages when first needed
+  std::vector<PageId> m_pages;
+  PageHandle m_page;
+  std::size_t m_page_index {0};
+
+  PageId data_page(std::size_t index);
+};
+
+#endif  // OVERFLOW_HPP
@@ -0,0 +1,91 @@
+#ifndef PAGE_LATCH_HPP
+#define PAGE_LATCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/**
+ * @brief Version latch: optimistic readers, one exclusive writer
+ *
+ * The version counts the writes to the pages it guards, two steps each: it
+ * is odd while a writer holds the latch. A reader takes no latch. It notes
+ * the version before reading the bytes and checks it unchanged after,
+ * discarding what it read otherwise, so it never writes to the latch and
+ * readers on different cores do not fight over its cache line.
+ *
+ * Bytes read under the latch may be torn and must be bounds-checked before
+ * they are used as offsets.
+ */
+class PageLatch
+{
+public:
+  // Wait out a writer; returns the version to validate against
+  std::uint64_t read_begin() const noexcept
+  {
+    std::uint64_t version = m_version.load(std::memory_order_acquire);
+    while ((version & 1U) != 0) {
+      std::this_thread::yield();
+      version = m_version.load(std::memory_order_acquire);
+    }
+    return version;
+  }
+
+  // Whether no write began since read_begin() returned `version`
+  bool validate(std::uint64_t version) const noexcept
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_version.load(std::memory_order_relaxed) == version;
+  }
+
+  void lock() noexcept
+  {
+    std::uint64_t version = m_version.load(std::memory_order_relaxed);
+    while ((version & 1U) != 0
+           || !m_version.compare_exchange_weak(
+               version, version + 1, std::memory_order_acquire))
+    {
+      std::this_thread::yield();
+      version = m_version.load(std::memory_order_relaxed);
+    }
+    // Readers must see the odd version before any of the writes
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void unlock() noexcept
+  {
+    m_version.fetch_add(1, std::memory_order_release);
+  }
+
+private:
+  std::atomic<std::uint64_t> m_version {0};
+};
+
+/**
+ * @brief Latches of the pages of a file, shared by all who modify them
+ *
+ * Pages map onto a fixed number of latches, each on a cache line of its
+ * own. Pages sharing a latch only cost readers a spurious restart; a
+ * writer must take each latch once however many of its pages it locks.
+ */
+class PageLatches
+{
+public:
+  PageLatch& of(std::uint32_t page) const noexcept
+  {
+    return m_slots[page % SLOTS].latch;
+  }
+
+private:
+  static constexpr std::size_t SLOTS = 1024;
+
+  struct alignas(64) Slot
+  {
+    PageLatch latch;
+  };
+  std::unique_ptr<Slot[]> m_slots {new Slot[SLOTS]};
+};
+
+#endif  // PAGE_LATCH_HPP
@@ -1,86 +1,1286 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <system_error>
 
 #include "pager.hpp"
 
-// Constants
-constexpr std::size_t CACHE_SIZE = PAGE_SIZE * CACHE_PAGES;
+#include "byte_order.hpp"
+#include "crc32c.hpp"
+#include "file_header.hpp"
+
+namespace
+{
+// Records the lifetime of the timer in a latency histogram
+class LatencyTimer
+{
+public:
+  explicit LatencyTimer(LatencyHistogram& histogram) noexcept
+      : m_histogram(histogram)
+      , m_start(std::chrono::steady_clock::now())
+  {
+  }
+  ~LatencyTimer()
+  {
+    m_histogram.record(nanoseconds_since(m_start));
+  }
+
+  LatencyTimer(const LatencyTimer&) = delete;
+  LatencyTimer& operator=(const LatencyTimer&) = delete;
+  LatencyTimer(LatencyTimer&&) = delete;
+  LatencyTimer& operator=(LatencyTimer&&) = delete;
+
+private:
+  LatencyHistogram& m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by = 1) noexcept
+{
+  counter.fetch_add(by, std::memory_order_relaxed);
+}
+
+std::atomic<std::uint64_t> next_pager_id {1};
+
+// Freelist trunk page: next trunk page, number of leaves, leaf page numbers
+constexpr std::size_t TRUNK_NEXT_OFFSET = 0;
+constexpr std::size_t TRUNK_COUNT_OFFSET = 4;
+constexpr std::size_t TRUNK_LEAVES_OFFSET = 8;
+
+// Size of the page trailer holding the checksum, see Pager::seal_page()
+constexpr std::uint32_t CHECKSUM_SIZE = 4;
+
+// Bounds of one extension of the file, see Pager::grow_file()
+constexpr std::uint64_t MIN_EXTENT = std::uint64_t {1} << 20U;
+constexpr std::uint64_t MAX_EXTENT = std::uint64_t {64} << 20U;
+
+std::size_t leaf_offset(std::uint32_t leaf) noexcept
+{
+  return TRUNK_LEAVES_OFFSET + std::size_t {leaf} * sizeof(std::uint32_t);
+}
+
+std::runtime_error corrupt_page(PageId page_number)
+{
+  return std::runtime_error("Checksum mismatch on page "
+                            + std::to_string(page_number));
+}
+
+FileHeader decode_header(const std::byte* page)
+{
+  auto header = FileHeader::decode(page);
+  if (!header) {
+    throw std::runtime_error("Corrupt database header");
+  }
+  return *header;
+}
+}  // namespace
+
+/**
+ * @brief Construct a new Pager::Pager object
+ *
+ * An empty file is initialised with a header page recording the page size;
+ * files that carry a header are opened with the page size stored there, and
+ * headerless files use options.page_size.
+ *
+ * Direct I/O needs every transfer to be an aligned, whole number of
+ * logical blocks. Frames are aligned to the page size by the arena, so it
+ * is only enabled in ReadMode::buffer_pool, when pages are a multiple of
+ * the block size and the file holds whole pages; otherwise, or where the
+ * filesystem refuses it, the file is read and written buffered.
+ *
+ * A file with compressed pages is always read into the buffer pool and
+ * buffered: its slots are neither page aligned nor mappable as pages. A
+ * file in WAL mode, whose newest pages are in the log, is always read into
+ * the buffer pool too; checkpoints and snapshot reads, which bypass the
+ * frames, use aligned buffers of their own.
+ *
+ * @param filename Path to the file
+ * @param options Buffer pool configuration
+ * @throws std::runtime_error if file cannot be opened
+ * @throws std::invalid_argument if the page size or cache budget is invalid
+ */
+Pager::Pager(const std::filesystem::path& filename, PagerOptions options)
+    : read_mode(options.read_mode)
+    , page_size(options.page_size)
+    , cache_budget(0)
+    , num_pages(0)
+    , m_id(next_pager_id.fetch_add(1, std::memory_order_relaxed))
+    , m_max_read_ahead(options.max_read_ahead)
+    , m_replacer(make_replacer(options.replacement_policy, 0))
+{
+  if (!is_valid_page_size(options.page_size)) {
+    throw std::invalid_argument("Invalid page size");
+  }
+
+  m_io = open_file_io(filename, options.io_backend);
+  file_size = m_io->size();
+  const std::uint32_t header_pages = read_header(filename, options);
+  if (m_compressed || m_wal) {
+    read_mode = ReadMode::buffer_pool;
+    file_size = std::uint64_t {header_pages} * page_size;
+  }
+  // The file may run past the pages in use, into its preallocated extent
+  num_pages = header_pages != 0
+      ? header_pages
+      : static_cast<std::uint32_t>((file_size + page_size - 1) / page_size);
+  // The header was read buffered; every later transfer is a whole frame
+  if (options.direct_io && read_mode == ReadMode::buffer_pool && !m_compressed
+      && page_size % m_io->direct_alignment() == 0
+      && file_size % page_size == 0)
+  {
+    m_io->enable_direct_io();
+  }
+
+  std::size_t max_budget = options.max_cache_budget == 0
+      ? physical_memory_bytes()
+      : options.max_cache_budget;
+  max_budget = std::max(max_budget, options.cache_budget);
+  m_arena = FrameArena(page_size, max_budget / page_size, options.huge_pages);
+  m_frame_chunks.resize((m_arena.max_frames() + FRAME_CHUNK - 1)
+                        / FRAME_CHUNK);
+  set_cache_budget(options.cache_budget);
+
+  if (read_mode == ReadMode::mmap) {
+    m_mapping = FileMapping(filename);
+    m_mapping.ensure_mapped(static_cast<std::size_t>(num_pages) * page_size);
+  }
+
+  m_checkpoint_options = options.checkpoint_options;
+  if (m_wal && m_checkpoint_options.background) {
+    m_checkpointer = std::make_unique<Checkpointer>(
+        *m_wal, m_checkpoint_options, [this] { run_checkpoint(true); });
+  }
+}
+
+/**
+ * @brief Adopt the page size and features stored in the file header,
+ * writing a header to an empty file
+ *
+ * @param filename Path to the file, naming the page map and the log
+ * @param options Page size and features for new or headerless files
+ * @return std::uint32_t Pages in use according to the header, 0 if the
+ * file has no header or predates the page count
+ * @throws std::runtime_error if the header or the page map is corrupt
+ */
+std::uint32_t Pager::read_header(const std::filesystem::path& filename,
+                                 const PagerOptions& options)
+{
+  page_size = options.page_size;
+
+  if (file_size == 0) {
+    FileHeader header;
+    header.page_size = page_size;
+    header.page_count = 1;
+    if (options.page_checksums) {
+      header.flags |= FileHeader::PAGE_CHECKSUMS;
+      m_checksums = true;
+    }
+    if (options.compression) {
+      header.flags |= FileHeader::PAGE_COMPRESSION;
+      m_compressed = std::make_unique<CompressedFile>(
+          *m_io, CompressedFile::map_path(filename), page_size, true);
+    }
+    if (options.wal) {
+      header.flags |= FileHeader::WAL;
+      m_wal = std::make_unique<Wal>(
+          Wal::wal_path(filename), page_size, options.wal_options, true);
+    }
+    std::vector<std::byte> header_page(page_size);
+    header.encode(header_page.data());
+    seal_page(0, header_page.data());
+    m_io->write(header_page.data(), header_page.size(), 0);
+    file_size = page_size;
+    m_has_header = true;
+    return header.page_count;
+  }
+
+  if (file_size < FileHeader::SIZE) {
+    return 0;
+  }
+
+  std::array<std::byte, FileHeader::SIZE> raw {};
+  m_io->read(raw.data(), raw.size(), 0);
+  auto header = FileHeader::decode(raw.data());
+  if (!header) {
+    return 0;
+  }
+  if (!is_valid_page_size(header->page_size)) {
+    throw std::runtime_error("Corrupt database header");
+  }
+  page_size = header->page_size;
+  m_has_header = true;
+  m_free_pages = header->freelist_count;
+  m_checksums = (header->flags & FileHeader::PAGE_CHECKSUMS) != 0;
+  if ((header->flags & FileHeader::PAGE_COMPRESSION) != 0) {
+    m_compressed = std::make_unique<CompressedFile>(
+        *m_io, CompressedFile::map_path(filename), page_size, false);
+  }
+  if ((header->flags & FileHeader::WAL) == 0) {
+    return header->page_count;
+  }
+
+  // The newest header and page count are in the log, if it has commits
+  m_wal = std::make_unique<Wal>(
+      Wal::wal_path(filename), page_size, options.wal_options, false);
+  std::vector<std::byte> header_page(page_size);
+  if (m_wal->read_page(0, header_page.data())) {
+    m_free_pages = decode_header(header_page.data()).freelist_count;
+  }
+  return m_wal->db_pages() != 0 ? m_wal->db_pages() : header->page_count;
+}
+
+/**
+ * @brief Resize the buffer pool to hold as many pages as fit in bytes
+ *
+ * Growing only commits new frames. Shrinking evicts the pages held by the
+ * dropped frames, writing dirty ones back first.
+ *
+ * @param bytes New cache budget
+ * @throws std::invalid_argument if bytes is smaller than one page
+ * @throws std::length_error if bytes exceeds the maximum budget
+ * @throws std::runtime_error if a frame that would be dropped is pinned
+ */
+void Pager::set_cache_budget(std::size_t bytes)
+{
+  const std::size_t frames = bytes / page_size;
+  if (frames == 0) {
+    throw std::invalid_argument("Cache budget is smaller than one page");
+  }
+  if (frames > m_arena.max_frames()) {
+    throw std::length_error("Cache budget exceeds the maximum budget");
+  }
+
+  std::lock_guard resize(m_resize_latch);
+  // Dirty pages of dropped frames are written while nothing is latched
+  std::vector<PageId> dropped;
+  for (FrameId frame = frames; frame < m_frame_count; frame++) {
+    auto& entry = frame_entry(frame);
+    std::lock_guard lock(entry.latch);
+    if (entry.state == FrameState::ready && entry.is_dirty) {
+      dropped.push_back(entry.page_number);
+    }
+  }
+  for (PageId page : dropped) {
+    flush(static_cast<int>(page));
+  }
+
+  resize_pool(frames);
+  cache_budget = bytes;
+}
+
+/**
+ * @brief Commit or drop frames so that exactly frames frames are in use
+ *
+ * @param frames New number of frames
+ * @throws std::runtime_error if a dropped frame is pinned, loading or dirty
+ */
+void Pager::resize_pool(std::size_t frames)
+{
+  std::lock_guard pool(m_pool_latch);
+  const std::size_t old_frames = m_frame_count;
+
+  if (frames < old_frames) {
+    std::array<std::unique_lock<std::mutex>, PAGE_TABLE_SHARDS> shards;
+    for (std::size_t i = 0; i < PAGE_TABLE_SHARDS; i++) {
+      shards[i] = std::unique_lock(m_page_table[i].latch);
+    }
+    for (FrameId frame = frames; frame < old_frames; frame++) {
+      auto& entry = frame_entry(frame);
+      std::lock_guard lock(entry.latch);
+      if (entry.pin_count > 0 || entry.state == FrameState::loading
+          || entry.state == FrameState::failed)
+      {
+        throw std::runtime_error("Cannot shrink buffer pool: frame is pinned");
+      }
+      if (entry.state == FrameState::ready && entry.is_dirty) {
+        throw std::runtime_error("Cannot shrink buffer pool: frame is dirty");
+      }
+    }
+    for (FrameId frame = frames; frame < old_frames; frame++) {
+      auto& entry = frame_entry(frame);
+      m_replacer->remove(frame);
+      if (entry.state == FrameState::ready) {
+        shard_of(entry.page_number).pages.erase(entry.page_number);
+        bump(m_counters.evictions);
+        if (entry.is_prefetched.exchange(false)) {
+          bump(m_counters.prefetch_wasted);
+        }
+      }
+      entry.state = FrameState::free;
+    }
+    m_free_frames.erase(std::remove_if(m_free_frames.begin(),
+                                       m_free_frames.end(),
+                                       [frames](FrameId frame)
+                                       { return frame >= frames; }),
+                        m_free_frames.end());
+  }
+
+  m_arena.resize(frames);
+  for (std::size_t chunk = old_frames / FRAME_CHUNK;
+       chunk * FRAME_CHUNK < frames;
+       chunk++)
+  {
+    if (!m_frame_chunks[chunk]) {
+      m_frame_chunks[chunk] = std::make_unique<Frame[]>(FRAME_CHUNK);
+    }
+  }
+  m_replacer->resize(frames);
+  // Unpinning a failed frame frees it and must not allocate
+  m_free_frames.reserve(frames);
+  for (FrameId frame = frames; frame > old_frames; frame--) {
+    m_free_frames.push_back(frame - 1);
+  }
+  m_frame_count = frames;
+}
+
+/**
+ * @brief Get the number of pages in the file
+ *
+ * @return Number of pages in the database file
+ */
+std::uint32_t Pager::get_num_pages() noexcept
+{
+  return num_pages;
+}
+
+std::uint32_t Pager::get_usable_size() const noexcept
+{
+  return m_checksums ? page_size - CHECKSUM_SIZE : page_size;
+}
+
+std::size_t Pager::get_cache_hits() const noexcept
+{
+  return m_counters.hits.load(std::memory_order_relaxed);
+}
+
+ReadAheadStats Pager::get_read_ahead_stats() const noexcept
+{
+  ReadAheadStats read_ahead;
+  read_ahead.prefetched =
+      m_counters.prefetched.load(std::memory_order_relaxed);
+  read_ahead.used = m_counters.prefetch_used.load(std::memory_order_relaxed);
+  read_ahead.wasted =
+      m_counters.prefetch_wasted.load(std::memory_order_relaxed);
+  return read_ahead;
+}
+
+/**
+ * @brief Take a snapshot of the buffer pool counters
+ *
+ * Counting costs the hot path a few relaxed increments; the dirty, pinned
+ * and cached page counts are only derived here by walking the frames, so
+ * handles into the mmap file mapping are not counted as pinned. Misses
+ * served by the mapping add no bytes_read: the kernel faults pages in.
+ *
+ * @return PagerStats Counters at the time of the call
+ */
+PagerStats Pager::stats() const
+{
+  PagerStats stats;
+  stats.hits = m_counters.hits.load(std::memory_order_relaxed);
+  stats.misses = m_counters.misses.load(std::memory_order_relaxed);
+  stats.evictions = m_counters.evictions.load(std::memory_order_relaxed);
+  stats.dirty_evictions =
+      m_counters.dirty_evictions.load(std::memory_order_relaxed);
+  stats.bytes_read = m_counters.bytes_read.load(std::memory_order_relaxed);
+  stats.bytes_written =
+      m_counters.bytes_written.load(std::memory_order_relaxed);
+  stats.syncs = m_counters.syncs.load(std::memory_order_relaxed);
+  stats.checksum_failures =
+      m_counters.checksum_failures.load(std::memory_order_relaxed);
+
+  const std::size_t frames = m_frame_count;
+  for (FrameId frame = 0; frame < frames; frame++) {
+    const auto& entry = frame_entry(frame);
+    if (entry.state != FrameState::ready) {
+      continue;
+    }
+    std::lock_guard lock(entry.latch);
+    stats.cached_pages++;
+    stats.dirty_pages += entry.is_dirty ? 1 : 0;
+    if (entry.pin_count > 0) {
+      stats.pinned_pages++;
+    }
+  }
+
+  stats.read_ahead = get_read_ahead_stats();
+  stats.read_latency = m_counters.read_latency.snapshot();
+  stats.write_latency = m_counters.write_latency.snapshot();
+  if (m_compressed) {
+    stats.compression = m_compressed->stats();
+  }
+  if (m_wal) {
+    stats.wal = m_wal->stats();
+    stats.checkpoint.checkpoints =
+        m_counters.checkpoints.load(std::memory_order_relaxed);
+    stats.checkpoint.pages_copied =
+        m_counters.checkpoint_pages.load(std::memory_order_relaxed);
+    stats.checkpoint.failures =
+        m_counters.checkpoint_failures.load(std::memory_order_relaxed);
+    stats.checkpoint.duration = m_counters.checkpoint_duration.snapshot();
+  }
+  return stats;
+}
+
+/**
+ * @brief Hint the access pattern of upcoming reads
+ *
+ * In ReadMode::mmap this is forwarded to the kernel with madvise().
+ *
+ * @param pattern Expected access pattern
+ */
+void Pager::advise(AccessPattern pattern) noexcept
+{
+  if (read_mode == ReadMode::mmap) {
+    m_mapping.advise(pattern);
+  }
+}
+
+/**
+ * @brief Pin a page in the cache, loading it from disk if not cached
+ *
+ * The returned handle points straight into the cache frame. The frame stays
+ * pinned, and therefore resident, until the handle is destroyed. In
+ * ReadMode::mmap pages that are not in the cache are not loaded: the handle
+ * points into the file mapping instead.
+ *
+ * Pins that walk the file in page order trigger read-ahead, see
+ * plan_read_ahead().
+ *
+ * @param page_number The page number to pin
+ * @return PageHandle Handle to the cached page
+ * @throws std::out_of_range if page_number is out of bounds
+ * @throws std::runtime_error if every frame is pinned
+ */
+PageHandle Pager::pin(PageId page_number)
+{
+  if (page_number >= num_pages) {
+    throw std::out_of_range("Page number out of bounds");
+  }
+
+  if (auto handle = pin_resident(page_number, true)) {
+    auto [ahead, ahead_count] = plan_read_ahead(page_number, true);
+    prefetch(ahead, ahead_count);
+    return std::move(*handle);
+  }
+
+  // The mapping serves every page, so only the look-ahead trigger applies
+  auto [ahead, ahead_count] =
+      plan_read_ahead(page_number, read_mode == ReadMode::mmap);
+
+  if (read_mode == ReadMode::mmap) {
+    bump(m_counters.misses);
+    prefetch(ahead, ahead_count);
+    m_mapped_pins++;
+    std::size_t offset = static_cast<std::size_t>(page_number) * page_size;
+    // The mapping is read-only; mark_dirty() moves writers onto a frame
+    auto* data = const_cast<std::byte*>(m_mapping.data() + offset);
+    PageHandle handle(this, PageHandle::MAPPED, page_number, data);
+    if (!verify_page(page_number, data)) {
+      bump(m_counters.checksum_failures);
+      throw corrupt_page(page_number);
+    }
+    return handle;
+  }
+
+  while (true) {
+    // The missing page and the read-ahead window go out as one batch
+    std::vector<FrameLoad> loads;
+    if (!reserve_frame(page_number, acquire_frame(), false, loads)) {
+      // Another thread loaded the page first
+      if (auto handle = pin_resident(page_number, true)) {
+        return std::move(*handle);
+      }
+      continue;
+    }
+    bump(m_counters.misses);
+
+    try {
+      collect_loads(loads, ahead, ahead_count);
+    } catch (...) {
+      fail_loads(loads);
+      throw;
+    }
+    read_loads(loads, 1);
+    publish_loads(loads, 1);
+    const FrameId frame = loads.front().second;
+    return PageHandle(this, frame, page_number, frame_data(frame));
+  }
+}
+
+/**
+ * @brief Pin a page if it is in the pool, waiting for an in-flight read
+ *
+ * The pin is taken under the shard latch, which is what keeps an evicting
+ * thread from taking the frame away between lookup and pin.
+ *
+ * @param page_number Page to pin
+ * @param access Count the pin as an access: hits, replacer history
+ * @return std::optional<PageHandle> The pinned page, or std::nullopt if it
+ * is not resident or its read failed
+ */
+std::optional<PageHandle> Pager::pin_resident(PageId page_number, bool access)
+{
+  auto& shard = shard_of(page_number);
+  std::vector<Access> full_buffer;
+  FrameId frame = 0;
+  bool prefetched = false;
+  {
+    std::lock_guard lock(shard.latch);
+    auto it = shard.pages.find(page_number);
+    if (it == shard.pages.end()) {
+      return std::nullopt;
+    }
+    frame = it->second;
+    auto& entry = frame_entry(frame);
+    entry.pin_count++;
+    // The first pin of a prefetched page is the access its load recorded
+    if (access && !(prefetched = entry.is_prefetched.exchange(false))) {
+      shard.accesses.push_back(Access {frame, page_number});
+      if (shard.accesses.size() >= ACCESS_BUFFER) {
+        full_buffer.swap(shard.accesses);
+      }
+    }
+  }
+
+  if (!full_buffer.empty()) {
+    std::lock_guard pool(m_pool_latch);
+    record_accesses(full_buffer);
+  }
+  if (!wait_until_loaded(frame_entry(frame))) {
+    unpin_frame(frame);
+    return std::nullopt;
+  }
+  if (access) {
+    bump(m_counters.hits);
+    if (prefetched) {
+      bump(m_counters.prefetch_used);
+    }
+  }
+  return PageHandle(this, frame, page_number, frame_data(frame));
+}
+
+/**
+ * @brief Load the non-resident pages of [first, first + count) in one batch
+ *
+ * Pages are left unpinned. The read is submitted as a single batch, so an
+ * asynchronous I/O backend keeps all of it in flight at once. Stops early
+ * when no unpinned frame is left. In ReadMode::mmap the kernel is asked to
+ * read the range ahead instead.
+ *
+ * @param first First page of the run
+ * @param count Number of pages
+ * @return std::size_t Number of pages loaded
+ */
+std::size_t Pager::prefetch(PageId first, PageId count)
+{
+  if (first >= num_pages || count == 0) {
+    return 0;
+  }
+  count = std::min<PageId>(count, num_pages - first);
+
+  if (read_mode == ReadMode::mmap) {
+    m_mapping.will_need(static_cast<std::size_t>(first) * page_size,
+                        static_cast<std::size_t>(count) * page_size);
+    return 0;
+  }
+
+  std::vector<FrameLoad> loads;
+  try {
+    collect_loads(loads, first, count);
+  } catch (...) {
+    fail_loads(loads);
+    throw;
+  }
+  if (loads.empty()) {
+    return 0;
+  }
+  read_loads(loads, 0);
+  publish_loads(loads, 0);
+  return loads.size();
+}
+
+/**
+ * @brief Detect sequential access and decide what to read ahead of a pin
+ *
+ * Read-ahead starts once SEQUENTIAL_RUN consecutive pages were pinned in
+ * order by the same thread. Every time the reader gets within half a
+ * window of the pages already read ahead, the next window is requested.
+ * The window starts at INITIAL_WINDOW pages and doubles up to the maximum,
+ * which never exceeds a quarter of the pool. Read-ahead pages evicted
+ * unused since the last window, whichever thread evicted them, mean the
+ * pool does not keep up: the window is halved instead, down to
+ * INITIAL_WINDOW.
+ *
+ * @param page_number Page being pinned
+ * @param resident Whether the page is available without a read
+ * @return std::pair<PageId, PageId> First page and count to read ahead
+ */
+std::pair<PageId, PageId> Pager::plan_read_ahead(PageId page_number,
+                                                 bool resident)
+{
+  constexpr std::uint32_t SEQUENTIAL_RUN = 2;
+  constexpr std::uint32_t INITIAL_WINDOW = 4;
+
+  auto& ahead = thread_read_ahead();
+  if (ahead.last_page != ReadAhead::NO_PAGE
+      && page_number == ahead.last_page + 1)
+  {
+    ahead.run++;
+  } else {
+    ahead.run = 0;
+    ahead.window = 0;
+    ahead.next = 0;
+  }
+  ahead.last_page = page_number;
+
+  const auto max_window = static_cast<std::uint32_t>(
+      std::min<std::size_t>(m_max_read_ahead, m_frame_count / 4));
+  if (ahead.run < SEQUENTIAL_RUN || max_window == 0) {
+    return {0, 0};
+  }
+  if (!resident) {
+    // Either nothing was read ahead yet or it was evicted before use
+    ahead.next = page_number + 1;
+  } else if (ahead.next > page_number + ahead.window / 2) {
+    return {0, 0};
+  }
+
+  const std::uint64_t wasted =
+      m_counters.prefetch_wasted.load(std::memory_order_relaxed);
+  if (ahead.window == 0) {
+    ahead.window = INITIAL_WINDOW;
+  } else if (wasted != ahead.wasted) {
+    ahead.window = std::max(ahead.window / 2, INITIAL_WINDOW);
+  } else {
+    ahead.window *= 2;
+  }
+  ahead.window = std::min(ahead.window, max_window);
+  ahead.wasted = wasted;
+  const PageId first = std::max(ahead.next, page_number + 1);
+  if (first >= num_pages) {
+    return {0, 0};
+  }
+  const PageId count = std::min<PageId>(ahead.window, num_pages - first);
+  ahead.next = first + count;
+  return {first, count};
+}
+
+/**
+ * @brief Read-ahead state of the calling thread for this Pager
+ *
+ * Each thread keeps one detector and resets it whenever it turns to a
+ * different Pager, so concurrent scans do not break each other's runs.
+ */
+Pager::ReadAhead& Pager::thread_read_ahead() const
+{
+  struct Slot
+  {
+    std::uint64_t pager_id {0};
+    ReadAhead state;
+  };
+  thread_local Slot slot;
+  if (slot.pager_id != m_id) {
+    slot.pager_id = m_id;
+    slot.state = ReadAhead {};
+  }
+  return slot.state;
+}
+
+/**
+ * @brief Claim frames for the non-resident pages of [first, first + count)
+ *
+ * Stops early when no unpinned frame is left.
+ *
+ * @param loads Pages and the frames they will be read into; appended to
+ * @param first First page of the run
+ * @param count Number of pages
+ */
+void Pager::collect_loads(std::vector<FrameLoad>& loads,
+                          PageId first,
+                          PageId count)
+{
+  count = first < num_pages ? std::min<PageId>(count, num_pages - first) : 0;
+  for (PageId page = first; page < first + count; page++) {
+    {
+      auto& shard = shard_of(page);
+      std::lock_guard lock(shard.latch);
+      if (shard.pages.count(page) != 0) {
+        continue;
+      }
+    }
+    auto frame = try_acquire_frame();
+    if (!frame) {
+      break;
+    }
+    reserve_frame(page, *frame, true, loads);
+  }
+}
+
+/**
+ * @brief Publish a claimed frame as the loading copy of a page
+ *
+ * The frame is mapped in the page table in FrameState::loading and pinned
+ * on behalf of the loading thread, so other threads wanting the page wait
+ * for the read instead of issuing their own.
+ *
+ * @param page_number Page about to be read
+ * @param frame Frame obtained from acquire_frame()
+ * @param prefetched Whether the page is loaded ahead of demand
+ * @param loads Appended to if the frame was published
+ * @return bool False if the page is already resident; the frame is freed
+ */
+bool Pager::reserve_frame(PageId page_number,
+                          FrameId frame,
+                          bool prefetched,
+                          std::vector<FrameLoad>& loads)
+{
+  {
+    auto& shard = shard_of(page_number);
+    std::lock_guard lock(shard.latch);
+    if (shard.pages.count(page_number) == 0) {
+      auto& entry = frame_entry(frame);
+      {
+        std::lock_guard frame_lock(entry.latch);
+        entry.page_number = page_number;
+        entry.is_dirty = false;
+      }
+      entry.is_prefetched = prefetched;
+      entry.pin_count = 1;
+      entry.state = FrameState::loading;
+      shard.pages.emplace(page_number, frame);
+      loads.emplace_back(page_number, frame);
+      return true;
+    }
+  }
+  release_frame(frame);
+  io_finished(1);
+  return false;
+}
+
+/**
+ * @brief Read claimed frames with one batch, with no latch held
+ *
+ * With page checksums every page is verified. A read-ahead page that fails
+ * is abandoned and dropped from loads, so only a caller that asked for it
+ * sees the error.
+ *
+ * @param loads Pages and the frames claimed for them
+ * @param pinned Number of leading loads the caller asked for
+ * @throws std::system_error if the read fails; the loads are abandoned
+ * @throws std::runtime_error if one of the first pinned pages fails its
+ * checksum; the loads are abandoned
+ */
+void Pager::read_loads(std::vector<FrameLoad>& loads, std::size_t pinned)
+{
+  std::vector<IoRequest> requests;
+  requests.reserve(loads.size());
+  for (const auto& [page, frame] : loads) {
+    const std::uint64_t offset = static_cast<std::uint64_t>(page) * page_size;
+    requests.push_back(IoRequest {frame_data(frame), page_size, offset});
+  }
+
+  try {
+    LatencyTimer timer(m_counters.read_latency);
+    read_pages(requests);
+  } catch (...) {
+    fail_loads(loads);
+    throw;
+  }
+  bump(m_counters.bytes_read,
+       static_cast<std::uint64_t>(loads.size()) * page_size);
+  if (!m_checksums) {
+    return;
+  }
+
+  std::vector<FrameLoad> good;
+  std::vector<FrameLoad> corrupt;
+  good.reserve(loads.size());
+  for (std::size_t i = 0; i < loads.size(); i++) {
+    const auto& [page, frame] = loads[i];
+    if (verify_page(page, frame_data(frame))) {
+      good.push_back(loads[i]);
+      continue;
+    }
+    bump(m_counters.checksum_failures);
+    if (i < pinned) {
+      fail_loads(loads);
+      throw corrupt_page(page);
+    }
+    corrupt.push_back(loads[i]);
+  }
+  if (!corrupt.empty()) {
+    fail_loads(corrupt);
+    loads.swap(good);
+  }
+}
+
+/**
+ * @brief CRC-32C of a page without its trailer, seeded with the page number
+ *
+ * The seed makes a page written to the wrong place fail verification too.
+ */
+std::uint32_t Pager::page_checksum(PageId page_number,
+                                   const std::byte* data) const noexcept
+{
+  std::array<std::byte, sizeof(PageId)> seed {};
+  store_u32(seed.data(), page_number);
+  return crc32c(data,
+                page_size - CHECKSUM_SIZE,
+                crc32c(seed.data(), seed.size()));
+}
+
+/**
+ * @brief Store the checksum trailer of a page about to be written
+ *
+ * The trailer is the last CHECKSUM_SIZE bytes of the page, outside the
+ * usable size. Does nothing unless the file has page checksums.
+ */
+void Pager::seal_page(PageId page_number, std::byte* data) const noexcept
+{
+  if (m_checksums) {
+    store_u32(data + page_size - CHECKSUM_SIZE,
+              page_checksum(page_number, data));
+  }
+}
+
+/**
+ * @brief Check the trailer of a page that was just read
+ *
+ * An all-zero page is accepted: it was allocated but never written, like
+ * the tail of a preallocated extent.
+ *
+ * @return bool False if the page is torn or corrupt
+ */
+bool Pager::verify_page(PageId page_number,
+                        const std::byte* data) const noexcept
+{
+  if (!m_checksums
+      || load_u32(data + page_size - CHECKSUM_SIZE)
+          == page_checksum(page_number, data))
+  {
+    return true;
+  }
+  return std::all_of(
+      data, data + page_size, [](std::byte b) { return b == std::byte {0}; });
+}
+
+/**
+ * @brief Make loaded frames ready, evictable, and wake threads waiting
+ *
+ * @param loads Frames whose read completed
+ * @param pinned The first pinned loads stay pinned for the caller; the
+ * loading pin on the rest is dropped
+ */
+void Pager::publish_loads(const std::vector<FrameLoad>& loads,
+                          std::size_t pinned)
+{
+  {
+    std::lock_guard pool(m_pool_latch);
+    for (const auto& load : loads) {
+      // Forget accesses that reached the frame while it held another page
+      m_replacer->remove(load.second);
+      m_replacer->record_access(load.second);
+      m_replacer->set_evictable(load.second, true);
+    }
+  }
+  for (std::size_t i = 0; i < loads.size(); i++) {
+    frame_entry(loads[i].second).state = FrameState::ready;
+    if (i >= pinned) {
+      bump(m_counters.prefetched);
+      unpin_frame(loads[i].second);
+    }
+  }
+  io_finished(loads.size());
+}
+
+/**
+ * @brief Abandon loads whose read failed or never started
+ *
+ * The pages are unmapped and their frames marked failed; whoever drops the
+ * last pin on such a frame returns it to the free list.
+ *
+ * @param loads Frames published by reserve_frame()
+ */
+void Pager::fail_loads(const std::vector<FrameLoad>& loads)
+{
+  for (const auto& [page, frame] : loads) {
+    auto& shard = shard_of(page);
+    std::lock_guard lock(shard.latch);
+    shard.pages.erase(page);
+    frame_entry(frame).state = FrameState::failed;
+  }
+  io_finished(loads.size());
+  for (const auto& load : loads) {
+    unpin_frame(load.second);
+  }
+}
+
+/**
+ * @brief Block until another thread's read of a frame has finished
+ *
+ * @return bool True if the frame now holds its page
+ */
+bool Pager::wait_until_loaded(const Frame& entry)
+{
+  if (entry.state == FrameState::loading) {
+    std::unique_lock lock(m_load_latch);
+    m_load_done.wait(lock,
+                     [&entry] { return entry.state != FrameState::loading; });
+  }
+  return entry.state == FrameState::ready;
+}
+
+/**
+ * @brief Mark the page behind a handle as modified
+ *
+ * A handle pointing into the file mapping is first moved onto a cache
+ * frame holding a private copy of the page.
+ *
+ * @param handle A handle obtained from pin()
+ * @throws std::runtime_error if a mapped page needs a frame and all are pinned
+ */
+void Pager::mark_dirty(PageHandle& handle)
+{
+  if (handle.m_frame == PageHandle::MAPPED) {
+    const PageId page_number = handle.m_page_number;
+    auto copy = pin_resident(page_number, true);
+    while (!copy) {
+      std::vector<FrameLoad> loads;
+      if (reserve_frame(page_number, acquire_frame(), false, loads)) {
+        const FrameId frame = loads.front().second;
+        std::memcpy(frame_data(frame), handle.m_data, page_size);
+        publish_loads(loads, 1);
+        copy = PageHandle(this, frame, page_number, frame_data(frame));
+      } else {
+        copy = pin_resident(page_number, true);
+      }
+    }
+    handle = std::move(*copy);
+  }
+
+  // Wait out a write-back of the frame still reading its bytes
+  auto& entry = frame_entry(handle.m_frame);
+  while (true) {
+    {
+      std::lock_guard lock(entry.latch);
+      if (!entry.is_writing) {
+        entry.is_dirty = true;
+        return;
+      }
+    }
+    std::unique_lock lock(m_load_latch);
+    m_load_done.wait(lock, [&entry] { return !entry.is_writing; });
+  }
+}
+
+/**
+ * @brief Drop the pin held by a handle and empty it
+ *
+ * @param handle A handle obtained from pin()
+ */
+void Pager::unpin(PageHandle& handle) noexcept
+{
+  if (handle.m_pager != this) {
+    return;
+  }
+  if (handle.m_frame == PageHandle::MAPPED) {
+    if (--m_mapped_pins == 0) {
+      std::lock_guard lock(m_mapping_latch);
+      m_mapping.release_retired();
+    }
+  } else {
+    unpin_frame(handle.m_frame);
+  }
+  handle.m_pager = nullptr;
+  handle.m_data = nullptr;
+}
+
+void Pager::unpin_frame(FrameId frame) noexcept
+{
+  auto& entry = frame_entry(frame);
+  if (--entry.pin_count == 0 && entry.state == FrameState::failed) {
+    release_frame(frame);
+  }
+}
 
 /**
- * @brief Construct a new Pager::Pager object
+ * @brief Retrieve a copy of a page, loading it from disk if not cached
  *
- * @param filename Path to the file
- * @throws std::runtime_error if file cannot be opened
+ * Prefer pin() on hot paths: this copies the whole page out of the cache.
+ *
+ * @param page_number The page number to retrieve
+ * @return std::shared_ptr<Page> The requested page
+ * @throws std::out_of_range if page_number is out of bounds
  */
-Pager::Pager(const std::filesystem::path& filename)
-    : page_size(PAGE_SIZE)
-    , cache(std::make_unique<std::byte[]>(CACHE_SIZE))
+std::shared_ptr<Page> Pager::get_page(int page_number)
 {
-  file_stream.open(filename, std::ios::binary | std::ios::in | std::ios::out);
-  if (!file_stream) {
-    throw std::runtime_error("Cannot open file");
+  if (page_number < 0) {
+    throw std::out_of_range("Page number out of bounds");
   }
 
-  // Get file size
-  file_stream.seekg(0, std::ios::end);
-  file_size = file_stream.tellg();
-  num_pages = (file_size + page_size - 1) / page_size;
+  auto handle = pin(static_cast<PageId>(page_number));
+  std::vector<std::byte> page_data(handle.bytes(), handle.bytes() + page_size);
+  return std::make_shared<Page>(
+      Page {page_number, false, std::move(page_data)});
 }
 
 /**
- * @brief Get the number of pages in the file
+ * @brief Start a read transaction
  *
- * @return Number of pages in the database file
+ * @return WalSnapshot Snapshot of the commits so far in WAL mode; an empty
+ * one otherwise, for which get_page() reads through the cache
  */
-std::uint32_t Pager::get_num_pages() noexcept
+WalSnapshot Pager::begin_read() const
 {
-  return num_pages;
+  return m_wal ? m_wal->snapshot() : WalSnapshot {};
 }
 
 /**
- * @brief Retrieve a page from the cache or load it from disk if not cached
+ * @brief Retrieve a copy of a page as committed when a snapshot was taken
+ *
+ * The page comes from the newest frame in the log the snapshot sees, or
+ * else from the file. The buffer pool is bypassed, since it may hold
+ * images committed later or not at all. Looking the frame up takes no
+ * lock, so readers do not wait for commits in progress.
  *
  * @param page_number The page number to retrieve
- * @return std::shared_ptr<Page> The requested page
+ * @param snapshot Snapshot from begin_read()
+ * @return std::shared_ptr<Page> The page; zero-filled if it did not exist
+ * yet
  * @throws std::out_of_range if page_number is out of bounds
+ * @throws std::runtime_error if the page fails its checksum
  */
-std::shared_ptr<Page> Pager::get_page(int page_number)
+std::shared_ptr<Page> Pager::get_page(int page_number,
+                                      const WalSnapshot& snapshot)
 {
-  if (page_number >= num_pages) {
+  if (!m_wal || !snapshot) {
+    return get_page(page_number);
+  }
+  if (page_number < 0 || static_cast<PageId>(page_number) >= num_pages) {
     throw std::out_of_range("Page number out of bounds");
   }
 
-  size_t cache_index =
-      page_number % CACHE_PAGES;  // FIX: use CACHE_PAGES not CACHE_SIZE
-  auto& entry = m_page_table[cache_index];
+  const auto page = static_cast<PageId>(page_number);
+  std::vector<std::byte> page_data(page_size);
+  {
+    LatencyTimer timer(m_counters.read_latency);
+    if (!m_wal->read_page(page, snapshot, page_data.data())) {
+      const IoRequest request {page_data.data(),
+                               page_size,
+                               static_cast<std::uint64_t>(page) * page_size};
+      if (m_compressed) {
+        m_compressed->read_pages({request});
+      } else if (m_io->is_direct()) {
+        // The copy handed out is not aligned for direct I/O
+        const AlignedBuffer scratch(page_size, m_io->direct_alignment());
+        m_io->read(scratch.data(), page_size, request.offset);
+        std::memcpy(page_data.data(), scratch.data(), page_size);
+      } else {
+        m_io->read(request.buffer, request.length, request.offset);
+      }
+    }
+  }
+  bump(m_counters.bytes_read, page_size);
+  if (!verify_page(page, page_data.data())) {
+    bump(m_counters.checksum_failures);
+    throw corrupt_page(page);
+  }
+  return std::make_shared<Page>(
+      Page {page_number, false, std::move(page_data)});
+}
 
-  /* If page cached in the slot is different, evict*/
-  if (entry.is_valid && entry.stored_page_number != page_number) {
-    evict_page(cache_index);
+/**
+ * @brief Allocate a page, reusing a freed one before growing the file
+ *
+ * Freed pages come off the freelist, the leaves of the first trunk page
+ * before the trunk page itself. Otherwise the page is appended, growing
+ * the file by a whole preallocated extent when it runs out of room (see
+ * grow_file()). Either way nothing is read from disk.
+ *
+ * Files without a header have no freelist and grow a page at a time.
+ *
+ * @return PageHandle The new page, pinned, zero-filled and dirty
+ * @throws std::runtime_error if the file already has 2^32 - 1 pages
+ * @throws std::system_error if the file cannot grow
+ */
+PageHandle Pager::allocate_page()
+{
+  std::lock_guard lock(m_alloc_latch);
+  if (!m_has_header) {
+    return append_page();
   }
 
-  if (!entry.is_valid) {
-    std::size_t offset = page_number * PAGE_SIZE;
-    file_stream.seekg(offset);
-    file_stream.read(
-        reinterpret_cast<char*>(cache.get() + cache_index * PAGE_SIZE),
-        PAGE_SIZE);
-    entry.stored_page_number = page_number;
-    entry.is_valid = true;
-    entry.is_dirty = false;
+  auto header_page = pin(0);
+  auto header = decode_header(header_page.bytes());
+  PageHandle handle;
+  if (header.freelist_trunk == 0) {
+    grow_file(num_pages + 1);
+    handle = append_page();
+    header.page_count = num_pages;
   } else {
-    cache_hits++;
+    auto trunk = pin(header.freelist_trunk);
+    const std::uint32_t leaves = load_u32(trunk.bytes() + TRUNK_COUNT_OFFSET);
+    if (leaves > 0) {
+      handle = pin_zeroed(load_u32(trunk.bytes() + leaf_offset(leaves - 1)));
+      trunk.mark_dirty();
+      store_u32(trunk.bytes() + TRUNK_COUNT_OFFSET, leaves - 1);
+    } else {
+      // An empty trunk page is handed out itself; the next one takes over
+      const PageId page = header.freelist_trunk;
+      header.freelist_trunk = load_u32(trunk.bytes() + TRUNK_NEXT_OFFSET);
+      trunk.release();
+      handle = pin_zeroed(page);
+    }
+    header.freelist_count--;
   }
 
-  std::vector<std::byte> page_data(PAGE_SIZE);
-  std::memcpy(
-      page_data.data(), cache.get() + cache_index * PAGE_SIZE, PAGE_SIZE);
-  return std::make_shared<Page>(
-      Page {page_number, false, std::move(page_data)});
+  header_page.mark_dirty();
+  header.encode(header_page.bytes());
+  m_free_pages = header.freelist_count;
+  return handle;
+}
+
+/**
+ * @brief Return a page to the freelist for allocate_page() to reuse
+ *
+ * The freelist is a chain of trunk pages starting at the file header. A
+ * trunk page holds the number of the next trunk page, its number of leaves
+ * and the leaf page numbers. A freed page becomes a leaf of the first trunk
+ * page, or the new first trunk page once that one is full. The file does
+ * not shrink. Freeing a page twice corrupts the freelist.
+ *
+ * @param page_number Page nothing refers to any more
+ * @throws std::out_of_range for page 0 or pages past the end of the file
+ * @throws std::logic_error if the file has no header to hold the freelist
+ */
+void Pager::free_page(PageId page_number)
+{
+  if (page_number == 0 || page_number >= num_pages) {
+    throw std::out_of_range("Page number out of bounds");
+  }
+  std::lock_guard lock(m_alloc_latch);
+  if (!m_has_header) {
+    throw std::logic_error("Freelist needs a database header");
+  }
+
+  auto header_page = pin(0);
+  auto header = decode_header(header_page.bytes());
+  const auto capacity = static_cast<std::uint32_t>(
+      (get_usable_size() - TRUNK_LEAVES_OFFSET) / sizeof(std::uint32_t));
+
+  bool added = false;
+  if (header.freelist_trunk != 0) {
+    auto trunk = pin(header.freelist_trunk);
+    const std::uint32_t leaves = load_u32(trunk.bytes() + TRUNK_COUNT_OFFSET);
+    if (leaves < capacity) {
+      trunk.mark_dirty();
+      store_u32(trunk.bytes() + leaf_offset(leaves), page_number);
+      store_u32(trunk.bytes() + TRUNK_COUNT_OFFSET, leaves + 1);
+      added = true;
+    }
+  }
+  if (!added) {
+    auto trunk = pin_zeroed(page_number);
+    store_u32(trunk.bytes() + TRUNK_NEXT_OFFSET, header.freelist_trunk);
+    header.freelist_trunk = page_number;
+  }
+  header.freelist_count++;
+
+  header_page.mark_dirty();
+  header.encode(header_page.bytes());
+  m_free_pages = header.freelist_count;
+}
+
+/**
+ * @brief Add a page at the end of the database; caller holds m_alloc_latch
+ *
+ * @return PageHandle The new page, pinned, zero-filled and dirty
+ * @throws std::runtime_error if the file already has 2^32 - 1 pages
+ */
+PageHandle Pager::append_page()
+{
+  const PageId page = num_pages;
+  if (page == std::numeric_limits<PageId>::max()) {
+    throw std::runtime_error("Database is full");
+  }
+  auto handle = pin_zeroed(page);
+  num_pages = page + 1;
+  if (read_mode == ReadMode::mmap) {
+    std::lock_guard lock(m_mapping_latch);
+    m_mapping.ensure_mapped(static_cast<std::size_t>(num_pages) * page_size);
+  }
+  return handle;
+}
+
+/**
+ * @brief Make the file long enough to hold pages pages
+ *
+ * The file grows by an eighth of its size, between MIN_EXTENT and
+ * MAX_EXTENT bytes, with the blocks allocated at once: appending pages
+ * within the extent changes neither the file size nor the block map.
+ * A compressed file grows as slots are written, and in WAL mode the file
+ * is not written at all, so for those only the page count is tracked.
+ * Caller holds m_alloc_latch.
+ *
+ * @param pages Number of pages the file must hold
+ * @throws std::system_error if the file cannot grow
+ */
+void Pager::grow_file(PageId pages)
+{
+  const std::uint64_t needed = std::uint64_t {pages} * page_size;
+  if (needed <= file_size) {
+    return;
+  }
+  if (m_compressed || m_wal) {
+    file_size = needed;
+    return;
+  }
+  const std::uint64_t extent =
+      std::clamp<std::uint64_t>(file_size / 8, MIN_EXTENT, MAX_EXTENT);
+  std::uint64_t size = std::max(needed, file_size + extent);
+  size = (size + page_size - 1) / page_size * page_size;
+  m_io->allocate(size);
+  file_size = size;
+}
+
+/**
+ * @brief Pin a page whose contents do not matter, without reading it
+ *
+ * @param page_number Page to pin
+ * @return PageHandle The page, zero-filled and dirty
+ */
+PageHandle Pager::pin_zeroed(PageId page_number)
+{
+  while (true) {
+    if (auto handle = pin_resident(page_number, true)) {
+      handle->mark_dirty();
+      std::memset(handle->bytes(), 0, page_size);
+      return std::move(*handle);
+    }
+
+    std::vector<FrameLoad> loads;
+    if (!reserve_frame(page_number, acquire_frame(), false, loads)) {
+      continue;
+    }
+    const FrameId frame = loads.front().second;
+    std::memset(frame_data(frame), 0, page_size);
+    publish_loads(loads, 1);
+    PageHandle handle(this, frame, page_number, frame_data(frame));
+    handle.mark_dirty();
+    return handle;
+  }
 }
 
 /**
- * @brief Write a page to the cache and disk if it is marked dirty
+ * @brief Copy a page into the cache if it is marked dirty
+ *
+ * The page is only written to disk on eviction, flush() or flush_all().
  *
  * @param page The page to write
  */
@@ -89,43 +1289,137 @@ void Pager::write_page(const Page& page)
   if (!page.is_dirty)
     return;
 
-  size_t cache_index = page.page_number % CACHE_PAGES;  // FIX: use CACHE_PAGES
-  // Update cache with new data
-  std::memcpy(
-      cache.get() + cache_index * PAGE_SIZE, page.data.data(), PAGE_SIZE);
-  m_page_table[cache_index].is_dirty = false;  // Mark as clean after write
+  if (page.page_number < 0 || page.data.size() != page_size) {
+    throw std::invalid_argument("Page does not match the database page size");
+  }
 
-  std::size_t offset = page.page_number * PAGE_SIZE;
-  file_stream.seekp(offset);
-  file_stream.write(reinterpret_cast<const char*>(page.data.data()), PAGE_SIZE);
+  auto handle = pin(static_cast<PageId>(page.page_number));
+  handle.mark_dirty();
+  std::memcpy(handle.bytes(), page.data.data(), page_size);
 }
 
 /**
- * @brief Flush a page from the cache to disk
+ * @brief Write a cached page to disk if it is dirty
+ *
+ * The write is not synced; flush_all() makes pages durable.
  *
  * @param page_number The page number to flush
  */
 void Pager::flush(int page_number)
 {
-  if (page_number >= num_pages)
+  if (page_number < 0 || static_cast<PageId>(page_number) >= num_pages)
     return;
 
-  size_t cache_index = page_number % CACHE_PAGES;  // FIX: use CACHE_PAGES
-  std::size_t offset = page_number * PAGE_SIZE;
-  file_stream.seekp(offset);
-  file_stream.write(
-      reinterpret_cast<const char*>(cache.get() + cache_index * PAGE_SIZE),
-      PAGE_SIZE);
-  file_stream.flush();
+  auto handle = pin_resident(static_cast<PageId>(page_number), false);
+  if (!handle)
+    return;
+
+  write_frame(handle->m_frame, true);
+}
+
+/**
+ * @brief Write every dirty page to disk and make the file durable
+ *
+ * Dirty pages are written in page order as one batch, so runs of adjacent
+ * pages become single vectored writes, followed by one fdatasync for the
+ * whole batch. This is the commit point of the write-back cache.
+ *
+ * In WAL mode the batch is one commit, taking in the pages spilled to the
+ * log since the last; if nothing else is dirty then, the header page is
+ * written again to carry the commit.
+ *
+ * @throws std::system_error on I/O error; pages that were not confirmed
+ * written stay dirty
+ */
+void Pager::flush_all()
+{
+  if (m_wal && m_wal->has_spilled()) {
+    pin(0).mark_dirty();
+  }
+
+  // Pinning keeps the frames from being evicted while they are written;
+  // the pins count as in flight so acquire_frame() waits them out
+  std::vector<PageHandle> dirty;
+  const std::size_t frames = m_frame_count;
+  dirty.reserve(frames);
+  for (FrameId frame = 0; frame < frames; frame++) {
+    auto& entry = frame_entry(frame);
+    if (entry.state != FrameState::ready) {
+      continue;
+    }
+    PageId page = 0;
+    {
+      std::lock_guard lock(entry.latch);
+      if (!entry.is_dirty) {
+        continue;
+      }
+      page = entry.page_number;
+    }
+    m_frames_in_flight++;
+    if (auto handle = pin_resident(page, false)) {
+      dirty.push_back(std::move(*handle));
+    } else {
+      io_finished(1);
+    }
+  }
+  std::sort(dirty.begin(),
+            dirty.end(),
+            [](const PageHandle& lhs, const PageHandle& rhs)
+            { return lhs.id() < rhs.id(); });
+
+  std::vector<IoRequest> requests;
+  std::vector<FrameId> written;
+  requests.reserve(dirty.size());
+  for (const auto& handle : dirty) {
+    auto& entry = frame_entry(handle.m_frame);
+    std::lock_guard lock(entry.latch);
+    if (entry.is_dirty) {
+      entry.is_dirty = false;
+      entry.is_writing = true;
+      written.push_back(handle.m_frame);
+      seal_page(handle.id(), frame_data(handle.m_frame));
+      const std::uint64_t offset =
+          static_cast<std::uint64_t>(handle.id()) * page_size;
+      requests.push_back(IoRequest {frame_data(handle.m_frame),
+                                    page_size,
+                                    offset});
+    }
+  }
+
+  std::exception_ptr error;
+  try {
+    if (!requests.empty()) {
+      LatencyTimer timer(m_counters.write_latency);
+      write_pages(requests, true);
+    }
+    sync_pages();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  end_writes(written, error != nullptr);
+  const std::size_t pinned = dirty.size();
+  dirty.clear();
+  io_finished(pinned);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  bump(m_counters.bytes_written,
+       static_cast<std::uint64_t>(requests.size()) * page_size);
+  bump(m_counters.syncs);
 }
 
 /**
- * @brief Destructor for Pager, closes the file stream
+ * @brief Destructor for Pager, flushes dirty pages and closes the file
  */
 Pager::~Pager()
 {
-  if (file_stream.is_open()) {
-    file_stream.close();
+  m_checkpointer.reset();
+  if (m_io) {
+    try {
+      flush_all();
+    } catch (...) {
+      // Destructors must not throw; unwritten pages are lost
+    }
   }
 }
 
@@ -133,29 +1427,549 @@ Pager::~Pager()
  * @brief Factory function to create a Pager instance
  *
  * @param filename Path to the database file
+ * @param options Buffer pool configuration
  * @return std::unique_ptr<Pager> New Pager instance
  */
-auto create_pager(const std::filesystem::path& filename)
+auto create_pager(const std::filesystem::path& filename, PagerOptions options)
     -> std::unique_ptr<Pager>
 {
-  return std::make_unique<Pager>(filename);
+  return std::make_unique<Pager>(filename, options);
+}
+
+/**
+ * @brief Find a frame for a new page: a free one, or the replacer's victim
+ *
+ * Waits while frames are only unavailable because other threads are
+ * reading into them or writing them back.
+ *
+ * @return FrameId An empty frame, no longer mapped in the page table
+ * @throws std::runtime_error if every frame is pinned
+ */
+FrameId Pager::acquire_frame()
+{
+  while (true) {
+    const std::uint64_t generation = m_io_generation;
+    if (auto frame = try_acquire_frame()) {
+      return *frame;
+    }
+    if (m_frames_in_flight == 0 && m_io_generation == generation) {
+      throw std::runtime_error("No unpinned frame available");
+    }
+    // Frames tied up by reads or write-backs in flight come back shortly
+    std::unique_lock lock(m_load_latch);
+    m_load_done.wait(lock,
+                     [this, generation]
+                     { return m_io_generation != generation; });
+  }
+}
+
+/**
+ * @brief Take a free frame or evict the replacer's victim
+ *
+ * The replacer does not track pins, so a victim is checked under its shard
+ * latch and handed back if it turns out to be pinned. A dirty victim is
+ * written back with no latch held while it stays readable; the eviction is
+ * abandoned if it was pinned or dirtied again in the meantime.
+ *
+ * The frame counts as in flight until reserve_frame() has published it.
+ *
+ * @return std::optional<FrameId> An empty frame, or std::nullopt if every
+ * frame is pinned or in flight
+ * @throws std::system_error if writing back a dirty victim fails
+ */
+std::optional<FrameId> Pager::try_acquire_frame()
+{
+  std::unique_lock pool(m_pool_latch);
+  drain_accesses();
+
+  // Victims that cannot go yet return to the replacer only after the
+  // search, or a pinned frame would just come back as the next victim
+  std::vector<FrameId> skipped;
+  auto restore = [this, &skipped]
+  {
+    for (auto frame : skipped) {
+      m_replacer->record_access(frame);
+      m_replacer->set_evictable(frame, true);
+    }
+  };
+  try {
+    auto frame = find_victim(pool, skipped);
+    restore();
+    if (frame) {
+      // Until its load is published or abandoned, see acquire_frame()
+      m_frames_in_flight++;
+    }
+    return frame;
+  } catch (...) {
+    restore();
+    throw;
+  }
+}
+
+/**
+ * @brief Take a free frame or evict the replacer's next victim
+ *
+ * Pinned victims, and dirty ones dirtied again during their write-back,
+ * are appended to skipped.
+ *
+ * @param pool The held pool latch; released while a victim is written back
+ * @param skipped Victims the caller must hand back to the replacer
+ * @return std::optional<FrameId> An empty frame, if any could be freed
+ */
+std::optional<FrameId> Pager::find_victim(std::unique_lock<std::mutex>& pool,
+                                          std::vector<FrameId>& skipped)
+{
+  while (true) {
+    if (!m_free_frames.empty()) {
+      FrameId frame = m_free_frames.back();
+      m_free_frames.pop_back();
+      return frame;
+    }
+
+    auto victim = m_replacer->evict();
+    if (!victim) {
+      return std::nullopt;
+    }
+    auto& entry = frame_entry(*victim);
+    PageId page = 0;
+    {
+      std::lock_guard lock(entry.latch);
+      page = entry.page_number;
+    }
+    auto& shard = shard_of(page);
+
+    bool evicted = false;
+    bool dirty = false;
+    {
+      std::lock_guard shard_lock(shard.latch);
+      std::lock_guard frame_lock(entry.latch);
+      if (entry.pin_count == 0) {
+        dirty = entry.is_dirty;
+        if (!dirty) {
+          shard.pages.erase(page);
+          evicted = true;
+        }
+      }
+    }
+
+    if (dirty) {
+      m_frames_in_flight++;
+      pool.unlock();
+      try {
+        write_frame(*victim, false);
+      } catch (...) {
+        pool.lock();
+        skipped.push_back(*victim);
+        io_finished(1);
+        throw;
+      }
+      pool.lock();
+
+      {
+        std::lock_guard shard_lock(shard.latch);
+        std::lock_guard frame_lock(entry.latch);
+        if (entry.pin_count == 0 && !entry.is_dirty) {
+          shard.pages.erase(page);
+          evicted = true;
+          bump(m_counters.dirty_evictions);
+        }
+      }
+      io_finished(1);
+    }
+    if (!evicted) {
+      skipped.push_back(*victim);
+      continue;
+    }
+
+    entry.state = FrameState::free;
+    bump(m_counters.evictions);
+    if (entry.is_prefetched.exchange(false)) {
+      bump(m_counters.prefetch_wasted);
+    }
+    return *victim;
+  }
+}
+
+/**
+ * @brief Return a frame that holds no page to the free list
+ *
+ * @param frame Frame that is unmapped and unpinned
+ */
+void Pager::release_frame(FrameId frame)
+{
+  std::lock_guard pool(m_pool_latch);
+  frame_entry(frame).state = FrameState::free;
+  m_free_frames.push_back(frame);
+}
+
+/**
+ * @brief Hand buffered accesses to the replacer; the caller holds the pool
+ * latch
+ *
+ * @param accesses Accesses taken out of the shards; cleared
+ */
+void Pager::record_accesses(std::vector<Access>& accesses)
+{
+  for (const auto& access : accesses) {
+    if (access.frame >= m_frame_count) {
+      continue;
+    }
+    auto& entry = frame_entry(access.frame);
+    if (entry.state != FrameState::ready) {
+      continue;
+    }
+    std::lock_guard lock(entry.latch);
+    // The frame may have been given to another page since
+    if (entry.page_number == access.page_number) {
+      m_replacer->record_access(access.frame);
+    }
+  }
+  accesses.clear();
+}
+
+/**
+ * @brief Apply every buffered access so the replacer sees them before
+ * choosing a victim; the caller holds the pool latch
+ */
+void Pager::drain_accesses()
+{
+  std::vector<Access> accesses;
+  for (auto& shard : m_page_table) {
+    std::lock_guard lock(shard.latch);
+    accesses.insert(
+        accesses.end(), shard.accesses.begin(), shard.accesses.end());
+    shard.accesses.clear();
+  }
+  record_accesses(accesses);
+}
+
+/**
+ * @brief Write a dirty frame to its page on disk and mark it clean
+ *
+ * The caller keeps the frame from being reused, by pinning it or by
+ * holding it as an eviction victim. No latch is held during the write;
+ * mark_dirty() on the frame waits for it to finish.
+ *
+ * @param frame Index of the cache frame to write
+ * @param commit In WAL mode, whether the page is committed or only
+ * spilled, see write_pages()
+ */
+void Pager::write_frame(FrameId frame, bool commit)
+{
+  auto& entry = frame_entry(frame);
+  PageId page = 0;
+  {
+    std::lock_guard lock(entry.latch);
+    if (!entry.is_dirty) {
+      return;
+    }
+    entry.is_dirty = false;
+    entry.is_writing = true;
+    page = entry.page_number;
+  }
+  seal_page(page, frame_data(frame));
+  const std::uint64_t offset = static_cast<std::uint64_t>(page) * page_size;
+
+  std::exception_ptr error;
+  try {
+    LatencyTimer timer(m_counters.write_latency);
+    write_pages({IoRequest {frame_data(frame), page_size, offset}}, commit);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  end_writes({frame}, error != nullptr);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  bump(m_counters.bytes_written, page_size);
+}
+
+/**
+ * @brief Read whole pages at page-aligned offsets
+ *
+ * In WAL mode a page in the log is read from there, spilled or committed;
+ * the rest come from the file, through the codec if it is compressed. The
+ * batch is read under one snapshot.
+ */
+void Pager::read_pages(const std::vector<IoRequest>& requests)
+{
+  const std::vector<IoRequest>* file_reads = &requests;
+  std::vector<IoRequest> unlogged;
+  if (m_wal) {
+    const auto snapshot = m_wal->snapshot();
+    for (const auto& request : requests) {
+      const auto page = static_cast<PageId>(request.offset / page_size);
+      if (!m_wal->read_spilled(page, snapshot, request.buffer)) {
+        unlogged.push_back(request);
+      }
+    }
+    file_reads = &unlogged;
+  }
+
+  if (file_reads->empty()) {
+    return;
+  }
+  if (m_compressed) {
+    m_compressed->read_pages(*file_reads);
+  } else {
+    m_io->read_batch(*file_reads);
+  }
+}
+
+/**
+ * @brief Write whole pages at page-aligned offsets
+ *
+ * In WAL mode the file is left untouched and the pages go to the log:
+ * committed as one transaction, durable on return, or spilled there
+ * without a commit, so that an evicted page of a change in progress does
+ * not commit the change half done.
+ *
+ * @param requests Pages to write
+ * @param commit In WAL mode, whether to commit the pages
+ */
+void Pager::write_pages(const std::vector<IoRequest>& requests, bool commit)
+{
+  if (m_wal) {
+    std::vector<WalPage> pages;
+    pages.reserve(requests.size());
+    for (const auto& request : requests) {
+      pages.push_back(WalPage {
+          static_cast<PageId>(request.offset / page_size), request.buffer});
+    }
+    if (!commit) {
+      m_wal->spill(pages);
+      return;
+    }
+    m_wal->commit(pages, num_pages);
+    if (m_checkpointer) {
+      m_checkpointer->notify_commit();
+    }
+  } else {
+    write_file_pages(requests);
+  }
+}
+
+// Write whole pages to the file itself, through the codec if compressed
+void Pager::write_file_pages(const std::vector<IoRequest>& requests)
+{
+  if (m_compressed) {
+    m_compressed->write_pages(requests);
+  } else if (requests.size() == 1) {
+    m_io->write(requests[0].buffer, requests[0].length, requests[0].offset);
+  } else {
+    m_io->write_batch(requests);
+  }
+}
+
+// Make written pages durable; WAL commits already are
+void Pager::sync_pages()
+{
+  if (!m_wal) {
+    sync_file_pages();
+  }
+}
+
+void Pager::sync_file_pages()
+{
+  if (m_compressed) {
+    m_compressed->sync();
+  } else {
+    m_io->sync();
+  }
+}
+
+/**
+ * @brief Copy committed pages from the log into the file
+ *
+ * Copies the newest image of every page committed since the last
+ * checkpoint, up to the oldest commit a reader still sees, so that no
+ * reader finds a newer page in the file than its snapshot allows. Pages go
+ * out in page number order, CheckpointOptions::batch_pages per batched
+ * write, and are synced before the log is told. If no reader is behind
+ * the last commit, the log then restarts.
+ *
+ * Foreground reads and commits go on meanwhile: the copy only reads
+ * frames, and the restart holds commits off for a header write.
+ *
+ * Does nothing unless the file is in WAL mode.
+ *
+ * @throws std::system_error if the copy or the restart fails; what was
+ * copied is copied again by the next checkpoint
+ */
+void Pager::checkpoint()
+{
+  if (m_wal) {
+    run_checkpoint(false);
+  }
+}
+
+/**
+ * @brief Run one checkpoint, see checkpoint()
+ *
+ * @param background Whether the Checkpointer runs it: it is then paced by
+ * the I/O budget and abandoned when the Pager closes
+ */
+void Pager::run_checkpoint(bool background)
+{
+  std::lock_guard lock(m_checkpoint_latch);
+  const auto start = std::chrono::steady_clock::now();
+  try {
+    const auto snapshot = m_wal->snapshot();
+    const std::uint64_t limit = m_wal->oldest_snapshot();
+    const auto frames = m_wal->checkpoint_frames(snapshot, limit);
+
+    const std::size_t batch = std::max<std::size_t>(
+        1, std::min(m_checkpoint_options.batch_pages, frames.size()));
+    // Written straight to the file, so aligned in case of direct I/O
+    const AlignedBuffer buffer(batch * page_size, m_io->direct_alignment());
+    std::vector<std::uint64_t> batch_frames;
+    std::vector<IoRequest> requests;
+    for (std::size_t first = 0; first < frames.size(); first += batch) {
+      const std::size_t count = std::min(batch, frames.size() - first);
+      batch_frames.clear();
+      requests.clear();
+      for (std::size_t i = 0; i < count; i++) {
+        const auto [page, frame] = frames[first + i];
+        batch_frames.push_back(frame);
+        requests.push_back(
+            IoRequest {buffer.data() + i * page_size,
+                       page_size,
+                       static_cast<std::uint64_t>(page) * page_size});
+      }
+      m_wal->read_frames(batch_frames, buffer.data());
+      write_file_pages(requests);
+      bump(m_counters.checkpoint_pages, count);
+      const auto copied = static_cast<std::uint64_t>(count) * page_size;
+      if (background && !m_checkpointer->pace(copied)) {
+        return;
+      }
+    }
+    if (!frames.empty()) {
+      sync_file_pages();
+    }
+    m_wal->finish_checkpoint(limit, m_checkpoint_options.wal_size_limit);
+  } catch (...) {
+    bump(m_counters.checkpoint_failures);
+    throw;
+  }
+  bump(m_counters.checkpoints);
+  m_counters.checkpoint_duration.record(nanoseconds_since(start));
+}
+
+/**
+ * @brief Clear the writing flag of frames and wake writers waiting on it
+ *
+ * @param frames Frames whose write-back finished
+ * @param failed Whether the write failed; the pages become dirty again
+ */
+void Pager::end_writes(const std::vector<FrameId>& frames, bool failed)
+{
+  for (FrameId frame : frames) {
+    auto& entry = frame_entry(frame);
+    std::lock_guard lock(entry.latch);
+    entry.is_writing = false;
+    entry.is_dirty = entry.is_dirty || failed;
+  }
+  io_finished(0);
 }
 
 /**
- * @brief Evict a page from the cache, writing it to disk if dirty
+ * @brief Wake threads waiting for reads, write-backs or frames
  *
- * @param cache_index Index of the cache slot to evict
+ * @param frames Number of in-flight frames the finished I/O held
  */
-void Pager::evict_page(size_t cache_index)
+void Pager::io_finished(std::size_t frames)
+{
+  {
+    std::lock_guard lock(m_load_latch);
+    m_io_generation++;
+  }
+  // Only after the generation moved, see acquire_frame()
+  m_frames_in_flight -= frames;
+  m_load_done.notify_all();
+}
+
+Pager::Frame& Pager::frame_entry(FrameId frame) const noexcept
 {
-  auto& entry = m_page_table[cache_index];
-  if (entry.is_valid && entry.is_dirty) {
-    std::size_t offset = entry.stored_page_number * PAGE_SIZE;
-    file_stream.seekp(offset);
-    file_stream.write(
-        reinterpret_cast<const char*>(cache.get() + cache_index * PAGE_SIZE),
-        PAGE_SIZE);
+  return m_frame_chunks[frame / FRAME_CHUNK][frame % FRAME_CHUNK];
+}
+
+Pager::PageTableShard& Pager::shard_of(PageId page_number) noexcept
+{
+  // Fibonacci hashing spreads runs of adjacent pages over every shard
+  constexpr unsigned SHARD_BITS = 4;
+  static_assert(std::size_t {1} << SHARD_BITS == PAGE_TABLE_SHARDS);
+  constexpr std::uint32_t MULTIPLIER = 2654435769U;
+  return m_page_table[(page_number * MULTIPLIER) >> (32U - SHARD_BITS)];
+}
+
+std::byte* Pager::frame_data(FrameId frame) const noexcept
+{
+  return m_arena.frame(frame);
+}
+
+// --- PageHandle ---
+
+PageHandle::PageHandle(Pager* pager,
+                       FrameId frame,
+                       PageId page_number,
+                       std::byte* data) noexcept
+    : m_pager(pager)
+    , m_frame(frame)
+    , m_page_number(page_number)
+    , m_data(data)
+{
+}
+
+PageHandle::~PageHandle()
+{
+  release();
+}
+
+PageHandle::PageHandle(PageHandle&& other) noexcept
+    : m_pager(other.m_pager)
+    , m_frame(other.m_frame)
+    , m_page_number(other.m_page_number)
+    , m_data(other.m_data)
+{
+  other.m_pager = nullptr;
+  other.m_data = nullptr;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other) noexcept
+{
+  if (this != &other) {
+    release();
+    m_pager = other.m_pager;
+    m_frame = other.m_frame;
+    m_page_number = other.m_page_number;
+    m_data = other.m_data;
+    other.m_pager = nullptr;
+    other.m_data = nullptr;
+  }
+  return *this;
+}
+
+bool PageHandle::dirty() const noexcept
+{
+  if (m_pager == nullptr || m_frame == MAPPED) {
+    return false;
+  }
+  const auto& entry = m_pager->frame_entry(m_frame);
+  std::lock_guard lock(entry.latch);
+  return entry.is_dirty;
+}
+
+void PageHandle::mark_dirty()
+{
+  if (m_pager != nullptr) {
+    m_pager->mark_dirty(*this);
+  }
+}
+
+void PageHandle::release() noexcept
+{
+  if (m_pager != nullptr) {
+    m_pager->unpin(*this);
   }
-  entry.is_valid = false;
-  entry.is_dirty = false;
-}
\ No newline at end of file
+}
@@ -2,16 +2,34 @@
 #define PAGER_HPP
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <filesystem>
-#include <fstream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "checkpointer.hpp"
+#include "compressed_file.hpp"
+#include "file_io.hpp"
+#include "file_mapping.hpp"
+#include "frame_arena.hpp"
+#include "page_latch.hpp"
+#include "pager_stats.hpp"
+#include "replacer.hpp"
+#include "wal.hpp"
+
+// Defaults: page size of new databases and frames in the buffer pool
 constexpr std::size_t PAGE_SIZE = 4096;
 constexpr std::size_t CACHE_PAGES = 100;
 
+using PageId = std::uint32_t;
+
 class Page
 {
 public:
@@ -20,51 +38,378 @@ public:
   std::vector<std::byte> data;
 };
 
+enum class ReadMode
+{
+  buffer_pool,  // every page is read into a cache frame
+  mmap  // clean pages are read in place from a shared file mapping
+};
+
+struct PagerOptions
+{
+  // Eviction policy of the buffer pool; LRU-K is scan resistant
+  ReplacementPolicy replacement_policy {ReplacementPolicy::lru_k};
+  // Memory for cached pages in bytes, see Pager::set_cache_budget()
+  std::size_t cache_budget {PAGE_SIZE * CACHE_PAGES};
+  // Largest budget the pool may later grow to; 0 means physical memory
+  std::size_t max_cache_budget {0};
+  // Page size of a new file; files with a header use the stored size
+  std::uint32_t page_size {static_cast<std::uint32_t>(PAGE_SIZE)};
+  // Back the buffer pool with huge pages (hugetlb needs max_cache_budget)
+  HugePages huge_pages {HugePages::off};
+  // How clean pages are read
+  ReadMode read_mode {ReadMode::buffer_pool};
+  // How page reads and writes reach the file
+  IoBackend io_backend {IoBackend::pread};
+  // Bypass the kernel page cache (O_DIRECT) so cached pages are held once,
+  // in the pool; stays buffered where the filesystem refuses it
+  bool direct_io {false};
+  // Largest read-ahead window in pages; 0 disables sequential read-ahead
+  std::uint32_t max_read_ahead {32};
+  // End every page of a new file in a CRC-32C trailer verified on each
+  // read; files with a header keep the setting they were created with
+  bool page_checksums {false};
+  // Store the pages of a new file LZ-compressed, with a page map in a
+  // sidecar file; implies ReadMode::buffer_pool and buffered I/O
+  bool compression {false};
+  // Commit written-back pages of a new file to a write-ahead log instead
+  // of overwriting the file; implies ReadMode::buffer_pool. flush() and
+  // flush_all() are the commits: pages evicted in between are logged
+  // uncommitted, and lost with a crash before the next commit
+  bool wal {false};
+  WalOptions wal_options;
+  // When committed pages are copied back from the log into the file
+  CheckpointOptions checkpoint_options;
+};
+
+class Pager;
+
+/**
+ * @brief RAII pin on a page frame living in the Pager cache
+ *
+ * A handle gives direct access to the cached bytes of a page; nothing is
+ * copied. While at least one handle to a frame is alive the frame is pinned
+ * and will never be evicted. Destroying (or releasing) the handle unpins it.
+ *
+ * Call mark_dirty() before modifying the bytes. In ReadMode::mmap a clean
+ * handle points into a read-only file mapping and mark_dirty() moves it onto
+ * a private cache frame, so bytes() must be fetched again afterwards.
+ *
+ * Handles must not outlive the Pager that produced them.
+ */
+class PageHandle
+{
+public:
+  PageHandle() noexcept = default;
+  ~PageHandle();
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+  PageHandle(PageHandle&& other) noexcept;
+  PageHandle& operator=(PageHandle&& other) noexcept;
+
+  PageId id() const noexcept { return m_page_number; }
+  std::byte* bytes() noexcept { return m_data; }
+  const std::byte* bytes() const noexcept { return m_data; }
+  bool dirty() const noexcept;
+
+  // Flag the page as modified so it is written back before eviction
+  void mark_dirty();
+
+  // Unpin early; the handle becomes empty
+  void release() noexcept;
+
+  explicit operator bool() const noexcept { return m_pager != nullptr; }
+
+private:
+  friend class Pager;
+  // Frame index of handles that point into the file mapping
+  static constexpr FrameId MAPPED = static_cast<FrameId>(-1);
+
+  PageHandle(Pager* pager,
+             FrameId frame,
+             PageId page_number,
+             std::byte* data) noexcept;
+
+  Pager* m_pager {nullptr};
+  FrameId m_frame {0};
+  PageId m_page_number {0};
+  std::byte* m_data {nullptr};
+};
+
+/**
+ * @brief Buffer pool over a database file
+ *
+ * Safe for concurrent use: any number of threads may pin, read and prefetch
+ * pages while one writer dirties and flushes them. The page table is split
+ * into shards, each behind its own latch; a frame's metadata has a latch of
+ * its own and its pin count is atomic. The pool latch guards the replacer
+ * and the free list. No latch is ever held across disk I/O: a page being
+ * read is published as loading and other threads wanting it wait for the
+ * read to finish, and dirty victims are written back with no latch held.
+ *
+ * Latch order: pool, then shard, then frame.
+ */
 class Pager
 {
 public:
   // Constructor/Destructor
-  explicit Pager(
-      const std::filesystem::path& filename);  // Can throw runtime_error
+  explicit Pager(const std::filesystem::path& filename,
+                 PagerOptions options = {});  // Can throw runtime_error
   ~Pager();
 
   // Delete copy operations
   Pager(const Pager&) = delete;
   Pager& operator=(const Pager&) = delete;
 
-  // Allow move operations
-  Pager(Pager&&) noexcept = default;
-  Pager& operator=(Pager&&) noexcept = default;
+  // Handles, latches and counters refer to the Pager, so it cannot move
+  Pager(Pager&&) = delete;
+  Pager& operator=(Pager&&) = delete;
 
-  // Page operations
+  // Zero-copy page access
+  PageHandle pin(PageId page_number);
+  void mark_dirty(PageHandle& handle);
+  void unpin(PageHandle& handle) noexcept;
+
+  // Write-back: dirty pages reach the file on eviction or flush; in WAL
+  // mode flush() and flush_all() commit, evictions only spill to the log
   void flush(int page_number);
+  void flush_all();
+
+  // Copying page operations
   std::shared_ptr<Page> get_page(int page_number);
   void write_page(const Page& page);
 
+  // Read transactions: in WAL mode a snapshot pins the committed pages
+  WalSnapshot begin_read() const;
+  std::shared_ptr<Page> get_page(int page_number, const WalSnapshot& snapshot);
+
+  // Copy committed pages from the log into the file now; see also
+  // CheckpointOptions for the background checkpoints
+  void checkpoint();
+
+  // Page allocation: freed pages are reused before the file grows
+  PageHandle allocate_page();
+  void free_page(PageId page_number);
+
+  // Resize the buffer pool without reopening the file
+  void set_cache_budget(std::size_t bytes);
+  // Hint the expected access pattern of upcoming reads
+  void advise(AccessPattern pattern) noexcept;
+  // Load a run of pages into the pool with one batched read
+  std::size_t prefetch(PageId first, PageId count);
+
   // Getters
   std::uint32_t get_num_pages() noexcept;
-  std::size_t get_cache_hits() const noexcept { return cache_hits; }
+  std::uint32_t get_page_size() const noexcept { return page_size; }
+  // Bytes of a page available to callers: all but the checksum trailer
+  std::uint32_t get_usable_size() const noexcept;
+  bool get_page_checksums() const noexcept { return m_checksums; }
+  bool get_compression() const noexcept { return m_compressed != nullptr; }
+  bool get_wal() const noexcept { return m_wal != nullptr; }
+  std::size_t get_cache_budget() const noexcept { return cache_budget; }
+  std::size_t get_cache_frames() const noexcept { return m_frame_count; }
+  std::size_t get_cache_hits() const noexcept;
+  ReadMode get_read_mode() const noexcept { return read_mode; }
+  IoBackend get_io_backend() const noexcept { return m_io->backend(); }
+  bool get_direct_io() const noexcept { return m_io->is_direct(); }
+  ReadAheadStats get_read_ahead_stats() const noexcept;
+  std::uint32_t get_free_pages() const noexcept { return m_free_pages; }
+  // Snapshot of every counter; the only call that walks the pool
+  PagerStats stats() const;
+  // Version latches over the page contents, for structures whose readers
+  // validate what they read instead of latching it; see BTree
+  const PageLatches& latches() const noexcept { return m_latches; }
 
 private:
-  std::fstream file_stream;
-  std::unique_ptr<std::byte[]> cache;
+  friend class PageHandle;
+
+  std::unique_ptr<FileIo> m_io;
+  // Set when pages are stored compressed; all page I/O goes through it
+  std::unique_ptr<CompressedFile> m_compressed;
+  // Set in WAL mode: written-back pages are committed here instead
+  std::unique_ptr<Wal> m_wal;
+  FileMapping m_mapping;
+  std::mutex m_mapping_latch;
+  std::atomic<std::size_t> m_mapped_pins {0};
+  ReadMode read_mode;
+  FrameArena m_arena;
   std::uint32_t page_size;
-  std::uint32_t file_size;
-  std::uint32_t num_pages;
-  std::size_t cache_hits {0};
+  std::atomic<std::size_t> cache_budget;
+  // Bytes allocated to the file; guarded by m_alloc_latch
+  std::uint64_t file_size;
+  std::atomic<std::uint32_t> num_pages;
+  // Serializes allocate_page() and free_page()
+  std::mutex m_alloc_latch;
+  // Headerless files have no freelist and no stored page count
+  bool m_has_header {false};
+  std::atomic<std::uint32_t> m_free_pages {0};
+  // Pages end in a CRC-32C trailer (FileHeader::PAGE_CHECKSUMS)
+  bool m_checksums {false};
+  // Identifies this Pager to the per-thread read-ahead detectors
+  std::uint64_t m_id;
+  // Only handed out, never taken by the Pager itself
+  PageLatches m_latches;
+
+  // Relaxed atomics: bumped on the hot path, only read by stats()
+  struct Counters
+  {
+    std::atomic<std::uint64_t> hits {0};
+    std::atomic<std::uint64_t> misses {0};
+    std::atomic<std::uint64_t> evictions {0};
+    std::atomic<std::uint64_t> dirty_evictions {0};
+    std::atomic<std::uint64_t> bytes_read {0};
+    std::atomic<std::uint64_t> bytes_written {0};
+    std::atomic<std::uint64_t> syncs {0};
+    std::atomic<std::uint64_t> prefetched {0};
+    std::atomic<std::uint64_t> prefetch_used {0};
+    std::atomic<std::uint64_t> prefetch_wasted {0};
+    std::atomic<std::uint64_t> checksum_failures {0};
+    std::atomic<std::uint64_t> checkpoints {0};
+    std::atomic<std::uint64_t> checkpoint_pages {0};
+    std::atomic<std::uint64_t> checkpoint_failures {0};
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+    LatencyHistogram checkpoint_duration;
+  };
+  Counters m_counters;
+
+  // Sequential access detector driving read-ahead, one per thread
+  struct ReadAhead
+  {
+    static constexpr PageId NO_PAGE = static_cast<PageId>(-1);
+
+    PageId last_page {NO_PAGE};
+    // Consecutive pins of last_page + 1
+    std::uint32_t run {0};
+    std::uint32_t window {0};
+    // First page past the pages already read ahead
+    PageId next {0};
+    // Counters::prefetch_wasted when the window last changed
+    std::uint64_t wasted {0};
+  };
+  std::uint32_t m_max_read_ahead;
+
+  enum class FrameState : std::uint8_t
+  {
+    free,  // in the free list, or claimed by an evicting thread
+    loading,  // mapped in the page table while its read is in flight
+    ready,
+    failed  // its read failed; freed by the last unpin
+  };
 
-  struct CacheEntry
+  struct Frame
   {
-    int stored_page_number {-1};
+    // Guards page_number, is_dirty and is_writing
+    mutable std::mutex latch;
+    PageId page_number {0};
     bool is_dirty {false};
-    bool is_valid {false};
+    // A write-back is reading the bytes; mark_dirty() waits for it
+    std::atomic<bool> is_writing {false};
+    std::atomic<FrameState> state {FrameState::free};
+    // Only raised while holding the latch of the page's shard
+    std::atomic<std::uint32_t> pin_count {0};
+    // Loaded ahead of demand and not pinned since
+    std::atomic<bool> is_prefetched {false};
+  };
+  // Frames live in fixed chunks so growing the pool never moves one
+  static constexpr std::size_t FRAME_CHUNK = 1024;
+  std::vector<std::unique_ptr<Frame[]>> m_frame_chunks;
+  std::atomic<std::size_t> m_frame_count {0};
+
+  // Accesses to resident pages are buffered per shard and handed to the
+  // replacer in bulk, so hits do not contend on the pool latch
+  struct Access
+  {
+    FrameId frame;
+    PageId page_number;
+  };
+  static constexpr std::size_t ACCESS_BUFFER = 64;
+
+  // Fully associative: any page may live in any frame
+  struct PageTableShard
+  {
+    std::mutex latch;
+    std::unordered_map<PageId, FrameId> pages;
+    std::vector<Access> accesses;
   };
-  std::array<CacheEntry, CACHE_PAGES> m_page_table;
-  void evict_page(size_t cache_index);
+  static constexpr std::size_t PAGE_TABLE_SHARDS = 16;
+  std::array<PageTableShard, PAGE_TABLE_SHARDS> m_page_table;
+
+  // Guards m_free_frames and m_replacer
+  std::mutex m_pool_latch;
+  std::vector<FrameId> m_free_frames;
+  std::unique_ptr<Replacer> m_replacer;
+  // Serializes set_cache_budget()
+  std::mutex m_resize_latch;
+
+  // Threads waiting for another thread's read or write-back of a page
+  std::mutex m_load_latch;
+  std::condition_variable m_load_done;
+  // Bumped under m_load_latch whenever such I/O finishes
+  std::atomic<std::uint64_t> m_io_generation {0};
+  // Frames neither free nor evictable because their I/O is in flight
+  std::atomic<std::size_t> m_frames_in_flight {0};
+
+  // Serializes checkpoints, the only writers of the file in WAL mode
+  std::mutex m_checkpoint_latch;
+  CheckpointOptions m_checkpoint_options;
+  // Set in WAL mode with background checkpoints; stopped first on close
+  std::unique_ptr<Checkpointer> m_checkpointer;
+
+  using FrameLoad = std::pair<PageId, FrameId>;
+
+  std::uint32_t read_header(const std::filesystem::path& filename,
+                            const PagerOptions& options);
+  PageHandle append_page();
+  void grow_file(PageId pages);
+  PageHandle pin_zeroed(PageId page_number);
+  Frame& frame_entry(FrameId frame) const noexcept;
+  PageTableShard& shard_of(PageId page_number) noexcept;
+  std::byte* frame_data(FrameId frame) const noexcept;
+  ReadAhead& thread_read_ahead() const;
+
+  std::optional<PageHandle> pin_resident(PageId page_number, bool access);
+  std::optional<FrameId> try_acquire_frame();
+  std::optional<FrameId> find_victim(std::unique_lock<std::mutex>& pool,
+                                     std::vector<FrameId>& skipped);
+  FrameId acquire_frame();
+  void release_frame(FrameId frame);
+  bool reserve_frame(PageId page_number,
+                     FrameId frame,
+                     bool prefetched,
+                     std::vector<FrameLoad>& loads);
+  void collect_loads(std::vector<FrameLoad>& loads,
+                     PageId first,
+                     PageId count);
+  void read_loads(std::vector<FrameLoad>& loads, std::size_t pinned);
+  std::uint32_t page_checksum(PageId page_number,
+                              const std::byte* data) const noexcept;
+  void seal_page(PageId page_number, std::byte* data) const noexcept;
+  bool verify_page(PageId page_number, const std::byte* data) const noexcept;
+  void publish_loads(const std::vector<FrameLoad>& loads,
+                     std::size_t pinned);
+  void fail_loads(const std::vector<FrameLoad>& loads);
+  bool wait_until_loaded(const Frame& entry);
+  void unpin_frame(FrameId frame) noexcept;
+  void record_accesses(std::vector<Access>& accesses);
+  void drain_accesses();
+  std::pair<PageId, PageId> plan_read_ahead(PageId page_number,
+                                            bool resident);
+  void write_frame(FrameId frame, bool commit);
+  void end_writes(const std::vector<FrameId>& frames, bool failed);
+  void io_finished(std::size_t frames);
+  void read_pages(const std::vector<IoRequest>& requests);
+  void write_pages(const std::vector<IoRequest>& requests, bool commit);
+  void write_file_pages(const std::vector<IoRequest>& requests);
+  void sync_pages();
+  void sync_file_pages();
+  void run_checkpoint(bool background);
+  void resize_pool(std::size_t frames);
 };
 
 // Factory function
-auto create_pager(const std::filesystem::path& filename)
-    -> std::unique_ptr<Pager>;
+auto create_pager(const std::filesystem::path& filename,
+                  PagerOptions options = {}) -> std::unique_ptr<Pager>;
 
-#endif  // PAGER_HPP
\ No newline at end of file
+#endif  // PAGER_HPP
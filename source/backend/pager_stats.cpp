@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+
+#include "pager_stats.hpp"
+
+std::uint64_t nanoseconds_since(
+    std::chrono::steady_clock::time_point start) noexcept
+{
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+std::uint64_t LatencySnapshot::count() const noexcept
+{
+  std::uint64_t total = 0;
+  for (auto n : buckets) {
+    total += n;
+  }
+  return total;
+}
+
+/**
+ * @brief Estimate a quantile from the bucket counts
+ *
+ * @param q Quantile in [0, 1], e.g. 0.99
+ * @return std::uint64_t Upper bound of the bucket containing the quantile,
+ * 0 if the histogram is empty
+ */
+std::uint64_t LatencySnapshot::percentile(double q) const noexcept
+{
+  const std::uint64_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  q = std::clamp(q, 0.0, 1.0);
+  const auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total))));
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return i == 0 ? 0 : (std::uint64_t {1} << i) - 1;
+    }
+  }
+  return (std::uint64_t {1} << (BUCKETS - 1)) - 1;
+}
+
+std::size_t LatencyHistogram::bucket_of(std::uint64_t nanoseconds) noexcept
+{
+  std::size_t bits = 0;
+  while (nanoseconds != 0) {
+    nanoseconds >>= 1U;
+    bits++;
+  }
+  return std::min(bits, LatencySnapshot::BUCKETS - 1);
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) noexcept
+{
+  m_buckets[bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const noexcept
+{
+  LatencySnapshot snapshot;
+  for (std::size_t i = 0; i < LatencySnapshot::BUCKETS; i++) {
+    snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+double PagerStats::hit_rate() const noexcept
+{
+  const std::uint64_t accesses = hits + misses;
+  return accesses == 0
+      ? 0.0
+      : static_cast<double>(hits) / static_cast<double>(accesses);
+}
+
+double CompressionStats::ratio() const noexcept
+{
+  return bytes_stored == 0
+      ? 0.0
+      : static_cast<double>(bytes_in) / static_cast<double>(bytes_stored);
+}
+
+double WalStats::commits_per_sync() const noexcept
+{
+  return syncs == 0
+      ? 0.0
+      : static_cast<double>(commits) / static_cast<double>(syncs);
+}
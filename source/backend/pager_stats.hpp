@@ -0,0 +1,149 @@
+#ifndef PAGER_STATS_HPP
+#define PAGER_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Counts of a latency histogram at one point in time
+ *
+ * Bucket 0 holds latencies of 0 ns; bucket i > 0 holds latencies in
+ * [2^(i-1), 2^i) ns. The last bucket also absorbs anything larger.
+ */
+struct LatencySnapshot
+{
+  static constexpr std::size_t BUCKETS = 40;
+
+  std::array<std::uint64_t, BUCKETS> buckets {};
+
+  std::uint64_t count() const noexcept;
+  // Upper bound in ns of the bucket holding the q-quantile, q in [0, 1]
+  std::uint64_t percentile(double q) const noexcept;
+};
+
+/**
+ * @brief Log2-bucketed latency histogram
+ *
+ * record() is a single relaxed atomic increment, so it is safe to call from
+ * any thread and costs next to nothing; readers take a snapshot().
+ */
+class LatencyHistogram
+{
+public:
+  void record(std::uint64_t nanoseconds) noexcept;
+  LatencySnapshot snapshot() const noexcept;
+
+  static std::size_t bucket_of(std::uint64_t nanoseconds) noexcept;
+
+private:
+  std::array<std::atomic<std::uint64_t>, LatencySnapshot::BUCKETS> m_buckets {};
+};
+
+// Time elapsed since start, in the unit LatencyHistogram::record() takes
+std::uint64_t nanoseconds_since(
+    std::chrono::steady_clock::time_point start) noexcept;
+
+// Pages loaded ahead of demand, by read-ahead or prefetch()
+struct ReadAheadStats
+{
+  std::size_t prefetched {0};
+  // Pinned before eviction
+  std::size_t used {0};
+  // Evicted without ever being pinned
+  std::size_t wasted {0};
+};
+
+/**
+ * @brief Codec counters of a file with compressed pages, see CompressedFile
+ *
+ * Stored bytes count whole slots, so the ratio is the space actually saved
+ * on disk rather than the raw output of the codec.
+ */
+struct CompressionStats
+{
+  std::uint64_t pages_written {0};
+  // Pages stored raw because they did not compress
+  std::uint64_t pages_raw {0};
+  // Pages decompressed on a miss
+  std::uint64_t pages_read {0};
+  std::uint64_t bytes_in {0};
+  std::uint64_t bytes_stored {0};
+
+  LatencySnapshot compress_latency;
+  LatencySnapshot decompress_latency;
+
+  // Page bytes written per byte stored, 0 before the first write
+  double ratio() const noexcept;
+};
+
+/**
+ * @brief Counters of a write-ahead log, see Wal
+ *
+ * Every group commit costs one append and one sync, so commits per sync is
+ * the average batch size the group commit achieved.
+ */
+struct WalStats
+{
+  std::uint64_t commits {0};
+  std::uint64_t frames {0};
+  std::uint64_t syncs {0};
+  std::uint64_t bytes_written {0};
+  // Times the log started over after a checkpoint
+  std::uint64_t restarts {0};
+  // Bytes of the log at the time of the snapshot
+  std::uint64_t size {0};
+  // From the call to commit() until the commit is durable
+  LatencySnapshot commit_latency;
+
+  double commits_per_sync() const noexcept;
+};
+
+// Counters of the checkpoints of a log, see Pager::checkpoint()
+struct CheckpointStats
+{
+  std::uint64_t checkpoints {0};
+  std::uint64_t pages_copied {0};
+  std::uint64_t failures {0};
+  LatencySnapshot duration;
+};
+
+/**
+ * @brief Snapshot of the Pager's buffer pool counters, see Pager::stats()
+ *
+ * Counters are cumulative since the Pager was opened; dirty, pinned and
+ * cached pages describe the pool at the time of the snapshot. Latencies
+ * are sampled once per read or write call, so a batch counts once.
+ */
+struct PagerStats
+{
+  std::uint64_t hits {0};
+  std::uint64_t misses {0};
+  std::uint64_t evictions {0};
+  // Evictions that had to write the page back first
+  std::uint64_t dirty_evictions {0};
+  std::uint64_t bytes_read {0};
+  std::uint64_t bytes_written {0};
+  std::uint64_t syncs {0};
+  // Pages whose trailer checksum did not match when read
+  std::uint64_t checksum_failures {0};
+
+  std::size_t cached_pages {0};
+  std::size_t dirty_pages {0};
+  std::size_t pinned_pages {0};
+
+  ReadAheadStats read_ahead;
+  LatencySnapshot read_latency;
+  LatencySnapshot write_latency;
+  // All zero unless the file stores pages compressed
+  CompressionStats compression;
+  // All zero unless the file is in WAL mode
+  WalStats wal;
+  CheckpointStats checkpoint;
+
+  double hit_rate() const noexcept;
+};
+
+#endif  // PAGER_STATS_HPP
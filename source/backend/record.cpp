@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "record.hpp"
+
+#include "overflow.hpp"
+
+namespace
+{
+constexpr std::uint64_t NULL_TYPE = 0;
+constexpr std::uint64_t ZERO_TYPE = 8;
+constexpr std::uint64_t ONE_TYPE = 9;
+constexpr std::uint64_t TEXT_BASE = 13;
+// Bytes of the integer serial types 1 to 6
+constexpr std::size_t INTEGER_BYTES[] = {0, 1, 2, 3, 4, 6, 8};
+
+constexpr std::byte NULL_TAG {0x00};
+constexpr std::byte INTEGER_TAG {0x01};
+constexpr std::byte TEXT_TAG {0x02};
+constexpr std::byte ESCAPE {0xFF};
+constexpr std::size_t ROWID_SIZE = 8;
+constexpr std::uint64_t SIGN_BIT = 1ULL << 63U;
+
+[[noreturn]] void corrupt()
+{
+  throw std::runtime_error("Corrupt record");
+}
+
+// Big-endian, unlike the fixed-width integers of byte_order.hpp; a load
+// and a byte swap where the compiler allows, as it does not spot the loop
+std::uint64_t load_be64(const std::byte* src) noexcept
+{
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  std::uint64_t value = 0;
+  std::memcpy(&value, src, sizeof(value));
+  return __builtin_bswap64(value);
+#else
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = (value << 8U) | std::to_integer<std::uint64_t>(src[i]);
+  }
+  return value;
+#endif
+}
+
+unsigned leading_zeros(std::uint64_t value) noexcept
+{
+#if defined(__GNUC__)
+  return static_cast<unsigned>(__builtin_clzll(value));
+#else
+  unsigned zeros = 0;
+  for (; (value & (std::uint64_t {1} << 63U)) == 0; value <<= 1U) {
+    zeros++;
+  }
+  return zeros;
+#endif
+}
+
+// Byte by byte, for the ninth byte and the last bytes of a buffer
+std::uint64_t read_varint_slow(const std::byte*& src, const std::byte* end)
+{
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    if (src == end) {
+      corrupt();
+    }
+    const auto byte = std::to_integer<std::uint64_t>(*src++);
+    value = (value << 7U) | (byte & 0x7FU);
+    if ((byte & 0x80U) == 0) {
+      return value;
+    }
+  }
+  if (src == end) {
+    corrupt();
+  }
+  return (value << 8U) | std::to_integer<std::uint64_t>(*src++);
+}
+}  // namespace
+
+void append_varint(std::vector<std::byte>& dst, std::uint64_t value)
+{
+  if (value >> 56U != 0) {
+    // Eight groups of 7 bits, then the low 8 bits whole
+    for (int shift = 57; shift >= 8; shift -= 7) {
+      dst.push_back(static_cast<std::byte>(((value >> shift) & 0x7FU) | 0x80U));
+    }
+    dst.push_back(static_cast<std::byte>(value & 0xFFU));
+    return;
+  }
+  int shift = 0;
+  while (value >> (shift + 7) != 0) {
+    shift += 7;
+  }
+  for (; shift > 0; shift -= 7) {
+    dst.push_back(static_cast<std::byte>(((value >> shift) & 0x7FU) | 0x80U));
+  }
+  dst.push_back(static_cast<std::byte>(value & 0x7FU));
+}
+
+/**
+ * @brief Decode a varint and step past it
+ *
+ * One and two bytes, the size of nearly every serial type and header size,
+ * cost a test each, which branch prediction makes near free and which keep
+ * the next varint's address independent of this one's value. Varints of 3
+ * to 8 bytes, with 8 bytes left to load, are decoded without a loop: the
+ * first byte lacking the high bit is found in the stop bits of all 8 at
+ * once, and the 7-bit groups before it are packed together by three mask
+ * and shift steps. Anything else takes the byte by byte loop.
+ *
+ * @throws std::runtime_error if the varint runs past `end`
+ */
+std::uint64_t read_varint(const std::byte*& src, const std::byte* end)
+{
+  if (src == end) {
+    corrupt();
+  }
+  const auto first = std::to_integer<std::uint64_t>(src[0]);
+  if (first < 0x80U) {
+    src++;
+    return first;
+  }
+  if (end - src >= 2 && std::to_integer<std::uint8_t>(src[1]) < 0x80U) {
+    const auto second = std::to_integer<std::uint64_t>(src[1]);
+    src += 2;
+    return ((first & 0x7FU) << 7U) | second;
+  }
+  if (end - src >= 8) {
+    const std::uint64_t word = load_be64(src);
+    const std::uint64_t stops = ~word & 0x8080808080808080ULL;
+    if (stops != 0) {
+      const unsigned bytes = leading_zeros(stops) / 8 + 1;
+      std::uint64_t groups =
+          (word >> (64 - 8 * bytes)) & 0x7F7F7F7F7F7F7F7FULL;
+      groups = (groups & 0x007F007F007F007FULL)
+          | ((groups & 0x7F007F007F007F00ULL) >> 1U);
+      groups = (groups & 0x00003FFF00003FFFULL)
+          | ((groups & 0x3FFF00003FFF0000ULL) >> 2U);
+      groups = (groups & 0x000000000FFFFFFFULL)
+          | ((groups & 0x0FFFFFFF00000000ULL) >> 4U);
+      src += bytes;
+      return groups;
+    }
+  }
+  return read_varint_slow(src, end);
+}
+
+namespace
+{
+std::uint64_t integer_type(std::int64_t value) noexcept
+{
+  if (value == 0 || value == 1) {
+    return value == 0 ? ZERO_TYPE : ONE_TYPE;
+  }
+  for (std::uint64_t type = 1; type < 6; type++) {
+    const std::size_t bits = INTEGER_BYTES[type] * 8 - 1;
+    const std::int64_t limit = std::int64_t {1} << bits;
+    if (value >= -limit && value < limit) {
+      return type;
+    }
+  }
+  return 6;
+}
+
+std::size_t body_size(std::uint64_t type)
+{
+  if (type >= TEXT_BASE && type % 2 == 1) {
+    return static_cast<std::size_t>((type - TEXT_BASE) / 2);
+  }
+  if (type == NULL_TYPE || type == ZERO_TYPE || type == ONE_TYPE) {
+    return 0;
+  }
+  if (type > 6) {
+    corrupt();
+  }
+  return INTEGER_BYTES[type];
+}
+
+// Sign-extend from the top byte
+std::int64_t body_integer(const std::byte* body, std::size_t bytes) noexcept
+{
+  std::uint64_t bits =
+      std::to_integer<std::int8_t>(body[0]) < 0 ? ~std::uint64_t {0} : 0;
+  for (std::size_t i = 0; i < bytes; i++) {
+    bits = (bits << 8U) | std::to_integer<std::uint64_t>(body[i]);
+  }
+  return static_cast<std::int64_t>(bits);
+}
+
+std::uint64_t key_integer(const std::byte* src) noexcept
+{
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < ROWID_SIZE; i++) {
+    value = (value << 8U) | std::to_integer<std::uint64_t>(src[i]);
+  }
+  return value ^ SIGN_BIT;
+}
+}  // namespace
+
+std::vector<std::byte> encode_record(const std::vector<Value>& values)
+{
+  std::vector<std::byte> types;
+  std::size_t bodies = 0;
+  for (const Value& value : values) {
+    std::uint64_t type = NULL_TYPE;
+    if (const auto* integer = std::get_if<std::int64_t>(&value)) {
+      type = integer_type(*integer);
+    } else if (const auto* text = std::get_if<std::string>(&value)) {
+      type = TEXT_BASE + 2 * static_cast<std::uint64_t>(text->size());
+    }
+    append_varint(types, type);
+    bodies += body_size(type);
+  }
+
+  // The header size counts its own varint
+  std::size_t header = types.size() + 1;
+  std::vector<std::byte> size_varint;
+  for (;;) {
+    size_varint.clear();
+    append_varint(size_varint, header);
+    if (size_varint.size() + types.size() == header) {
+      break;
+    }
+    header = size_varint.size() + types.size();
+  }
+
+  std::vector<std::byte> record;
+  record.reserve(header + bodies);
+  record.insert(record.end(), size_varint.begin(), size_varint.end());
+  record.insert(record.end(), types.begin(), types.end());
+  for (const Value& value : values) {
+    if (const auto* integer = std::get_if<std::int64_t>(&value)) {
+      const std::uint64_t type = integer_type(*integer);
+      const auto bits = static_cast<std::uint64_t>(*integer);
+      for (std::size_t i = body_size(type); i > 0; i--) {
+        const std::size_t shift = 8 * (i - 1);
+        record.push_back(static_cast<std::byte>((bits >> shift) & 0xFFU));
+      }
+    } else if (const auto* text = std::get_if<std::string>(&value)) {
+      for (const char c : *text) {
+        record.push_back(static_cast<std::byte>(c));
+      }
+    }
+  }
+  return record;
+}
+
+std::vector<Value> decode_record(const std::byte* record, std::size_t size)
+{
+  const std::byte* const end = record + size;
+  const std::byte* type_at = record;
+  const std::uint64_t header = read_varint(type_at, end);
+  if (header > size) {
+    corrupt();
+  }
+  const std::byte* const header_end = record + header;
+  const std::byte* body = header_end;
+
+  std::vector<Value> values;
+  while (type_at < header_end) {
+    const std::uint64_t type = read_varint(type_at, header_end);
+    const std::size_t bytes = body_size(type);
+    if (static_cast<std::size_t>(end - body) < bytes) {
+      corrupt();
+    }
+    if (type == NULL_TYPE) {
+      values.emplace_back();
+    } else if (type == ZERO_TYPE || type == ONE_TYPE) {
+      values.emplace_back(std::int64_t {type == ONE_TYPE ? 1 : 0});
+    } else if (type >= TEXT_BASE) {
+      values.emplace_back(std::string(reinterpret_cast<const char*>(body),
+                                      bytes));
+    } else {
+      values.emplace_back(body_integer(body, bytes));
+    }
+    body += bytes;
+  }
+  return values;
+}
+
+RecordView::RecordView(const std::byte* record, std::size_t size)
+{
+  reset(record, size);
+}
+
+void RecordView::reset(const std::byte* record, std::size_t size)
+{
+  m_record = record;
+  m_columns.clear();
+  const std::byte* type_at = record;
+  const std::uint64_t header = read_varint(type_at, record + size);
+  if (header > size
+      || header < static_cast<std::uint64_t>(type_at - record))
+  {
+    corrupt();
+  }
+  const std::byte* const header_end = record + header;
+  auto body = static_cast<std::size_t>(header);
+  while (type_at < header_end) {
+    const std::uint64_t type = read_varint(type_at, header_end);
+    const std::size_t bytes = body_size(type);
+    if (size - body < bytes) {
+      corrupt();
+    }
+    m_columns.push_back({type, body});
+    body += bytes;
+  }
+}
+
+ValueView RecordView::column(std::size_t k) const
+{
+  if (k >= m_columns.size()) {
+    throw std::out_of_range("No such column in the record");
+  }
+  const auto [type, offset] = m_columns[k];
+  if (type >= TEXT_BASE) {
+    return std::string_view(reinterpret_cast<const char*>(m_record + offset),
+                            static_cast<std::size_t>((type - TEXT_BASE) / 2));
+  }
+  if (type == NULL_TYPE) {
+    return std::monostate {};
+  }
+  if (type == ZERO_TYPE || type == ONE_TYPE) {
+    return std::int64_t {type == ONE_TYPE ? 1 : 0};
+  }
+  return body_integer(m_record + offset, INTEGER_BYTES[type]);
+}
+
+Value to_value(const ValueView& view)
+{
+  if (const auto* integer = std::get_if<std::int64_t>(&view)) {
+    return *integer;
+  }
+  if (const auto* text = std::get_if<std::string_view>(&view)) {
+    return std::string(*text);
+  }
+  return std::monostate {};
+}
+
+ValueView view_of(const Value& value) noexcept
+{
+  if (const auto* integer = std::get_if<std::int64_t>(&value)) {
+    return *integer;
+  }
+  if (const auto* text = std::get_if<std::string>(&value)) {
+    return std::string_view(*text);
+  }
+  return std::monostate {};
+}
+
+std::vector<Value> decode_record(PayloadReader& record,
+                                 const std::vector<bool>& wanted)
+{
+  const std::size_t size = record.size();
+  // The header size varint takes at most 9 bytes
+  std::vector<std::byte> header(std::min<std::size_t>(size, 9));
+  record.read(0, header.size(), header.data());
+  const std::byte* type_at = header.data();
+  const std::uint64_t header_size =
+      read_varint(type_at, header.data() + header.size());
+  if (header_size > size) {
+    corrupt();
+  }
+  const auto read_at = static_cast<std::size_t>(type_at - header.data());
+  header.resize(static_cast<std::size_t>(header_size));
+  if (header.size() > read_at) {
+    record.read(read_at, header.size() - read_at, header.data() + read_at);
+  }
+  type_at = header.data() + read_at;
+  const std::byte* const header_end = header.data() + header.size();
+
+  std::vector<Value> values;
+  std::size_t body = header.size();
+  while (type_at < header_end) {
+    const std::uint64_t type = read_varint(type_at, header_end);
+    const std::size_t bytes = body_size(type);
+    if (size - body < bytes) {
+      corrupt();
+    }
+    values.emplace_back();
+    if (values.size() <= wanted.size() && wanted[values.size() - 1]) {
+      if (type == ZERO_TYPE || type == ONE_TYPE) {
+        values.back() = std::int64_t {type == ONE_TYPE ? 1 : 0};
+      } else if (type >= TEXT_BASE) {
+        // Copied straight from the pages holding it
+        std::string text(bytes, '\0');
+        record.read(body, bytes, reinterpret_cast<std::byte*>(text.data()));
+        values.back() = std::move(text);
+      } else if (type != NULL_TYPE) {
+        std::byte integer[8];
+        record.read(body, bytes, integer);
+        values.back() = body_integer(integer, bytes);
+      }
+    }
+    body += bytes;
+  }
+  return values;
+}
+
+void append_key(std::vector<std::byte>& key, const Value& value)
+{
+  if (const auto* integer = std::get_if<std::int64_t>(&value)) {
+    key.push_back(INTEGER_TAG);
+    append_key_rowid(key, *integer);
+  } else if (const auto* text = std::get_if<std::string>(&value)) {
+    key.push_back(TEXT_TAG);
+    for (const char c : *text) {
+      key.push_back(static_cast<std::byte>(c));
+      if (c == '\0') {
+        key.push_back(ESCAPE);
+      }
+    }
+    key.push_back(std::byte {0});
+    key.push_back(std::byte {0});
+  } else {
+    key.push_back(NULL_TAG);
+  }
+}
+
+void append_key_rowid(std::vector<std::byte>& key, std::int64_t rowid)
+{
+  const std::uint64_t bits = static_cast<std::uint64_t>(rowid) ^ SIGN_BIT;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    key.push_back(static_cast<std::byte>((bits >> shift) & 0xFFU));
+  }
+}
+
+std::vector<std::byte> non_null_key()
+{
+  return {INTEGER_TAG};
+}
+
+std::vector<Value> decode_key(const std::byte* key,
+                              std::size_t size,
+                              std::size_t columns)
+{
+  const std::byte* const end = key + size;
+  std::vector<Value> values;
+  values.reserve(columns);
+  while (values.size() < columns) {
+    if (key == end) {
+      corrupt();
+    }
+    const std::byte tag = *key++;
+    if (tag == NULL_TAG) {
+      values.emplace_back();
+    } else if (tag == INTEGER_TAG) {
+      if (static_cast<std::size_t>(end - key) < ROWID_SIZE) {
+        corrupt();
+      }
+      values.emplace_back(static_cast<std::int64_t>(key_integer(key)));
+      key += ROWID_SIZE;
+    } else if (tag == TEXT_TAG) {
+      std::string text;
+      for (;;) {
+        if (end - key < 2) {
+          corrupt();
+        }
+        if (key[0] != std::byte {0}) {
+          text.push_back(static_cast<char>(*key++));
+        } else if (key[1] == ESCAPE) {
+          text.push_back('\0');
+          key += 2;
+        } else if (key[1] == std::byte {0}) {
+          break;
+        } else {
+          corrupt();
+        }
+      }
+      key += 2;
+      values.emplace_back(std::move(text));
+    } else {
+      corrupt();
+    }
+  }
+  return values;
+}
+
+std::int64_t key_rowid(const std::byte* key, std::size_t size) noexcept
+{
+  return static_cast<std::int64_t>(key_integer(key + size - ROWID_SIZE));
+}
@@ -0,0 +1,109 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+class PayloadReader;
+
+// A column value: NULL, INTEGER or TEXT
+using Value = std::variant<std::monostate, std::int64_t, std::string>;
+// A column value read in place: TEXT points into the bytes it came from
+using ValueView =
+    std::variant<std::monostate, std::int64_t, std::string_view>;
+
+Value to_value(const ValueView& view);
+// Valid as long as `value` is
+ValueView view_of(const Value& value) noexcept;
+
+/**
+ * Records are the payloads of table rows. A record is a header, its size
+ * in bytes as a varint followed by one serial type varint per column, then
+ * the column bodies in order:
+ *
+ *   serial type  body
+ *             0  NULL, no body
+ *          1..6  INTEGER of 1, 2, 3, 4, 6 or 8 bytes, big-endian
+ *             8  INTEGER 0, no body
+ *             9  INTEGER 1, no body
+ *    N >= 13, N odd  TEXT of (N - 13) / 2 bytes
+ *
+ * Varints are big-endian: 7 bits per byte with the high bit set on all
+ * but the last, and a ninth byte, if any, giving all of its 8 bits.
+ */
+std::vector<std::byte> encode_record(const std::vector<Value>& values);
+// Can throw runtime_error for a malformed record
+std::vector<Value> decode_record(const std::byte* record, std::size_t size);
+// Decode the columns flagged in `wanted`, leaving the others NULL; only the
+// header and the bodies of those columns are read, so the overflow pages
+// of the others are never pinned. Can throw runtime_error.
+std::vector<Value> decode_record(PayloadReader& record,
+                                 const std::vector<bool>& wanted);
+
+// The varints of record headers
+void append_varint(std::vector<std::byte>& dst, std::uint64_t value);
+// Steps `src` past the varint; can throw runtime_error past `end`
+std::uint64_t read_varint(const std::byte*& src, const std::byte* end);
+
+/**
+ * @brief Column by column access to a record held in memory
+ *
+ * The header is walked once, into a table of the serial type and body
+ * offset of every column. column(k) then decodes column k alone, in O(1)
+ * whatever k, and returns TEXT as a view into the record: read a row in
+ * its leaf and nothing is copied. The record must outlive the view and the
+ * values it returns.
+ *
+ * reset() points the view at another record and reuses the table, so a
+ * scan keeps one view for all its rows.
+ */
+class RecordView
+{
+public:
+  RecordView() = default;
+  // Can throw runtime_error for a malformed record
+  RecordView(const std::byte* record, std::size_t size);
+
+  // Can throw runtime_error for a malformed record
+  void reset(const std::byte* record, std::size_t size);
+
+  std::size_t columns() const noexcept { return m_columns.size(); }
+  // Can throw out_of_range past the last column
+  ValueView column(std::size_t k) const;
+
+private:
+  struct Column
+  {
+    std::uint64_t type;
+    std::size_t offset;
+  };
+
+  const std::byte* m_record {nullptr};
+  std::vector<Column> m_columns;
+};
+
+/**
+ * Index keys are compared with memcmp, so they are encoded to sort like
+ * the values they hold: a tag byte, NULL (0x00) below INTEGER (0x01)
+ * below TEXT (0x02), then the body. An INTEGER is 8 bytes big-endian with
+ * the sign bit flipped; TEXT has its zero bytes escaped as 0x00 0xFF and
+ * ends in 0x00 0x00. Each encoding is self-delimiting, so that the key of
+ * a column prefix is a byte prefix of the whole key.
+ */
+void append_key(std::vector<std::byte>& key, const Value& value);
+// The rowid that makes an index key unique; 8 bytes without a tag
+void append_key_rowid(std::vector<std::byte>& key, std::int64_t rowid);
+// Smallest key above every NULL, where range scans over values start
+std::vector<std::byte> non_null_key();
+// Decode the first `columns` values of a key; can throw runtime_error
+std::vector<Value> decode_key(const std::byte* key,
+                              std::size_t size,
+                              std::size_t columns);
+// The rowid ending a key
+std::int64_t key_rowid(const std::byte* key, std::size_t size) noexcept;
+
+#endif  // RECORD_HPP
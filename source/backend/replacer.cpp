@@ -0,0 +1,186 @@
+#include "replacer.hpp"
+
+// --- ClockReplacer ---
+
+ClockReplacer::ClockReplacer(std::size_t num_frames)
+    : m_slots(num_frames)
+{
+}
+
+void ClockReplacer::record_access(FrameId frame)
+{
+  auto& slot = m_slots.at(frame);
+  slot.tracked = true;
+  slot.referenced = true;
+}
+
+void ClockReplacer::set_evictable(FrameId frame, bool evictable)
+{
+  auto& slot = m_slots.at(frame);
+  if (!slot.tracked || slot.evictable == evictable) {
+    return;
+  }
+  slot.evictable = evictable;
+  if (evictable) {
+    m_evictable_count++;
+  } else {
+    m_evictable_count--;
+  }
+}
+
+/**
+ * @brief Advance the clock hand until an unreferenced evictable frame is found
+ *
+ * @return The victim frame, or std::nullopt when every frame is pinned
+ */
+std::optional<FrameId> ClockReplacer::evict()
+{
+  if (m_evictable_count == 0) {
+    return std::nullopt;
+  }
+
+  // Two sweeps are enough: the first clears every reference bit
+  for (std::size_t step = 0; step < 2 * m_slots.size(); step++) {
+    FrameId frame = m_hand;
+    m_hand = (m_hand + 1) % m_slots.size();
+
+    auto& slot = m_slots[frame];
+    if (!slot.tracked || !slot.evictable) {
+      continue;
+    }
+    if (slot.referenced) {
+      slot.referenced = false;
+      continue;
+    }
+    remove(frame);
+    return frame;
+  }
+  return std::nullopt;
+}
+
+void ClockReplacer::remove(FrameId frame)
+{
+  auto& slot = m_slots.at(frame);
+  if (slot.tracked && slot.evictable) {
+    m_evictable_count--;
+  }
+  slot = Slot {};
+}
+
+void ClockReplacer::resize(std::size_t num_frames)
+{
+  m_slots.resize(num_frames);
+  if (m_hand >= num_frames) {
+    m_hand = 0;
+  }
+}
+
+// --- LruKReplacer ---
+
+LruKReplacer::LruKReplacer(std::size_t num_frames, std::size_t k)
+    : m_k(k == 0 ? 1 : k)
+    , m_slots(num_frames)
+{
+}
+
+void LruKReplacer::record_access(FrameId frame)
+{
+  auto& slot = m_slots.at(frame);
+  if (slot.tracked && slot.evictable) {
+    unlink(frame);
+  }
+  slot.tracked = true;
+  slot.history.push_back(++m_clock);
+  if (slot.history.size() > m_k) {
+    slot.history.erase(slot.history.begin());
+  }
+  if (slot.evictable) {
+    link(frame);
+  }
+}
+
+void LruKReplacer::set_evictable(FrameId frame, bool evictable)
+{
+  auto& slot = m_slots.at(frame);
+  if (!slot.tracked || slot.evictable == evictable) {
+    return;
+  }
+  if (evictable) {
+    slot.evictable = true;
+    link(frame);
+  } else {
+    unlink(frame);
+    slot.evictable = false;
+  }
+}
+
+/**
+ * @brief Evict the frame with the largest backward K-distance
+ *
+ * @return The victim frame, or std::nullopt when every frame is pinned
+ */
+std::optional<FrameId> LruKReplacer::evict()
+{
+  auto& candidates = m_young.empty() ? m_mature : m_young;
+  if (candidates.empty()) {
+    return std::nullopt;
+  }
+  FrameId frame = candidates.begin()->second;
+  remove(frame);
+  return frame;
+}
+
+void LruKReplacer::remove(FrameId frame)
+{
+  auto& slot = m_slots.at(frame);
+  if (slot.tracked && slot.evictable) {
+    unlink(frame);
+  }
+  slot = Slot {};
+}
+
+void LruKReplacer::resize(std::size_t num_frames)
+{
+  m_slots.resize(num_frames);
+}
+
+// The oldest retained timestamp is the first access for young frames and the
+// K-th most recent access for mature ones; smaller means evict sooner.
+LruKReplacer::Key LruKReplacer::key_of(FrameId frame) const
+{
+  return {m_slots[frame].history.front(), frame};
+}
+
+std::set<LruKReplacer::Key>& LruKReplacer::set_of(FrameId frame)
+{
+  return m_slots[frame].history.size() < m_k ? m_young : m_mature;
+}
+
+void LruKReplacer::unlink(FrameId frame)
+{
+  set_of(frame).erase(key_of(frame));
+}
+
+void LruKReplacer::link(FrameId frame)
+{
+  set_of(frame).insert(key_of(frame));
+}
+
+/**
+ * @brief Factory function to create the replacer for a buffer pool
+ *
+ * @param policy Replacement policy to use
+ * @param num_frames Number of frames in the pool
+ * @return std::unique_ptr<Replacer> New replacer instance
+ */
+auto make_replacer(ReplacementPolicy policy, std::size_t num_frames)
+    -> std::unique_ptr<Replacer>
+{
+  switch (policy) {
+    case ReplacementPolicy::clock:
+      return std::make_unique<ClockReplacer>(num_frames);
+    case ReplacementPolicy::lru_k:
+      return std::make_unique<LruKReplacer>(num_frames);
+  }
+  return std::make_unique<LruKReplacer>(num_frames);
+}
@@ -0,0 +1,124 @@
+#ifndef REPLACER_HPP
+#define REPLACER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+using FrameId = std::size_t;
+
+enum class ReplacementPolicy
+{
+  clock,
+  lru_k
+};
+
+/**
+ * @brief Chooses which cache frame to evict when the buffer pool is full
+ *
+ * The buffer pool reports every access to a frame and whether the frame may
+ * currently be evicted (i.e. it holds a page and is not pinned). Frames that
+ * are not evictable are never returned by evict().
+ */
+class Replacer
+{
+public:
+  virtual ~Replacer() = default;
+
+  // Note that the page held by frame was accessed
+  virtual void record_access(FrameId frame) = 0;
+  // Allow or forbid eviction of frame (pinned frames are not evictable)
+  virtual void set_evictable(FrameId frame, bool evictable) = 0;
+  // Pick and forget a victim, if any frame is evictable
+  virtual std::optional<FrameId> evict() = 0;
+  // Forget all history of frame (its page left the pool)
+  virtual void remove(FrameId frame) = 0;
+  // Number of evictable frames
+  virtual std::size_t size() const = 0;
+  // Track num_frames frames; dropped frames must have been removed first
+  virtual void resize(std::size_t num_frames) = 0;
+};
+
+/**
+ * @brief Second-chance (CLOCK) replacement
+ *
+ * Cheap approximation of LRU: every access sets a reference bit and the
+ * clock hand clears bits until it finds an unreferenced evictable frame.
+ * Not scan resistant.
+ */
+class ClockReplacer : public Replacer
+{
+public:
+  explicit ClockReplacer(std::size_t num_frames);
+
+  void record_access(FrameId frame) override;
+  void set_evictable(FrameId frame, bool evictable) override;
+  std::optional<FrameId> evict() override;
+  void remove(FrameId frame) override;
+  std::size_t size() const override { return m_evictable_count; }
+  void resize(std::size_t num_frames) override;
+
+private:
+  struct Slot
+  {
+    bool tracked {false};
+    bool evictable {false};
+    bool referenced {false};
+  };
+  std::vector<Slot> m_slots;
+  std::size_t m_hand {0};
+  std::size_t m_evictable_count {0};
+};
+
+/**
+ * @brief LRU-K replacement (O'Neil et al.)
+ *
+ * Evicts the frame whose K-th most recent access is the oldest. Frames with
+ * fewer than K recorded accesses have an infinite backward K-distance and
+ * are evicted first, in order of their first access, so a sequential scan
+ * only competes with itself and leaves the re-referenced working set alone.
+ */
+class LruKReplacer : public Replacer
+{
+public:
+  explicit LruKReplacer(std::size_t num_frames, std::size_t k = 2);
+
+  void record_access(FrameId frame) override;
+  void set_evictable(FrameId frame, bool evictable) override;
+  std::optional<FrameId> evict() override;
+  void remove(FrameId frame) override;
+  std::size_t size() const override
+  {
+    return m_young.size() + m_mature.size();
+  }
+  void resize(std::size_t num_frames) override;
+
+private:
+  struct Slot
+  {
+    bool tracked {false};
+    bool evictable {false};
+    // Up to K most recent access timestamps, oldest first
+    std::vector<std::uint64_t> history;
+  };
+  using Key = std::pair<std::uint64_t, FrameId>;
+
+  Key key_of(FrameId frame) const;
+  std::set<Key>& set_of(FrameId frame);
+  void unlink(FrameId frame);
+  void link(FrameId frame);
+
+  std::size_t m_k;
+  std::uint64_t m_clock {0};
+  std::vector<Slot> m_slots;
+  std::set<Key> m_young;  // fewer than K accesses
+  std::set<Key> m_mature;  // at least K accesses
+};
+
+auto make_replacer(ReplacementPolicy policy, std::size_t num_frames)
+    -> std::unique_ptr<Replacer>;
+
+#endif  // REPLACER_HPP
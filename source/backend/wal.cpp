@@ -0,0 +1,705 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "wal.hpp"
+
+#include "byte_order.hpp"
+#include "crc32c.hpp"
+
+namespace
+{
+constexpr std::array<char, 8> MAGIC = {'D', 'I', 'Y', '-', 'W', 'A', 'L'};
+constexpr std::uint32_t FORMAT_VERSION = 2;
+
+constexpr std::size_t HEADER_SIZE = 32;
+constexpr std::size_t HEADER_VERSION_OFFSET = 8;
+constexpr std::size_t HEADER_PAGE_SIZE_OFFSET = 12;
+constexpr std::size_t HEADER_SALT_OFFSET = 16;
+constexpr std::size_t HEADER_BASE_OFFSET = 20;
+constexpr std::size_t HEADER_CHECKSUM_OFFSET = 28;
+
+constexpr std::size_t FRAME_HEADER_SIZE = 24;
+constexpr std::size_t FRAME_PAGE_OFFSET = 0;
+constexpr std::size_t FRAME_COMMIT_OFFSET = 4;
+constexpr std::size_t FRAME_NUMBER_OFFSET = 8;
+constexpr std::size_t FRAME_SALT_OFFSET = 16;
+constexpr std::size_t FRAME_CHECKSUM_OFFSET = 20;
+
+// Frames read per call while scanning the log on open
+constexpr std::size_t RECOVERY_CHUNK = 256;
+
+std::uint32_t frame_checksum(const std::byte* frame,
+                             std::uint32_t page_size) noexcept
+{
+  return crc32c(frame + FRAME_HEADER_SIZE,
+                page_size,
+                crc32c(frame, FRAME_CHECKSUM_OFFSET));
+}
+}  // namespace
+
+/**
+ * @brief Open the log of a database, recovering the commits it holds
+ *
+ * A log whose header is missing or torn holds no commits and is started
+ * afresh.
+ *
+ * @param filename Path to the log, created if missing
+ * @param page_size Page size of the database
+ * @param options Group commit configuration
+ * @param create Whether the database is new; any existing log is discarded
+ * @throws std::runtime_error if the log cannot be opened or belongs to a
+ * database with another page size
+ */
+Wal::Wal(const std::filesystem::path& filename,
+         std::uint32_t page_size,
+         WalOptions options,
+         bool create)
+    : m_io(open_file_io(filename, IoBackend::pread, true))
+    , m_page_size(page_size)
+    , m_options(options)
+{
+  std::array<std::byte, HEADER_SIZE> header {};
+  if (!create && m_io->size() >= HEADER_SIZE) {
+    m_io->read(header.data(), header.size(), 0);
+  }
+  if (std::memcmp(header.data(), MAGIC.data(), MAGIC.size()) != 0
+      || load_u32(header.data() + HEADER_CHECKSUM_OFFSET)
+          != crc32c(header.data(), HEADER_CHECKSUM_OFFSET))
+  {
+    reset(1);
+    return;
+  }
+  if (load_u32(header.data() + HEADER_VERSION_OFFSET) != FORMAT_VERSION) {
+    throw std::runtime_error("Unsupported WAL format version");
+  }
+  if (load_u32(header.data() + HEADER_PAGE_SIZE_OFFSET) != page_size) {
+    throw std::runtime_error("WAL page size does not match the database");
+  }
+  m_salt = load_u32(header.data() + HEADER_SALT_OFFSET);
+  m_base = load_u64(header.data() + HEADER_BASE_OFFSET);
+  if (m_base == 0) {
+    throw std::runtime_error("Corrupt WAL header");
+  }
+  recover();
+}
+
+std::filesystem::path Wal::wal_path(const std::filesystem::path& filename)
+{
+  auto path = filename;
+  path += "-wal";
+  return path;
+}
+
+std::uint64_t Wal::frame_offset(std::uint64_t frame) const noexcept
+{
+  return HEADER_SIZE
+      + (frame - m_base.load(std::memory_order_relaxed))
+      * (FRAME_HEADER_SIZE + m_page_size);
+}
+
+std::uint64_t Wal::size() const noexcept
+{
+  // The base first: it only moves up to the last commit
+  const std::uint64_t base = m_base;
+  return HEADER_SIZE
+      + (last_commit() + 1 - base) * (FRAME_HEADER_SIZE + m_page_size);
+}
+
+/**
+ * @brief Start an empty log with a new salt, on open
+ *
+ * @param base Number of the first frame
+ * @throws std::system_error if the header cannot be written
+ */
+void Wal::reset(std::uint64_t base)
+{
+  m_io->truncate(0);
+  m_next_frame = base;
+  m_backfilled = base - 1;
+  m_indexed = base - 1;
+  m_db_pages = 0;
+  restart(false);
+}
+
+/**
+ * @brief Make the log empty, writing frames from the start again
+ *
+ * Called by the commit leader, or before the log is in use. The index is
+ * emptied first, so that readers turn to the database file, and the
+ * header is only rewritten once no reader is still reading a frame.
+ *
+ * @param truncate Whether to cut the file to its header, rather than
+ * leave the invalidated frames to be overwritten
+ * @throws std::system_error if the header cannot be written
+ */
+void Wal::restart(bool truncate)
+{
+  m_index.reset();
+  m_index.wait_for_readers();
+
+  m_salt = std::random_device {}();
+  std::array<std::byte, HEADER_SIZE> header {};
+  std::memcpy(header.data(), MAGIC.data(), MAGIC.size());
+  store_u32(header.data() + HEADER_VERSION_OFFSET, FORMAT_VERSION);
+  store_u32(header.data() + HEADER_PAGE_SIZE_OFFSET, m_page_size);
+  store_u32(header.data() + HEADER_SALT_OFFSET, m_salt);
+  store_u64(header.data() + HEADER_BASE_OFFSET, m_next_frame);
+  store_u32(header.data() + HEADER_CHECKSUM_OFFSET,
+            crc32c(header.data(), HEADER_CHECKSUM_OFFSET));
+
+  m_io->write(header.data(), header.size(), 0);
+  if (truncate) {
+    m_io->truncate(HEADER_SIZE);
+  }
+  m_io->sync();
+  m_base = m_next_frame;
+}
+
+struct Wal::ScannedSegment
+{
+  // First frame that failed validation, or the end of the segment
+  std::uint64_t end {0};
+  // Last commit marker, 0 if the segment has none
+  std::uint64_t last_commit {0};
+  std::uint32_t db_pages {0};
+  // Newest frame of each page up to the last commit marker
+  std::unordered_map<std::uint32_t, std::uint64_t> committed;
+  // Newest frame of each page after it, committed by a later segment
+  std::unordered_map<std::uint32_t, std::uint64_t> tail;
+};
+
+/**
+ * @brief Rebuild the page index by scanning the log from the first frame
+ *
+ * The log is split into segments of WalOptions::recovery_segment_frames
+ * frames, which a pool of WalOptions::recovery_threads threads reads and
+ * verifies in parallel, each into a page map of its own. The maps are then
+ * merged in log order up to the last valid commit.
+ *
+ * The log ends at the first frame that is torn, out of sequence or from an
+ * older log; segments past one are not scanned further. Frames after the
+ * last commit marker belong to a commit that never finished. They are cut
+ * off, so that a later, shorter append cannot be followed by intact frames
+ * of the abandoned commit. So are frames a restart left behind.
+ *
+ * @throws std::system_error if a read fails
+ */
+void Wal::recover()
+{
+  const std::size_t frame_size = FRAME_HEADER_SIZE + m_page_size;
+  const std::uint64_t size = m_io->size();
+  const std::uint64_t base = m_base;
+  const std::uint64_t end = base + (size - HEADER_SIZE) / frame_size;
+  const std::uint64_t segment_frames =
+      std::max<std::uint64_t>(1, m_options.recovery_segment_frames);
+  const auto segment_count =
+      static_cast<std::size_t>((end - base + segment_frames - 1)
+                               / segment_frames);
+  std::vector<ScannedSegment> segments(segment_count);
+
+  std::atomic<std::size_t> next {0};
+  std::atomic<std::uint64_t> invalid_from {end};
+  std::mutex error_latch;
+  std::exception_ptr error;
+  const auto scan = [&]
+  {
+    try {
+      for (std::size_t i = next++; i < segment_count; i = next++) {
+        const std::uint64_t first = base + i * segment_frames;
+        scan_segment(first,
+                     std::min(end, first + segment_frames),
+                     segments[i],
+                     invalid_from);
+      }
+    } catch (...) {
+      std::lock_guard lock(error_latch);
+      error = std::current_exception();
+      invalid_from = base;
+    }
+  };
+
+  const unsigned threads = static_cast<unsigned>(std::min<std::size_t>(
+      m_options.recovery_threads != 0
+          ? m_options.recovery_threads
+          : std::max(1U, std::thread::hardware_concurrency()),
+      segment_count));
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; t++) {
+    pool.emplace_back(scan);
+  }
+  scan();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  // Frames before the log's first were copied into the database file
+  std::uint64_t last_commit = base - 1;
+  m_backfilled = last_commit;
+  std::size_t last_segment = 0;
+  for (std::size_t i = 0; i < segment_count; i++) {
+    if (segments[i].last_commit != 0) {
+      last_segment = i;
+      last_commit = segments[i].last_commit;
+      m_db_pages = segments[i].db_pages;
+    }
+    if (segments[i].end != std::min(end, base + (i + 1) * segment_frames)) {
+      break;
+    }
+  }
+
+  if (last_commit >= base) {
+    std::unordered_map<std::uint32_t, std::uint64_t> newest;
+    for (std::size_t i = 0; i <= last_segment; i++) {
+      for (const auto& [page, frame] : segments[i].committed) {
+        newest[page] = frame;
+      }
+      if (i < last_segment) {
+        for (const auto& [page, frame] : segments[i].tail) {
+          newest[page] = frame;
+        }
+      }
+    }
+    // Only the newest frame of a page is indexed: no reader is older
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> frames;
+    frames.reserve(newest.size());
+    for (const auto& [page, frame] : newest) {
+      frames.emplace_back(frame, page);
+    }
+    std::sort(frames.begin(), frames.end());
+    for (const auto& [frame, page] : frames) {
+      m_index.append(page, frame);
+    }
+  }
+  m_index.publish(last_commit);
+  m_indexed = last_commit;
+  m_next_frame = last_commit + 1;
+  if (size > frame_offset(m_next_frame)) {
+    m_io->truncate(frame_offset(m_next_frame));
+    m_io->sync();
+  }
+}
+
+/**
+ * @brief Verify the frames of one segment of the log and map its pages
+ *
+ * Stops at the first invalid frame, and gives up once another segment
+ * found one earlier in the log, past which nothing counts.
+ *
+ * @param first First frame of the segment
+ * @param end One past its last frame
+ * @param segment Receives what the scan found
+ * @param invalid_from First invalid frame found by any segment so far
+ */
+void Wal::scan_segment(std::uint64_t first,
+                       std::uint64_t end,
+                       ScannedSegment& segment,
+                       std::atomic<std::uint64_t>& invalid_from)
+{
+  const std::size_t frame_size = FRAME_HEADER_SIZE + m_page_size;
+  std::vector<std::byte> chunk(
+      static_cast<std::size_t>(std::min<std::uint64_t>(RECOVERY_CHUNK,
+                                                       end - first))
+      * frame_size);
+
+  std::uint64_t frame = first;
+  segment.end = end;
+  while (frame < end) {
+    if (frame >= invalid_from) {
+      segment.end = frame;
+      return;
+    }
+    const auto count = static_cast<std::size_t>(
+        std::min<std::uint64_t>(RECOVERY_CHUNK, end - frame));
+    m_io->read(chunk.data(), count * frame_size, frame_offset(frame));
+
+    for (std::size_t i = 0; i < count; i++, frame++) {
+      const std::byte* src = chunk.data() + i * frame_size;
+      if (load_u64(src + FRAME_NUMBER_OFFSET) != frame
+          || load_u32(src + FRAME_SALT_OFFSET) != m_salt
+          || load_u32(src + FRAME_CHECKSUM_OFFSET)
+              != frame_checksum(src, m_page_size))
+      {
+        segment.end = frame;
+        std::uint64_t current = invalid_from;
+        while (frame < current
+               && !invalid_from.compare_exchange_weak(current, frame))
+        {
+        }
+        return;
+      }
+      segment.tail[load_u32(src + FRAME_PAGE_OFFSET)] = frame;
+      const std::uint32_t db_pages = load_u32(src + FRAME_COMMIT_OFFSET);
+      if (db_pages != 0) {
+        for (const auto& [page, page_frame] : segment.tail) {
+          segment.committed[page] = page_frame;
+        }
+        segment.tail.clear();
+        segment.last_commit = frame;
+        segment.db_pages = db_pages;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Append a transaction to the log and wait until it is durable
+ *
+ * The calling thread either leads a group commit or waits for the leader
+ * whose batch picked its pages up. Pages spilled before the commit become
+ * part of it.
+ *
+ * @param pages Page images of the transaction, written in this order
+ * @param db_pages Pages in the database once the transaction is applied
+ * @return std::uint64_t Frame number of the commit marker, or of the last
+ * commit if pages is empty
+ * @throws std::invalid_argument if db_pages is 0
+ * @throws std::system_error if the append or the sync fails
+ * @throws std::runtime_error if an earlier append failed
+ */
+std::uint64_t Wal::commit(const std::vector<WalPage>& pages,
+                          std::uint32_t db_pages)
+{
+  if (pages.empty()) {
+    return last_commit();
+  }
+  if (db_pages == 0) {
+    throw std::invalid_argument("A commit must record the database size");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const std::uint64_t frame = enqueue(pages, db_pages);
+  m_commit_latency.record(nanoseconds_since(start));
+  return frame;
+}
+
+/**
+ * @brief Append pages of a transaction that has not committed yet
+ *
+ * The frames go through the commit queue like a commit, but the last one
+ * carries no commit marker and the append is not synced unless a commit
+ * shares the batch. Snapshots do not see them and recovery ignores them
+ * until a later commit is appended behind them, which then covers them
+ * too. read_spilled() finds them meanwhile.
+ *
+ * @param pages Page images, written in this order
+ * @throws std::system_error if the append fails
+ * @throws std::runtime_error if an earlier append failed
+ */
+void Wal::spill(const std::vector<WalPage>& pages)
+{
+  if (!pages.empty()) {
+    enqueue(pages, 0);
+  }
+}
+
+// Queue pages for the next group commit and wait until they are appended
+std::uint64_t Wal::enqueue(const std::vector<WalPage>& pages,
+                           std::uint32_t db_pages)
+{
+  Commit commit {&pages, db_pages};
+  {
+    std::unique_lock lock(m_commit_latch);
+    m_queue.push_back(&commit);
+    m_queued_frames += pages.size();
+    // A leader waiting for its batch to fill counts the new frames
+    m_commit_done.notify_all();
+    while (!commit.done) {
+      if (m_leading) {
+        m_commit_done.wait(lock);
+      } else {
+        lead(lock);
+      }
+    }
+  }
+  if (commit.error) {
+    std::rethrow_exception(commit.error);
+  }
+  return commit.frame;
+}
+
+/**
+ * @brief Take every queued commit and append it as one batch
+ *
+ * Called with m_commit_latch held; it is released while waiting for the
+ * batch to fill and during the I/O.
+ */
+void Wal::lead(std::unique_lock<std::mutex>& lock)
+{
+  m_leading = true;
+  if (m_options.max_commit_delay.count() > 0) {
+    m_commit_done.wait_for(lock,
+                           m_options.max_commit_delay,
+                           [this]
+                           {
+                             return m_queued_frames
+                                 >= m_options.max_batch_frames;
+                           });
+  }
+
+  std::vector<Commit*> batch;
+  batch.swap(m_queue);
+  const std::uint64_t first = m_next_frame;
+  m_next_frame += m_queued_frames;
+  m_queued_frames = 0;
+
+  std::exception_ptr error;
+  if (m_failed) {
+    error = std::make_exception_ptr(
+        std::runtime_error("WAL is unusable after a failed commit"));
+  } else {
+    lock.unlock();
+    try {
+      append(batch, first);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    m_failed = error != nullptr;
+  }
+
+  for (Commit* commit : batch) {
+    commit->error = error;
+    commit->done = true;
+  }
+  m_leading = false;
+  m_commit_done.notify_all();
+}
+
+/**
+ * @brief Write a batch of commits with one append and one sync, then
+ * publish them to readers
+ *
+ * Spilled pages in the batch are indexed but only published with a commit
+ * behind them; a batch of nothing else is not synced.
+ *
+ * @param batch Commits in queue order
+ * @param first Frame number of the first frame of the batch
+ */
+void Wal::append(const std::vector<Commit*>& batch, std::uint64_t first)
+{
+  const std::size_t frame_size = FRAME_HEADER_SIZE + m_page_size;
+  std::size_t frames = 0;
+  std::size_t commits = 0;
+  for (const Commit* commit : batch) {
+    frames += commit->pages->size();
+    commits += commit->db_pages != 0 ? 1 : 0;
+  }
+
+  std::vector<std::byte> out(frames * frame_size);
+  std::uint64_t frame = first;
+  std::uint64_t last_commit = 0;
+  std::uint32_t db_pages = 0;
+  for (Commit* commit : batch) {
+    const auto& pages = *commit->pages;
+    for (std::size_t i = 0; i < pages.size(); i++, frame++) {
+      std::byte* dst = out.data() + (frame - first) * frame_size;
+      const bool last = i + 1 == pages.size();
+      store_u32(dst + FRAME_PAGE_OFFSET, pages[i].page_number);
+      store_u32(dst + FRAME_COMMIT_OFFSET, last ? commit->db_pages : 0);
+      store_u64(dst + FRAME_NUMBER_OFFSET, frame);
+      store_u32(dst + FRAME_SALT_OFFSET, m_salt);
+      std::memcpy(dst + FRAME_HEADER_SIZE, pages[i].data, m_page_size);
+      store_u32(dst + FRAME_CHECKSUM_OFFSET, frame_checksum(dst, m_page_size));
+    }
+    commit->frame = frame - 1;
+    if (commit->db_pages != 0) {
+      last_commit = commit->frame;
+      db_pages = commit->db_pages;
+    }
+  }
+
+  m_io->write(out.data(), out.size(), frame_offset(first));
+  if (commits != 0) {
+    m_io->sync();
+  }
+
+  // Readers see the frames once the whole batch is durable
+
+  frame = first;
+  for (const Commit* commit : batch) {
+    for (const WalPage& page : *commit->pages) {
+      m_index.append(page.page_number, frame++);
+    }
+  }
+  m_indexed = frame - 1;
+  if (commits != 0) {
+    m_db_pages = db_pages;
+    m_index.publish(last_commit);
+  }
+
+  m_commits.fetch_add(commits, std::memory_order_relaxed);
+  m_frames.fetch_add(frames, std::memory_order_relaxed);
+  m_syncs.fetch_add(commits != 0 ? 1 : 0, std::memory_order_relaxed);
+  m_bytes_written.fetch_add(out.size(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Read the newest committed image of a page
+ *
+ * @param page_number Page to look up
+ * @param dst Destination of page size bytes
+ * @return bool False if no commit in the log holds the page
+ * @throws std::system_error if the read fails
+ */
+bool Wal::read_page(std::uint32_t page_number, std::byte* dst)
+{
+  return read_page(page_number, m_index.snapshot(), dst);
+}
+
+/**
+ * @brief Read the image of a page as of a snapshot
+ *
+ * Frames committed after the snapshot was taken are not seen. No lock is
+ * taken, so readers never wait for a commit in progress.
+ *
+ * @param page_number Page to look up
+ * @param snapshot Snapshot taken from this log
+ * @param dst Destination of page size bytes
+ * @return bool False if no commit visible to the snapshot holds the page
+ * @throws std::system_error if the read fails
+ */
+bool Wal::read_page(std::uint32_t page_number,
+                    const WalSnapshot& snapshot,
+                    std::byte* dst)
+{
+  // A restart waits for the read before the frame can be overwritten
+  const WalIndex::Pin pin(m_index, snapshot);
+  const std::uint64_t frame = m_index.lookup(page_number, snapshot);
+  if (frame == 0) {
+    return false;
+  }
+  m_io->read(dst, m_page_size, frame_offset(frame) + FRAME_HEADER_SIZE);
+  return true;
+}
+
+/**
+ * @brief Read the newest image of a page, spilled or committed
+ *
+ * For the writer reloading a page it spilled: past the last commit, every
+ * frame in the log is one of its own.
+ *
+ * @param page_number Page to look up
+ * @param snapshot Snapshot taken from this log, pinning the index
+ * @param dst Destination of page size bytes
+ * @return bool False if the log holds no image of the page
+ * @throws std::system_error if the read fails
+ */
+bool Wal::read_spilled(std::uint32_t page_number,
+                       const WalSnapshot& snapshot,
+                       std::byte* dst)
+{
+  const WalIndex::Pin pin(m_index, snapshot);
+  const std::uint64_t frame =
+      m_index.lookup(page_number, snapshot, m_indexed.load());
+  if (frame == 0) {
+    return false;
+  }
+  m_io->read(dst, m_page_size, frame_offset(frame) + FRAME_HEADER_SIZE);
+  return true;
+}
+
+/**
+ * @brief List the frames a checkpoint copies into the database file
+ *
+ * @param snapshot Snapshot held by the checkpoint
+ * @param limit Newest commit to copy; no reader may see an older one
+ * @return Newest frame up to limit of every page changed since the last
+ * checkpoint, in page number order
+ */
+std::vector<std::pair<std::uint32_t, std::uint64_t>> Wal::checkpoint_frames(
+    const WalSnapshot& snapshot, std::uint64_t limit) const
+{
+  return m_index.frames_between(snapshot, m_backfilled, limit);
+}
+
+/**
+ * @brief Read the page images of committed frames with one batched read
+ *
+ * Only for frames a restart cannot overwrite meanwhile: those of the
+ * checkpoint in progress.
+ *
+ * @param frames Frame numbers
+ * @param dst Destination of one page size per frame
+ * @throws std::system_error if the read fails
+ */
+void Wal::read_frames(const std::vector<std::uint64_t>& frames,
+                      std::byte* dst)
+{
+  std::vector<IoRequest> requests;
+  requests.reserve(frames.size());
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    requests.push_back(IoRequest {dst + i * m_page_size,
+                                  m_page_size,
+                                  frame_offset(frames[i]) + FRAME_HEADER_SIZE});
+  }
+  m_io->read_batch(requests);
+}
+
+/**
+ * @brief Record that a checkpoint copied the frames up to limit, and
+ * restart the log if nothing in it is needed any more
+ *
+ * The log restarts once every commit is copied, no reader sees an older
+ * one than the last and no spilled frame waits for a commit. The restart
+ * holds off commits like a leader would.
+ *
+ * @param limit Newest commit the checkpoint copied, durably
+ * @param size_limit A log file larger than this is truncated on restart
+ * @return bool Whether the log restarted
+ * @throws std::system_error if the restart fails; the log is then
+ * unusable, as after a failed commit
+ */
+bool Wal::finish_checkpoint(std::uint64_t limit, std::uint64_t size_limit)
+{
+  if (limit > m_backfilled) {
+    m_backfilled = limit;
+  }
+
+  std::unique_lock lock(m_commit_latch);
+  m_commit_done.wait(lock, [this] { return !m_leading; });
+  const std::uint64_t last = last_commit();
+  if (m_failed || last < m_base || m_backfilled != last
+      || oldest_snapshot() < last || m_indexed != last)
+  {
+    return false;
+  }
+
+  m_leading = true;
+  lock.unlock();
+  std::exception_ptr error;
+  try {
+    restart(m_io->size() > size_limit);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+  m_failed = error != nullptr;
+  m_leading = false;
+  m_commit_done.notify_all();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  m_restarts.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+WalStats Wal::stats() const noexcept
+{
+  WalStats stats;
+  stats.commits = m_commits.load(std::memory_order_relaxed);
+  stats.frames = m_frames.load(std::memory_order_relaxed);
+  stats.syncs = m_syncs.load(std::memory_order_relaxed);
+  stats.bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+  stats.restarts = m_restarts.load(std::memory_order_relaxed);
+  stats.size = size();
+  stats.commit_latency = m_commit_latency.snapshot();
+  return stats;
+}
@@ -0,0 +1,204 @@
+#ifndef WAL_HPP
+#define WAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "file_io.hpp"
+#include "pager_stats.hpp"
+#include "wal_index.hpp"
+
+struct WalOptions
+{
+  // Longest a commit leader waits for more commits to join its batch
+  std::chrono::microseconds max_commit_delay {0};
+  // The leader stops waiting once this many frames are queued
+  std::size_t max_batch_frames {1024};
+  // Threads scanning the log on open; 0 uses one per core
+  unsigned recovery_threads {0};
+  // Frames scanned per recovery task
+  std::size_t recovery_segment_frames {4096};
+};
+
+// A page image to commit; the bytes must stay valid during the commit
+struct WalPage
+{
+  std::uint32_t page_number;
+  const std::byte* data;
+};
+
+/**
+ * @brief Write-ahead log of page images, next to the database file
+ *
+ * Layout (little-endian): a 32-byte header, then the frames in order.
+ *
+ *   header  offset  size  field
+ *                0     8  magic "DIY-WAL"
+ *                8     4  format version
+ *               12     4  page size
+ *               16     4  salt, new for every fresh log
+ *               20     8  number of the first frame
+ *               28     4  CRC-32C of bytes 0-27
+ *
+ *   frame   offset  size  field
+ *                0     4  page number
+ *                4     4  pages in the database after the commit, on the
+ *                         last frame of a commit; 0 on the others
+ *                8     8  frame number
+ *               16     4  salt of the log
+ *               20     4  CRC-32C of bytes 0-19 and the page image
+ *               24        page image
+ *
+ * Frames are only ever appended. A commit is its frames in order, the
+ * last one marked; it counts once the marked frame is durable. On open the
+ * log is scanned and frames past the last valid commit are ignored, as is
+ * anything from an older log, which carries another salt. The scan is
+ * split into segments verified in parallel, see recover().
+ *
+ * commit() is group commit: committing threads queue their pages and one
+ * of them, the leader, writes everything queued with a single append and
+ * a single fdatasync, then wakes the others. A leader may wait up to
+ * WalOptions::max_commit_delay for more commits to join its batch.
+ *
+ * spill() appends the pages of a transaction still in progress, without a
+ * commit marker and without a sync. Readers do not see them, recovery
+ * drops them, and the next commit takes them in. The log does not restart
+ * while spilled frames wait for their commit.
+ *
+ * Readers find frames through a WalIndex without taking a lock. A reader
+ * wanting a stable view of several pages holds a snapshot() and passes it
+ * to read_page().
+ *
+ * A checkpoint copies frames back into the database file, see
+ * Pager::checkpoint(). Once every commit is copied and no reader needs an
+ * older one, the log restarts: a new header with a new salt invalidates
+ * the frames, which later commits overwrite from the start. Frame numbers
+ * keep counting, so that snapshots stay comparable.
+ *
+ * All calls may be made from several threads at once.
+ */
+class Wal
+{
+public:
+  // create starts a fresh log, discarding one left behind
+  Wal(const std::filesystem::path& filename,
+      std::uint32_t page_size,
+      WalOptions options,
+      bool create);  // Can throw runtime_error
+
+  // Durably append one transaction; returns the frame number of its commit
+  std::uint64_t commit(const std::vector<WalPage>& pages,
+                       std::uint32_t db_pages);
+  // Append pages of a transaction in progress, for the next commit to cover
+  void spill(const std::vector<WalPage>& pages);
+  // Copy the newest committed image of a page; false if the log has none
+  bool read_page(std::uint32_t page_number, std::byte* dst);
+  // Same, as of a snapshot; false if the snapshot sees no image in the log
+  bool read_page(std::uint32_t page_number,
+                 const WalSnapshot& snapshot,
+                 std::byte* dst);
+  // Same, also seeing pages spilled since the last commit
+  bool read_spilled(std::uint32_t page_number,
+                    const WalSnapshot& snapshot,
+                    std::byte* dst);
+  // Pin the commits made so far for a read transaction
+  WalSnapshot snapshot() const { return m_index.snapshot(); }
+
+  // Checkpointing: the frames to copy, up to a commit no reader is behind
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> checkpoint_frames(
+      const WalSnapshot& snapshot, std::uint64_t limit) const;
+  // Copy the images of frames to dst, one page each
+  void read_frames(const std::vector<std::uint64_t>& frames, std::byte* dst);
+  // Record the frames up to limit as copied; restarts the log when possible
+  bool finish_checkpoint(std::uint64_t limit, std::uint64_t size_limit);
+
+  std::uint64_t last_commit() const noexcept
+  {
+    return m_index.global_sequence();
+  }
+  // Whether spilled frames wait for a commit
+  bool has_spilled() const noexcept { return m_indexed != last_commit(); }
+  // Last frame copied into the database file
+  std::uint64_t backfilled() const noexcept { return m_backfilled; }
+  // Oldest commit a reader may see, last_commit() if there is no reader
+  std::uint64_t oldest_snapshot() const noexcept
+  {
+    return m_index.oldest_snapshot();
+  }
+  // Database size recorded by the last commit, 0 before the first
+  std::uint32_t db_pages() const noexcept { return m_db_pages; }
+  // Bytes of the log up to the last commit
+  std::uint64_t size() const noexcept;
+  WalStats stats() const noexcept;
+
+  // Log of a database file: its name followed by "-wal"
+  static std::filesystem::path wal_path(const std::filesystem::path& filename);
+
+private:
+  // A commit waiting in the queue; lives on the committing thread's stack
+  struct Commit
+  {
+    const std::vector<WalPage>* pages;
+    std::uint32_t db_pages;  // 0 for spilled pages: no commit marker
+    std::uint64_t frame {0};
+    std::exception_ptr error {};
+    bool done {false};
+  };
+
+  std::unique_ptr<FileIo> m_io;
+  std::uint32_t m_page_size;
+  WalOptions m_options;
+  std::uint32_t m_salt {0};
+  // Number of the first frame in the log; changes on restart
+  std::atomic<std::uint64_t> m_base {1};
+
+  // Guards the queue, the leader flag and frame numbering
+  std::mutex m_commit_latch;
+  std::condition_variable m_commit_done;
+  std::vector<Commit*> m_queue;
+  std::size_t m_queued_frames {0};
+  bool m_leading {false};
+  // A failed append leaves the tail unknown; later commits are refused
+  bool m_failed {false};
+  std::uint64_t m_next_frame {1};
+
+  // Committed frames of every page; written by the leader only
+  WalIndex m_index;
+  // Last frame indexed; past last_commit() while spilled frames wait
+  std::atomic<std::uint64_t> m_indexed {0};
+  std::atomic<std::uint32_t> m_db_pages {0};
+  std::atomic<std::uint64_t> m_backfilled {0};
+
+  std::atomic<std::uint64_t> m_commits {0};
+  std::atomic<std::uint64_t> m_frames {0};
+  std::atomic<std::uint64_t> m_syncs {0};
+  std::atomic<std::uint64_t> m_bytes_written {0};
+  std::atomic<std::uint64_t> m_restarts {0};
+  LatencyHistogram m_commit_latency;
+
+  // What recovery found in one segment of the log
+  struct ScannedSegment;
+
+  std::uint64_t frame_offset(std::uint64_t frame) const noexcept;
+  void reset(std::uint64_t base);
+  void restart(bool truncate);
+  void recover();
+  void scan_segment(std::uint64_t first,
+                    std::uint64_t end,
+                    ScannedSegment& segment,
+                    std::atomic<std::uint64_t>& invalid_from);
+  std::uint64_t enqueue(const std::vector<WalPage>& pages,
+                        std::uint32_t db_pages);
+  void lead(std::unique_lock<std::mutex>& lock);
+  void append(const std::vector<Commit*>& batch, std::uint64_t first);
+};
+
+#endif  // WAL_HPP
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#include "wal_index.hpp"
+
+namespace
+{
+// Fibonacci hashing spreads consecutive page numbers over the table
+constexpr std::uint32_t HASH_MULTIPLIER = 2654435761U;
+
+std::size_t first_probe(std::uint32_t page_number, std::size_t slots) noexcept
+{
+  return static_cast<std::size_t>(page_number * HASH_MULTIPLIER) & (slots - 1);
+}
+}  // namespace
+
+WalSnapshot::WalSnapshot(const WalIndex* index,
+                         std::size_t slot,
+                         std::uint64_t sequence) noexcept
+    : m_index(index)
+    , m_slot(slot)
+    , m_sequence(sequence)
+{
+}
+
+WalSnapshot::~WalSnapshot()
+{
+  if (m_index != nullptr) {
+    m_index->release(m_slot);
+  }
+}
+
+WalSnapshot::WalSnapshot(WalSnapshot&& other) noexcept
+    : m_index(std::exchange(other.m_index, nullptr))
+    , m_slot(other.m_slot)
+    , m_sequence(other.m_sequence)
+{
+}
+
+WalSnapshot& WalSnapshot::operator=(WalSnapshot&& other) noexcept
+{
+  if (this != &other) {
+    if (m_index != nullptr) {
+      m_index->release(m_slot);
+    }
+    m_index = std::exchange(other.m_index, nullptr);
+    m_slot = other.m_slot;
+    m_sequence = other.m_sequence;
+  }
+  return *this;
+}
+
+// Snapshots must not outlive the index
+WalIndex::~WalIndex()
+{
+  free_chain(m_newest.load(std::memory_order_relaxed));
+  for (const Retired& retired : m_retired) {
+    free_chain(retired.segments);
+  }
+}
+
+void WalIndex::free_chain(Segment* segment) noexcept
+{
+  while (segment != nullptr) {
+    delete std::exchange(segment, segment->older);
+  }
+}
+
+/**
+ * @brief Index a frame, opening a new segment when the newest is full
+ *
+ * The frame stays invisible to readers until a publish() covers it.
+ *
+ * @param page_number Page the frame holds
+ * @param frame Frame number, larger than any indexed before
+ */
+void WalIndex::append(std::uint32_t page_number, std::uint64_t frame)
+{
+  Segment* newest = m_newest.load(std::memory_order_relaxed);
+  if (newest == nullptr || frame - newest->first_frame >= SEGMENT_FRAMES) {
+    newest = new Segment(frame, newest);
+    m_newest.store(newest, std::memory_order_release);
+    m_segment_count.fetch_add(1, std::memory_order_relaxed);
+    reclaim();
+  }
+
+  const std::uint64_t entry =
+      (std::uint64_t {page_number} << 32U) | (frame - newest->first_frame + 1);
+  std::size_t slot = first_probe(page_number, SEGMENT_SLOTS);
+  // At most SEGMENT_FRAMES of the slots are ever used, so one is empty
+  while (newest->slots[slot].load(std::memory_order_relaxed) != 0) {
+    slot = (slot + 1) & (SEGMENT_SLOTS - 1);
+  }
+  newest->slots[slot].store(entry, std::memory_order_release);
+}
+
+void WalIndex::publish(std::uint64_t commit_frame) noexcept
+{
+  m_sequence.store(commit_frame);
+}
+
+/**
+ * @brief Unlink every segment and retire it in the current epoch
+ *
+ * Readers registered from now on enter the next epoch and cannot reach the
+ * retired segments. The global sequence is kept.
+ */
+void WalIndex::reset()
+{
+  Segment* old = m_newest.exchange(nullptr);
+  m_segment_count.store(0, std::memory_order_relaxed);
+  if (old != nullptr) {
+    m_retired.push_back({m_epoch.fetch_add(1), old});
+  }
+  reclaim();
+}
+
+// Free the retired segments no reader can still be walking
+void WalIndex::reclaim()
+{
+  if (m_retired.empty()) {
+    return;
+  }
+  const std::uint64_t oldest = oldest_epoch();
+  auto done = std::partition(m_retired.begin(),
+                             m_retired.end(),
+                             [oldest](const Retired& retired)
+                             { return retired.epoch >= oldest; });
+  std::for_each(done,
+                m_retired.end(),
+                [](const Retired& retired) { free_chain(retired.segments); });
+  m_retired.erase(done, m_retired.end());
+}
+
+/**
+ * @brief Wait for the reads pinned before the call to end
+ *
+ * Snapshots held between reads do not delay it.
+ */
+void WalIndex::wait_for_readers()
+{
+  const std::uint64_t epoch = m_epoch.fetch_add(1);
+  while (oldest_epoch() <= epoch) {
+    std::this_thread::yield();
+  }
+}
+
+std::uint64_t WalIndex::oldest_epoch() const noexcept
+{
+  std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+  for (const ReaderSlot& reader : m_readers) {
+    const std::uint64_t epoch = reader.epoch.load();
+    if (epoch != 0) {
+      oldest = std::min(oldest, epoch);
+    }
+  }
+  return oldest;
+}
+
+/**
+ * @brief Register a reader and record the sequence it sees
+ *
+ * Claims a free reader slot, starting from the one this thread used last.
+ * Yields while all MAX_READERS slots are taken.
+ */
+WalSnapshot WalIndex::snapshot() const
+{
+  thread_local std::size_t hint =
+      std::hash<std::thread::id> {}(std::this_thread::get_id()) % MAX_READERS;
+
+  for (;;) {
+    for (std::size_t i = 0; i < MAX_READERS; i++) {
+      const std::size_t slot = (hint + i) % MAX_READERS;
+      std::uint64_t expected = FREE;
+      if (m_readers[slot].sequence.compare_exchange_strong(expected, PENDING))
+      {
+        hint = slot;
+        const std::uint64_t sequence = m_sequence.load();
+        m_readers[slot].sequence.store(sequence);
+        return WalSnapshot(this, slot, sequence);
+      }
+    }
+    std::this_thread::yield();
+  }
+}
+
+void WalIndex::release(std::size_t slot) const noexcept
+{
+  m_readers[slot].sequence.store(FREE);
+}
+
+WalIndex::Pin::Pin(const WalIndex& index, const WalSnapshot& snapshot) noexcept
+{
+  if (!snapshot) {
+    return;
+  }
+  auto& epoch = index.m_readers[snapshot.m_slot].epoch;
+  // Only the snapshot's thread pins its slot
+  if (epoch.load(std::memory_order_relaxed) == 0) {
+    epoch.store(index.m_epoch.load());
+    m_index = &index;
+    m_slot = snapshot.m_slot;
+  }
+}
+
+WalIndex::Pin::~Pin()
+{
+  if (m_index != nullptr) {
+    m_index->m_readers[m_slot].epoch.store(0);
+  }
+}
+
+std::uint64_t WalIndex::lookup(std::uint32_t page_number,
+                               const WalSnapshot& snapshot) const noexcept
+{
+  return lookup(page_number, snapshot, snapshot.sequence());
+}
+
+/**
+ * @brief Find the newest frame of a page up to a limit
+ *
+ * Segments opened after the limit are skipped whole. Slots of the newest
+ * segment may fill while the lookup probes them; any frame found past the
+ * limit is ignored. The snapshot only pins the index for the lookup.
+ *
+ * @param page_number Page to look up
+ * @param snapshot A snapshot taken from this index
+ * @param limit Newest frame to consider, usually the snapshot's sequence
+ * @return std::uint64_t Frame number, or 0 if the page has no visible frame
+ */
+std::uint64_t WalIndex::lookup(std::uint32_t page_number,
+                               const WalSnapshot& snapshot,
+                               std::uint64_t limit) const noexcept
+{
+  if (!snapshot) {
+    return 0;
+  }
+  const Pin pin(*this, snapshot);
+  const Segment* segment = m_newest.load(std::memory_order_acquire);
+  for (; segment != nullptr; segment = segment->older) {
+    if (segment->first_frame > limit) {
+      continue;
+    }
+    std::uint64_t found = 0;
+    std::size_t slot = first_probe(page_number, SEGMENT_SLOTS);
+    for (;;) {
+      const std::uint64_t entry =
+          segment->slots[slot].load(std::memory_order_acquire);
+      if (entry == 0) {
+        break;
+      }
+      if (entry >> 32U == page_number) {
+        const std::uint64_t frame =
+            segment->first_frame + (entry & 0xFFFFFFFFU) - 1;
+        if (frame <= limit) {
+          found = std::max(found, frame);
+        }
+      }
+      slot = (slot + 1) & (SEGMENT_SLOTS - 1);
+    }
+    if (found != 0) {
+      return found;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Smallest sequence a registered reader may see
+ *
+ * The global sequence is read first, so a reader registering meanwhile sees
+ * at least it. A reader that has not recorded its sequence yet counts as 0.
+ */
+std::uint64_t WalIndex::oldest_snapshot() const noexcept
+{
+  std::uint64_t oldest = m_sequence.load();
+  for (const ReaderSlot& reader : m_readers) {
+    oldest = std::min(oldest, reader.sequence.load());
+  }
+  return oldest;
+}
+
+/**
+ * @brief Collect the frames a checkpoint copies into the database file
+ *
+ * Segments holding only frames up to `after` are not visited.
+ *
+ * @param snapshot A snapshot taken from this index
+ * @param after Frames up to this one are ignored
+ * @param limit Newest frame to consider, at most the snapshot's sequence
+ * @return Page number and newest frame of every page found
+ */
+std::vector<std::pair<std::uint32_t, std::uint64_t>> WalIndex::frames_between(
+    const WalSnapshot& snapshot, std::uint64_t after, std::uint64_t limit) const
+{
+  std::unordered_map<std::uint32_t, std::uint64_t> newest;
+  const Pin pin(*this, snapshot);
+  // One past the last frame of the segment being visited
+  std::uint64_t end = FREE;
+  const Segment* segment = m_newest.load(std::memory_order_acquire);
+  for (; segment != nullptr && end - 1 > after; segment = segment->older) {
+    for (const auto& slot : segment->slots) {
+      const std::uint64_t entry = slot.load(std::memory_order_acquire);
+      const std::uint64_t frame =
+          segment->first_frame + (entry & 0xFFFFFFFFU) - 1;
+      if (entry != 0 && frame > after && frame <= limit) {
+        auto& found = newest[static_cast<std::uint32_t>(entry >> 32U)];
+        found = std::max(found, frame);
+      }
+    }
+    end = segment->first_frame;
+  }
+
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> frames(newest.begin(),
+                                                               newest.end());
+  std::sort(frames.begin(), frames.end());
+  return frames;
+}
+
+std::size_t WalIndex::segments() const noexcept
+{
+  return m_segment_count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,192 @@
+#ifndef WAL_INDEX_HPP
+#define WAL_INDEX_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+class WalIndex;
+
+/**
+ * @brief Registration of a reader with a WalIndex
+ *
+ * Holds the committed sequence the reader sees. Readers that want a
+ * consistent view across several pages keep one for the whole read
+ * transaction. A snapshot is used by one thread at a time.
+ */
+class WalSnapshot
+{
+public:
+  WalSnapshot() noexcept = default;
+  ~WalSnapshot();
+
+  WalSnapshot(const WalSnapshot&) = delete;
+  WalSnapshot& operator=(const WalSnapshot&) = delete;
+
+  WalSnapshot(WalSnapshot&& other) noexcept;
+  WalSnapshot& operator=(WalSnapshot&& other) noexcept;
+
+  // Frame number of the last commit visible to the reader
+  std::uint64_t sequence() const noexcept { return m_sequence; }
+
+  explicit operator bool() const noexcept { return m_index != nullptr; }
+
+private:
+  friend class WalIndex;
+
+  WalSnapshot(const WalIndex* index,
+              std::size_t slot,
+              std::uint64_t sequence) noexcept;
+
+  const WalIndex* m_index {nullptr};
+  std::size_t m_slot {0};
+  std::uint64_t m_sequence {0};
+};
+
+/**
+ * @brief Page number to newest frame map of a write-ahead log
+ *
+ * Frames are indexed in segments of SEGMENT_FRAMES consecutive frames.
+ * Each segment is an open-addressed hash table with twice as many slots as
+ * frames, linked from newest to oldest. The one writer fills empty slots
+ * with single atomic stores and links a new segment in when the newest is
+ * full; slots and links are never changed afterwards. Frames become
+ * visible by raising the global sequence with publish().
+ *
+ * Readers take no lock. A lookup walks the segments from the newest and
+ * returns the newest frame of the page no later than the reader's
+ * snapshot, ignoring frames indexed after the snapshot was taken.
+ *
+ * Every snapshot holds one of MAX_READERS reader slots, which records
+ * its sequence for oldest_snapshot(). reset() unlinks every segment when
+ * the log starts over. Segments are freed by epoch-based reclamation: a
+ * reader publishes in its slot the epoch it entered its current read in,
+ * see Pin, and a retired segment is freed once no read is left in the
+ * epoch it was retired in.
+ *
+ * Frame numbers must keep increasing across resets, so that sequences
+ * stay comparable.
+ */
+class WalIndex
+{
+public:
+  static constexpr std::size_t SEGMENT_FRAMES = 4096;
+  static constexpr std::size_t MAX_READERS = 128;
+
+  WalIndex() = default;
+  ~WalIndex();
+
+  WalIndex(const WalIndex&) = delete;
+  WalIndex& operator=(const WalIndex&) = delete;
+  WalIndex(WalIndex&&) = delete;
+  WalIndex& operator=(WalIndex&&) = delete;
+
+  // Writer: index a frame; frames arrive in increasing order
+  void append(std::uint32_t page_number, std::uint64_t frame);
+  // Writer: make frames up to commit_frame visible to new snapshots
+  void publish(std::uint64_t commit_frame) noexcept;
+  // Writer: forget every frame; memory is freed once readers move on
+  void reset();
+  // Writer: wait until every read pinned before the call has ended
+  void wait_for_readers();
+
+  /**
+   * @brief One read by the holder of a snapshot
+   *
+   * While pinned, index memory stays allocated and wait_for_readers()
+   * waits, so that a reader can go on using a frame it found. Lookups pin
+   * themselves; a pin taken around them extends theirs.
+   */
+  class Pin
+  {
+  public:
+    Pin(const WalIndex& index, const WalSnapshot& snapshot) noexcept;
+    ~Pin();
+
+    Pin(const Pin&) = delete;
+    Pin& operator=(const Pin&) = delete;
+    Pin(Pin&&) = delete;
+    Pin& operator=(Pin&&) = delete;
+
+  private:
+    const WalIndex* m_index {nullptr};
+    std::size_t m_slot {0};
+  };
+
+  // Register a reader seeing everything published so far
+  WalSnapshot snapshot() const;
+  // Newest frame of a page visible to the snapshot, 0 if none
+  std::uint64_t lookup(std::uint32_t page_number,
+                       const WalSnapshot& snapshot) const noexcept;
+  // Same, up to limit rather than the snapshot's sequence: for the writer,
+  // which may look past the last commit at frames it indexed since
+  std::uint64_t lookup(std::uint32_t page_number,
+                       const WalSnapshot& snapshot,
+                       std::uint64_t limit) const noexcept;
+  // Newest frame up to limit of each page with a frame after `after`,
+  // sorted by page number; limit must not exceed the snapshot
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> frames_between(
+      const WalSnapshot& snapshot,
+      std::uint64_t after,
+      std::uint64_t limit) const;
+
+  std::uint64_t global_sequence() const noexcept { return m_sequence; }
+  // Smallest sequence a reader may still see; global_sequence() if none
+  std::uint64_t oldest_snapshot() const noexcept;
+  std::size_t segments() const noexcept;
+
+private:
+  friend class WalSnapshot;
+
+  static constexpr std::size_t SEGMENT_SLOTS = 2 * SEGMENT_FRAMES;
+  // Sequence of a reader slot no snapshot holds
+  static constexpr std::uint64_t FREE =
+      std::numeric_limits<std::uint64_t>::max();
+  // Sequence of a reader slot whose snapshot is still being taken
+  static constexpr std::uint64_t PENDING = 0;
+
+  struct Segment
+  {
+    explicit Segment(std::uint64_t first, Segment* next) noexcept
+        : first_frame(first)
+        , older(next)
+    {
+    }
+
+    std::uint64_t first_frame;
+    Segment* older;
+    // Page number in the high half, frame index + 1 in the low; 0 = empty
+    std::array<std::atomic<std::uint64_t>, SEGMENT_SLOTS> slots {};
+  };
+
+  struct alignas(64) ReaderSlot
+  {
+    std::atomic<std::uint64_t> sequence {FREE};
+    // Epoch of the pinned read; 0 when not pinned
+    std::atomic<std::uint64_t> epoch {0};
+  };
+
+  struct Retired
+  {
+    std::uint64_t epoch;
+    Segment* segments;
+  };
+
+  std::atomic<Segment*> m_newest {nullptr};
+  std::atomic<std::uint64_t> m_sequence {0};
+  std::atomic<std::uint64_t> m_epoch {1};
+  mutable std::array<ReaderSlot, MAX_READERS> m_readers {};
+  std::atomic<std::size_t> m_segment_count {0};
+  // Writer-only
+  std::vector<Retired> m_retired;
+
+  void release(std::size_t slot) const noexcept;
+  std::uint64_t oldest_epoch() const noexcept;
+  void reclaim();
+  static void free_chain(Segment* segment) noexcept;
+};
+
+#endif  // WAL_INDEX_HPP
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+#include "catalog.hpp"
+
+#include "backend/hash_index.hpp"
+#include "backend/index_tree.hpp"
+
+namespace
+{
+constexpr std::size_t KIND_COLUMN = 0;
+constexpr std::size_t NAME_COLUMN = 1;
+constexpr std::size_t TABLE_COLUMN = 2;
+constexpr std::size_t ROOT_COLUMN = 3;
+constexpr std::size_t COLUMNS_COLUMN = 4;
+constexpr std::size_t INCLUDED_COLUMN = 5;
+constexpr std::size_t METHOD_COLUMN = 6;
+constexpr std::size_t SCHEMA_COLUMNS = 7;
+
+const char* type_name(ColumnType type) noexcept
+{
+  return type == ColumnType::INTEGER ? "INTEGER" : "TEXT";
+}
+
+std::string join(const std::vector<std::string>& names)
+{
+  std::string list;
+  for (const std::string& name : names) {
+    list += list.empty() ? name : "," + name;
+  }
+  return list;
+}
+
+std::vector<std::string> split(const std::string& list)
+{
+  std::vector<std::string> names;
+  std::size_t start = 0;
+  while (start < list.size()) {
+    const std::size_t comma = std::min(list.find(',', start), list.size());
+    names.push_back(list.substr(start, comma - start));
+    start = comma + 1;
+  }
+  return names;
+}
+
+const std::string& text_of(const std::vector<Value>& row, std::size_t column)
+{
+  const auto* text = std::get_if<std::string>(&row.at(column));
+  if (text == nullptr) {
+    throw std::runtime_error("Corrupt schema row");
+  }
+  return *text;
+}
+
+PageId page_of(const std::vector<Value>& row)
+{
+  const auto* page = std::get_if<std::int64_t>(&row.at(ROOT_COLUMN));
+  if (page == nullptr) {
+    throw std::runtime_error("Corrupt schema row");
+  }
+  return static_cast<PageId>(*page);
+}
+
+IndexMethod method_of(const std::vector<Value>& row)
+{
+  const std::string& method = text_of(row, METHOD_COLUMN);
+  if (method == "BTREE") {
+    return IndexMethod::BTREE;
+  }
+  if (method == "HASH") {
+    return IndexMethod::HASH;
+  }
+  throw std::runtime_error("Corrupt schema row");
+}
+
+// Each name at most once
+void check_unique(const std::vector<std::string>& names)
+{
+  const std::set<std::string> seen(names.begin(), names.end());
+  if (seen.size() != names.size()) {
+    throw std::invalid_argument("Column named twice");
+  }
+}
+}  // namespace
+
+std::optional<std::size_t> TableDef::column_index(
+    const std::string& column) const
+{
+  for (std::size_t i = 0; i < columns.size(); i++) {
+    if (columns[i].name == column) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+bool IndexDef::covers(const std::string& column) const
+{
+  return std::find(columns.begin(), columns.end(), column) != columns.end()
+      || std::find(included.begin(), included.end(), column)
+      != included.end();
+}
+
+/**
+ * @brief Open the schema of a file, creating it in a new file
+ *
+ * @param pager Pager of the database; a file without pages gets the header
+ * and an empty schema
+ */
+Catalog::Catalog(Pager& pager)
+    : m_pager(pager)
+    , m_schema(pager, open_schema(pager))
+{
+  BTreeCursor cursor(m_schema);
+  for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+    PayloadReader payload = cursor.payload_reader();
+    const std::vector<Value> row =
+        decode_record(payload, std::vector<bool>(SCHEMA_COLUMNS, true));
+    if (row.size() != SCHEMA_COLUMNS) {
+      throw std::runtime_error("Corrupt schema row");
+    }
+    const std::string& kind = text_of(row, KIND_COLUMN);
+    const std::string& name = text_of(row, NAME_COLUMN);
+    if (kind == "table") {
+      TableDef table {name, {}, page_of(row)};
+      for (const std::string& column : split(text_of(row, COLUMNS_COLUMN))) {
+        const std::size_t space = column.find(' ');
+        const std::string type = column.substr(space + 1);
+        table.columns.push_back(
+            {column.substr(0, space),
+             type == "INTEGER" ? ColumnType::INTEGER : ColumnType::TEXT});
+      }
+      m_tables.emplace(name, std::move(table));
+    } else if (kind == "index") {
+      m_indexes.emplace(name,
+                        IndexDef {name,
+                                  text_of(row, TABLE_COLUMN),
+                                  split(text_of(row, COLUMNS_COLUMN)),
+                                  split(text_of(row, INCLUDED_COLUMN)),
+                                  page_of(row),
+                                  method_of(row)});
+    } else {
+      throw std::runtime_error("Corrupt schema row");
+    }
+  }
+}
+
+PageId Catalog::open_schema(Pager& pager)
+{
+  if (pager.get_num_pages() > SCHEMA_ROOT) {
+    return SCHEMA_ROOT;
+  }
+  if (BTree::create(pager) != SCHEMA_ROOT) {
+    throw std::runtime_error("Schema page already in use");
+  }
+  return SCHEMA_ROOT;
+}
+
+void Catalog::check_name(const std::string& name) const
+{
+  if (m_tables.count(name) != 0 || m_indexes.count(name) != 0) {
+    throw std::invalid_argument("Name already in use: " + name);
+  }
+}
+
+void Catalog::add_schema_row(const std::vector<Value>& row)
+{
+  BTreeCursor cursor(m_schema);
+  std::int64_t rowid = 1;
+  if (cursor.last()) {
+    if (cursor.rowid() == std::numeric_limits<std::int64_t>::max()) {
+      throw std::overflow_error("No rowid left");
+    }
+    rowid = cursor.rowid() + 1;
+  }
+  m_schema.insert(rowid, encode_record(row));
+}
+
+const TableDef& Catalog::create_table(const std::string& name,
+                                      const std::vector<ColumnDef>& columns)
+{
+  check_name(name);
+  if (columns.empty()) {
+    throw std::invalid_argument("A table needs a column");
+  }
+  std::vector<std::string> names;
+  std::vector<std::string> definitions;
+  for (const ColumnDef& column : columns) {
+    names.push_back(column.name);
+    definitions.push_back(column.name + " " + type_name(column.type));
+  }
+  check_unique(names);
+
+  TableDef table {name, columns, BTree::create(m_pager)};
+  add_schema_row({std::string("table"),
+                  name,
+                  name,
+                  std::int64_t {table.root},
+                  join(definitions),
+                  std::string(),
+                  std::string()});
+  return m_tables.emplace(name, std::move(table)).first->second;
+}
+
+/**
+ * @brief Record a new, empty index
+ *
+ * @param index Definition of the index; its root is ignored
+ * @return const IndexDef& The definition with the root of the new tree
+ */
+const IndexDef& Catalog::create_index(const IndexDef& index)
+{
+  check_name(index.name);
+  const TableDef* table = find_table(index.table);
+  if (table == nullptr) {
+    throw std::invalid_argument("No such table: " + index.table);
+  }
+  if (index.columns.empty()) {
+    throw std::invalid_argument("An index needs a key column");
+  }
+  std::vector<std::string> all = index.columns;
+  all.insert(all.end(), index.included.begin(), index.included.end());
+  for (const std::string& column : all) {
+    if (!table->column_index(column)) {
+      throw std::invalid_argument("No such column: " + column);
+    }
+  }
+  check_unique(all);
+
+  IndexDef created = index;
+  const bool hash = created.method == IndexMethod::HASH;
+  created.root =
+      hash ? HashIndex::create(m_pager) : IndexTree::create(m_pager);
+  add_schema_row({std::string("index"),
+                  created.name,
+                  created.table,
+                  std::int64_t {created.root},
+                  join(created.columns),
+                  join(created.included),
+                  std::string(hash ? "HASH" : "BTREE")});
+  return m_indexes.emplace(created.name, std::move(created)).first->second;
+}
+
+const TableDef* Catalog::find_table(const std::string& name) const
+{
+  const auto found = m_tables.find(name);
+  return found == m_tables.end() ? nullptr : &found->second;
+}
+
+const IndexDef* Catalog::find_index(const std::string& name) const
+{
+  const auto found = m_indexes.find(name);
+  return found == m_indexes.end() ? nullptr : &found->second;
+}
+
+std::vector<const IndexDef*> Catalog::indexes_of(
+    const std::string& table) const
+{
+  std::vector<const IndexDef*> indexes;
+  for (const auto& [name, index] : m_indexes) {
+    if (index.table == table) {
+      indexes.push_back(&index);
+    }
+  }
+  return indexes;
+}
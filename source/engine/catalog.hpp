@@ -0,0 +1,105 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "backend/btree.hpp"
+#include "backend/pager.hpp"
+#include "backend/record.hpp"
+
+enum class ColumnType
+{
+  INTEGER,
+  TEXT
+};
+
+enum class IndexMethod
+{
+  BTREE,
+  HASH
+};
+
+struct ColumnDef
+{
+  std::string name;
+  ColumnType type;
+};
+
+struct TableDef
+{
+  std::string name;
+  std::vector<ColumnDef> columns;
+  // Root of the BTree of its rows
+  PageId root {0};
+
+  // Position of a column; std::nullopt if the table has none by that name
+  std::optional<std::size_t> column_index(const std::string& column) const;
+};
+
+struct IndexDef
+{
+  std::string name;
+  std::string table;
+  // Columns of the key, in key order
+  std::vector<std::string> columns;
+  // Columns covered by the payload of each entry
+  std::vector<std::string> included;
+  // Root of the IndexTree, or meta page of the HashIndex, of its entries
+  PageId root {0};
+  IndexMethod method {IndexMethod::BTREE};
+
+  // Whether an entry holds the column, in its key or its payload
+  bool covers(const std::string& column) const;
+};
+
+/**
+ * @brief Tables and indexes of a database file
+ *
+ * The schema is kept in a BTree rooted at page 1, created with the file,
+ * one row per table or index. A row is a record of its kind ("table" or
+ * "index"), name, table, root page, columns, covered columns and access
+ * method ("BTREE" or "HASH", empty for a table); columns are a
+ * comma-separated list, with the type after each name for a table.
+ * Tables and indexes share one namespace.
+ *
+ * The catalog loads the whole schema when opened and writes a row for
+ * each table or index it creates. It does not fill new indexes; see
+ * Executor.
+ */
+class Catalog
+{
+public:
+  static constexpr PageId SCHEMA_ROOT = 1;
+
+  explicit Catalog(Pager& pager);  // Can throw runtime_error
+
+  // Both can throw invalid_argument for a taken name or unknown columns;
+  // the new tree is empty
+  const TableDef& create_table(const std::string& name,
+                               const std::vector<ColumnDef>& columns);
+  const IndexDef& create_index(const IndexDef& index);
+
+  // nullptr if there is none by that name
+  const TableDef* find_table(const std::string& name) const;
+  const IndexDef* find_index(const std::string& name) const;
+  // Indexes of a table, by name
+  std::vector<const IndexDef*> indexes_of(const std::string& table) const;
+
+  Pager& pager() const noexcept { return m_pager; }
+
+private:
+  Pager& m_pager;
+  BTree m_schema;
+  std::map<std::string, TableDef> m_tables;
+  std::map<std::string, IndexDef> m_indexes;
+
+  static PageId open_schema(Pager& pager);
+  void check_name(const std::string& name) const;
+  void add_schema_row(const std::vector<Value>& row);
+};
+
+#endif  // CATALOG_HPP
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "executor.hpp"
+
+#include "backend/btree.hpp"
+#include "backend/hash_index.hpp"
+#include "backend/index_tree.hpp"
+
+namespace
+{
+// Bytes of the rowid ending a B+tree index key
+constexpr std::size_t ROWID_KEY_SIZE = 8;
+
+Value bind(const ColumnDef& column, const std::string& literal)
+{
+  if (column.type == ColumnType::TEXT) {
+    return literal;
+  }
+  std::int64_t value = 0;
+  const char* end = literal.data() + literal.size();
+  const auto [parsed, error] = std::from_chars(literal.data(), end, value);
+  if (error != std::errc() || parsed != end) {
+    throw std::invalid_argument("Not an INTEGER for " + column.name + ": "
+                                + literal);
+  }
+  return value;
+}
+
+// Values of a column share a type, bar NULLs, which sort first
+int compare_values(const ValueView& a, const ValueView& b) noexcept
+{
+  if (a.index() != b.index()) {
+    return a.index() < b.index() ? -1 : 1;
+  }
+  if (const auto* integer = std::get_if<std::int64_t>(&a)) {
+    const std::int64_t other = std::get<std::int64_t>(b);
+    return *integer < other ? -1 : (*integer > other ? 1 : 0);
+  }
+  if (const auto* text = std::get_if<std::string_view>(&a)) {
+    return text->compare(std::get<std::string_view>(b));
+  }
+  return 0;
+}
+
+// NULL matches no comparison
+bool matches(const ValueView& value,
+             const std::string& op,
+             const ValueView& bound)
+{
+  if (std::holds_alternative<std::monostate>(value)) {
+    return false;
+  }
+  const int order = compare_values(value, bound);
+  if (op == "=") {
+    return order == 0;
+  }
+  if (op == "!=") {
+    return order != 0;
+  }
+  if (op == "<") {
+    return order < 0;
+  }
+  if (op == "<=") {
+    return order <= 0;
+  }
+  if (op == ">") {
+    return order > 0;
+  }
+  return order >= 0;
+}
+
+std::size_t column_of(const TableDef& table, const std::string& column)
+{
+  const auto index = table.column_index(column);
+  if (!index) {
+    throw std::invalid_argument("No such column: " + column);
+  }
+  return *index;
+}
+
+// Positions of the selected columns; "*" selects all of them
+std::vector<std::size_t> projection(const TableDef& table,
+                                    const std::vector<std::string>& columns)
+{
+  std::vector<std::size_t> positions;
+  for (const std::string& column : columns) {
+    if (column == "*") {
+      for (std::size_t i = 0; i < table.columns.size(); i++) {
+        positions.push_back(i);
+      }
+    } else {
+      positions.push_back(column_of(table, column));
+    }
+  }
+  return positions;
+}
+
+struct Entry
+{
+  // Key columns alone; a B+tree index appends the rowid to keep keys unique
+  std::vector<std::byte> key;
+  std::int64_t rowid {0};
+  std::vector<std::byte> payload;
+};
+
+Entry entry_of(const TableDef& table,
+               const IndexDef& index,
+               const Row& row,
+               std::int64_t rowid)
+{
+  Entry entry;
+  for (const std::string& column : index.columns) {
+    append_key(entry.key, row[column_of(table, column)]);
+  }
+  entry.rowid = rowid;
+  if (!index.included.empty()) {
+    Row covered;
+    for (const std::string& column : index.included) {
+      covered.push_back(row[column_of(table, column)]);
+    }
+    entry.payload = encode_record(covered);
+  }
+  return entry;
+}
+
+// Whether the key and payload of an entry fit in the index
+bool fits(Pager& pager, const IndexDef& index, const Entry& entry)
+{
+  const std::size_t size = entry.key.size() + entry.payload.size();
+  if (index.method == IndexMethod::HASH) {
+    return size <= HashIndex(pager, index.root).max_entry();
+  }
+  return size + ROWID_KEY_SIZE <= IndexTree(pager, index.root).max_entry();
+}
+
+void insert_entry(Pager& pager, const IndexDef& index, const Entry& entry)
+{
+  if (index.method == IndexMethod::HASH) {
+    HashIndex(pager, index.root).insert(entry.key, entry.rowid, entry.payload);
+    return;
+  }
+  std::vector<std::byte> key = entry.key;
+  append_key_rowid(key, entry.rowid);
+  IndexTree(pager, index.root).insert(key, entry.payload);
+}
+
+// The columns of a table row found in an index entry; the others are NULL
+template<typename Cursor>
+Row row_of_entry(const TableDef& table,
+                 const IndexDef& index,
+                 const Cursor& cursor)
+{
+  Row row(table.columns.size());
+  Row keys = decode_key(cursor.key(), cursor.key_size(), index.columns.size());
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    row[column_of(table, index.columns[i])] = std::move(keys[i]);
+  }
+  if (!index.included.empty()) {
+    Row covered = decode_record(cursor.payload(), cursor.payload_size());
+    for (std::size_t i = 0; i < covered.size() && i < index.included.size();
+         i++)
+    {
+      row[column_of(table, index.included[i])] = std::move(covered[i]);
+    }
+  }
+  return row;
+}
+}  // namespace
+
+std::string QueryPlan::describe(const std::optional<condition>& where) const
+{
+  if (access == Access::TABLE_SCAN) {
+    return "SCAN " + table->name;
+  }
+  std::string text = access == Access::INDEX_SEEK ? "SEARCH " : "SCAN ";
+  text += table->name + " USING ";
+  text += covering ? "COVERING " : "";
+  text += index->method == IndexMethod::HASH ? "HASH INDEX " : "INDEX ";
+  text += index->name;
+  if (access == Access::INDEX_SEEK) {
+    text += " (" + where->column + where->op + "?)";
+  }
+  return text;
+}
+
+Executor::Executor(Catalog& catalog) noexcept
+    : m_catalog(catalog)
+{
+}
+
+const TableDef& Executor::table_of(const std::string& name) const
+{
+  const TableDef* table = m_catalog.find_table(name);
+  if (table == nullptr) {
+    throw std::invalid_argument("No such table: " + name);
+  }
+  return *table;
+}
+
+std::vector<Row> Executor::execute(const std::string& sql)
+{
+  parser statement_parser(sql);
+  const auto statement = statement_parser.parse_statement();
+  if (!statement) {
+    throw std::invalid_argument("Syntax error in: " + sql);
+  }
+  if (const auto* select = std::get_if<select_statement>(&*statement)) {
+    return execute(*select);
+  }
+  if (const auto* insert = std::get_if<insert_statement>(&*statement)) {
+    execute(*insert);
+  } else if (const auto* index =
+                 std::get_if<create_index_statement>(&*statement))
+  {
+    execute(*index);
+  } else if (!std::holds_alternative<empty_statement>(*statement)) {
+    throw std::invalid_argument("Statement not supported: " + sql);
+  }
+  return {};
+}
+
+/**
+ * @brief Create an index and add an entry for every row of its table
+ */
+void Executor::execute(const create_index_statement& stmt)
+{
+  const TableDef& table = table_of(stmt.table);
+  IndexDef definition {stmt.name, stmt.table, stmt.columns, stmt.included};
+  definition.method =
+      stmt.method == "HASH" ? IndexMethod::HASH : IndexMethod::BTREE;
+  for (const std::string& column : stmt.columns) {
+    column_of(table, column);
+  }
+  for (const std::string& column : stmt.included) {
+    column_of(table, column);
+  }
+
+  // Build every entry first, so that an oversized one leaves no index
+  std::vector<bool> wanted(table.columns.size());
+  for (std::size_t i = 0; i < wanted.size(); i++) {
+    wanted[i] = definition.covers(table.columns[i].name);
+  }
+  std::vector<Entry> entries;
+  BTree rows(m_catalog.pager(), table.root);
+  BTreeCursor cursor(rows);
+  for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+    PayloadReader payload = cursor.payload_reader();
+    const Row row = decode_record(payload, wanted);
+    entries.push_back(entry_of(table, definition, row, cursor.rowid()));
+  }
+  for (const Entry& entry : entries) {
+    if (!fits(m_catalog.pager(), definition, entry)) {
+      throw std::invalid_argument("Row too large for index " + stmt.name);
+    }
+  }
+  // Keys are prefix-free, so this is the order of key and rowid together
+  std::sort(entries.begin(),
+            entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.key != b.key ? a.key < b.key : a.rowid < b.rowid;
+            });
+
+  const IndexDef& index = m_catalog.create_index(definition);
+  if (index.method == IndexMethod::HASH) {
+    for (const Entry& entry : entries) {
+      insert_entry(m_catalog.pager(), index, entry);
+    }
+    return;
+  }
+  // A B+tree index is built bottom-up from the sorted entries, into the
+  // root the catalog allocated
+  IndexLoader loader(m_catalog.pager());
+  for (const Entry& entry : entries) {
+    std::vector<std::byte> key = entry.key;
+    append_key_rowid(key, entry.rowid);
+    loader.add(key, entry.payload);
+  }
+  loader.finish(index.root);
+}
+
+/**
+ * @brief Add a row and its index entries
+ *
+ * Columns left out are NULL.
+ */
+std::int64_t Executor::execute(const insert_statement& stmt)
+{
+  const TableDef& table = table_of(stmt.table);
+  if (stmt.columns.size() != stmt.values.size()) {
+    throw std::invalid_argument("Columns and values do not match");
+  }
+  Row row(table.columns.size());
+  std::vector<bool> given(table.columns.size());
+  for (std::size_t i = 0; i < stmt.columns.size(); i++) {
+    const std::size_t position = column_of(table, stmt.columns[i]);
+    if (given[position]) {
+      throw std::invalid_argument("Column named twice: " + stmt.columns[i]);
+    }
+    given[position] = true;
+    row[position] = bind(table.columns[position], stmt.values[i]);
+  }
+
+  BTree rows(m_catalog.pager(), table.root);
+  BTreeCursor cursor(rows);
+  std::int64_t rowid = 1;
+  if (cursor.last()) {
+    if (cursor.rowid() == std::numeric_limits<std::int64_t>::max()) {
+      throw std::overflow_error("No rowid left");
+    }
+    rowid = cursor.rowid() + 1;
+  }
+  const std::vector<std::byte> record = encode_record(row);
+  std::vector<std::pair<const IndexDef*, Entry>> entries;
+  for (const IndexDef* index : m_catalog.indexes_of(table.name)) {
+    Entry entry = entry_of(table, *index, row, rowid);
+    if (!fits(m_catalog.pager(), *index, entry)) {
+      throw std::invalid_argument("Row too large for index " + index->name);
+    }
+    entries.emplace_back(index, std::move(entry));
+  }
+
+  rows.insert(rowid, record);
+  for (const auto& [index, entry] : entries) {
+    insert_entry(m_catalog.pager(), *index, entry);
+  }
+  return rowid;
+}
+
+/**
+ * @brief Choose how to read the table of a SELECT
+ *
+ * An index the predicate can seek is preferred, a covering one among
+ * those first, then a hash index over a B+tree one; without one, a
+ * covering B+tree index is scanned instead of the table, its entries being
+ * narrower than the rows. A hash index can only be looked up by its whole
+ * key, so it serves "=" on its single key column and nothing else.
+ */
+QueryPlan Executor::plan(const select_statement& stmt) const
+{
+  QueryPlan plan;
+  plan.table = &table_of(stmt.table);
+  if (stmt.join_clause) {
+    throw std::invalid_argument("JOIN is not supported");
+  }
+
+  std::vector<std::string> read;
+  for (const std::size_t position : projection(*plan.table, stmt.columns)) {
+    read.push_back(plan.table->columns[position].name);
+  }
+  if (stmt.where_clause) {
+    read.push_back(plan.table->columns[column_of(
+        *plan.table, stmt.where_clause->column)].name);
+  }
+
+  int best = 0;
+  for (const IndexDef* index : m_catalog.indexes_of(stmt.table)) {
+    const bool hash = index->method == IndexMethod::HASH;
+    bool seekable = stmt.where_clause && stmt.where_clause->op != "!="
+        && index->columns.front() == stmt.where_clause->column;
+    if (hash) {
+      seekable = seekable && stmt.where_clause->op == "="
+          && index->columns.size() == 1;
+      if (!seekable) {
+        continue;
+      }
+    }
+    const bool covering =
+        std::all_of(read.begin(),
+                    read.end(),
+                    [&](const std::string& c) { return index->covers(c); });
+    const int score = (seekable ? 4 : 0) + (covering ? 2 : 0) + (hash ? 1 : 0);
+    if (score > best) {
+      best = score;
+      plan.index = index;
+      plan.covering = covering;
+      plan.access = seekable ? QueryPlan::Access::INDEX_SEEK
+                             : QueryPlan::Access::INDEX_SCAN;
+    }
+  }
+  return plan;
+}
+
+std::vector<Row> Executor::execute(const select_statement& stmt)
+{
+  const QueryPlan plan = this->plan(stmt);
+  const TableDef& table = *plan.table;
+  const std::vector<std::size_t> positions =
+      projection(table, stmt.columns);
+  std::optional<std::size_t> where_column;
+  Value bound;
+  if (stmt.where_clause) {
+    where_column = column_of(table, stmt.where_clause->column);
+    bound = bind(table.columns[*where_column], stmt.where_clause->value);
+  }
+  const ValueView bound_view = view_of(bound);
+  // Columns left out are not decoded, nor their overflow pages read
+  std::vector<bool> wanted(table.columns.size());
+  for (const std::size_t position : positions) {
+    wanted[position] = true;
+  }
+  if (where_column) {
+    wanted[*where_column] = true;
+  }
+
+  std::vector<Row> result;
+  const auto emit = [&](const Row& row) {
+    if (where_column
+        && !matches(view_of(row[*where_column]),
+                    stmt.where_clause->op,
+                    bound_view))
+    {
+      return;
+    }
+    Row projected;
+    projected.reserve(positions.size());
+    for (const std::size_t position : positions) {
+      projected.push_back(row[position]);
+    }
+    result.push_back(std::move(projected));
+  };
+
+  BTree rows(m_catalog.pager(), table.root);
+  BTreeCursor row_cursor(rows);
+  if (plan.access == QueryPlan::Access::TABLE_SCAN) {
+    // Rows whole in their leaf are filtered in place; only those that pass
+    // have their columns copied out
+    RecordView record;
+    for (bool valid = row_cursor.first(); valid; valid = row_cursor.next()) {
+      if (row_cursor.local_size() != row_cursor.payload_size()) {
+        PayloadReader payload = row_cursor.payload_reader();
+        emit(decode_record(payload, wanted));
+        continue;
+      }
+      record.reset(row_cursor.payload(), row_cursor.payload_size());
+      if (where_column
+          && !matches(record.column(*where_column),
+                      stmt.where_clause->op,
+                      bound_view))
+      {
+        continue;
+      }
+      Row projected;
+      projected.reserve(positions.size());
+      for (const std::size_t position : positions) {
+        projected.push_back(to_value(record.column(position)));
+      }
+      result.push_back(std::move(projected));
+    }
+    return result;
+  }
+
+  // Rows of the index entries the cursor stands on, whole or covered
+  const auto row_of = [&](const auto& cursor, std::int64_t rowid) {
+    if (plan.covering) {
+      return row_of_entry(table, *plan.index, cursor);
+    }
+    if (!row_cursor.seek(rowid) || row_cursor.rowid() != rowid) {
+      throw std::runtime_error("Index entry without a row");
+    }
+    PayloadReader payload = row_cursor.payload_reader();
+    return decode_record(payload, wanted);
+  };
+
+  if (plan.index->method == IndexMethod::HASH) {
+    const HashIndex index(m_catalog.pager(), plan.index->root);
+    HashCursor cursor(index);
+    std::vector<std::byte> key;
+    append_key(key, bound);
+    for (bool valid = cursor.find(key); valid; valid = cursor.next()) {
+      emit(row_of(cursor, cursor.rowid()));
+    }
+    return result;
+  }
+
+  const IndexTree tree(m_catalog.pager(), plan.index->root);
+  IndexCursor cursor(tree);
+  bool valid = false;
+  const std::string op =
+      plan.access == QueryPlan::Access::INDEX_SEEK ? stmt.where_clause->op : "";
+  if (op == "=" || op == ">" || op == ">=") {
+    std::vector<std::byte> start;
+    append_key(start, bound);
+    valid = cursor.seek(start);
+  } else if (op == "<" || op == "<=") {
+    valid = cursor.seek(non_null_key());
+  } else {
+    valid = cursor.first();
+  }
+
+  for (; valid; valid = cursor.next()) {
+    Row row = row_of_entry(table, *plan.index, cursor);
+    if (!op.empty()
+        && !matches(view_of(row[*where_column]), op, bound_view))
+    {
+      // Keys equal to the bound precede those a ">" wants; anything else
+      // that fails is past the range
+      if (op == ">") {
+        continue;
+      }
+      break;
+    }
+    emit(plan.covering
+             ? std::move(row)
+             : row_of(cursor, key_rowid(cursor.key(), cursor.key_size())));
+  }
+  return result;
+}
@@ -0,0 +1,81 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "catalog.hpp"
+#include "frontend/parser.hpp"
+
+using Row = std::vector<Value>;
+
+/**
+ * @brief How a SELECT reads its table
+ *
+ * A predicate on the first key column of an index, other than "!=", turns
+ * into an index seek: the index is entered at the first key the predicate
+ * can match and left past the last. An index holding every column the
+ * query reads, in its key or covered columns, answers it alone; the table
+ * tree is then never visited. Otherwise each entry found fetches its row
+ * by rowid. A hash index serves only "=" on its one key column, with a
+ * lookup of a few pages whatever the size of the table.
+ */
+struct QueryPlan
+{
+  enum class Access
+  {
+    TABLE_SCAN,
+    // Every entry of a covering index, in key order
+    INDEX_SCAN,
+    INDEX_SEEK
+  };
+
+  const TableDef* table {nullptr};
+  Access access {Access::TABLE_SCAN};
+  const IndexDef* index {nullptr};
+  // The index answers the query without the table
+  bool covering {false};
+
+  // In the style of EXPLAIN QUERY PLAN, e.g.
+  // "SEARCH users USING COVERING INDEX by_age (age>?)" or
+  // "SEARCH users USING HASH INDEX by_id (id=?)"
+  std::string describe(const std::optional<condition>& where) const;
+};
+
+/**
+ * @brief Runs statements against the tables of a Catalog
+ *
+ * Literals are bound to the type of their column: INTEGER columns take
+ * decimal integers, TEXT columns any literal. A SELECT decodes only the
+ * columns it reads, so the overflow pages of large values it leaves out
+ * are never read; a table scan tests its WHERE clause on rows in place and
+ * copies out only the rows that pass. INSERT gives the row the
+ * rowid after the largest one and adds an entry to every index of the
+ * table; CREATE INDEX, with USING HASH for a hash index, fills the new
+ * index from the rows already there.
+ * Statement errors throw invalid_argument before anything is written.
+ */
+class Executor
+{
+public:
+  explicit Executor(Catalog& catalog) noexcept;
+
+  // Parse and run one statement; rows of a SELECT, none otherwise
+  std::vector<Row> execute(const std::string& sql);
+
+  void execute(const create_index_statement& stmt);
+  // Returns the rowid of the new row
+  std::int64_t execute(const insert_statement& stmt);
+  std::vector<Row> execute(const select_statement& stmt);
+
+  QueryPlan plan(const select_statement& stmt) const;
+
+private:
+  Catalog& m_catalog;
+
+  const TableDef& table_of(const std::string& name) const;
+};
+
+#endif  // EXECUTOR_HPP
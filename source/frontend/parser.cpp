@@ -301,6 +301,100 @@ tl::expected<delete_statement, parse_error> parser::parse_delete()
   return stmt;
 }
 
+// --- CREATE INDEX statement ---
+// Grammar: CREATE INDEX index_name ON table_name "(" column_list ")"
+// [INCLUDE "(" column_list ")"] ";" ;
+tl::expected<create_index_statement, parse_error> parser::parse_create_index()
+{
+  if (auto create_kw = consume(token_type::keyword, "CREATE"); !create_kw) {
+    return tl::make_unexpected(create_kw.error());
+  }
+  if (auto index_kw = consume(token_type::keyword, "INDEX"); !index_kw) {
+    return tl::make_unexpected(index_kw.error());
+  }
+  create_index_statement stmt;
+  const auto name = consume(token_type::identifier, "");
+  if (name.has_value()) {
+    stmt.name = name.value().value;
+  } else {
+    return tl::make_unexpected(name.error());
+  }
+  if (auto on_kw = consume(token_type::keyword, "ON"); !on_kw) {
+    return tl::make_unexpected(on_kw.error());
+  }
+  const auto table = consume(token_type::identifier, "");
+  if (table.has_value()) {
+    stmt.table = table.value().value;
+  } else {
+    return tl::make_unexpected(table.error());
+  }
+
+  if (peek().type == token_type::keyword && peek().value == "USING") {
+    if (auto using_kw = consume(token_type::keyword, "USING"); !using_kw) {
+      return tl::make_unexpected(using_kw.error());
+    }
+    const auto method = consume(token_type::identifier, "");
+    if (!method.has_value()) {
+      return tl::make_unexpected(method.error());
+    }
+    if (method.value().value != "BTREE" && method.value().value != "HASH") {
+      return tl::make_unexpected(parse_error::mismatching_value);
+    }
+    stmt.method = method.value().value;
+  }
+
+  auto columns = parse_column_list();
+  if (!columns) {
+    return tl::make_unexpected(columns.error());
+  }
+  stmt.columns = columns.value();
+
+  if (peek().type == token_type::keyword && peek().value == "INCLUDE") {
+    if (auto include_kw = consume(token_type::keyword, "INCLUDE"); !include_kw)
+    {
+      return tl::make_unexpected(include_kw.error());
+    }
+    auto included = parse_column_list();
+    if (!included) {
+      return tl::make_unexpected(included.error());
+    }
+    stmt.included = included.value();
+  }
+  if (auto semi = consume(token_type::punctuation, ";"); !semi) {
+    return tl::make_unexpected(semi.error());
+  }
+  return stmt;
+}
+
+// --- Parenthesized column list ---
+// Grammar: "(" column_list ")" ;
+tl::expected<std::vector<std::string>, parse_error> parser::parse_column_list()
+{
+  if (auto lparen = consume(token_type::punctuation, "("); !lparen) {
+    return tl::make_unexpected(lparen.error());
+  }
+  std::vector<std::string> columns;
+  while (true) {
+    const auto col = consume(token_type::identifier, "");
+    if (col.has_value()) {
+      columns.push_back(col.value().value);
+    } else {
+      return tl::make_unexpected(col.error());
+    }
+    if (peek().type == token_type::punctuation && peek().value == ",") {
+      if (auto comma = consume(token_type::punctuation, ","); !comma) {
+        return tl::make_unexpected(comma.error());
+      }
+    } else {
+      break;
+    }
+  }
+  if (auto rparen = consume(token_type::punctuation, ")"); !rparen) {
+    return tl::make_unexpected(rparen.error());
+  }
+  return columns;
+}
+
 // --- WHERE clause / condition ---
 // Grammar: condition ::= column_name operator value ;
 tl::expected<condition, parse_error> parser::parse_condition()
@@ -334,7 +428,7 @@ tl::expected<condition, parse_error> parser::parse_condition()
 
 // --- Top-level statement ---
 // Grammar: statement ::= select_statement | insert_statement | update_statement
-// | delete_statement | ";" ;
+// | delete_statement | create_index_statement | ";" ;
 tl::expected<statement_variant, parse_error> parser::parse_statement()
 {
   if (peek().type == token_type::punctuation && peek().value == ";") {
@@ -373,6 +467,12 @@ tl::expected<statement_variant, parse_error> parser::parse_statement()
       return tl::make_unexpected(deleteStmt.error());
     }
     return statement_variant(deleteStmt.value());
+  } else if (tok.value == "CREATE") {
+    auto createIndexStmt = parse_create_index();
+    if (!createIndexStmt) {
+      return tl::make_unexpected(createIndexStmt.error());
+    }
+    return statement_variant(createIndexStmt.value());
   }
 
   return tl::make_unexpected(parse_error::unknown_statement);
@@ -60,6 +60,15 @@ struct delete_statement
   std::optional<condition> where_clause;
 };
 
+struct create_index_statement
+{
+  std::string name;
+  std::string table;
+  std::string method = "BTREE";  // Access method: BTREE or HASH.
+  std::vector<std::string> columns;  // Key columns, in key order.
+  std::vector<std::string> included;  // Covered columns, stored unsorted.
+};
+
 struct empty_statement
 {
 };
@@ -68,7 +77,8 @@ using statement_variant = std::variant<empty_statement,
                                        select_statement,
                                        insert_statement,
                                        update_statement,
-                                       delete_statement>;
+                                       delete_statement,
+                                       create_index_statement>;
 
 // --- Parser Class Declaration ---
 class parser
@@ -85,10 +95,12 @@ public:
   tl::expected<insert_statement, parse_error> parse_insert();
   tl::expected<update_statement, parse_error> parse_update();
   tl::expected<delete_statement, parse_error> parse_delete();
+  tl::expected<create_index_statement, parse_error> parse_create_index();
 
   // Additional productions.
   tl::expected<condition, parse_error> parse_condition();
   tl::expected<join_clause, parse_error> parse_join_clause();
+  tl::expected<std::vector<std::string>, parse_error> parse_column_list();
 
 private:
   // Helper function to consume a token of a specific type and (optionally) a
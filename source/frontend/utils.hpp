@@ -11,10 +11,15 @@ const std::unordered_set<std::string> keywords = {"SELECT",
                                                   "DELETE",
                                                   "INTO",
                                                   "SET",
-                                                  "VALUES"};
+                                                  "VALUES",
+                                                  "CREATE",
+                                                  "INDEX",
+                                                  "ON",
+                                                  "INCLUDE",
+                                                  "USING"};
 
 const std::unordered_set<char> operators = {'=', '<', '>', '!', '+'};
-const std::unordered_set<char> punctuation = {',', ';', '(', ')'};
+const std::unordered_set<char> punctuation = {',', ';', '(', ')', '*'};
 
 // Helper function to check if a word is a keyword
 bool iskeyword(const std::string& word)
@@ -1,24 +1,48 @@
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include <fmt/core.h>
 
+#include "backend/pager.hpp"
 #include "input_buffer.hpp"
+#include "meta_command.hpp"
 
-auto main() -> int
+auto main(int argc, char** argv) -> int
 {
   auto buffer = input_buffer(std::cin);
 
+  std::unique_ptr<Pager> pager;
+  if (argc > 1) {
+    try {
+      pager = create_pager(argv[1]);
+    } catch (const std::exception& e) {
+      fmt::print("Cannot open database '{}': {}\n", argv[1], e.what());
+      return 1;
+    }
+  }
+
   /*TODO Separate user input as library instead of writing raw code in main*/
 
   while (true) {
     fmt::print("db > ");
     std::string line = buffer.read_line();
 
-    if (line == ".exit") {
+    if (buffer.eof() && line.empty()) {
       break;
     }
 
+    if (!line.empty() && line[0] == '.') {
+      auto result = execute_meta_command(line, pager.get(), std::cout);
+      if (result == meta_command_result::exit) {
+        break;
+      }
+      if (result != meta_command_result::unrecognized) {
+        continue;
+      }
+    }
+
     fmt::print("Unrecognized command '{}'.\n", line);
   }
 }
@@ -0,0 +1,176 @@
+#include <cctype>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "meta_command.hpp"
+
+#include <fmt/format.h>
+
+#include "backend/pager.hpp"
+
+auto parse_byte_size(const std::string& text) -> std::optional<std::size_t>
+{
+  if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return std::nullopt;
+  }
+
+  std::size_t pos = 0;
+  unsigned long long value = 0;
+  try {
+    value = std::stoull(text, &pos);
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+
+  unsigned shift = 0;
+  if (pos < text.size()) {
+    switch (std::toupper(static_cast<unsigned char>(text[pos]))) {
+      case 'K':
+        shift = 10;
+        break;
+      case 'M':
+        shift = 20;
+        break;
+      case 'G':
+        shift = 30;
+        break;
+      default:
+        return std::nullopt;
+    }
+    pos++;
+  }
+  if (pos != text.size()
+      || value > (std::numeric_limits<std::size_t>::max() >> shift))
+  {
+    return std::nullopt;
+  }
+  return static_cast<std::size_t>(value) << shift;
+}
+
+namespace
+{
+void print_latency(const char* name,
+                   const LatencySnapshot& latency,
+                   std::ostream& out)
+{
+  out << fmt::format("{}: {} calls, p50 < {} ns, p99 < {} ns, max < {} ns\n",
+                     name,
+                     latency.count(),
+                     latency.percentile(0.5) + 1,
+                     latency.percentile(0.99) + 1,
+                     latency.percentile(1.0) + 1);
+}
+
+void print_stats(const PagerStats& stats, std::ostream& out)
+{
+  out << fmt::format("hits: {}, misses: {} (hit rate {:.1f}%)\n",
+                     stats.hits,
+                     stats.misses,
+                     stats.hit_rate() * 100.0);
+  out << fmt::format("evictions: {} ({} dirty)\n",
+                     stats.evictions,
+                     stats.dirty_evictions);
+  out << fmt::format("bytes read: {}, bytes written: {}, syncs: {}\n",
+                     stats.bytes_read,
+                     stats.bytes_written,
+                     stats.syncs);
+  out << fmt::format("checksum failures: {}\n", stats.checksum_failures);
+  out << fmt::format("pages cached: {}, dirty: {}, pinned: {}\n",
+                     stats.cached_pages,
+                     stats.dirty_pages,
+                     stats.pinned_pages);
+  out << fmt::format("read-ahead: {} prefetched, {} used, {} wasted\n",
+                     stats.read_ahead.prefetched,
+                     stats.read_ahead.used,
+                     stats.read_ahead.wasted);
+  print_latency("read latency", stats.read_latency, out);
+  print_latency("write latency", stats.write_latency, out);
+
+  const auto& compression = stats.compression;
+  if (compression.pages_written + compression.pages_read > 0) {
+    out << fmt::format(
+        "compression: ratio {:.2f}, {} pages written ({} raw), {} read\n",
+        compression.ratio(),
+        compression.pages_written,
+        compression.pages_raw,
+        compression.pages_read);
+    print_latency("compress latency", compression.compress_latency, out);
+    print_latency("decompress latency", compression.decompress_latency, out);
+  }
+
+  const auto& wal = stats.wal;
+  if (wal.commits > 0) {
+    out << fmt::format(
+        "wal: {} commits, {} frames, {} syncs ({:.1f} commits per sync), "
+        "{} bytes\n",
+        wal.commits,
+        wal.frames,
+        wal.syncs,
+        wal.commits_per_sync(),
+        wal.size);
+    print_latency("commit latency", wal.commit_latency, out);
+  }
+
+  const auto& checkpoint = stats.checkpoint;
+  if (checkpoint.checkpoints + checkpoint.failures > 0) {
+    out << fmt::format(
+        "checkpoints: {}, {} pages copied, {} failed, {} log restarts\n",
+        checkpoint.checkpoints,
+        checkpoint.pages_copied,
+        checkpoint.failures,
+        wal.restarts);
+    print_latency("checkpoint duration", checkpoint.duration, out);
+  }
+}
+}  // namespace
+
+auto execute_meta_command(const std::string& line,
+                          Pager* pager,
+                          std::ostream& out) -> meta_command_result
+{
+  std::istringstream words(line);
+  std::string command;
+  std::string argument;
+  words >> command >> argument;
+
+  if (command == ".exit") {
+    return meta_command_result::exit;
+  }
+
+  if (command == ".cache_size") {
+    if (pager == nullptr) {
+      out << "No database is open.\n";
+      return meta_command_result::invalid_argument;
+    }
+    if (!argument.empty()) {
+      auto bytes = parse_byte_size(argument);
+      if (!bytes) {
+        out << fmt::format("Invalid size '{}'.\n", argument);
+        return meta_command_result::invalid_argument;
+      }
+      try {
+        pager->set_cache_budget(*bytes);
+      } catch (const std::exception& e) {
+        out << fmt::format("Cannot resize cache: {}.\n", e.what());
+        return meta_command_result::invalid_argument;
+      }
+    }
+    out << fmt::format("cache_size: {} bytes ({} pages of {} bytes)\n",
+                       pager->get_cache_budget(),
+                       pager->get_cache_frames(),
+                       pager->get_page_size());
+    return meta_command_result::success;
+  }
+
+  if (command == ".stats") {
+    if (pager == nullptr) {
+      out << "No database is open.\n";
+      return meta_command_result::invalid_argument;
+    }
+    print_stats(pager->stats(), out);
+    return meta_command_result::success;
+  }
+
+  return meta_command_result::unrecognized;
+}
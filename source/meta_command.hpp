@@ -0,0 +1,39 @@
+#ifndef META_COMMAND_HPP
+#define META_COMMAND_HPP
+
+#include <optional>
+#include <ostream>
+#include <string>
+
+class Pager;
+
+enum class meta_command_result
+{
+  success,
+  exit,
+  unrecognized,
+  invalid_argument
+};
+
+/**
+ * @brief Executes a REPL dot-command such as ".exit", ".cache_size 64M" or
+ * ".stats".
+ *
+ * @param line The full input line, starting with '.'.
+ * @param pager The open database, or nullptr if none is open.
+ * @param out Stream receiving the command's output.
+ * @return meta_command_result Outcome of the command.
+ */
+auto execute_meta_command(const std::string& line,
+                          Pager* pager,
+                          std::ostream& out) -> meta_command_result;
+
+/**
+ * @brief Parses a byte count with an optional K, M or G suffix.
+ *
+ * @param text The text to parse, e.g. "4096", "512K" or "2G".
+ * @return std::optional<std::size_t> The size in bytes, or std::nullopt.
+ */
+auto parse_byte_size(const std::string& text) -> std::optional<std::size_t>;
+
+#endif  // META_COMMAND_HPP
@@ -0,0 +1,1031 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/core.h>
+
+#include "../source/backend/btree.hpp"
+#include "../source/backend/byte_order.hpp"
+#include "../source/backend/crc32c.hpp"
+#include "../source/backend/hash_index.hpp"
+#include "../source/backend/index_tree.hpp"
+#include "../source/backend/key_search.hpp"
+#include "../source/backend/pager.hpp"
+#include "../source/backend/record.hpp"
+#include "../source/backend/wal.hpp"
+#include "../source/backend/wal_index.hpp"
+
+// Benchmarks are hidden; run them with `diy-sqlite_test "[benchmark]"`
+
+namespace
+{
+
+class BenchFile
+{
+public:
+  BenchFile(std::string name, std::size_t pages)
+      : m_name(std::move(name))
+  {
+    std::ofstream file(m_name, std::ios::binary | std::ios::trunc);
+    std::vector<std::byte> page(PAGE_SIZE);
+    for (std::size_t i = 0; i < pages; i++) {
+      std::fill(page.begin(), page.end(), static_cast<std::byte>(i));
+      file.write(reinterpret_cast<const char*>(page.data()),
+                 static_cast<std::streamsize>(page.size()));
+    }
+  }
+  ~BenchFile() { std::filesystem::remove(m_name); }
+
+  BenchFile(const BenchFile&) = delete;
+  BenchFile& operator=(const BenchFile&) = delete;
+  BenchFile(BenchFile&&) = delete;
+  BenchFile& operator=(BenchFile&&) = delete;
+
+  const std::string& name() const { return m_name; }
+
+private:
+  std::string m_name;
+};
+
+// Point lookups over a small hot set, interrupted by full sequential scans
+std::vector<PageId> mixed_trace(PageId db_pages, PageId hot_pages)
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<PageId> hot(0, hot_pages - 1);
+  std::vector<PageId> trace;
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 500; i++) {
+      trace.push_back(hot(rng));
+    }
+    for (PageId page = hot_pages; page < db_pages; page++) {
+      trace.push_back(page);
+    }
+  }
+  return trace;
+}
+
+// Model of the former direct-mapped m_page_table (slot = page % CACHE_PAGES)
+double direct_mapped_hit_rate(const std::vector<PageId>& trace)
+{
+  std::array<std::optional<PageId>, CACHE_PAGES> slots {};
+  std::size_t hits = 0;
+  for (auto page : trace) {
+    auto& slot = slots[page % CACHE_PAGES];
+    if (slot == page) {
+      hits++;
+    }
+    slot = page;
+  }
+  return static_cast<double>(hits) / static_cast<double>(trace.size());
+}
+
+double pager_hit_rate(const std::string& file,
+                      ReplacementPolicy policy,
+                      const std::vector<PageId>& trace)
+{
+  auto pager = create_pager(file, PagerOptions {policy});
+  for (auto page : trace) {
+    pager->pin(page);
+  }
+  return static_cast<double>(pager->get_cache_hits())
+      / static_cast<double>(trace.size());
+}
+
+}  // namespace
+
+TEST_CASE("Buffer pool hit rate under scan + point lookups", "[.benchmark]")
+{
+  constexpr PageId db_pages = 1000;
+  constexpr PageId hot_pages = 60;
+  BenchFile file("bench_policy.db", db_pages);
+  auto trace = mixed_trace(db_pages, hot_pages);
+
+  auto direct = direct_mapped_hit_rate(trace);
+  auto clock = pager_hit_rate(file.name(), ReplacementPolicy::clock, trace);
+  auto lru_k = pager_hit_rate(file.name(), ReplacementPolicy::lru_k, trace);
+
+  fmt::print(
+      "hit rate over {} accesses, {} frames\n", trace.size(), CACHE_PAGES);
+  fmt::print("  direct-mapped : {:.3f}\n", direct);
+  fmt::print("  clock         : {:.3f}\n", clock);
+  fmt::print("  lru-k (k=2)   : {:.3f}\n", lru_k);
+  CHECK(lru_k > direct);
+
+  BENCHMARK("pin: lru-k, mixed trace")
+  {
+    return pager_hit_rate(file.name(), ReplacementPolicy::lru_k, trace);
+  };
+  BENCHMARK("pin: clock, mixed trace")
+  {
+    return pager_hit_rate(file.name(), ReplacementPolicy::clock, trace);
+  };
+}
+
+TEST_CASE("Read path latency: buffer pool vs mmap", "[.benchmark]")
+{
+  constexpr PageId db_pages = 4096;
+  BenchFile file("bench_read_path.db", db_pages);
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<PageId> any_page(0, db_pages - 1);
+  std::vector<PageId> random_pages(db_pages);
+  for (auto& page : random_pages) {
+    page = any_page(rng);
+  }
+
+  auto read_all = [](Pager& pager, const std::vector<PageId>& pages)
+  {
+    std::size_t sum = 0;
+    for (auto page : pages) {
+      auto handle = pager.pin(page);
+      sum += std::to_integer<std::size_t>(handle.bytes()[PAGE_SIZE / 2]);
+    }
+    return sum;
+  };
+  std::vector<PageId> sequential_pages(db_pages);
+  for (PageId page = 0; page < db_pages; page++) {
+    sequential_pages[page] = page;
+  }
+
+  for (auto mode : {ReadMode::buffer_pool, ReadMode::mmap}) {
+    PagerOptions options;
+    options.read_mode = mode;
+    auto pager = create_pager(file.name(), options);
+    const std::string name =
+        mode == ReadMode::mmap ? "mmap" : "buffer pool";
+
+    pager->advise(AccessPattern::sequential);
+    BENCHMARK(name + ": sequential scan, 4096 pages")
+    {
+      return read_all(*pager, sequential_pages);
+    };
+    pager->advise(AccessPattern::random);
+    BENCHMARK(name + ": random reads, 4096 pages")
+    {
+      return read_all(*pager, random_pages);
+    };
+  }
+}
+
+TEST_CASE("Batched prefetch: pread vs io_uring", "[.benchmark]")
+{
+  constexpr PageId db_pages = 2048;
+  BenchFile file("bench_io_backend.db", db_pages);
+
+  for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+    PagerOptions options;
+    options.io_backend = backend;
+    options.cache_budget = db_pages * PAGE_SIZE;
+    const std::string name =
+        backend == IoBackend::io_uring ? "io_uring" : "pread";
+
+    BENCHMARK(name + ": open + prefetch 2048 pages")
+    {
+      auto pager = create_pager(file.name(), options);
+      return pager->prefetch(0, db_pages);
+    };
+  }
+}
+
+TEST_CASE("Sequential scan with and without read-ahead", "[.benchmark]")
+{
+  constexpr PageId db_pages = 4096;
+  BenchFile file("bench_read_ahead.db", db_pages);
+
+  for (std::uint32_t window : {0U, 8U, 32U}) {
+    PagerOptions options;
+    options.max_read_ahead = window;
+    options.cache_budget = 256 * PAGE_SIZE;
+
+    {
+      auto pager = create_pager(file.name(), options);
+      for (int page = 0; page < static_cast<int>(db_pages); page++) {
+        pager->get_page(page);
+      }
+      const auto& stats = pager->get_read_ahead_stats();
+      fmt::print("max window {:2}: prefetched {} used {} wasted {}\n",
+                 window,
+                 stats.prefetched,
+                 stats.used,
+                 stats.wasted);
+    }
+
+    BENCHMARK("get_page scan, max read-ahead " + std::to_string(window))
+    {
+      auto pager = create_pager(file.name(), options);
+      std::size_t sum = 0;
+      for (int page = 0; page < static_cast<int>(db_pages); page++) {
+        sum += std::to_integer<std::size_t>(pager->get_page(page)->data[0]);
+      }
+      return sum;
+    };
+  }
+}
+
+TEST_CASE("Commit: per-page writes vs sorted flush_all", "[.benchmark]")
+{
+  constexpr PageId db_pages = 1024;
+  BenchFile file("bench_flush.db", db_pages);
+  PagerOptions options;
+  options.cache_budget = db_pages * PAGE_SIZE;
+  auto pager = create_pager(file.name(), options);
+
+  // Dirty every page in a scattered order
+  std::vector<PageId> pages(db_pages);
+  for (PageId page = 0; page < db_pages; page++) {
+    pages[page] = page;
+  }
+  std::shuffle(pages.begin(), pages.end(), std::mt19937(3));
+  auto dirty_all = [&]
+  {
+    for (auto page : pages) {
+      auto handle = pager->pin(page);
+      handle.mark_dirty();
+    }
+  };
+
+  // Both variants end with one fdatasync; only the writes differ
+  BENCHMARK("1024 dirty pages: flush each in dirtying order")
+  {
+    dirty_all();
+    for (auto page : pages) {
+      pager->flush(static_cast<int>(page));
+    }
+    pager->flush_all();
+  };
+  BENCHMARK("1024 dirty pages: flush_all (sorted, coalesced, 1 sync)")
+  {
+    dirty_all();
+    pager->flush_all();
+  };
+}
+
+TEST_CASE("Random reads past the pool: buffered vs O_DIRECT", "[.benchmark]")
+{
+  constexpr PageId db_pages = 16384;
+  BenchFile file("bench_direct_io.db", db_pages);
+
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<PageId> any_page(0, db_pages - 1);
+  std::vector<PageId> trace(8192);
+  for (auto& page : trace) {
+    page = any_page(rng);
+  }
+
+  // Buffered misses are served from the kernel page cache, which holds a
+  // second copy of the file; direct misses always reach the device
+  for (bool direct : {false, true}) {
+    PagerOptions options;
+    options.direct_io = direct;
+    options.cache_budget = 1024 * PAGE_SIZE;
+    auto pager = create_pager(file.name(), options);
+    if (direct && !pager->get_direct_io()) {
+      fmt::print("O_DIRECT refused by the filesystem, skipping\n");
+      continue;
+    }
+    const std::string name = direct ? "O_DIRECT" : "buffered";
+
+    BENCHMARK(name + ": 8192 random pins, 1024 frames, 16384 pages")
+    {
+      std::size_t sum = 0;
+      for (auto page : trace) {
+        sum += std::to_integer<std::size_t>(pager->pin(page).bytes()[0]);
+      }
+      return sum;
+    };
+  }
+}
+
+TEST_CASE("Page checksum overhead", "[.benchmark]")
+{
+  std::vector<std::byte> page(PAGE_SIZE);
+  std::mt19937 rng(13);
+  for (auto& byte : page) {
+    byte = static_cast<std::byte>(rng());
+  }
+  fmt::print("crc32c implementation: {}\n", crc32c_implementation());
+
+  BENCHMARK("crc32c, 4096-byte page")
+  {
+    return crc32c(page.data(), page.size());
+  };
+  BENCHMARK("crc32c table fallback, 4096-byte page")
+  {
+    return crc32c_portable(page.data(), page.size());
+  };
+
+  // Every pin misses the pool and verifies the page it reads
+  constexpr PageId db_pages = 4096;
+  for (bool checksums : {false, true}) {
+    const std::string file_name = "bench_checksums.db";
+    std::filesystem::remove(file_name);
+    std::ofstream(file_name, std::ios::binary).close();
+    PagerOptions options;
+    options.page_checksums = checksums;
+    options.cache_budget = db_pages * PAGE_SIZE;
+    {
+      auto pager = create_pager(file_name, options);
+      for (PageId page = 1; page < db_pages; page++) {
+        pager->allocate_page();
+      }
+    }
+
+    options.cache_budget = 64 * PAGE_SIZE;
+    options.max_read_ahead = 0;
+    BENCHMARK(std::string(checksums ? "checksums" : "no checksums")
+              + ": read 4096 pages through a 64-frame pool")
+    {
+      auto pager = create_pager(file_name, options);
+      std::size_t sum = 0;
+      for (PageId page = 0; page < db_pages; page++) {
+        sum += std::to_integer<std::size_t>(pager->pin(page).bytes()[0]);
+      }
+      return sum;
+    };
+    std::filesystem::remove(file_name);
+  }
+}
+
+TEST_CASE("Concurrent random reads: 1..N threads", "[.benchmark]")
+{
+  constexpr PageId db_pages = 4096;
+  constexpr std::size_t reads_per_thread = 100000;
+  BenchFile file("bench_threads.db", db_pages);
+
+  // Warm pool: only the latching is measured, not the disk
+  PagerOptions options;
+  options.cache_budget = db_pages * PAGE_SIZE;
+  auto pager = create_pager(file.name(), options);
+  pager->prefetch(0, db_pages);
+
+  const unsigned max_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    BENCHMARK(std::to_string(threads) + " threads x 100000 random pins")
+    {
+      std::vector<std::thread> workers;
+      std::vector<std::size_t> sums(threads);
+      for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(
+            [&, t]
+            {
+              std::mt19937 rng(t);
+              std::uniform_int_distribution<PageId> any_page(
+                  0, db_pages - 1);
+              for (std::size_t i = 0; i < reads_per_thread; i++) {
+                auto handle = pager->pin(any_page(rng));
+                sums[t] += std::to_integer<std::size_t>(handle.bytes()[0]);
+              }
+            });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+      return sums;
+    };
+  }
+}
+
+TEST_CASE("WAL group commit: commits/sec vs batch size", "[.benchmark]")
+{
+  constexpr int commits_per_thread = 50;
+  const std::string file_name = "bench_wal.db-wal";
+  const std::vector<std::byte> page(PAGE_SIZE, std::byte {7});
+
+  // Each commit is one page; the batch size is how many commits share an
+  // append and an fdatasync, reported after each run
+  const unsigned max_threads =
+      std::max(16U, std::thread::hardware_concurrency());
+  for (auto delay : {std::chrono::microseconds(0),
+                     std::chrono::microseconds(200)})
+  {
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+      WalOptions options;
+      options.max_commit_delay = delay;
+      options.max_batch_frames = threads;
+      Wal wal(file_name, PAGE_SIZE, options, true);
+
+      BENCHMARK(fmt::format("{} threads x {} commits, delay {} us",
+                            threads,
+                            commits_per_thread,
+                            delay.count()))
+      {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+          workers.emplace_back(
+              [&, t]
+              {
+                for (int i = 0; i < commits_per_thread; i++) {
+                  wal.commit({{t, page.data()}}, threads);
+                }
+              });
+        }
+        for (auto& worker : workers) {
+          worker.join();
+        }
+      };
+      const auto stats = wal.stats();
+      fmt::print("{} threads, delay {} us: {:.1f} commits per sync\n",
+                 threads,
+                 delay.count(),
+                 stats.commits_per_sync());
+    }
+  }
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("WAL index lookups while a writer appends", "[.benchmark]")
+{
+  constexpr std::uint32_t page_count = 10000;
+  constexpr int lookups = 100000;
+
+  // Readers look pages up under fresh snapshots while the writer keeps
+  // indexing and publishing; neither side takes a lock. The writer resets
+  // the index now and then to bound its memory
+  for (unsigned threads = 1; threads <= 8; threads *= 2) {
+    WalIndex index;
+    for (std::uint64_t frame = 1; frame <= page_count; frame++) {
+      index.append(static_cast<std::uint32_t>(frame), frame);
+    }
+    index.publish(page_count);
+
+    std::atomic<bool> done {false};
+    std::thread writer(
+        [&]
+        {
+          for (std::uint64_t frame = page_count + 1; !done; frame++) {
+            index.append(static_cast<std::uint32_t>(frame % page_count),
+                         frame);
+            index.publish(frame);
+            if (frame % (16 * WalIndex::SEGMENT_FRAMES) == 0) {
+              index.reset();
+            }
+          }
+        });
+
+    BENCHMARK(fmt::format("{} readers x {} lookups", threads, lookups))
+    {
+      std::vector<std::thread> readers;
+      for (unsigned t = 0; t < threads; t++) {
+        readers.emplace_back(
+            [&, t]
+            {
+              std::mt19937 rng(t);
+              std::uniform_int_distribution<std::uint32_t> dist(
+                  0, page_count - 1);
+              for (int i = 0; i < lookups; i++) {
+                const auto snapshot = index.snapshot();
+                index.lookup(dist(rng), snapshot);
+              }
+            });
+      }
+      for (auto& reader : readers) {
+        reader.join();
+      }
+    };
+    done = true;
+    writer.join();
+  }
+}
+
+TEST_CASE("WAL commit latency with background checkpoints", "[.benchmark]")
+{
+  constexpr PageId pages = 256;
+  constexpr int commits = 200;
+  const std::string file_name = "bench_checkpoint.db";
+
+  // Single-page commits over a small database; checkpoints copy the log
+  // back underneath, paced by the I/O budget
+  for (bool background : {false, true}) {
+    std::filesystem::remove(file_name);
+    std::ofstream(file_name, std::ios::binary).close();
+    PagerOptions options;
+    options.wal = true;
+    options.checkpoint_options.background = background;
+    options.checkpoint_options.wal_bytes = 64 * PAGE_SIZE;
+    options.checkpoint_options.io_budget = 64U << 20U;
+    auto pager = create_pager(file_name, options);
+    for (PageId page = 1; page < pages; page++) {
+      pager->allocate_page();
+    }
+    pager->flush_all();
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<PageId> dist(1, pages - 1);
+    BENCHMARK(fmt::format("{} commits, background checkpoints {}",
+                          commits,
+                          background ? "on" : "off"))
+    {
+      for (int i = 0; i < commits; i++) {
+        const PageId page = dist(rng);
+        pager->pin(page).mark_dirty();
+        pager->flush(static_cast<int>(page));
+      }
+    };
+    const auto stats = pager->stats();
+    fmt::print("checkpoints {}: {} runs, {} pages copied, log {} bytes, "
+               "commit p99 {} us\n",
+               background ? "on" : "off",
+               stats.checkpoint.checkpoints,
+               stats.checkpoint.pages_copied,
+               stats.wal.size,
+               stats.wal.commit_latency.percentile(0.99) / 1000);
+    pager.reset();
+    std::filesystem::remove(Wal::wal_path(file_name));
+  }
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("WAL recovery: startup time vs threads", "[.benchmark]")
+{
+  constexpr std::uint32_t frames = 16384;
+  constexpr std::uint32_t commit_frames = 64;
+  const std::string file_name = "bench_recovery.db-wal";
+
+  // A 64 MiB log of commits over 4096 pages, reopened from a warm page
+  // cache, so that the scan is bound by checksums and merging
+  {
+    Wal wal(file_name, PAGE_SIZE, {}, true);
+    std::vector<std::vector<std::byte>> images(
+        commit_frames, std::vector<std::byte>(PAGE_SIZE, std::byte {3}));
+    std::vector<WalPage> commit(commit_frames);
+    for (std::uint32_t first = 0; first < frames; first += commit_frames) {
+      for (std::uint32_t i = 0; i < commit_frames; i++) {
+        commit[i] = {(first + i) % 4096, images[i].data()};
+      }
+      wal.commit(commit, 4096);
+    }
+  }
+
+  for (unsigned threads = 1; threads <= 8; threads *= 2) {
+    WalOptions options;
+    options.recovery_threads = threads;
+    BENCHMARK(fmt::format("{} frames, {} recovery threads", frames, threads))
+    {
+      return Wal(file_name, PAGE_SIZE, options, false).last_commit();
+    };
+  }
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("B+tree seeks and scans", "[.benchmark]")
+{
+  constexpr std::int64_t rows = 100000;
+  const std::string file_name = "bench_btree.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  // 100-byte rows inserted in random order, so that leaves are split in
+  // the middle rather than filled by appends
+  auto pager = create_pager(file_name);
+  BTree tree(*pager, BTree::create(*pager));
+  std::vector<std::int64_t> rowids(rows);
+  std::iota(rowids.begin(), rowids.end(), 0);
+  std::mt19937 rng(11);
+  std::shuffle(rowids.begin(), rowids.end(), rng);
+  const std::vector<std::byte> row(100, std::byte {5});
+  for (const std::int64_t rowid : rowids) {
+    tree.insert(rowid, row);
+  }
+  fmt::print("{} rows: depth {}, {} pages\n",
+             rows,
+             tree.depth(),
+             pager->get_num_pages());
+
+  std::uniform_int_distribution<std::int64_t> dist(0, rows - 1);
+  BENCHMARK("10000 point seeks")
+  {
+    BTreeCursor cursor(tree);
+    std::int64_t sum = 0;
+    for (int i = 0; i < 10000; i++) {
+      cursor.seek(dist(rng));
+      sum += cursor.rowid();
+    }
+    return sum;
+  };
+
+  BENCHMARK("100 range scans of 1000 rows")
+  {
+    BTreeCursor cursor(tree);
+    std::size_t bytes = 0;
+    for (int i = 0; i < 100; i++) {
+      bool valid = cursor.seek(dist(rng));
+      for (int n = 0; valid && n < 1000; n++, valid = cursor.next()) {
+        bytes += cursor.payload_size();
+      }
+    }
+    return bytes;
+  };
+
+  BENCHMARK("Full scan")
+  {
+    BTreeCursor cursor(tree);
+    std::int64_t count = 0;
+    for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+      count++;
+    }
+    return count;
+  };
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("B+tree point lookups: 1..N reader threads", "[.benchmark]")
+{
+  constexpr std::int64_t rows = 200000;
+  constexpr int lookups_per_thread = 100000;
+  const std::string file_name = "bench_btree_threads.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  // The pool holds the whole tree: only the traversal is measured
+  PagerOptions options;
+  options.cache_budget = PAGE_SIZE * 16384;
+  auto pager = create_pager(file_name, options);
+  const PageId root = BTree::create(*pager);
+  BTree tree(*pager, root);
+  const std::vector<std::byte> row(100, std::byte {5});
+  for (std::int64_t rowid = 0; rowid < rows; rowid += 2) {
+    tree.insert(rowid, row);
+  }
+  fmt::print("{} rows: depth {}, {} pages\n",
+             rows / 2,
+             tree.depth(),
+             pager->get_num_pages());
+
+  const auto run_readers = [&](unsigned threads)
+  {
+    std::vector<std::thread> readers;
+    std::vector<std::size_t> found(threads);
+    for (unsigned t = 0; t < threads; t++) {
+      readers.emplace_back(
+          [&, t]
+          {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<std::int64_t> dist(0, rows - 1);
+            for (int i = 0; i < lookups_per_thread; i++) {
+              found[t] += tree.find(dist(rng)).has_value() ? 1 : 0;
+            }
+          });
+    }
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    return found;
+  };
+
+  // Readers alone, then alongside a writer filling in the odd rowids,
+  // whose splits make them restart now and then
+  const unsigned max_threads =
+      std::max(8U, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    BENCHMARK(fmt::format("{} threads x {} lookups", threads,
+                          lookups_per_thread))
+    {
+      return run_readers(threads);
+    };
+  }
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    std::atomic<bool> done {false};
+    std::thread writer(
+        [&]
+        {
+          for (std::int64_t rowid = 1; !done; rowid += 2) {
+            tree.insert(rowid % rows, row);
+            tree.erase(rowid % rows);
+          }
+        });
+    BENCHMARK(fmt::format("{} threads x {} lookups, with a writer", threads,
+                          lookups_per_thread))
+    {
+      return run_readers(threads);
+    };
+    done = true;
+    writer.join();
+  }
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("B+tree bulk load vs row-at-a-time inserts", "[.benchmark]")
+{
+  constexpr std::int64_t rows = 20000;
+  const std::string file_name = "bench_bulk_load.db";
+  const std::vector<std::byte> row(100, std::byte {5});
+
+  // Each run builds a sorted table in a fresh file and writes it back
+  const auto build = [&](bool bulk)
+  {
+    std::filesystem::remove(file_name);
+    std::ofstream(file_name, std::ios::binary).close();
+    auto pager = create_pager(file_name);
+    if (bulk) {
+      BTreeLoader loader(*pager, {100});
+      for (std::int64_t rowid = 0; rowid < rows; rowid++) {
+        loader.add(rowid, row);
+      }
+      loader.finish();
+    } else {
+      BTree tree(*pager, BTree::create(*pager));
+      for (std::int64_t rowid = 0; rowid < rows; rowid++) {
+        tree.insert(rowid, row);
+      }
+    }
+    return pager->get_num_pages();
+  };
+
+  fmt::print("{} rows: {} pages bulk loaded, {} pages inserted\n",
+             rows,
+             build(true),
+             build(false));
+  BENCHMARK(fmt::format("Bulk load {} sorted rows", rows))
+  {
+    return build(true);
+  };
+  BENCHMARK(fmt::format("Insert {} sorted rows one at a time", rows))
+  {
+    return build(false);
+  };
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Index build: bulk load vs entry-at-a-time inserts",
+          "[.benchmark]")
+{
+  constexpr std::int64_t rows = 20000;
+  const std::string file_name = "bench_index_build.db";
+
+  // The entries CREATE INDEX makes of a random TEXT column, sorted
+  std::mt19937 rng(21);
+  std::uniform_int_distribution<int> letters('a', 'z');
+  std::vector<std::vector<std::byte>> keys;
+  for (std::int64_t rowid = 0; rowid < rows; rowid++) {
+    std::string text(12, ' ');
+    for (char& letter : text) {
+      letter = static_cast<char>(letters(rng));
+    }
+    std::vector<std::byte> key;
+    append_key(key, text);
+    append_key_rowid(key, rowid);
+    keys.push_back(std::move(key));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  // Each run builds the index in a fresh file and writes it back; the
+  // loader fills leaves to 90 percent like CREATE INDEX
+  const auto build = [&](bool bulk)
+  {
+    std::filesystem::remove(file_name);
+    std::ofstream(file_name, std::ios::binary).close();
+    auto pager = create_pager(file_name);
+    const IndexTree tree(*pager, IndexTree::create(*pager));
+    if (bulk) {
+      IndexLoader loader(*pager);
+      for (const auto& key : keys) {
+        loader.add(key, {});
+      }
+      loader.finish(tree.root());
+    } else {
+      IndexTree writer(*pager, tree.root());
+      for (const auto& key : keys) {
+        writer.insert(key, {});
+      }
+    }
+    return pager->get_num_pages();
+  };
+
+  fmt::print("{} entries: {} pages bulk loaded, {} pages inserted\n",
+             rows,
+             build(true),
+             build(false));
+  BENCHMARK(fmt::format("Bulk load {} sorted entries", rows))
+  {
+    return build(true);
+  };
+  BENCHMARK(fmt::format("Insert {} sorted entries one at a time", rows))
+  {
+    return build(false);
+  };
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Interior node key search", "[.benchmark]")
+{
+  // 1024 full interior nodes of a 4 KiB-page tree, 340 keys each, probed
+  // in random order so that most searches miss the cache
+  constexpr std::size_t nodes = 1024;
+  constexpr std::size_t keys_per_node = 340;
+  constexpr int probes = 100000;
+  std::mt19937_64 rng(13);
+  std::vector<std::int64_t> keys(nodes * keys_per_node);
+  std::vector<std::byte> encoded(keys.size() * 8);
+  for (std::size_t node = 0; node < nodes; node++) {
+    std::int64_t key = 0;
+    for (std::size_t i = 0; i < keys_per_node; i++) {
+      key += static_cast<std::int64_t>(rng() % 1000 + 1);
+      keys[node * keys_per_node + i] = key;
+    }
+  }
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    store_u64(encoded.data() + i * 8, static_cast<std::uint64_t>(keys[i]));
+  }
+  std::vector<std::pair<std::size_t, std::int64_t>> lookups(probes);
+  for (auto& [node, key] : lookups) {
+    node = rng() % nodes;
+    key = static_cast<std::int64_t>(rng() % (keys_per_node * 500));
+  }
+
+  fmt::print("key search implementation: {}\n", key_search_implementation());
+  BENCHMARK(fmt::format("{} searches, key_lower_bound", probes))
+  {
+    std::size_t sum = 0;
+    for (const auto& [node, key] : lookups) {
+      sum += key_lower_bound(
+          encoded.data() + node * keys_per_node * 8, keys_per_node, key);
+    }
+    return sum;
+  };
+  BENCHMARK(fmt::format("{} searches, scalar fallback", probes))
+  {
+    std::size_t sum = 0;
+    for (const auto& [node, key] : lookups) {
+      sum += key_lower_bound_portable(
+          encoded.data() + node * keys_per_node * 8, keys_per_node, key);
+    }
+    return sum;
+  };
+  BENCHMARK(fmt::format("{} searches, std::lower_bound", probes))
+  {
+    std::size_t sum = 0;
+    for (const auto& [node, key] : lookups) {
+      const auto first = keys.begin()
+          + static_cast<std::ptrdiff_t>(node * keys_per_node);
+      sum += static_cast<std::size_t>(
+          std::lower_bound(first, first + keys_per_node, key) - first);
+    }
+    return sum;
+  };
+}
+
+TEST_CASE("Index equality lookups: hash vs B+tree", "[.benchmark]")
+{
+  constexpr std::int64_t rows = 50000;
+  const std::string file_name = "bench_hash.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  // The same entries in both, keyed by an integer column, as CREATE INDEX
+  // builds them; the pool holds both, so lookups cost page reads in memory
+  PagerOptions options;
+  options.cache_budget = PAGE_SIZE * 8192;
+  auto pager = create_pager(file_name, options);
+  IndexTree tree(*pager, IndexTree::create(*pager));
+  HashIndex hash(*pager, HashIndex::create(*pager));
+  const auto key_of = [](std::int64_t value) {
+    std::vector<std::byte> key;
+    append_key(key, value);
+    return key;
+  };
+  for (std::int64_t value = 0; value < rows; value++) {
+    std::vector<std::byte> key = key_of(value);
+    hash.insert(key, value, {});
+    append_key_rowid(key, value);
+    tree.insert(key, {});
+  }
+  fmt::print("{} entries: B+tree depth {}, {} hash buckets, {} pages\n",
+             rows,
+             tree.depth(),
+             hash.buckets(),
+             pager->get_num_pages());
+
+  std::mt19937 rng(22);
+  std::uniform_int_distribution<std::int64_t> dist(0, rows - 1);
+  // Pages pinned per lookup: fixed for the hash index, the depth for the
+  // tree
+  const auto pins = [&] {
+    const PagerStats stats = pager->stats();
+    return stats.hits + stats.misses;
+  };
+  const std::uint64_t before = pins();
+  for (int i = 0; i < 1000; i++) {
+    HashCursor(hash).find(key_of(dist(rng)));
+  }
+  const std::uint64_t between = pins();
+  for (int i = 0; i < 1000; i++) {
+    IndexCursor(tree).seek(key_of(dist(rng)));
+  }
+  fmt::print("pages per lookup: hash {:.2f}, B+tree {:.2f}\n",
+             static_cast<double>(between - before) / 1000,
+             static_cast<double>(pins() - between) / 1000);
+
+  BENCHMARK("10000 hash index lookups")
+  {
+    HashCursor cursor(hash);
+    std::int64_t sum = 0;
+    for (int i = 0; i < 10000; i++) {
+      cursor.find(key_of(dist(rng)));
+      sum += cursor.rowid();
+    }
+    return sum;
+  };
+
+  BENCHMARK("10000 B+tree index seeks")
+  {
+    IndexCursor cursor(tree);
+    std::size_t sum = 0;
+    for (int i = 0; i < 10000; i++) {
+      cursor.seek(key_of(dist(rng)));
+      sum += cursor.key_size();
+    }
+    return sum;
+  };
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Record decode: narrow and wide rows", "[.benchmark]")
+{
+  constexpr int rows = 10000;
+  // Narrow rows as in a table of ids and names; wide ones of 64 columns,
+  // alternating integers of every width and texts past 127 bytes, whose
+  // serial types take two-byte varints
+  std::mt19937_64 rng(25);
+  const auto shape = [&](std::size_t columns, std::size_t text_size) {
+    std::vector<std::vector<std::byte>> records;
+    for (int i = 0; i < rows; i++) {
+      std::vector<Value> values;
+      for (std::size_t c = 0; c < columns; c++) {
+        if (c % 2 == 0) {
+          values.emplace_back(
+              static_cast<std::int64_t>(rng() >> (rng() % 64)));
+        } else {
+          values.emplace_back(std::string(text_size, 'v'));
+        }
+      }
+      records.push_back(encode_record(values));
+    }
+    return records;
+  };
+
+  for (const auto& [name, columns, text_size] :
+       {std::tuple<const char*, std::size_t, std::size_t> {"narrow", 4, 12},
+        std::tuple<const char*, std::size_t, std::size_t> {"wide", 64, 150}})
+  {
+    const auto records = shape(columns, text_size);
+    std::size_t bytes = 0;
+    for (const auto& record : records) {
+      bytes += record.size();
+    }
+    fmt::print("{} rows: {} columns, {} bytes each\n",
+               name,
+               columns,
+               bytes / records.size());
+
+    BENCHMARK(fmt::format("{} x {}: decode every column", rows, name))
+    {
+      std::size_t decoded = 0;
+      for (const auto& record : records) {
+        decoded += decode_record(record.data(), record.size()).size();
+      }
+      return decoded;
+    };
+
+    BENCHMARK(fmt::format("{} x {}: view every column", rows, name))
+    {
+      RecordView view;
+      std::size_t seen = 0;
+      for (const auto& record : records) {
+        view.reset(record.data(), record.size());
+        for (std::size_t k = 0; k < view.columns(); k++) {
+          seen += view.column(k).index();
+        }
+      }
+      return seen;
+    };
+
+    BENCHMARK(fmt::format("{} x {}: view the last column", rows, name))
+    {
+      RecordView view;
+      std::size_t seen = 0;
+      for (const auto& record : records) {
+        view.reset(record.data(), record.size());
+        seen += std::get<std::string_view>(view.column(columns - 1)).size();
+      }
+      return seen;
+    };
+  }
+}
@@ -1,5 +1,8 @@
 #include <filesystem>
+#include <fstream>
 #include <random>
+#include <set>
+#include <thread>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -119,4 +122,1313 @@ TEST_CASE("File Persistence", "[pager]")
   }
 
   fixture.TearDown();
-}
\ No newline at end of file
+}
+TEST_CASE("Pinned Page Handles", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+
+  SECTION("Handle points into the cache")
+  {
+    auto pager = create_pager("test.db");
+    auto handle = pager->pin(0);
+    REQUIRE(handle);
+    REQUIRE(handle.id() == 0);
+    REQUIRE_FALSE(handle.dirty());
+
+    handle.bytes()[0] = std::byte {0xCC};
+    auto again = pager->pin(0);
+    REQUIRE(again.bytes() == handle.bytes());
+    REQUIRE(again.bytes()[0] == std::byte {0xCC});
+    REQUIRE(pager->get_cache_hits() == 1);
+  }
+
+  SECTION("Dirty pages are written back on close")
+  {
+    {
+      auto pager = create_pager("test.db");
+      auto handle = pager->pin(0);
+      std::fill_n(handle.bytes(), PAGE_SIZE, std::byte {0xDD});
+      handle.mark_dirty();
+      REQUIRE(handle.dirty());
+    }
+    auto pager = create_pager("test.db");
+    REQUIRE(pager->get_page(0)->data[PAGE_SIZE - 1] == std::byte {0xDD});
+  }
+
+  SECTION("Moved handles keep a single pin")
+  {
+    auto pager = create_pager("test.db");
+    PageHandle outer;
+    {
+      auto inner = pager->pin(0);
+      outer = std::move(inner);
+      REQUIRE_FALSE(inner);
+    }
+    REQUIRE(outer);
+    outer.release();
+    REQUIRE_FALSE(outer);
+  }
+
+  fixture.TearDown();
+}
+
+void append_zero_pages(const std::string& file_name, std::size_t count)
+{
+  std::ofstream file(file_name, std::ios::binary | std::ios::app);
+  std::vector<std::byte> zeros(PAGE_SIZE * count, std::byte {0});
+  file.write(reinterpret_cast<const char*>(zeros.data()),
+             static_cast<std::streamsize>(zeros.size()));
+}
+
+TEST_CASE("Pinned Frames Are Never Evicted", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, CACHE_PAGES);
+
+  auto pager = create_pager("test.db");
+  REQUIRE(pager->get_num_pages() == CACHE_PAGES + 1);
+
+  std::vector<PageHandle> pinned;
+  for (PageId page = 0; page < CACHE_PAGES; page++) {
+    pinned.push_back(pager->pin(page));
+  }
+  pinned[0].bytes()[0] = std::byte {0x11};
+  REQUIRE_THROWS_AS(pager->pin(CACHE_PAGES), std::runtime_error);
+  REQUIRE(pinned[0].bytes()[0] == std::byte {0x11});
+
+  pinned[1].release();
+  REQUIRE_NOTHROW(pager->pin(CACHE_PAGES));
+  REQUIRE(pinned[0].bytes()[0] == std::byte {0x11});
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Fully Associative Cache", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, CACHE_PAGES);
+
+  SECTION("Pages mapping to the same slot no longer conflict")
+  {
+    auto pager = create_pager("test.db");
+    pager->pin(0);
+    pager->pin(CACHE_PAGES);
+    pager->pin(0);
+    pager->pin(CACHE_PAGES);
+    REQUIRE(pager->get_cache_hits() == 2);
+  }
+
+  SECTION("LRU-K keeps the working set across a sequential scan")
+  {
+    auto run = [](ReplacementPolicy policy)
+    {
+      auto pager = create_pager("test.db", PagerOptions {policy});
+      constexpr PageId hot_pages = 10;
+      for (int round = 0; round < 2; round++) {
+        for (PageId page = 0; page < hot_pages; page++) {
+          pager->pin(page);
+        }
+      }
+      for (PageId page = hot_pages; page <= CACHE_PAGES; page++) {
+        pager->pin(page);
+      }
+      auto before = pager->get_cache_hits();
+      for (PageId page = 0; page < hot_pages; page++) {
+        pager->pin(page);
+      }
+      return pager->get_cache_hits() - before;
+    };
+
+    REQUIRE(run(ReplacementPolicy::lru_k) == 10);
+    REQUIRE(run(ReplacementPolicy::clock) < 10);
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Runtime Cache Budget", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 15);
+
+  PagerOptions options;
+  options.cache_budget = 8 * PAGE_SIZE;
+  options.max_cache_budget = 64 * PAGE_SIZE;
+  auto pager = create_pager("test.db", options);
+  REQUIRE(pager->get_cache_frames() == 8);
+
+  SECTION("Growing keeps pinned pages in place")
+  {
+    auto handle = pager->pin(3);
+    handle.bytes()[0] = std::byte {0x33};
+    pager->set_cache_budget(16 * PAGE_SIZE);
+    REQUIRE(pager->get_cache_frames() == 16);
+    REQUIRE(pager->get_cache_budget() == 16 * PAGE_SIZE);
+    REQUIRE(handle.bytes()[0] == std::byte {0x33});
+    for (PageId page = 0; page < 16; page++) {
+      pager->pin(page);
+    }
+  }
+
+  SECTION("Shrinking writes back dirty pages")
+  {
+    for (PageId page = 0; page < 8; page++) {
+      auto handle = pager->pin(page);
+      handle.bytes()[0] = static_cast<std::byte>(page + 1);
+      handle.mark_dirty();
+    }
+    pager->set_cache_budget(2 * PAGE_SIZE);
+    REQUIRE(pager->get_cache_frames() == 2);
+    for (PageId page = 0; page < 8; page++) {
+      REQUIRE(pager->pin(page).bytes()[0] == static_cast<std::byte>(page + 1));
+    }
+  }
+
+  SECTION("Invalid budgets are rejected")
+  {
+    REQUIRE_THROWS_AS(pager->set_cache_budget(PAGE_SIZE - 1),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(pager->set_cache_budget(65 * PAGE_SIZE),
+                      std::length_error);
+
+    std::vector<PageHandle> pinned;
+    for (PageId page = 0; page < 8; page++) {
+      pinned.push_back(pager->pin(page));
+    }
+    REQUIRE_THROWS_AS(pager->set_cache_budget(4 * PAGE_SIZE),
+                      std::runtime_error);
+    REQUIRE(pager->get_cache_frames() == 8);
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Page Size Header", "[pager]")
+{
+  const std::string file_name = "header_test.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  {
+    PagerOptions options;
+    options.page_size = 8192;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_page_size() == 8192);
+    REQUIRE(pager->get_num_pages() == 1);
+    REQUIRE(pager->get_cache_frames() == PAGE_SIZE * CACHE_PAGES / 8192);
+  }
+
+  // The stored page size wins over the default
+  auto pager = create_pager(file_name);
+  REQUIRE(pager->get_page_size() == 8192);
+  REQUIRE(std::filesystem::file_size(file_name) == 8192);
+
+  PagerOptions invalid;
+  invalid.page_size = 1000;
+  REQUIRE_THROWS_AS(create_pager(file_name, invalid), std::invalid_argument);
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Memory-Mapped Reads", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 3);
+
+  {
+    auto pager = create_pager("test.db");
+    auto handle = pager->pin(2);
+    std::fill_n(handle.bytes(), PAGE_SIZE, std::byte {0x22});
+    handle.mark_dirty();
+  }
+
+  PagerOptions options;
+  options.read_mode = ReadMode::mmap;
+
+  SECTION("Clean pages are read in place")
+  {
+    auto pager = create_pager("test.db", options);
+    auto handle = pager->pin(2);
+    REQUIRE(handle.bytes()[PAGE_SIZE - 1] == std::byte {0x22});
+    REQUIRE_FALSE(handle.dirty());
+
+    auto again = pager->pin(2);
+    REQUIRE(again.bytes() == handle.bytes());
+    REQUIRE(pager->get_cache_hits() == 0);
+    pager->advise(AccessPattern::sequential);
+  }
+
+  SECTION("Writers get a private frame")
+  {
+    {
+      auto pager = create_pager("test.db", options);
+      auto reader = pager->pin(1);
+      auto writer = pager->pin(1);
+      const std::byte* mapped = writer.bytes();
+
+      writer.mark_dirty();
+      REQUIRE(writer.dirty());
+      REQUIRE(writer.bytes() != mapped);
+      writer.bytes()[0] = std::byte {0x44};
+      REQUIRE(reader.bytes()[0] == std::byte {0});
+
+      // Later readers see the dirty frame
+      REQUIRE(pager->pin(1).bytes() == writer.bytes());
+    }
+    auto pager = create_pager("test.db", options);
+    REQUIRE(pager->pin(1).bytes()[0] == std::byte {0x44});
+    REQUIRE(pager->pin(2).bytes()[0] == std::byte {0x22});
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Batched Prefetch", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 31);
+
+  for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+    PagerOptions options;
+    options.io_backend = backend;
+    options.cache_budget = 16 * PAGE_SIZE;
+    {
+      auto pager = create_pager("test.db", options);
+      for (PageId page = 0; page < 32; page++) {
+        auto handle = pager->pin(page);
+        handle.bytes()[0] = static_cast<std::byte>(page);
+        handle.mark_dirty();
+      }
+    }
+
+    auto pager = create_pager("test.db", options);
+    REQUIRE(pager->prefetch(4, 8) == 8);
+    // Already resident pages are skipped, the run is clamped to the file
+    REQUIRE(pager->prefetch(8, 8) == 4);
+    REQUIRE(pager->prefetch(28, 100) == 4);
+    REQUIRE(pager->prefetch(40, 1) == 0);
+    for (PageId page = 4; page < 16; page++) {
+      REQUIRE(pager->pin(page).bytes()[0] == static_cast<std::byte>(page));
+    }
+    REQUIRE(pager->pin(31).bytes()[0] == std::byte {31});
+    REQUIRE(pager->get_cache_hits() == 13);
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Sequential Read-Ahead", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 63);
+
+  PagerOptions options;
+  options.cache_budget = 32 * PAGE_SIZE;
+  {
+    auto pager = create_pager("test.db", options);
+    for (PageId page = 0; page < 64; page++) {
+      auto handle = pager->pin(page);
+      handle.bytes()[0] = static_cast<std::byte>(page);
+      handle.mark_dirty();
+    }
+  }
+
+  SECTION("A scan is served from read-ahead")
+  {
+    auto pager = create_pager("test.db", options);
+    for (int page = 0; page < 64; page++) {
+      REQUIRE(pager->get_page(page)->data[0] == static_cast<std::byte>(page));
+    }
+    const auto& stats = pager->get_read_ahead_stats();
+    REQUIRE(stats.prefetched > 0);
+    REQUIRE(stats.used == stats.prefetched);
+    REQUIRE(stats.wasted == 0);
+    // Only the pages before the run was recognised miss
+    REQUIRE(pager->get_cache_hits() == 64 - 3);
+  }
+
+  SECTION("Random access reads nothing ahead")
+  {
+    auto pager = create_pager("test.db", options);
+    for (PageId page : {7U, 3U, 40U, 41U, 12U, 13U, 60U, 2U}) {
+      pager->pin(page);
+    }
+    REQUIRE(pager->get_read_ahead_stats().prefetched == 0);
+  }
+
+  SECTION("Read-ahead can be disabled")
+  {
+    options.max_read_ahead = 0;
+    auto pager = create_pager("test.db", options);
+    for (PageId page = 0; page < 64; page++) {
+      pager->pin(page);
+    }
+    REQUIRE(pager->get_read_ahead_stats().prefetched == 0);
+    REQUIRE(pager->get_cache_hits() == 0);
+  }
+
+  SECTION("Pages evicted before use count as wasted")
+  {
+    options.cache_budget = 8 * PAGE_SIZE;
+    auto pager = create_pager("test.db", options);
+    REQUIRE(pager->prefetch(0, 8) == 8);
+    pager->pin(0);
+    for (PageId page = 20; page < 36; page += 2) {
+      pager->pin(page);
+    }
+    const auto& stats = pager->get_read_ahead_stats();
+    REQUIRE(stats.prefetched == 8);
+    REQUIRE(stats.used == 1);
+    REQUIRE(stats.wasted == 7);
+  }
+
+  SECTION("Waste caused by another thread shrinks the window of a scan")
+  {
+    auto pager = create_pager("test.db", options);
+    // Reads 3-6 ahead
+    for (PageId page = 0; page < 3; page++) {
+      pager->pin(page);
+    }
+    std::thread([&pager] {
+      pager->prefetch(32, 16);
+      for (PageId page = 63; page >= 50; page--) {
+        pager->pin(page);
+      }
+    }).join();
+    const auto before = pager->get_read_ahead_stats();
+    REQUIRE(before.wasted > 0);
+
+    // The next window would have doubled to 8 pages without the waste
+    PageId page = 3;
+    while (pager->get_read_ahead_stats().prefetched == before.prefetched) {
+      REQUIRE(page < 64);
+      pager->pin(page++);
+    }
+    REQUIRE(pager->get_read_ahead_stats().prefetched - before.prefetched <= 4);
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Write-Back Caching", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 7);
+
+  auto byte_on_disk = [&fixture](PageId page)
+  {
+    std::ifstream file(fixture.test_file, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(page * PAGE_SIZE));
+    return static_cast<std::byte>(file.get());
+  };
+
+  PagerOptions options;
+  options.cache_budget = 4 * PAGE_SIZE;
+  auto pager = create_pager("test.db", options);
+
+  // At flush_all() pages 2 and 3 coalesce into one write, 5 is another
+  for (int page : {5, 2, 3}) {
+    auto copy = pager->get_page(page);
+    copy->data[0] = static_cast<std::byte>(page);
+    copy->is_dirty = true;
+    pager->write_page(*copy);
+  }
+  REQUIRE(byte_on_disk(2) == std::byte {0});
+  REQUIRE(pager->pin(2).dirty());
+
+  pager->flush(2);
+  REQUIRE(byte_on_disk(2) == std::byte {2});
+  REQUIRE_FALSE(pager->pin(2).dirty());
+  REQUIRE(byte_on_disk(3) == std::byte {0});
+
+  pager->flush_all();
+  REQUIRE(byte_on_disk(3) == std::byte {3});
+  REQUIRE(byte_on_disk(5) == std::byte {5});
+  REQUIRE_FALSE(pager->pin(5).dirty());
+
+  // Dirty victims are written back when evicted
+  {
+    auto handle = pager->pin(7);
+    handle.bytes()[0] = std::byte {7};
+    handle.mark_dirty();
+  }
+  for (PageId page = 0; page < 7; page++) {
+    pager->pin(page);
+  }
+  REQUIRE(byte_on_disk(7) == std::byte {7});
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Latency Histogram Buckets", "[pager]")
+{
+  REQUIRE(LatencyHistogram::bucket_of(0) == 0);
+  REQUIRE(LatencyHistogram::bucket_of(1) == 1);
+  REQUIRE(LatencyHistogram::bucket_of(1000) == 10);
+  REQUIRE(LatencyHistogram::bucket_of(1024) == 11);
+  REQUIRE(LatencyHistogram::bucket_of(~std::uint64_t {0})
+          == LatencySnapshot::BUCKETS - 1);
+
+  LatencyHistogram histogram;
+  REQUIRE(histogram.snapshot().percentile(0.5) == 0);
+  for (int i = 0; i < 99; i++) {
+    histogram.record(100);
+  }
+  histogram.record(5000);
+  auto snapshot = histogram.snapshot();
+  REQUIRE(snapshot.count() == 100);
+  REQUIRE(snapshot.percentile(0.5) == 127);
+  REQUIRE(snapshot.percentile(0.99) == 127);
+  REQUIRE(snapshot.percentile(1.0) == 8191);
+}
+
+TEST_CASE("Pager Statistics", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 7);
+
+  PagerOptions options;
+  options.cache_budget = 4 * PAGE_SIZE;
+  options.max_read_ahead = 0;
+  auto pager = create_pager("test.db", options);
+
+  auto first = pager->pin(0);
+  first.mark_dirty();
+  auto second = pager->pin(1);
+  pager->pin(1);
+
+  auto stats = pager->stats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 2);
+  REQUIRE(stats.cached_pages == 2);
+  REQUIRE(stats.dirty_pages == 1);
+  REQUIRE(stats.pinned_pages == 2);
+  REQUIRE(stats.bytes_read == 2 * PAGE_SIZE);
+  REQUIRE(stats.read_latency.count() == 2);
+
+  first.release();
+  second.release();
+  for (PageId page = 2; page < 8; page++) {
+    pager->pin(page);
+  }
+  stats = pager->stats();
+  REQUIRE(stats.misses == 8);
+  REQUIRE(stats.evictions == 4);
+  REQUIRE(stats.dirty_evictions == 1);
+  REQUIRE(stats.bytes_written == PAGE_SIZE);
+  REQUIRE(stats.write_latency.count() == 1);
+  REQUIRE(stats.pinned_pages == 0);
+  REQUIRE(stats.dirty_pages == 0);
+
+  pager->flush_all();
+  REQUIRE(pager->stats().syncs == 1);
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Concurrent Readers And A Writer", "[pager]")
+{
+  constexpr PageId pages = 256;
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, pages - 1);
+  {
+    auto pager = create_pager("test.db");
+    for (PageId page = 0; page < pages; page++) {
+      auto handle = pager->pin(page);
+      handle.mark_dirty();
+      handle.bytes()[0] = static_cast<std::byte>(page);
+      handle.bytes()[PAGE_SIZE - 1] = static_cast<std::byte>(page);
+    }
+  }
+
+  PagerOptions options;
+  options.cache_budget = 32 * PAGE_SIZE;
+  auto pager = create_pager("test.db", options);
+  std::atomic<bool> corrupt {false};
+  std::atomic<std::size_t> pins {0};
+
+  auto check = [&corrupt](const PageHandle& handle)
+  {
+    const auto expected = static_cast<std::byte>(handle.id());
+    if (handle.bytes()[0] != expected
+        || handle.bytes()[PAGE_SIZE - 1] != expected)
+    {
+      corrupt = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned seed = 0; seed < 6; seed++) {
+    threads.emplace_back(
+        [&, seed]
+        {
+          std::mt19937 rng(seed);
+          std::uniform_int_distribution<PageId> any_page(0, pages - 1);
+          for (int i = 0; i < 2000; i++) {
+            if (seed % 2 == 0) {
+              check(pager->pin(any_page(rng)));
+            } else {
+              // Sequential runs exercise read-ahead
+              check(pager->pin(static_cast<PageId>(i) % pages));
+            }
+            pins++;
+          }
+        });
+  }
+  // The writer only touches bytes the readers do not look at
+  threads.emplace_back(
+      [&]
+      {
+        std::mt19937 rng(99);
+        std::uniform_int_distribution<PageId> any_page(0, pages - 1);
+        for (int i = 0; i < 1000; i++) {
+          auto handle = pager->pin(any_page(rng));
+          handle.mark_dirty();
+          handle.bytes()[8] = static_cast<std::byte>(i);
+          check(handle);
+          pins++;
+          if (i % 100 == 0) {
+            handle.release();
+            pager->flush_all();
+          }
+        }
+      });
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE_FALSE(corrupt);
+  auto stats = pager->stats();
+  REQUIRE(stats.hits + stats.misses == pins);
+  REQUIRE(stats.pinned_pages == 0);
+  REQUIRE(stats.cached_pages <= 32);
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Concurrent Misses On One Page Read It Once", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 7);
+
+  PagerOptions options;
+  options.max_read_ahead = 0;
+  auto pager = create_pager("test.db", options);
+
+  std::atomic<bool> go {false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back(
+        [&]
+        {
+          while (!go) {
+            std::this_thread::yield();
+          }
+          pager->pin(5);
+        });
+  }
+  go = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto stats = pager->stats();
+  REQUIRE(stats.misses == 1);
+  REQUIRE(stats.hits == 7);
+  REQUIRE(stats.bytes_read == PAGE_SIZE);
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Direct I/O", "[pager]")
+{
+  TestFixture fixture;
+  fixture.SetUp();
+  append_zero_pages(fixture.test_file, 15);
+
+  PagerOptions options;
+  options.direct_io = true;
+  options.cache_budget = 4 * PAGE_SIZE;
+
+  SECTION("Pages round-trip whether or not the filesystem allows it")
+  {
+    for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+      options.io_backend = backend;
+      {
+        auto pager = create_pager("test.db", options);
+        for (PageId page = 0; page < 16; page++) {
+          auto handle = pager->pin(page);
+          handle.mark_dirty();
+          handle.bytes()[0] = static_cast<std::byte>(page);
+          handle.bytes()[PAGE_SIZE - 1] = static_cast<std::byte>(page + 1);
+        }
+        pager->flush_all();
+        // Evicted long ago, so read back from the file
+        REQUIRE(pager->pin(1).bytes()[0] == std::byte {1});
+      }
+
+      auto pager = create_pager("test.db");
+      for (PageId page = 0; page < 16; page++) {
+        auto handle = pager->pin(page);
+        REQUIRE(handle.bytes()[0] == static_cast<std::byte>(page));
+        REQUIRE(handle.bytes()[PAGE_SIZE - 1]
+                == static_cast<std::byte>(page + 1));
+      }
+    }
+  }
+
+  SECTION("Files that are not whole pages stay buffered")
+  {
+    {
+      std::ofstream file(fixture.test_file, std::ios::binary | std::ios::app);
+      file.put('x');
+    }
+    auto pager = create_pager("test.db", options);
+    REQUIRE_FALSE(pager->get_direct_io());
+    REQUIRE(pager->pin(16).bytes()[0] == std::byte {'x'});
+  }
+
+  SECTION("The mmap read mode always goes through the page cache")
+  {
+    options.read_mode = ReadMode::mmap;
+    auto pager = create_pager("test.db", options);
+    REQUIRE_FALSE(pager->get_direct_io());
+  }
+
+  fixture.TearDown();
+}
+
+TEST_CASE("Page Allocation", "[pager]")
+{
+  const std::string file_name = "alloc_test.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  PagerOptions options;
+  options.page_size = 512;
+
+  SECTION("Appended pages grow the file in extents")
+  {
+    {
+      auto pager = create_pager(file_name, options);
+      for (PageId expected = 1; expected <= 10; expected++) {
+        auto handle = pager->allocate_page();
+        REQUIRE(handle.id() == expected);
+        REQUIRE(handle.dirty());
+        handle.bytes()[0] = static_cast<std::byte>(expected);
+      }
+      REQUIRE(pager->get_num_pages() == 11);
+    }
+    // The header page plus one preallocated extent holds all of them
+    REQUIRE(std::filesystem::file_size(file_name) == 512 + (1U << 20U));
+
+    auto pager = create_pager(file_name);
+    REQUIRE(pager->get_num_pages() == 11);
+    REQUIRE(pager->pin(10).bytes()[0] == std::byte {10});
+    REQUIRE_THROWS_AS(pager->pin(11), std::out_of_range);
+  }
+
+  SECTION("Freed pages are reused before the file grows")
+  {
+    auto pager = create_pager(file_name, options);
+    for (int i = 0; i < 5; i++) {
+      pager->allocate_page().bytes()[0] = std::byte {0xEE};
+    }
+    pager->free_page(2);
+    pager->free_page(4);
+    REQUIRE(pager->get_free_pages() == 2);
+
+    std::set<PageId> reused;
+    for (int i = 0; i < 2; i++) {
+      auto handle = pager->allocate_page();
+      REQUIRE(handle.bytes()[0] == std::byte {0});
+      reused.insert(handle.id());
+    }
+    REQUIRE(reused == std::set<PageId> {2, 4});
+    REQUIRE(pager->get_free_pages() == 0);
+    REQUIRE(pager->get_num_pages() == 6);
+    REQUIRE(pager->allocate_page().id() == 6);
+
+    REQUIRE_THROWS_AS(pager->free_page(0), std::out_of_range);
+    REQUIRE_THROWS_AS(pager->free_page(7), std::out_of_range);
+  }
+
+  SECTION("The freelist spans trunk pages and survives reopening")
+  {
+    // A 512-byte trunk page holds 126 leaves
+    constexpr PageId pages = 300;
+    {
+      options.cache_budget = 16 * 512;
+      auto pager = create_pager(file_name, options);
+      for (PageId page = 0; page < pages; page++) {
+        pager->allocate_page();
+      }
+      for (PageId page = 1; page <= pages; page++) {
+        pager->free_page(page);
+      }
+    }
+
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_free_pages() == pages);
+    std::set<PageId> reused;
+    for (PageId page = 0; page < pages; page++) {
+      reused.insert(pager->allocate_page().id());
+    }
+    REQUIRE(reused.size() == pages);
+    REQUIRE(*reused.begin() == 1);
+    REQUIRE(*reused.rbegin() == pages);
+    REQUIRE(pager->get_free_pages() == 0);
+    REQUIRE(pager->get_num_pages() == pages + 1);
+  }
+
+  SECTION("Files without a header have no freelist")
+  {
+    std::ofstream(file_name, std::ios::binary | std::ios::trunc)
+        .write(std::string(PAGE_SIZE, '\0').data(), PAGE_SIZE);
+    auto pager = create_pager(file_name);
+    REQUIRE(pager->allocate_page().id() == 1);
+    REQUIRE(pager->get_num_pages() == 2);
+    REQUIRE_THROWS_AS(pager->free_page(1), std::logic_error);
+  }
+
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Page Checksums", "[pager]")
+{
+  const std::string file_name = "checksum_test.db";
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  constexpr PageId pages = 8;
+  {
+    PagerOptions options;
+    options.page_checksums = true;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_usable_size() == PAGE_SIZE - 4);
+    for (PageId page = 1; page < pages; page++) {
+      auto handle = pager->allocate_page();
+      std::fill_n(handle.bytes(),
+                  pager->get_usable_size(),
+                  static_cast<std::byte>(page));
+    }
+  }
+  auto overwrite = [&file_name](PageId page, std::size_t offset, char value)
+  {
+    std::fstream file(file_name,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(page * PAGE_SIZE + offset));
+    file.put(value);
+  };
+
+  SECTION("The setting is stored in the header")
+  {
+    auto pager = create_pager(file_name);
+    REQUIRE(pager->get_page_checksums());
+    for (PageId page = 0; page < pages; page++) {
+      REQUIRE_NOTHROW(pager->pin(page));
+    }
+    REQUIRE(pager->stats().checksum_failures == 0);
+  }
+
+  SECTION("A corrupt page fails to load")
+  {
+    overwrite(3, 100, 'x');
+    for (auto mode : {ReadMode::buffer_pool, ReadMode::mmap}) {
+      PagerOptions options;
+      options.read_mode = mode;
+      auto pager = create_pager(file_name, options);
+      REQUIRE_THROWS_AS(pager->pin(3), std::runtime_error);
+      REQUIRE(pager->stats().checksum_failures == 1);
+      REQUIRE(pager->pin(4).bytes()[0] == std::byte {4});
+    }
+  }
+
+  SECTION("Read-ahead drops corrupt pages without failing the scan")
+  {
+    overwrite(6, PAGE_SIZE - 1, 'x');
+    auto pager = create_pager(file_name);
+    for (PageId page = 0; page < 6; page++) {
+      REQUIRE(pager->pin(page));
+    }
+    REQUIRE(pager->stats().checksum_failures == 1);
+    REQUIRE_THROWS_AS(pager->pin(6), std::runtime_error);
+  }
+
+  SECTION("Never written pages read as zeros")
+  {
+    {
+      std::fstream file(file_name,
+                        std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(static_cast<std::streamoff>(5 * PAGE_SIZE));
+      file.write(std::string(PAGE_SIZE, '\0').data(), PAGE_SIZE);
+    }
+    auto pager = create_pager(file_name);
+    REQUIRE(pager->pin(5).bytes()[0] == std::byte {0});
+  }
+
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE("Page Compression", "[pager]")
+{
+  const std::string file_name = "compression_test.db";
+  const auto map_name = CompressedFile::map_path(file_name);
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  constexpr PageId pages = 64;
+  const std::string row = "17|bob|bob@example.com|inactive|2023-06-30\n";
+  auto fill_text = [&row](PageHandle& handle, std::size_t length)
+  {
+    for (std::size_t i = 0; i < length; i++) {
+      handle.bytes()[i] = static_cast<std::byte>(row[(i + handle.id()) % 40]);
+    }
+  };
+  auto is_text = [&row](const PageHandle& handle, std::size_t length)
+  {
+    for (std::size_t i = 0; i < length; i++) {
+      if (handle.bytes()[i]
+          != static_cast<std::byte>(row[(i + handle.id()) % 40]))
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+  {
+    PagerOptions options;
+    options.compression = true;
+    options.page_checksums = true;
+    // Too small for the file, so pages are written back on eviction
+    options.cache_budget = PAGE_SIZE * 4;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_compression());
+    for (PageId page = 1; page < pages; page++) {
+      auto handle = pager->allocate_page();
+      fill_text(handle, pager->get_usable_size());
+    }
+    pager->flush_all();
+    const auto stats = pager->stats().compression;
+    REQUIRE(stats.pages_written >= pages - 1);
+    REQUIRE(stats.ratio() > 4.0);
+  }
+  REQUIRE(std::filesystem::exists(map_name));
+  REQUIRE(std::filesystem::file_size(file_name) < pages * PAGE_SIZE / 4);
+
+  SECTION("The setting is stored in the header")
+  {
+    PagerOptions options;
+    options.read_mode = ReadMode::mmap;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_compression());
+    REQUIRE(pager->get_read_mode() == ReadMode::buffer_pool);
+    REQUIRE(pager->get_num_pages() == pages);
+    for (PageId page = 1; page < pages; page++) {
+      REQUIRE(is_text(pager->pin(page), pager->get_usable_size()));
+    }
+    REQUIRE(pager->stats().compression.pages_read == pages - 1);
+    REQUIRE(pager->stats().checksum_failures == 0);
+  }
+
+  SECTION("Pages that change size move and free their slots")
+  {
+    std::mt19937 rng(9);
+    for (int round = 0; round < 4; round++) {
+      PagerOptions options;
+      options.cache_budget = PAGE_SIZE * 4;
+      auto pager = create_pager(file_name, options);
+      for (PageId page = 1; page < pages; page++) {
+        auto handle = pager->pin(page);
+        handle.mark_dirty();
+        if (round % 2 == 0) {
+          // Noise does not compress and is stored raw
+          for (std::size_t i = 0; i < pager->get_usable_size(); i++) {
+            handle.bytes()[i] = static_cast<std::byte>(rng());
+          }
+        } else {
+          fill_text(handle, pager->get_usable_size());
+        }
+      }
+      pager->flush_all();
+      if (round % 2 == 0) {
+        REQUIRE(pager->stats().compression.pages_raw == pages - 1);
+      }
+    }
+    auto pager = create_pager(file_name);
+    for (PageId page = 1; page < pages; page++) {
+      REQUIRE(is_text(pager->pin(page), pager->get_usable_size()));
+    }
+    // Raw pages reused the slots of the text pages before them
+    REQUIRE(std::filesystem::file_size(file_name) <= 3 * pages * PAGE_SIZE);
+  }
+
+  SECTION("A corrupt slot fails to load")
+  {
+    {
+      std::fstream file(file_name,
+                        std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(static_cast<std::streamoff>(PAGE_SIZE));
+      const auto slots = std::filesystem::file_size(file_name) - PAGE_SIZE;
+      file.write(std::string(slots, 'x').data(),
+                 static_cast<std::streamsize>(slots));
+    }
+    auto pager = create_pager(file_name);
+    REQUIRE_THROWS_AS(pager->pin(5), std::runtime_error);
+    REQUIRE(pager->pin(0));
+  }
+
+  SECTION("A new file discards a stale page map")
+  {
+    std::filesystem::remove(file_name);
+    std::ofstream(file_name, std::ios::binary).close();
+    PagerOptions options;
+    options.compression = true;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(std::filesystem::file_size(map_name) == 0);
+    auto handle = pager->allocate_page();
+    REQUIRE(handle.id() == 1);
+    REQUIRE(handle.bytes()[0] == std::byte {0});
+  }
+
+  std::filesystem::remove(file_name);
+  std::filesystem::remove(map_name);
+}
+
+TEST_CASE("Write-Ahead Log", "[pager]")
+{
+  const std::string file_name = "wal_pager_test.db";
+  const auto wal_name = Wal::wal_path(file_name);
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  constexpr PageId pages = 16;
+  {
+    PagerOptions options;
+    options.wal = true;
+    options.cache_budget = PAGE_SIZE * 4;
+    // Checkpoints only on request, so that the file stays untouched
+    options.checkpoint_options.background = false;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_wal());
+    for (PageId page = 1; page < pages; page++) {
+      auto handle = pager->allocate_page();
+      std::fill_n(handle.bytes(), PAGE_SIZE, static_cast<std::byte>(page));
+    }
+    pager->free_page(pages - 1);
+    // Evicted pages were spilled to the log, but nothing is committed yet
+    REQUIRE(pager->stats().wal.commits == 0);
+    REQUIRE(pager->stats().wal.frames > 0);
+    REQUIRE(pager->get_page(1)->data[0] == std::byte {1});
+    REQUIRE(pager->get_page(1, pager->begin_read())->data[0] == std::byte {0});
+    pager->flush_all();
+    // One commit covers the spilled pages and the rest
+    const auto stats = pager->stats().wal;
+    REQUIRE(stats.commits == 1);
+    REQUIRE(stats.frames >= pages);
+  }
+  // Nothing but the header reached the database file
+  REQUIRE(std::filesystem::file_size(file_name) == PAGE_SIZE);
+
+  SECTION("Reopening reads the committed pages from the log")
+  {
+    PagerOptions options;
+    options.read_mode = ReadMode::mmap;
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_wal());
+    REQUIRE(pager->get_read_mode() == ReadMode::buffer_pool);
+    REQUIRE(pager->get_num_pages() == pages);
+    REQUIRE(pager->get_free_pages() == 1);
+    for (PageId page = 1; page < pages - 1; page++) {
+      REQUIRE(pager->get_page(static_cast<int>(page))->data[0]
+              == static_cast<std::byte>(page));
+    }
+    REQUIRE(pager->allocate_page().id() == pages - 1);
+  }
+
+  SECTION("Uncommitted changes are lost, committed ones are not")
+  {
+    {
+      auto pager = create_pager(file_name);
+      auto handle = pager->pin(3);
+      handle.mark_dirty();
+      handle.bytes()[0] = std::byte {0x33};
+      handle.release();
+      pager->flush(3);
+      // Dirty but never written back: lost when the log is cut below
+      auto other = pager->pin(4);
+      other.mark_dirty();
+      other.bytes()[0] = std::byte {0x44};
+      other.release();
+      pager->flush_all();
+    }
+    std::filesystem::resize_file(wal_name,
+                                 std::filesystem::file_size(wal_name) - 1);
+    auto pager = create_pager(file_name);
+    REQUIRE(pager->pin(3).bytes()[0] == std::byte {0x33});
+    REQUIRE(pager->pin(4).bytes()[0] == std::byte {4});
+  }
+
+  SECTION("A crash loses the pages spilled since the last commit")
+  {
+    const std::string crash_name = "wal_pager_crash.db";
+    const auto crash_wal = Wal::wal_path(crash_name);
+    const auto overwrite = std::filesystem::copy_options::overwrite_existing;
+    {
+      PagerOptions options;
+      options.cache_budget = PAGE_SIZE * 4;
+      options.checkpoint_options.background = false;
+      auto pager = create_pager(file_name, options);
+      // Too many pages change for the pool: most are spilled on eviction
+      for (PageId page = 1; page < pages - 1; page++) {
+        auto handle = pager->pin(page);
+        handle.mark_dirty();
+        handle.bytes()[0] = std::byte {0x55};
+      }
+      REQUIRE(pager->stats().wal.commits == 0);
+      REQUIRE(pager->pin(1).bytes()[0] == std::byte {0x55});
+      // The log must not restart from under them
+      pager->checkpoint();
+      REQUIRE(pager->stats().wal.restarts == 0);
+
+      std::filesystem::copy_file(file_name, crash_name, overwrite);
+      std::filesystem::copy_file(wal_name, crash_wal, overwrite);
+    }
+    {
+      auto pager = create_pager(crash_name);
+      for (PageId page = 1; page < pages - 1; page++) {
+        REQUIRE(pager->pin(page).bytes()[0] == static_cast<std::byte>(page));
+      }
+    }
+    // Closing the pager committed them
+    auto pager = create_pager(file_name);
+    for (PageId page = 1; page < pages - 1; page++) {
+      REQUIRE(pager->pin(page).bytes()[0] == std::byte {0x55});
+    }
+    std::filesystem::remove(crash_name);
+    std::filesystem::remove(crash_wal);
+  }
+
+  SECTION("A read transaction sees the commits made before it began")
+  {
+    auto pager = create_pager(file_name);
+    const auto before = pager->begin_read();
+    REQUIRE(before);
+    {
+      auto handle = pager->pin(3);
+      handle.mark_dirty();
+      handle.bytes()[0] = std::byte {0x33};
+    }
+    // Not committed yet: no snapshot sees it
+    REQUIRE(pager->get_page(3, before)->data[0] == std::byte {3});
+    REQUIRE(pager->get_page(3, pager->begin_read())->data[0]
+            == std::byte {3});
+    pager->flush(3);
+
+    const auto after = pager->begin_read();
+    REQUIRE(after.sequence() > before.sequence());
+    REQUIRE(pager->get_page(3, before)->data[0] == std::byte {3});
+    REQUIRE(pager->get_page(3, after)->data[0] == std::byte {0x33});
+    REQUIRE(pager->get_page(4, after)->data[0] == std::byte {4});
+    REQUIRE_THROWS_AS(pager->get_page(static_cast<int>(pages), after),
+                      std::out_of_range);
+  }
+
+  SECTION("A checkpoint copies committed pages into the file")
+  {
+    const auto file_byte = [&file_name](PageId page)
+    {
+      std::ifstream file(file_name, std::ios::binary);
+      file.seekg(static_cast<std::streamoff>(page * PAGE_SIZE));
+      return file.get();
+    };
+
+    PagerOptions options;
+    options.checkpoint_options.background = false;
+    options.checkpoint_options.batch_pages = 4;
+    {
+      auto pager = create_pager(file_name, options);
+      {
+        const auto reader = pager->begin_read();
+        {
+          auto handle = pager->pin(3);
+          handle.mark_dirty();
+          handle.bytes()[0] = std::byte {0x33};
+        }
+        pager->flush(3);
+
+        // The reader holds the checkpoint back to the commit it sees
+        pager->checkpoint();
+        const auto stats = pager->stats();
+        REQUIRE(stats.checkpoint.checkpoints == 1);
+        REQUIRE(stats.checkpoint.pages_copied >= pages - 1);
+        REQUIRE(stats.wal.restarts == 0);
+        REQUIRE(file_byte(3) == 3);
+        REQUIRE(file_byte(pages - 2) == static_cast<int>(pages - 2));
+        REQUIRE(pager->get_page(3, reader)->data[0] == std::byte {3});
+      }
+
+      pager->checkpoint();
+      const auto stats = pager->stats();
+      REQUIRE(stats.checkpoint.checkpoints == 2);
+      REQUIRE(stats.wal.restarts == 1);
+      REQUIRE(stats.wal.size == 32);
+      REQUIRE(file_byte(3) == 0x33);
+      REQUIRE(pager->get_page(3, pager->begin_read())->data[0]
+              == std::byte {0x33});
+
+      auto handle = pager->pin(4);
+      handle.mark_dirty();
+      handle.bytes()[0] = std::byte {0x44};
+    }
+
+    auto pager = create_pager(file_name, options);
+    REQUIRE(pager->get_num_pages() == pages);
+    REQUIRE(pager->get_free_pages() == 1);
+    REQUIRE(pager->pin(3).bytes()[0] == std::byte {0x33});
+    REQUIRE(pager->pin(4).bytes()[0] == std::byte {0x44});
+    REQUIRE(pager->pin(5).bytes()[0] == std::byte {5});
+  }
+
+  SECTION("Checkpoints and snapshot reads work under direct I/O")
+  {
+    PagerOptions options;
+    options.direct_io = true;
+    options.checkpoint_options.background = false;
+    options.checkpoint_options.batch_pages = 4;
+    std::byte value {0x30};
+    for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+      options.io_backend = backend;
+      value = static_cast<std::byte>(std::to_integer<int>(value) + 1);
+      {
+        auto pager = create_pager(file_name, options);
+        {
+          auto handle = pager->pin(3);
+          handle.mark_dirty();
+          handle.bytes()[0] = value;
+        }
+        pager->flush(3);
+        pager->checkpoint();
+        const auto stats = pager->stats();
+        REQUIRE(stats.checkpoint.checkpoints == 1);
+        REQUIRE(stats.wal.restarts == 1);
+
+        // The log is empty, so snapshots read every page from the file
+        const auto snapshot = pager->begin_read();
+        for (PageId page = 1; page < pages - 1; page++) {
+          REQUIRE(pager->get_page(static_cast<int>(page), snapshot)->data[0]
+                  == (page == 3 ? value : static_cast<std::byte>(page)));
+        }
+      }
+
+      auto pager = create_pager(file_name);
+      REQUIRE(pager->get_num_pages() == pages);
+      REQUIRE(pager->pin(3).bytes()[0] == value);
+      REQUIRE(pager->pin(pages - 2).bytes()[0]
+              == static_cast<std::byte>(pages - 2));
+    }
+  }
+
+  std::filesystem::remove(file_name);
+  std::filesystem::remove(wal_name);
+}
+
+TEST_CASE("Background checkpoints", "[pager]")
+{
+  const std::string file_name = "checkpoint_test.db";
+  const auto wal_name = Wal::wal_path(file_name);
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+
+  constexpr PageId pages = 4;
+  constexpr int commits = 200;
+  PagerOptions options;
+  options.wal = true;
+  options.checkpoint_options.wal_bytes = 8 * PAGE_SIZE;
+  options.checkpoint_options.idle_time = std::chrono::milliseconds(1);
+  {
+    auto pager = create_pager(file_name, options);
+    for (PageId page = 1; page <= pages; page++) {
+      pager->allocate_page();
+    }
+    pager->flush_all();
+
+    // Every commit writes its number to all pages; a reader must never see
+    // two numbers at once, nor go back, while checkpoints run underneath
+    std::atomic<bool> done {false};
+    std::atomic<int> errors {0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+      readers.emplace_back(
+          [&]
+          {
+            std::byte seen {0};
+            while (!done) {
+              const auto snapshot = pager->begin_read();
+              const std::byte value = pager->get_page(1, snapshot)->data[0];
+              for (PageId page = 2; page <= pages; page++) {
+                if (pager->get_page(static_cast<int>(page), snapshot)->data[0]
+                    != value)
+                {
+                  errors++;
+                }
+              }
+              if (value < seen) {
+                errors++;
+              }
+              seen = value;
+            }
+          });
+    }
+    for (int i = 1; i <= commits; i++) {
+      for (PageId page = 1; page <= pages; page++) {
+        auto handle = pager->pin(page);
+        handle.mark_dirty();
+        handle.bytes()[0] = static_cast<std::byte>(i);
+      }
+      pager->flush_all();
+    }
+    done = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    REQUIRE(errors == 0);
+
+    // Idle now: the log is copied and restarts
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (pager->stats().wal.size > 32
+           && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto stats = pager->stats();
+    REQUIRE(stats.wal.size == 32);
+    REQUIRE(stats.wal.restarts > 0);
+    REQUIRE(stats.checkpoint.checkpoints > 0);
+    REQUIRE(stats.checkpoint.pages_copied >= pages);
+    REQUIRE(stats.checkpoint.failures == 0);
+  }
+
+  options.checkpoint_options.background = false;
+  auto pager = create_pager(file_name, options);
+  for (PageId page = 1; page <= pages; page++) {
+    REQUIRE(pager->pin(page).bytes()[0] == static_cast<std::byte>(commits));
+  }
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+  std::filesystem::remove(wal_name);
+}
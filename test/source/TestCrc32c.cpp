@@ -0,0 +1,59 @@
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/crc32c.hpp"
+
+namespace
+{
+const std::byte* bytes_of(std::string_view text)
+{
+  return reinterpret_cast<const std::byte*>(text.data());
+}
+}  // namespace
+
+TEST_CASE("CRC32C check values", "[crc32c]")
+{
+  // Check value of the CRC-32C catalogue entry, and RFC 3720 test vectors
+  constexpr std::string_view digits = "123456789";
+  REQUIRE(crc32c(bytes_of(digits), digits.size()) == 0xE3069283U);
+  REQUIRE(crc32c_portable(bytes_of(digits), digits.size()) == 0xE3069283U);
+
+  std::vector<std::byte> zeros(32, std::byte {0});
+  std::vector<std::byte> ones(32, std::byte {0xFF});
+  REQUIRE(crc32c(zeros.data(), zeros.size()) == 0x8A9136AAU);
+  REQUIRE(crc32c(ones.data(), ones.size()) == 0x62A8AB43U);
+  REQUIRE(crc32c(nullptr, 0) == 0);
+}
+
+TEST_CASE("CRC32C implementations agree", "[crc32c]")
+{
+  std::mt19937 rng(5);
+  std::vector<std::byte> data(4096 + 16);
+  for (auto& byte : data) {
+    byte = static_cast<std::byte>(rng());
+  }
+
+  // Every misalignment and every tail length of the 8-byte loop
+  for (std::size_t offset = 0; offset < 8; offset++) {
+    for (std::size_t length : {0, 1, 7, 8, 9, 63, 100, 4096}) {
+      REQUIRE(crc32c(data.data() + offset, length)
+              == crc32c_portable(data.data() + offset, length));
+    }
+  }
+
+  SECTION("Checksums continue across calls")
+  {
+    const auto whole = crc32c(data.data(), 4096);
+    REQUIRE(crc32c(data.data() + 1000, 3096, crc32c(data.data(), 1000))
+            == whole);
+    REQUIRE(crc32c_portable(data.data() + 13, 4083, crc32c(data.data(), 13))
+            == whole);
+  }
+
+  const std::string_view name = crc32c_implementation();
+  REQUIRE((name == "sse4.2" || name == "armv8" || name == "table"));
+}
@@ -0,0 +1,153 @@
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/file_io.hpp"
+
+namespace
+{
+const std::string io_test_file = "file_io_test.db";
+
+void create_empty_file()
+{
+  std::ofstream(io_test_file, std::ios::binary | std::ios::trunc).close();
+}
+}  // namespace
+
+TEST_CASE("Positional reads and writes", "[file_io]")
+{
+  create_empty_file();
+  auto io = open_file_io(io_test_file, IoBackend::pread);
+  REQUIRE(io->backend() == IoBackend::pread);
+
+  std::vector<std::byte> data(100, std::byte {0x5A});
+  io->write(data.data(), data.size(), 1000);
+  REQUIRE(io->size() == 1100);
+
+  std::vector<std::byte> back(200, std::byte {0xFF});
+  io->read(back.data(), back.size(), 1000);
+  REQUIRE(back[0] == std::byte {0x5A});
+  REQUIRE(back[99] == std::byte {0x5A});
+  // Past the end of file reads as zeros
+  REQUIRE(back[100] == std::byte {0});
+  REQUIRE(back[199] == std::byte {0});
+
+  io->truncate(0);
+  REQUIRE(io->size() == 0);
+  io.reset();
+  std::filesystem::remove(io_test_file);
+}
+
+TEST_CASE("Batched I/O on every backend", "[file_io]")
+{
+  for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+    create_empty_file();
+    auto io = open_file_io(io_test_file, backend);
+
+    // More requests than the io_uring queue depth
+    constexpr std::size_t count = 150;
+    constexpr std::size_t block = 512;
+    std::vector<std::byte> out(count * block);
+    std::vector<IoRequest> writes;
+    for (std::size_t i = 0; i < count; i++) {
+      std::fill_n(out.begin() + static_cast<std::ptrdiff_t>(i * block),
+                  block,
+                  static_cast<std::byte>(i));
+      writes.push_back(IoRequest {out.data() + i * block, block, i * block});
+    }
+    io->write_batch(writes);
+    io->sync();
+    REQUIRE(io->size() == count * block);
+
+    std::vector<std::byte> in(count * block);
+    std::vector<IoRequest> reads;
+    for (std::size_t i = count; i > 0; i--) {
+      reads.push_back(
+          IoRequest {in.data() + (i - 1) * block, block, (i - 1) * block});
+    }
+    io->read_batch(reads);
+    REQUIRE(in == out);
+
+    io.reset();
+    std::filesystem::remove(io_test_file);
+  }
+}
+
+TEST_CASE("Adjacent requests are coalesced", "[file_io]")
+{
+  for (auto backend : {IoBackend::pread, IoBackend::io_uring}) {
+    create_empty_file();
+    auto io = open_file_io(io_test_file, backend);
+
+    // Runs of adjacent requests separated by gaps, one longer than IOV_MAX
+    constexpr std::size_t block = 8;
+    std::vector<std::size_t> blocks;
+    for (std::size_t i = 0; i < 1500; i++) {
+      blocks.push_back(i);
+    }
+    for (std::size_t i = 1600; i < 1610; i++) {
+      blocks.push_back(i);
+    }
+    blocks.push_back(1700);
+
+    std::vector<std::byte> out(blocks.size() * block);
+    std::vector<IoRequest> writes;
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+      std::fill_n(out.begin() + static_cast<std::ptrdiff_t>(i * block),
+                  block,
+                  static_cast<std::byte>(blocks[i] + 1));
+      writes.push_back(
+          IoRequest {out.data() + i * block, block, blocks[i] * block});
+    }
+    io->write_batch(writes);
+    REQUIRE(io->size() == 1701 * block);
+
+    std::vector<std::byte> in(out.size());
+    std::vector<IoRequest> reads = writes;
+    for (std::size_t i = 0; i < reads.size(); i++) {
+      reads[i].buffer = in.data() + i * block;
+    }
+    io->read_batch(reads);
+    REQUIRE(in == out);
+
+    // A run crossing the end of file is completed with zeros
+    std::vector<std::byte> tail(3 * block, std::byte {0xFF});
+    io->read_batch({IoRequest {tail.data(), block, 1700 * block},
+                    IoRequest {tail.data() + block, block, 1701 * block},
+                    IoRequest {tail.data() + 2 * block, block, 1702 * block}});
+    REQUIRE(tail[0] == static_cast<std::byte>(1701 % 256));
+    REQUIRE(tail[block] == std::byte {0});
+    REQUIRE(tail[3 * block - 1] == std::byte {0});
+
+    io.reset();
+    std::filesystem::remove(io_test_file);
+  }
+}
+
+TEST_CASE("Preallocating file space", "[file_io]")
+{
+  create_empty_file();
+  auto io = open_file_io(io_test_file, IoBackend::pread);
+  std::vector<std::byte> data(10, std::byte {0x11});
+  io->write(data.data(), data.size(), 0);
+
+  io->allocate(1 << 16);
+  REQUIRE(io->size() == 1 << 16);
+  std::vector<std::byte> back(20, std::byte {0xFF});
+  io->read(back.data(), back.size(), 0);
+  REQUIRE(back[9] == std::byte {0x11});
+  REQUIRE(back[10] == std::byte {0});
+
+  // Never shrinks
+  io->allocate(100);
+  REQUIRE(io->size() == 1 << 16);
+  io.reset();
+  std::filesystem::remove(io_test_file);
+}
+
+TEST_CASE("Opening a missing file", "[file_io]")
+{
+  REQUIRE_THROWS(open_file_io("/invalid/path/file.db", IoBackend::pread));
+}
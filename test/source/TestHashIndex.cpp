@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/hash_index.hpp"
+#include "backend/pager.hpp"
+#include "backend/record.hpp"
+
+#include "test_helpers.hpp"
+
+namespace
+{
+const std::string hash_test_file = "hash_test.db";
+
+using Key = std::vector<std::byte>;
+
+// Rowids and payloads of the entries with a key, sorted
+std::vector<std::pair<std::int64_t, Key>> lookup(const HashIndex& index,
+                                                 const Key& key)
+{
+  std::vector<std::pair<std::int64_t, Key>> found;
+  HashCursor cursor(index);
+  for (bool valid = cursor.find(key); valid; valid = cursor.next()) {
+    REQUIRE(Key(cursor.key(), cursor.key() + cursor.key_size()) == key);
+    found.emplace_back(
+        cursor.rowid(),
+        Key(cursor.payload(), cursor.payload() + cursor.payload_size()));
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+}  // namespace
+
+TEST_CASE("Hash index basics", "[hash]")
+{
+  auto pager = fresh_pager(hash_test_file, 512);
+  HashIndex index(*pager, HashIndex::create(*pager));
+  REQUIRE(index.buckets() == 1);
+  REQUIRE(lookup(index, key_of(std::int64_t {1})).empty());
+  REQUIRE_FALSE(index.erase(key_of(std::int64_t {1}), 1));
+
+  const Key key = key_of(std::string("m"));
+  index.insert(key, 1, {});
+  index.insert(key, 2, Key(3, std::byte {7}));
+  REQUIRE_THROWS_AS(index.insert(key, 1, {}), std::invalid_argument);
+  REQUIRE_THROWS_AS(index.insert(Key(index.max_entry()), 3, Key(1)),
+                    std::length_error);
+  index.insert(Key(index.max_entry() - 1), 3, Key(1));
+  REQUIRE(index.verify() == 3);
+  REQUIRE(lookup(index, key)
+          == std::vector<std::pair<std::int64_t, Key>> {
+              {1, {}}, {2, Key(3, std::byte {7})}});
+
+  REQUIRE_FALSE(index.erase(key, 3));
+  REQUIRE(index.erase(key, 1));
+  REQUIRE(lookup(index, key).size() == 1);
+  REQUIRE(index.verify() == 2);
+  pager.reset();
+  std::filesystem::remove(hash_test_file);
+}
+
+TEST_CASE("Hash index random inserts and erases match a model", "[hash]")
+{
+  auto pager = fresh_pager(hash_test_file, 512);
+  const PageId meta = HashIndex::create(*pager);
+  auto index = std::make_unique<HashIndex>(*pager, meta);
+
+  std::mt19937 rng(22);
+  std::uniform_int_distribution<int> percent(0, 99);
+  // Few distinct keys, so that most have several rows
+  std::uniform_int_distribution<std::int64_t> values(0, 1500);
+  std::map<std::pair<Key, std::int64_t>, Key> model;
+  std::int64_t next_rowid = 1;
+
+  for (int i = 0; i < 8000; i++) {
+    const Key key = key_of(values(rng));
+    if (percent(rng) < 75) {
+      const Key payload(static_cast<std::size_t>(percent(rng) % 9),
+                        static_cast<std::byte>(i));
+      index->insert(key, next_rowid, payload);
+      model[{key, next_rowid++}] = payload;
+    } else {
+      const auto found = model.lower_bound({key, 0});
+      if (found != model.end() && found->first.first == key) {
+        REQUIRE(index->erase(key, found->first.second));
+        model.erase(found);
+      }
+      REQUIRE_FALSE(index->erase(key, next_rowid));
+    }
+    if (i % 500 == 0) {
+      REQUIRE(index->verify() == model.size());
+    }
+  }
+  REQUIRE(index->verify() == model.size());
+  REQUIRE(index->buckets() > 100);
+
+  // The table lives in its pages alone
+  index = std::make_unique<HashIndex>(*pager, meta);
+  for (std::int64_t value = 0; value <= 1500; value += 7) {
+    const Key key = key_of(value);
+    std::vector<std::pair<std::int64_t, Key>> expected;
+    for (auto it = model.lower_bound({key, 0});
+         it != model.end() && it->first.first == key;
+         ++it)
+    {
+      expected.emplace_back(it->first.second, it->second);
+    }
+    REQUIRE(lookup(*index, key) == expected);
+  }
+
+  // Emptied buckets keep their first page, overflow pages go back
+  for (const auto& entry : model) {
+    REQUIRE(index->erase(entry.first.first, entry.first.second));
+  }
+  REQUIRE(index->verify() == 0);
+  // Besides the header and the meta page, directory pages for the buckets
+  // past the first half of the meta page's 4-byte slots
+  const std::size_t direct = (pager->get_usable_size() - 32) / 4 / 2;
+  const std::size_t per_directory = (pager->get_usable_size() - 8) / 4;
+  REQUIRE(index->buckets() > direct);
+  const std::size_t directories =
+      (index->buckets() - direct + per_directory - 1) / per_directory;
+  REQUIRE(pager->get_num_pages() - pager->get_free_pages()
+          == 2 + directories + index->buckets());
+  pager.reset();
+  std::filesystem::remove(hash_test_file);
+}
+
+TEST_CASE("A hash bucket with many rows of one key overflows", "[hash]")
+{
+  // Many rows under one key fill a bucket's overflow pages
+  auto pager = fresh_pager(hash_test_file, 512);
+  HashIndex index(*pager, HashIndex::create(*pager));
+  const Key hot = key_of(std::string("hot"));
+  for (std::int64_t rowid = 0; rowid < 400; rowid++) {
+    index.insert(hot, rowid, {});
+    index.insert(key_of(rowid), rowid, {});
+  }
+  REQUIRE(index.verify() == 800);
+  REQUIRE(lookup(index, hot).size() == 400);
+  for (std::int64_t rowid = 0; rowid < 400; rowid++) {
+    REQUIRE(lookup(index, key_of(rowid)).size() == 1);
+  }
+  pager.reset();
+  std::filesystem::remove(hash_test_file);
+}
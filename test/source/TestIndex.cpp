@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/index_tree.hpp"
+#include "backend/pager.hpp"
+#include "backend/record.hpp"
+
+#include "test_helpers.hpp"
+
+namespace
+{
+const std::string index_test_file = "index_test.db";
+
+using Key = std::vector<std::byte>;
+
+Key random_key(std::mt19937& rng, std::size_t max_size)
+{
+  std::uniform_int_distribution<std::size_t> sizes(1, max_size);
+  // Few distinct bytes, so that keys share long prefixes
+  std::uniform_int_distribution<int> bytes(0, 3);
+  Key key(sizes(rng));
+  for (std::byte& b : key) {
+    b = static_cast<std::byte>(bytes(rng));
+  }
+  return key;
+}
+
+// Grow to a few thousand entries, then shrink back to none, checking the
+// tree against a model throughout
+void check_random_workload(std::uint32_t page_size)
+{
+  auto pager = fresh_pager(index_test_file, page_size);
+  IndexTree tree(*pager, IndexTree::create(*pager));
+
+  std::mt19937 rng(page_size);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::map<Key, Key> model;
+  // Mostly short keys, now and then one of the largest size
+  const auto next_key = [&] {
+    return random_key(rng, percent(rng) < 5 ? tree.max_entry() : 12);
+  };
+
+  for (int round = 0; round < 2; round++) {
+    const int insert_percent = round == 0 ? 70 : 30;
+    for (int i = 0; i < 5000; i++) {
+      const Key key = next_key();
+      if (percent(rng) < insert_percent) {
+        Key payload = random_key(rng, 4);
+        payload.resize(std::min(payload.size(), tree.max_entry() - key.size()));
+        if (model.count(key) != 0) {
+          REQUIRE_THROWS_AS(tree.insert(key, payload), std::invalid_argument);
+        } else {
+          tree.insert(key, payload);
+          model[key] = std::move(payload);
+        }
+      } else {
+        const auto found = model.lower_bound(key);
+        if (found != model.end()) {
+          REQUIRE(tree.erase(found->first));
+          model.erase(found);
+        }
+        REQUIRE(tree.erase(key) == (model.erase(key) != 0));
+      }
+      if (i % 250 == 0) {
+        REQUIRE(tree.verify() == model.size());
+      }
+    }
+    REQUIRE(tree.verify() == model.size());
+
+    IndexCursor cursor(tree);
+    auto expected = model.begin();
+    for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+      REQUIRE(expected != model.end());
+      REQUIRE(Key(cursor.key(), cursor.key() + cursor.key_size())
+              == expected->first);
+      REQUIRE(Key(cursor.payload(), cursor.payload() + cursor.payload_size())
+              == expected->second);
+      ++expected;
+    }
+    REQUIRE(expected == model.end());
+
+    for (int i = 0; i < 300; i++) {
+      const Key key = next_key();
+      const auto found = model.lower_bound(key);
+      REQUIRE(cursor.seek(key) == (found != model.end()));
+      if (found != model.end()) {
+        REQUIRE(Key(cursor.key(), cursor.key() + cursor.key_size())
+                == found->first);
+      }
+    }
+  }
+
+  const std::uint32_t pages = pager->get_num_pages();
+  while (!model.empty()) {
+    REQUIRE(tree.erase(model.begin()->first));
+    model.erase(model.begin());
+  }
+  REQUIRE(tree.verify() == 0);
+  REQUIRE(tree.depth() == 1);
+  // Besides the header and the root
+  REQUIRE(pager->get_free_pages() == pages - 2);
+
+  pager.reset();
+  std::filesystem::remove(index_test_file);
+}
+}  // namespace
+
+TEST_CASE("Index keys sort like their values", "[index]")
+{
+  const std::int64_t min = std::numeric_limits<std::int64_t>::min();
+  const std::int64_t max = std::numeric_limits<std::int64_t>::max();
+  const std::vector<Value> ordered = {Value(),
+                                      min,
+                                      min + 1,
+                                      std::int64_t {-256},
+                                      std::int64_t {-1},
+                                      std::int64_t {0},
+                                      std::int64_t {1},
+                                      std::int64_t {255},
+                                      std::int64_t {256},
+                                      max,
+                                      std::string(),
+                                      std::string(1, '\0'),
+                                      std::string("\0\0", 2),
+                                      std::string("\0a", 2),
+                                      std::string("a"),
+                                      std::string("a\0", 2),
+                                      std::string("ab"),
+                                      std::string("b")};
+
+  for (std::size_t i = 0; i < ordered.size(); i++) {
+    const Key key = key_of(ordered[i]);
+    REQUIRE(decode_key(key.data(), key.size(), 1).front() == ordered[i]);
+    if (i > 0) {
+      REQUIRE(key_of(ordered[i - 1]) < key);
+    }
+  }
+
+  // Each value ends where the next one starts
+  Key composite;
+  append_key(composite, std::string("a\0b", 3));
+  append_key(composite, std::int64_t {-7});
+  append_key(composite, Value());
+  append_key_rowid(composite, -42);
+  const auto values = decode_key(composite.data(), composite.size(), 3);
+  REQUIRE(values == std::vector<Value> {
+              std::string("a\0b", 3), std::int64_t {-7}, Value()});
+  REQUIRE(key_rowid(composite.data(), composite.size()) == -42);
+  REQUIRE(non_null_key() > key_of(Value()));
+  REQUIRE(non_null_key() < key_of(min));
+
+  REQUIRE_THROWS_AS(decode_key(composite.data(), 3, 1), std::runtime_error);
+}
+
+TEST_CASE("Index tree basics", "[index]")
+{
+  auto pager = fresh_pager(index_test_file, 512);
+  IndexTree tree(*pager, IndexTree::create(*pager));
+  IndexCursor cursor(tree);
+  REQUIRE_FALSE(cursor.first());
+  REQUIRE_FALSE(cursor.seek(key_of(std::int64_t {1})));
+  REQUIRE_FALSE(tree.erase(key_of(std::int64_t {1})));
+
+  tree.insert(key_of(std::string("m")), {});
+  REQUIRE_THROWS_AS(tree.insert(key_of(std::string("m")), {}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(tree.insert(Key(tree.max_entry()), Key(1)),
+                    std::length_error);
+  tree.insert(Key(tree.max_entry() - 1), Key(1));
+  REQUIRE(tree.verify() == 2);
+
+  REQUIRE(cursor.seek(key_of(std::string("a"))));
+  REQUIRE(Key(cursor.key(), cursor.key() + cursor.key_size())
+          == key_of(std::string("m")));
+  REQUIRE_FALSE(cursor.next());
+  pager.reset();
+  std::filesystem::remove(index_test_file);
+}
+
+TEST_CASE("Index tree random inserts and erases match a model", "[index]")
+{
+  SECTION("Small pages make a deep tree")
+  {
+    check_random_workload(512);
+  }
+
+  SECTION("Default pages")
+  {
+    check_random_workload(4096);
+  }
+}
+
+TEST_CASE("Index loader builds a tree from sorted entries", "[index]")
+{
+  auto pager = fresh_pager(index_test_file, 512);
+
+  SECTION("Entries out of order or too large are refused")
+  {
+    IndexLoader loader(*pager);
+    const IndexTree tree(*pager, IndexTree::create(*pager));
+    loader.add(key_of(std::string("m")), {});
+    REQUIRE_THROWS_AS(loader.add(key_of(std::string("m")), {}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(loader.add(key_of(std::string("a")), {}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(loader.add(Key(tree.max_entry()), Key(1)),
+                      std::length_error);
+    loader.add(key_of(std::string("z")), Key(3));
+    loader.finish(tree.root());
+    REQUIRE(tree.verify() == 2);
+    REQUIRE(loader.entries() == 2);
+  }
+
+  SECTION("A loaded tree matches its entries and takes changes")
+  {
+    for (unsigned fill : {50U, 100U}) {
+      // Half the keys up to the largest size, so that separators of very
+      // different sizes share interior nodes
+      std::mt19937 rng(fill);
+      std::uniform_int_distribution<int> percent(0, 99);
+      IndexTree tree(*pager, IndexTree::create(*pager));
+      std::map<Key, Key> model;
+      while (model.size() < 3000) {
+        Key key = random_key(rng, percent(rng) < 50 ? tree.max_entry() : 12);
+        Key payload = random_key(rng, 4);
+        payload.resize(std::min(payload.size(), tree.max_entry() - key.size()));
+        model[std::move(key)] = std::move(payload);
+      }
+
+      IndexLoader loader(*pager, {fill});
+      for (const auto& [key, payload] : model) {
+        loader.add(key, payload);
+      }
+      loader.finish(tree.root());
+      REQUIRE(tree.verify() == model.size());
+      REQUIRE(tree.depth() >= 3);
+
+      IndexCursor cursor(tree);
+      auto expected = model.begin();
+      for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+        REQUIRE(Key(cursor.key(), cursor.key() + cursor.key_size())
+                == expected->first);
+        REQUIRE(Key(cursor.payload(), cursor.payload() + cursor.payload_size())
+                == expected->second);
+        ++expected;
+      }
+      REQUIRE(expected == model.end());
+
+      for (int i = 0; i < 3000; i++) {
+        const Key key = random_key(rng, 12);
+        if (i % 2 == 0 && model.count(key) == 0) {
+          tree.insert(key, {});
+          model[key] = {};
+        } else {
+          const auto found = model.lower_bound(key);
+          if (found != model.end()) {
+            REQUIRE(tree.erase(found->first));
+            model.erase(found);
+          }
+        }
+      }
+      REQUIRE(tree.verify() == model.size());
+    }
+  }
+
+  SECTION("An empty load leaves the root empty")
+  {
+    IndexLoader loader(*pager);
+    const IndexTree tree(*pager, IndexTree::create(*pager));
+    loader.finish(tree.root());
+    REQUIRE(tree.verify() == 0);
+    REQUIRE(tree.depth() == 1);
+  }
+
+  pager.reset();
+  std::filesystem::remove(index_test_file);
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/byte_order.hpp"
+#include "backend/key_search.hpp"
+
+namespace
+{
+std::vector<std::byte> encode(const std::vector<std::int64_t>& keys)
+{
+  std::vector<std::byte> bytes(keys.size() * 8);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    store_u64(bytes.data() + i * 8, static_cast<std::uint64_t>(keys[i]));
+  }
+  return bytes;
+}
+}  // namespace
+
+TEST_CASE("Key search agrees with std::lower_bound", "[key_search]")
+{
+  std::mt19937_64 rng(9);
+  constexpr auto min = std::numeric_limits<std::int64_t>::min();
+  constexpr auto max = std::numeric_limits<std::int64_t>::max();
+
+  // Wide keys differ in their high halves, narrow ones only in the low
+  // halves, which SSE2 compares separately; key +- 1 must not overflow
+  const std::vector<std::int64_t> spans {max - 1, std::int64_t {1} << 33, 64};
+  for (const std::int64_t span : spans) {
+    std::uniform_int_distribution<std::int64_t> dist(-span, span);
+    // Every window size and tail length, and nodes larger than a page's
+    for (std::size_t count : {0, 1, 2, 3, 5, 15, 16, 17, 33, 100, 340, 1000})
+    {
+      std::vector<std::int64_t> keys(count);
+      std::generate(keys.begin(), keys.end(), [&] { return dist(rng); });
+      std::sort(keys.begin(), keys.end());
+      const auto bytes = encode(keys);
+
+      std::vector<std::int64_t> probes {min, max, -1, 0, 1};
+      for (const std::int64_t key : keys) {
+        probes.insert(probes.end(), {key - 1, key, key + 1});
+      }
+      for (int i = 0; i < 50; i++) {
+        probes.push_back(dist(rng));
+      }
+      for (const std::int64_t probe : probes) {
+        const auto expected = static_cast<std::size_t>(
+            std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin());
+        REQUIRE(key_lower_bound(bytes.data(), count, probe) == expected);
+        REQUIRE(key_lower_bound_portable(bytes.data(), count, probe)
+                == expected);
+      }
+    }
+  }
+
+  const std::string_view name = key_search_implementation();
+  REQUIRE((name == "avx2" || name == "sse2" || name == "neon"
+           || name == "scalar"));
+}
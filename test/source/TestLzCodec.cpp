@@ -0,0 +1,105 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/lz_codec.hpp"
+
+namespace
+{
+std::vector<std::byte> round_trip(const std::vector<std::byte>& input)
+{
+  std::vector<std::byte> compressed(lz_max_compressed_size(input.size()));
+  const auto size = lz_compress(
+      input.data(), input.size(), compressed.data(), compressed.size());
+  REQUIRE(size > 0);
+  compressed.resize(size);
+
+  std::vector<std::byte> output(input.size());
+  REQUIRE(lz_decompress(
+      compressed.data(), compressed.size(), output.data(), output.size()));
+  return compressed;
+}
+
+std::vector<std::byte> text_page(std::size_t size)
+{
+  const std::string row = "42|alice|alice@example.com|active|2024-01-01\n";
+  std::vector<std::byte> page(size);
+  for (std::size_t i = 0; i < size; i++) {
+    page[i] = static_cast<std::byte>(row[i % row.size()]);
+  }
+  return page;
+}
+}  // namespace
+
+TEST_CASE("LZ codec round trips", "[lz]")
+{
+  std::mt19937 rng(21);
+
+  SECTION("Compressible pages shrink")
+  {
+    auto text = text_page(4096);
+    REQUIRE(round_trip(text).size() < 400);
+    std::vector<std::byte> zeros(4096, std::byte {0});
+    REQUIRE(round_trip(zeros).size() < 64);
+  }
+
+  SECTION("Random data stays within the worst case")
+  {
+    std::vector<std::byte> noise(4096);
+    for (auto& byte : noise) {
+      byte = static_cast<std::byte>(rng());
+    }
+    REQUIRE(round_trip(noise).size()
+            <= lz_max_compressed_size(noise.size()));
+  }
+
+  SECTION("Short and mixed inputs")
+  {
+    for (std::size_t size : {0, 1, 5, 12, 13, 17, 300, 65536}) {
+      std::vector<std::byte> input(size);
+      for (std::size_t i = 0; i < size; i++) {
+        // Runs of repeats between random bytes
+        input[i] = static_cast<std::byte>((i / 7) % 3 == 0 ? rng() : i % 5);
+      }
+      round_trip(input);
+    }
+  }
+
+  SECTION("Output that does not fit is refused")
+  {
+    auto text = text_page(4096);
+    std::vector<std::byte> small(16);
+    REQUIRE(lz_compress(text.data(), text.size(), small.data(), small.size())
+            == 0);
+  }
+}
+
+TEST_CASE("LZ codec rejects malformed input", "[lz]")
+{
+  auto text = text_page(4096);
+  auto compressed = round_trip(text);
+  std::vector<std::byte> output(text.size());
+
+  // Truncated stream
+  REQUIRE_FALSE(lz_decompress(
+      compressed.data(), compressed.size() - 3, output.data(), output.size()));
+  // Wrong expected size
+  REQUIRE_FALSE(lz_decompress(
+      compressed.data(), compressed.size(), output.data(), output.size() - 1));
+  // A match reaching before the start of the output
+  const std::vector<std::byte> bad_offset = {
+      std::byte {0x10}, std::byte {'a'}, std::byte {0x05}, std::byte {0x00}};
+  REQUIRE_FALSE(lz_decompress(
+      bad_offset.data(), bad_offset.size(), output.data(), output.size()));
+  // Random garbage never crashes
+  std::mt19937 rng(3);
+  for (int i = 0; i < 1000; i++) {
+    std::vector<std::byte> garbage(1 + rng() % 64);
+    for (auto& byte : garbage) {
+      byte = static_cast<std::byte>(rng());
+    }
+    lz_decompress(garbage.data(), garbage.size(), output.data(), 64);
+  }
+}
@@ -0,0 +1,74 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/pager.hpp"
+#include "meta_command.hpp"
+
+TEST_CASE("parse_byte_size understands suffixes", "[meta_command]")
+{
+  REQUIRE(parse_byte_size("4096") == std::size_t {4096});
+  REQUIRE(parse_byte_size("512K") == std::size_t {512} << 10U);
+  REQUIRE(parse_byte_size("64m") == std::size_t {64} << 20U);
+  REQUIRE(parse_byte_size("2G") == std::size_t {2} << 30U);
+  REQUIRE_FALSE(parse_byte_size("").has_value());
+  REQUIRE_FALSE(parse_byte_size("-1").has_value());
+  REQUIRE_FALSE(parse_byte_size("12Q").has_value());
+  REQUIRE_FALSE(parse_byte_size("1KB").has_value());
+}
+
+TEST_CASE(".exit and unknown commands", "[meta_command]")
+{
+  std::ostringstream out;
+  REQUIRE(execute_meta_command(".exit", nullptr, out)
+          == meta_command_result::exit);
+  REQUIRE(execute_meta_command(".nope", nullptr, out)
+          == meta_command_result::unrecognized);
+}
+
+TEST_CASE(".cache_size resizes the buffer pool", "[meta_command]")
+{
+  const std::string file_name = "meta_command.db";
+  std::ofstream(file_name, std::ios::binary | std::ios::trunc).close();
+  auto pager = create_pager(file_name);
+
+  std::ostringstream out;
+  REQUIRE(execute_meta_command(".cache_size 64K", pager.get(), out)
+          == meta_command_result::success);
+  REQUIRE(pager->get_cache_budget() == 64 * 1024);
+  REQUIRE(pager->get_cache_frames() == 64 * 1024 / pager->get_page_size());
+  REQUIRE(out.str().find("65536 bytes") != std::string::npos);
+
+  REQUIRE(execute_meta_command(".cache_size 1", pager.get(), out)
+          == meta_command_result::invalid_argument);
+  REQUIRE(execute_meta_command(".cache_size lots", pager.get(), out)
+          == meta_command_result::invalid_argument);
+  REQUIRE(execute_meta_command(".cache_size", nullptr, out)
+          == meta_command_result::invalid_argument);
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
+
+TEST_CASE(".stats reports the buffer pool counters", "[meta_command]")
+{
+  const std::string file_name = "meta_command.db";
+  std::ofstream(file_name, std::ios::binary | std::ios::trunc).close();
+  auto pager = create_pager(file_name);
+  pager->pin(0);
+  pager->pin(0);
+
+  std::ostringstream out;
+  REQUIRE(execute_meta_command(".stats", pager.get(), out)
+          == meta_command_result::success);
+  REQUIRE(out.str().find("hits: 1, misses: 1") != std::string::npos);
+  REQUIRE(out.str().find("read latency: 1 calls") != std::string::npos);
+
+  REQUIRE(execute_meta_command(".stats", nullptr, out)
+          == meta_command_result::invalid_argument);
+
+  pager.reset();
+  std::filesystem::remove(file_name);
+}
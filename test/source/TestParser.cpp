@@ -56,3 +56,39 @@ TEST_CASE("Parse UPDATE statement", "[parser]")
   REQUIRE(stmt.where_clause->op == "=");
   REQUIRE(stmt.where_clause->value == "Alice");
 }
+
+TEST_CASE("Parse CREATE INDEX statement", "[parser]")
+{
+  parser p("CREATE INDEX by_age ON users (age, name) INCLUDE (email);");
+  auto stmt_opt = p.parse_statement();
+  REQUIRE(stmt_opt.has_value());
+  REQUIRE(std::holds_alternative<create_index_statement>(stmt_opt.value()));
+  auto& stmt = std::get<create_index_statement>(stmt_opt.value());
+
+  REQUIRE(stmt.name == "by_age");
+  REQUIRE(stmt.table == "users");
+  REQUIRE(stmt.columns.size() == 2);
+  REQUIRE(stmt.columns[0] == "age");
+  REQUIRE(stmt.columns[1] == "name");
+  REQUIRE(stmt.included.size() == 1);
+  REQUIRE(stmt.included[0] == "email");
+
+  parser plain("CREATE INDEX by_name ON users (name);");
+  auto plain_opt = plain.parse_create_index();
+  REQUIRE(plain_opt.has_value());
+  REQUIRE(plain_opt->included.empty());
+  REQUIRE(plain_opt->method == "BTREE");
+
+  parser hashed("CREATE INDEX by_id ON users USING HASH (id);");
+  auto hashed_opt = hashed.parse_create_index();
+  REQUIRE(hashed_opt.has_value());
+  REQUIRE(hashed_opt->method == "HASH");
+  REQUIRE(hashed_opt->columns == std::vector<std::string> {"id"});
+
+  parser unknown("CREATE INDEX by_id ON users USING GIST (id);");
+  REQUIRE(unknown.parse_create_index().error()
+          == parse_error::mismatching_value);
+
+  parser missing("CREATE INDEX by_name ON users ();");
+  REQUIRE_FALSE(missing.parse_create_index().has_value());
+}
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/btree.hpp"
+#include "backend/hash_index.hpp"
+#include "backend/index_tree.hpp"
+#include "backend/pager.hpp"
+#include "backend/record.hpp"
+#include "engine/catalog.hpp"
+#include "engine/executor.hpp"
+#include "frontend/parser.hpp"
+
+#include "test_helpers.hpp"
+
+namespace
+{
+const std::string query_test_file = "query_test.db";
+
+select_statement parse_select(const std::string& sql)
+{
+  parser select_parser(sql);
+  auto stmt = select_parser.parse_select();
+  REQUIRE(stmt.has_value());
+  return stmt.value();
+}
+
+std::vector<Row> sorted(std::vector<Row> rows)
+{
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+// users(id, name, age, city): 600 rows, ages 18 to 77, ten cities
+void fill_users(Catalog& catalog, Executor& executor)
+{
+  catalog.create_table("users",
+                       {{"id", ColumnType::INTEGER},
+                        {"name", ColumnType::TEXT},
+                        {"age", ColumnType::INTEGER},
+                        {"city", ColumnType::TEXT}});
+  for (int i = 0; i < 600; i++) {
+    executor.execute("INSERT INTO users (id, name, age, city) VALUES ("
+                     + std::to_string(i) + ", 'user" + std::to_string(i)
+                     + "', " + std::to_string(18 + (i * 7) % 60) + ", 'city"
+                     + std::to_string(i % 10) + "');");
+  }
+}
+}  // namespace
+
+TEST_CASE("Index seeks answer like table scans", "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  fill_users(catalog, executor);
+
+  const std::vector<std::string> queries = {
+      "SELECT * FROM users WHERE age = 30;",
+      "SELECT name, age FROM users WHERE age < 25;",
+      "SELECT name FROM users WHERE age <= 25;",
+      "SELECT id, age FROM users WHERE age > 70;",
+      "SELECT * FROM users WHERE age >= 70;",
+      "SELECT age FROM users WHERE age != 40;",
+      "SELECT age, city FROM users WHERE city = 'city3';",
+      "SELECT name FROM users WHERE age = 1000;",
+      "SELECT age FROM users;"};
+  std::vector<std::vector<Row>> expected;
+  for (const std::string& query : queries) {
+    REQUIRE(executor.plan(parse_select(query)).access
+            == QueryPlan::Access::TABLE_SCAN);
+    expected.push_back(sorted(executor.execute(query)));
+  }
+  REQUIRE(expected[0].size() == 10);
+  REQUIRE(expected[7].empty());
+
+  executor.execute("CREATE INDEX by_age ON users (age);");
+  executor.execute("CREATE INDEX by_city ON users (city, age) INCLUDE (name);");
+  REQUIRE(IndexTree(*pager, catalog.find_index("by_age")->root).verify()
+          == 600);
+  // Rows added after the index get their entries too
+  executor.execute(
+      "INSERT INTO users (id, name, age, city) VALUES (600, 'late', 30, "
+      "'city3');");
+  expected[0].push_back({std::int64_t {600},
+                         std::string("late"),
+                         std::int64_t {30},
+                         std::string("city3")});
+  expected[5].push_back({std::int64_t {30}});
+  expected[6].push_back({std::int64_t {30}, std::string("city3")});
+  expected[8].push_back({std::int64_t {30}});
+
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    CAPTURE(queries[i]);
+    REQUIRE(sorted(executor.execute(queries[i])) == sorted(expected[i]));
+  }
+}
+
+TEST_CASE("The planner prefers covering index seeks", "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  fill_users(catalog, executor);
+  executor.execute("CREATE INDEX by_age ON users (age);");
+  executor.execute("CREATE INDEX by_city ON users (city, age) INCLUDE (name);");
+
+  const auto describe = [&](const std::string& sql) {
+    const select_statement stmt = parse_select(sql);
+    return executor.plan(stmt).describe(stmt.where_clause);
+  };
+  REQUIRE(describe("SELECT * FROM users WHERE age = 30;")
+          == "SEARCH users USING INDEX by_age (age=?)");
+  REQUIRE(describe("SELECT age FROM users WHERE age > 30;")
+          == "SEARCH users USING COVERING INDEX by_age (age>?)");
+  REQUIRE(describe("SELECT name, age FROM users WHERE city = 'city1';")
+          == "SEARCH users USING COVERING INDEX by_city (city=?)");
+  REQUIRE(describe("SELECT id FROM users WHERE city >= 'city1';")
+          == "SEARCH users USING INDEX by_city (city>=?)");
+  REQUIRE(describe("SELECT name FROM users WHERE age != 30;")
+          == "SCAN users USING COVERING INDEX by_city");
+  REQUIRE(describe("SELECT id FROM users WHERE name = 'user1';")
+          == "SCAN users");
+
+  // An index-only scan returns rows in key order
+  const auto rows = executor.execute("SELECT age FROM users WHERE age < 20;");
+  REQUIRE(rows.size() == 20);
+  REQUIRE(std::is_sorted(rows.begin(), rows.end()));
+}
+
+TEST_CASE("Hash indexes answer equality lookups", "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  fill_users(catalog, executor);
+
+  const std::vector<std::string> queries = {
+      "SELECT * FROM users WHERE id = 42;",
+      "SELECT name FROM users WHERE city = 'city3';",
+      "SELECT city, name FROM users WHERE city = 'city3';",
+      "SELECT id FROM users WHERE city = 'nowhere';",
+      "SELECT id FROM users WHERE city > 'city8';"};
+  std::vector<std::vector<Row>> expected;
+  for (const std::string& query : queries) {
+    expected.push_back(sorted(executor.execute(query)));
+  }
+
+  executor.execute("CREATE INDEX by_id ON users USING HASH (id);");
+  executor.execute(
+      "CREATE INDEX by_city ON users USING HASH (city) INCLUDE (name);");
+  executor.execute("CREATE INDEX by_city_age ON users (city, age);");
+  REQUIRE(catalog.find_index("by_id")->method == IndexMethod::HASH);
+  REQUIRE(HashIndex(*pager, catalog.find_index("by_city")->root).verify()
+          == 600);
+  executor.execute(
+      "INSERT INTO users (id, name, age, city) VALUES (600, 'late', 30, "
+      "'city3');");
+  expected[1].push_back({std::string("late")});
+  expected[2].push_back({std::string("city3"), std::string("late")});
+
+  const auto describe = [&](const std::string& sql) {
+    const select_statement stmt = parse_select(sql);
+    return executor.plan(stmt).describe(stmt.where_clause);
+  };
+  REQUIRE(describe(queries[0]) == "SEARCH users USING HASH INDEX by_id (id=?)");
+  REQUIRE(describe(queries[1])
+          == "SEARCH users USING COVERING HASH INDEX by_city (city=?)");
+  REQUIRE(describe(queries[4])
+          == "SEARCH users USING INDEX by_city_age (city>?)");
+  REQUIRE(describe("SELECT id FROM users WHERE id < 5;") == "SCAN users");
+
+  for (std::size_t i = 0; i < queries.size(); i++) {
+    CAPTURE(queries[i]);
+    REQUIRE(sorted(executor.execute(queries[i])) == sorted(expected[i]));
+  }
+
+  REQUIRE_THROWS_AS(
+      executor.execute("CREATE INDEX bad ON users USING GIST (id);"),
+      std::invalid_argument);
+}
+
+TEST_CASE("SELECTs skip the overflow pages of the columns they leave out",
+          "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  catalog.create_table("docs",
+                       {{"id", ColumnType::INTEGER},
+                        {"body", ColumnType::TEXT},
+                        {"size", ColumnType::INTEGER}});
+  // Bodies of some 200 overflow pages each
+  const auto body_of = [](int id) {
+    return std::string(200 * 1024 + static_cast<std::size_t>(id),
+                       static_cast<char>('a' + id));
+  };
+  for (int id = 0; id < 5; id++) {
+    const std::string body = body_of(id);
+    executor.execute("INSERT INTO docs (id, body, size) VALUES ("
+                     + std::to_string(id) + ", '" + body + "', "
+                     + std::to_string(body.size()) + ");");
+  }
+  REQUIRE(BTree(*pager, catalog.find_table("docs")->root).verify() == 5);
+
+  const auto pins = [&] {
+    const PagerStats stats = pager->stats();
+    return stats.hits + stats.misses;
+  };
+  std::uint64_t before = pins();
+  const auto sizes = executor.execute("SELECT id, size FROM docs;");
+  // For each row, the list page and the last data page of the body, where
+  // the size column lives: nowhere near the 1000 pages of the bodies
+  REQUIRE(pins() - before < 5 * 2 + 10);
+  REQUIRE(sizes.size() == 5);
+  REQUIRE(sizes[3]
+          == Row {std::int64_t {3},
+                  std::int64_t {static_cast<std::int64_t>(body_of(3).size())}});
+
+  before = pins();
+  const auto bodies = executor.execute("SELECT body FROM docs WHERE id = 3;");
+  REQUIRE(pins() - before > 200);
+  REQUIRE(bodies == std::vector<Row> {{body_of(3)}});
+
+  // Building an index reads no more of the bodies
+  before = pins();
+  executor.execute("CREATE INDEX by_id ON docs (id);");
+  REQUIRE(pins() - before < 50);
+  REQUIRE(executor.execute("SELECT id FROM docs WHERE id >= 4;")
+          == std::vector<Row> {{std::int64_t {4}}});
+}
+
+TEST_CASE("Indexes survive reopening", "[query]")
+{
+  {
+    auto pager = fresh_pager(query_test_file, 1024);
+    Catalog catalog(*pager);
+    Executor executor(catalog);
+    fill_users(catalog, executor);
+    executor.execute("CREATE INDEX by_city ON users (city) INCLUDE (age);");
+    executor.execute("CREATE INDEX by_id ON users USING HASH (id);");
+  }
+  auto pager = create_pager(query_test_file);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  const IndexDef* index = catalog.find_index("by_city");
+  REQUIRE(index != nullptr);
+  REQUIRE(index->table == "users");
+  REQUIRE(index->columns == std::vector<std::string> {"city"});
+  REQUIRE(index->included == std::vector<std::string> {"age"});
+  REQUIRE(index->method == IndexMethod::BTREE);
+  REQUIRE(catalog.find_index("by_id")->method == IndexMethod::HASH);
+  REQUIRE(catalog.indexes_of("users").size() == 2);
+  REQUIRE(catalog.find_table("users")->columns.size() == 4);
+
+  const auto rows =
+      executor.execute("SELECT city, age FROM users WHERE city = 'city0';");
+  REQUIRE(rows.size() == 60);
+  for (const Row& row : rows) {
+    REQUIRE(row[0] == Value(std::string("city0")));
+  }
+  REQUIRE(executor.execute("SELECT name FROM users WHERE id = 7;")
+          == std::vector<Row> {{std::string("user7")}});
+  pager.reset();
+  std::filesystem::remove(query_test_file);
+}
+
+TEST_CASE("A schema row with an unknown method is refused", "[query]")
+{
+  const std::vector<Value> row {std::string("index"),
+                                std::string("by_age"),
+                                std::string("users"),
+                                std::int64_t {2},
+                                std::string("age"),
+                                std::string()};
+  std::vector<Value> with_method = row;
+  with_method.emplace_back(std::string("GIST"));
+  for (const auto& written : {row, with_method}) {
+    {
+      auto pager = fresh_pager(query_test_file, 1024);
+      Catalog catalog(*pager);
+      BTree schema(*pager, Catalog::SCHEMA_ROOT);
+      schema.insert(1, encode_record(written));
+    }
+    auto pager = create_pager(query_test_file);
+    REQUIRE_THROWS_AS(Catalog(*pager), std::runtime_error);
+  }
+  std::filesystem::remove(query_test_file);
+}
+
+TEST_CASE("Bad statements change nothing", "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  fill_users(catalog, executor);
+
+  REQUIRE_THROWS_AS(executor.execute("CREATE INDEX i ON nobody (age);"),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(executor.execute("CREATE INDEX i ON users (height);"),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(
+      executor.execute("CREATE INDEX i ON users (age) INCLUDE (age);"),
+      std::invalid_argument);
+  REQUIRE_THROWS_AS(executor.execute("CREATE INDEX users ON users (age);"),
+                    std::invalid_argument);
+  REQUIRE(catalog.indexes_of("users").empty());
+
+  executor.execute("CREATE INDEX by_age ON users (age);");
+  REQUIRE_THROWS_AS(executor.execute("CREATE INDEX by_age ON users (id);"),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(
+      executor.execute("INSERT INTO users (id, age) VALUES (1, 'old');"),
+      std::invalid_argument);
+  REQUIRE_THROWS_AS(executor.execute("SELECT id FROM users WHERE age = x1;"),
+                    std::invalid_argument);
+  REQUIRE(executor.execute("SELECT id FROM users WHERE age >= 0;").size()
+          == 600);
+  REQUIRE(IndexTree(*pager, catalog.find_index("by_age")->root).verify()
+          == 600);
+  pager.reset();
+  std::filesystem::remove(query_test_file);
+}
+
+TEST_CASE("An INSERT after the largest rowid fails", "[query]")
+{
+  auto pager = fresh_pager(query_test_file, 1024);
+  Catalog catalog(*pager);
+  Executor executor(catalog);
+  const TableDef& table =
+      catalog.create_table("t", {{"id", ColumnType::INTEGER}});
+  BTree(*pager, table.root)
+      .insert(std::numeric_limits<std::int64_t>::max(),
+              encode_record({std::int64_t {1}}));
+
+  REQUIRE_THROWS_AS(executor.execute("INSERT INTO t (id) VALUES (2);"),
+                    std::overflow_error);
+  REQUIRE(BTree(*pager, table.root).verify() == 1);
+  pager.reset();
+  std::filesystem::remove(query_test_file);
+}
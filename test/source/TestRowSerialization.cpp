@@ -0,0 +1,132 @@
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/record.hpp"
+
+namespace
+{
+std::vector<std::byte> varint(std::uint64_t value)
+{
+  std::vector<std::byte> bytes;
+  append_varint(bytes, value);
+  return bytes;
+}
+}  // namespace
+
+TEST_CASE("Varints round-trip at every length", "[record]")
+{
+  std::vector<std::uint64_t> values {0, 1, 127, 128, 300};
+  // Both sides of the limit of each length, 1 to 9 bytes
+  for (unsigned bits = 7; bits <= 56; bits += 7) {
+    const std::uint64_t limit = std::uint64_t {1} << bits;
+    values.insert(values.end(), {limit - 1, limit, limit + 1});
+  }
+  values.push_back(std::numeric_limits<std::uint64_t>::max());
+  std::mt19937_64 rng(25);
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(rng() >> (rng() % 64));
+  }
+
+  for (const std::uint64_t value : values) {
+    const std::vector<std::byte> bytes = varint(value);
+    REQUIRE(bytes.size() <= 9);
+    // Alone in its buffer and followed by other bytes, since the bytes left
+    // decide between the byte by byte loop and the packed path
+    const std::byte* src = bytes.data();
+    REQUIRE(read_varint(src, bytes.data() + bytes.size()) == value);
+    REQUIRE(src == bytes.data() + bytes.size());
+
+    std::vector<std::byte> padded = bytes;
+    padded.resize(bytes.size() + 8, std::byte {0xFF});
+    src = padded.data();
+    REQUIRE(read_varint(src, padded.data() + padded.size()) == value);
+    REQUIRE(src == padded.data() + bytes.size());
+  }
+
+  // A varint cut short
+  const std::vector<std::byte> bytes = varint(1U << 20U);
+  const std::byte* src = bytes.data();
+  REQUIRE_THROWS_AS(read_varint(src, bytes.data() + bytes.size() - 1),
+                    std::runtime_error);
+}
+
+TEST_CASE("Records round-trip", "[record]")
+{
+  constexpr auto min = std::numeric_limits<std::int64_t>::min();
+  constexpr auto max = std::numeric_limits<std::int64_t>::max();
+  std::vector<Value> values {std::monostate {},
+                             std::int64_t {0},
+                             std::int64_t {1},
+                             std::string(),
+                             std::string("a\0b", 3),
+                             std::string(100000, 'x'),
+                             min,
+                             max};
+  // Each integer width from both ends
+  for (unsigned bits : {7U, 15U, 23U, 31U, 47U}) {
+    const std::int64_t limit = std::int64_t {1} << bits;
+    values.insert(values.end(),
+                  {limit - 1, limit, -limit, -limit - 1, std::int64_t {2}});
+  }
+
+  const std::vector<std::byte> record = encode_record(values);
+  REQUIRE(decode_record(record.data(), record.size()) == values);
+
+  const RecordView view(record.data(), record.size());
+  REQUIRE(view.columns() == values.size());
+  // Out of order, each column alone
+  for (std::size_t k = values.size(); k-- > 0;) {
+    REQUIRE(to_value(view.column(k)) == values[k]);
+  }
+  REQUIRE_THROWS_AS(view.column(values.size()), std::out_of_range);
+
+  REQUIRE(encode_record({}).size() == 1);
+  REQUIRE(RecordView(encode_record({}).data(), 1).columns() == 0);
+}
+
+TEST_CASE("Record views read TEXT in place", "[record]")
+{
+  const std::vector<std::byte> record = encode_record(
+      {std::int64_t {7}, std::string("alpha"), std::string("beta")});
+  RecordView view(record.data(), record.size());
+  const auto text = std::get<std::string_view>(view.column(2));
+  REQUIRE(text == "beta");
+  REQUIRE(reinterpret_cast<const std::byte*>(text.data()) >= record.data());
+  REQUIRE(reinterpret_cast<const std::byte*>(text.data()) + text.size()
+          == record.data() + record.size());
+
+  // A view is pointed at record after record
+  const std::vector<std::byte> other =
+      encode_record({std::monostate {}, std::int64_t {-300}});
+  view.reset(other.data(), other.size());
+  REQUIRE(view.columns() == 2);
+  REQUIRE(std::holds_alternative<std::monostate>(view.column(0)));
+  REQUIRE(std::get<std::int64_t>(view.column(1)) == -300);
+
+  const Value value = std::string("gamma");
+  REQUIRE(std::get<std::string_view>(view_of(value)).data()
+          == std::get<std::string>(value).data());
+}
+
+TEST_CASE("Malformed records are refused", "[record]")
+{
+  const std::vector<std::byte> record =
+      encode_record({std::int64_t {1000}, std::string("text")});
+  // Bodies cut short, a header longer than the record, an unknown type
+  std::vector<std::vector<std::byte>> broken {
+      {record.begin(), record.end() - 1},
+      {std::byte {9}, std::byte {1}},
+      {std::byte {2}, std::byte {7}},
+      {std::byte {2}, std::byte {14}},
+      {}};
+  for (const auto& bytes : broken) {
+    REQUIRE_THROWS_AS(RecordView(bytes.data(), bytes.size()),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(decode_record(bytes.data(), bytes.size()),
+                      std::runtime_error);
+  }
+}
@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/btree.hpp"
+#include "backend/pager.hpp"
+
+#include "test_helpers.hpp"
+
+namespace
+{
+const std::string table_test_file = "table_test.db";
+
+std::vector<std::byte> row_of(std::int64_t rowid, std::size_t size)
+{
+  std::vector<std::byte> row(size);
+  for (std::size_t i = 0; i < size; i++) {
+    row[i] = static_cast<std::byte>(static_cast<std::size_t>(rowid) + i);
+  }
+  return row;
+}
+
+std::vector<std::byte> payload_of(const BTreeCursor& cursor)
+{
+  return cursor.payload_reader().read_all();
+}
+
+// Compare a full scan in both directions against the model
+void check_scans(const BTree& tree,
+                 const std::map<std::int64_t, std::vector<std::byte>>& model)
+{
+  BTreeCursor cursor(tree);
+  auto expected = model.begin();
+  for (bool valid = cursor.first(); valid; valid = cursor.next()) {
+    REQUIRE(expected != model.end());
+    REQUIRE(cursor.rowid() == expected->first);
+    REQUIRE(payload_of(cursor) == expected->second);
+    ++expected;
+  }
+  REQUIRE(expected == model.end());
+
+  auto reversed = model.rbegin();
+  for (bool valid = cursor.last(); valid; valid = cursor.prev()) {
+    REQUIRE(reversed != model.rend());
+    REQUIRE(cursor.rowid() == reversed->first);
+    ++reversed;
+  }
+  REQUIRE(reversed == model.rend());
+}
+}  // namespace
+
+TEST_CASE("B+tree basics", "[btree]")
+{
+  auto pager = fresh_pager(table_test_file, 512);
+  BTree tree(*pager, BTree::create(*pager));
+
+  SECTION("An empty tree has no rows")
+  {
+    BTreeCursor cursor(tree);
+    REQUIRE_FALSE(cursor.first());
+    REQUIRE_FALSE(cursor.last());
+    REQUIRE_FALSE(cursor.seek(0));
+    REQUIRE_FALSE(cursor.next());
+    REQUIRE_FALSE(tree.find(1));
+    REQUIRE_FALSE(tree.erase(1));
+    REQUIRE(tree.verify() == 0);
+    REQUIRE(tree.depth() == 1);
+  }
+
+  SECTION("Taken rowids are refused")
+  {
+    tree.insert(7, row_of(7, 10));
+    REQUIRE_THROWS_AS(tree.insert(7, row_of(7, 1)), std::invalid_argument);
+    tree.insert(8, row_of(8, tree.max_payload()));
+    REQUIRE(tree.find(7) == row_of(7, 10));
+    REQUIRE(tree.find(8) == row_of(8, tree.max_payload()));
+    REQUIRE(tree.verify() == 2);
+    // Nothing spilled
+    REQUIRE(pager->get_num_pages() == 2);
+  }
+
+  SECTION("Ascending rowids fill the leaves")
+  {
+    std::map<std::int64_t, std::vector<std::byte>> model;
+    for (std::int64_t rowid = 1; rowid <= 3000; rowid++) {
+      model[rowid] = row_of(rowid, 20);
+      tree.insert(rowid, model[rowid]);
+    }
+    REQUIRE(tree.verify() == model.size());
+    REQUIRE(tree.depth() >= 3);
+    check_scans(tree, model);
+
+    // 15 rows of 30 + 2 bytes fill the 496 bytes a leaf has for cells
+    const std::size_t leaves = model.size() / 15;
+    REQUIRE(pager->get_num_pages() <= leaves + leaves / 10);
+  }
+
+  SECTION("Seek stands on the first row not below the rowid")
+  {
+    for (std::int64_t rowid = -1000; rowid <= 1000; rowid += 10) {
+      tree.insert(rowid, row_of(rowid, 8));
+    }
+    BTreeCursor cursor(tree);
+    REQUIRE(cursor.seek(-5000));
+    REQUIRE(cursor.rowid() == -1000);
+    REQUIRE(cursor.seek(-995));
+    REQUIRE(cursor.rowid() == -990);
+    REQUIRE(cursor.seek(500));
+    REQUIRE(cursor.rowid() == 500);
+    REQUIRE(cursor.prev());
+    REQUIRE(cursor.rowid() == 490);
+    REQUIRE(cursor.seek(1000));
+    REQUIRE_FALSE(cursor.next());
+    REQUIRE_FALSE(cursor.seek(1001));
+  }
+
+  SECTION("Emptying the tree frees every page but the root")
+  {
+    for (std::int64_t rowid = 0; rowid < 2000; rowid++) {
+      tree.insert(rowid, row_of(rowid, 40));
+    }
+    const std::uint32_t pages = pager->get_num_pages();
+    for (std::int64_t rowid = 0; rowid < 2000; rowid++) {
+      REQUIRE(tree.erase(rowid));
+    }
+    REQUIRE(tree.verify() == 0);
+    REQUIRE(tree.depth() == 1);
+    // Besides the header and the root
+    REQUIRE(pager->get_free_pages() == pages - 2);
+  }
+  std::filesystem::remove(table_test_file);
+}
+
+TEST_CASE("B+tree rows survive reopening", "[btree]")
+{
+  PageId root = 0;
+  {
+    auto pager = fresh_pager(table_test_file, 1024);
+    root = BTree::create(*pager);
+    BTree tree(*pager, root);
+    for (std::int64_t rowid = 0; rowid < 1000; rowid++) {
+      tree.insert(rowid * 3, row_of(rowid, 50));
+    }
+  }
+  auto pager = create_pager(table_test_file);
+  BTree tree(*pager, root);
+  REQUIRE(tree.verify() == 1000);
+  REQUIRE(tree.find(999 * 3) == row_of(999, 50));
+  REQUIRE_FALSE(tree.find(1));
+  pager.reset();
+  std::filesystem::remove(table_test_file);
+}
+
+namespace
+{
+// Grow to a few thousand rows, then shrink back to none, checking the tree
+// against a model throughout
+void check_random_workload(std::uint32_t page_size)
+{
+  auto pager = fresh_pager(table_test_file, page_size);
+  BTree tree(*pager, BTree::create(*pager));
+
+  std::mt19937 rng(page_size);
+  std::uniform_int_distribution<std::int64_t> rowids(-5000, 5000);
+  std::uniform_int_distribution<std::size_t> sizes(0, tree.max_payload());
+  // Now and then a row that spills into one or a few overflow pages
+  std::uniform_int_distribution<std::size_t> spills(tree.max_payload() + 1,
+                                                    page_size * 3);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::map<std::int64_t, std::vector<std::byte>> model;
+
+  for (int round = 0; round < 2; round++) {
+    const int insert_percent = round == 0 ? 70 : 30;
+    for (int i = 0; i < 6000; i++) {
+      const std::int64_t rowid = rowids(rng);
+      if (percent(rng) < insert_percent) {
+        auto row = row_of(rowid, percent(rng) < 3 ? spills(rng) : sizes(rng));
+        if (model.count(rowid) != 0) {
+          REQUIRE_THROWS_AS(tree.insert(rowid, row), std::invalid_argument);
+        } else {
+          tree.insert(rowid, row);
+          model[rowid] = std::move(row);
+        }
+      } else {
+        REQUIRE(tree.erase(rowid) == (model.erase(rowid) != 0));
+      }
+      if (i % 250 == 0) {
+        REQUIRE(tree.verify() == model.size());
+      }
+    }
+    REQUIRE(tree.verify() == model.size());
+    check_scans(tree, model);
+
+    BTreeCursor cursor(tree);
+    for (int i = 0; i < 500; i++) {
+      const std::int64_t rowid = rowids(rng);
+      const auto expected = model.lower_bound(rowid);
+      REQUIRE(cursor.seek(rowid) == (expected != model.end()));
+      if (expected != model.end()) {
+        REQUIRE(cursor.rowid() == expected->first);
+        REQUIRE(payload_of(cursor) == expected->second);
+      }
+    }
+  }
+
+  const std::uint32_t pages = pager->get_num_pages();
+  while (!model.empty()) {
+    REQUIRE(tree.erase(model.begin()->first));
+    model.erase(model.begin());
+  }
+  REQUIRE(tree.verify() == 0);
+  REQUIRE(tree.depth() == 1);
+  // Overflow pages too; besides the header and the root
+  REQUIRE(pager->get_free_pages() == pages - 2);
+
+  pager.reset();
+  std::filesystem::remove(table_test_file);
+}
+}  // namespace
+
+TEST_CASE("B+tree random inserts and erases match a model", "[btree]")
+{
+  SECTION("Small pages make a deep tree")
+  {
+    check_random_workload(512);
+  }
+
+  SECTION("Default pages")
+  {
+    check_random_workload(4096);
+  }
+}
+
+TEST_CASE("B+tree bulk load", "[btree]")
+{
+  auto pager = fresh_pager(table_test_file, 512);
+
+  SECTION("An empty load yields an empty tree")
+  {
+    BTreeLoader loader(*pager);
+    BTree tree(*pager, loader.finish());
+    REQUIRE(tree.verify() == 0);
+    REQUIRE(tree.depth() == 1);
+  }
+
+  SECTION("Rows out of order and bad fill factors are refused")
+  {
+    REQUIRE_THROWS_AS(BTreeLoader(*pager, {49}), std::invalid_argument);
+    REQUIRE_THROWS_AS(BTreeLoader(*pager, {101}), std::invalid_argument);
+    BTreeLoader loader(*pager);
+    loader.add(5, row_of(5, 10));
+    REQUIRE_THROWS_AS(loader.add(5, row_of(5, 10)), std::invalid_argument);
+    REQUIRE_THROWS_AS(loader.add(4, row_of(4, 10)), std::invalid_argument);
+    loader.add(6, row_of(6, 1000));
+    BTree tree(*pager, loader.finish());
+    REQUIRE(tree.verify() == 2);
+    REQUIRE(tree.find(6) == row_of(6, 1000));
+  }
+
+  SECTION("The fill factor sets how full the leaves are")
+  {
+    // 15 rows of 30 + 2 bytes fill the 496 bytes a leaf has for cells
+    for (unsigned fill : {100U, 50U}) {
+      const std::uint32_t before = pager->get_num_pages();
+      BTreeLoader loader(*pager, {fill});
+      for (std::int64_t rowid = 0; rowid < 1500; rowid++) {
+        loader.add(rowid, row_of(rowid, 20));
+      }
+      BTree tree(*pager, loader.finish());
+      REQUIRE(tree.verify() == 1500);
+      const std::size_t per_leaf = fill == 100 ? 15 : 7;
+      const std::size_t leaves = 1500 / per_leaf;
+      const std::uint32_t pages = pager->get_num_pages() - before;
+      REQUIRE(pages > leaves);
+      REQUIRE(pages <= leaves + leaves / 8 + 1);
+    }
+  }
+
+  SECTION("A loaded tree matches its rows and takes changes")
+  {
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<std::int64_t> gaps(1, 20);
+    std::uniform_int_distribution<std::size_t> sizes(0, 111);
+    std::map<std::int64_t, std::vector<std::byte>> model;
+    BTreeLoader loader(*pager, {75});
+    for (std::int64_t rowid = -20000; model.size() < 4000;
+         rowid += gaps(rng))
+    {
+      // Every hundredth row spills
+      model[rowid] =
+          row_of(rowid, model.size() % 100 == 0 ? 2000 : sizes(rng));
+      loader.add(rowid, model[rowid]);
+    }
+    REQUIRE(loader.rows() == model.size());
+    BTree tree(*pager, loader.finish());
+    REQUIRE(tree.verify() == model.size());
+    REQUIRE(tree.depth() >= 3);
+    check_scans(tree, model);
+
+    std::uniform_int_distribution<std::int64_t> rowids(-20000, 60000);
+    for (int i = 0; i < 4000; i++) {
+      const std::int64_t rowid = rowids(rng);
+      if (i % 2 == 0 && model.count(rowid) == 0) {
+        model[rowid] = row_of(rowid, sizes(rng));
+        tree.insert(rowid, model[rowid]);
+      } else {
+        const auto found = model.lower_bound(rowid);
+        if (found != model.end()) {
+          REQUIRE(tree.erase(found->first));
+          model.erase(found);
+        }
+      }
+    }
+    REQUIRE(tree.verify() == model.size());
+    check_scans(tree, model);
+  }
+  pager.reset();
+  std::filesystem::remove(table_test_file);
+}
+
+TEST_CASE("B+tree payloads spill into overflow pages", "[btree]")
+{
+  SECTION("A tail of one page")
+  {
+    auto pager = fresh_pager(table_test_file, 512);
+    BTree tree(*pager, BTree::create(*pager));
+    const auto row = row_of(1, 500);
+    tree.insert(1, row);
+    // The root and one data page
+    REQUIRE(pager->get_num_pages() == 3);
+    REQUIRE(tree.find(1) == row);
+
+    BTreeCursor cursor(tree);
+    REQUIRE(cursor.first());
+    REQUIRE(cursor.payload_size() == 500);
+    REQUIRE(cursor.local_size() == tree.max_payload() - 8);
+    REQUIRE(std::memcmp(cursor.payload(), row.data(), cursor.local_size())
+            == 0);
+    REQUIRE(tree.erase(1));
+    REQUIRE(pager->get_free_pages() == 1);
+  }
+
+  SECTION("Large values are read in fragments, page by page")
+  {
+    auto pager = fresh_pager(table_test_file, 4096);
+    PageId root = BTree::create(*pager);
+    BTree tree(*pager, root);
+    const auto large = row_of(2, 300 * 1024);
+    tree.insert(1, row_of(1, 10));
+    tree.insert(2, large);
+    tree.insert(3, row_of(3, 10));
+    REQUIRE(tree.verify() == 3);
+
+    BTreeCursor cursor(tree);
+    REQUIRE(cursor.seek(2));
+    PayloadReader reader = cursor.payload_reader();
+    REQUIRE(reader.size() == large.size());
+    std::size_t offset = 0;
+    std::size_t fragments = 0;
+    while (offset < reader.size()) {
+      const auto [bytes, size] = reader.fragment(offset);
+      REQUIRE(size > 0);
+      REQUIRE(std::memcmp(bytes, large.data() + offset, size) == 0);
+      offset += size;
+      fragments++;
+    }
+    // The head, then one fragment per data page
+    const std::size_t tail = large.size() - cursor.local_size();
+    REQUIRE(fragments == 1 + (tail + 4091) / 4092);
+
+    // Reading the last byte pins the list page and the last data page only
+    PayloadReader skipping = cursor.payload_reader();
+    const auto pins = [&] {
+      const PagerStats stats = pager->stats();
+      return stats.hits + stats.misses;
+    };
+    const std::uint64_t before = pins();
+    std::byte last {};
+    skipping.read(large.size() - 1, 1, &last);
+    REQUIRE(last == large.back());
+    REQUIRE(pins() - before == 2);
+    REQUIRE_THROWS_AS(skipping.read(large.size(), 1, &last),
+                      std::out_of_range);
+  }
+
+  SECTION("Long tails chain list pages and are freed with their row")
+  {
+    auto pager = fresh_pager(table_test_file, 512);
+    PageId root = 0;
+    std::vector<std::byte> large;
+    {
+      root = BTree::create(*pager);
+      BTree tree(*pager, root);
+      // About 126 data pages per list page
+      large = row_of(5, 200 * 1024);
+      for (std::int64_t rowid = 0; rowid < 50; rowid++) {
+        tree.insert(rowid, rowid == 5 ? large : row_of(rowid, 50));
+      }
+      REQUIRE(tree.verify() == 50);
+      REQUIRE(pager->get_num_pages() > 400);
+    }
+    pager.reset();
+    pager = create_pager(table_test_file);
+    BTree tree(*pager, root);
+    REQUIRE(tree.verify() == 50);
+    REQUIRE(tree.find(5) == large);
+
+    const std::uint32_t pages = pager->get_num_pages();
+    const std::size_t free_before = pager->get_free_pages();
+    REQUIRE(tree.erase(5));
+    REQUIRE(tree.verify() == 49);
+    REQUIRE(pager->get_free_pages() - free_before > 400);
+    REQUIRE(pager->get_num_pages() == pages);
+    pager.reset();
+  }
+  std::filesystem::remove(table_test_file);
+}
+
+TEST_CASE("B+tree lookups run alongside a writer", "[btree]")
+{
+  // Small pages, so that the writer keeps splitting and merging nodes and
+  // growing and shrinking the root under the readers
+  auto pager = fresh_pager(table_test_file, 512);
+  const PageId root = BTree::create(*pager);
+  BTree tree(*pager, root);
+  // A rowid always comes with the same row; every tenth spills
+  const auto row_for = [](std::int64_t rowid)
+  {
+    return row_of(rowid,
+                  rowid % 10 == 0 ? 700
+                                  : 20 + static_cast<std::size_t>(rowid % 40));
+  };
+  // Even rowids below `kept` stay put; the others come and go
+  constexpr std::int64_t kept = 400;
+  constexpr std::int64_t churned = 2000;
+  for (std::int64_t rowid = 0; rowid < kept; rowid += 2) {
+    tree.insert(rowid, row_for(rowid));
+  }
+
+  std::atomic<bool> done {false};
+  std::atomic<std::size_t> lookups {0};
+  std::atomic<std::size_t> wrong {0};
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < 3; t++) {
+    readers.emplace_back(
+        [&, t]
+        {
+          // Through a BTree of its own, as readers of the table would
+          const BTree view(*pager, root);
+          std::mt19937 rng(t);
+          std::uniform_int_distribution<std::int64_t> any_row(0, churned);
+          for (std::size_t mine = 0; !done || mine < 1000; mine++) {
+            const std::int64_t rowid = any_row(rng);
+            const auto found = view.find(rowid);
+            const bool stays = rowid < kept && rowid % 2 == 0;
+            if ((stays && !found) || (found && *found != row_for(rowid))) {
+              wrong++;
+            }
+            lookups++;
+          }
+        });
+  }
+
+  std::mt19937 rng(24);
+  std::vector<std::int64_t> rowids;
+  for (std::int64_t rowid = 1; rowid < churned; rowid++) {
+    if (rowid >= kept || rowid % 2 == 1) {
+      rowids.push_back(rowid);
+    }
+  }
+  for (int round = 0; round < 4; round++) {
+    std::shuffle(rowids.begin(), rowids.end(), rng);
+    for (const std::int64_t rowid : rowids) {
+      tree.insert(rowid, row_for(rowid));
+    }
+    std::shuffle(rowids.begin(), rowids.end(), rng);
+    for (const std::int64_t rowid : rowids) {
+      tree.erase(rowid);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  REQUIRE(wrong == 0);
+  REQUIRE(lookups >= 3000);
+  REQUIRE(tree.verify() == kept / 2);
+  pager.reset();
+  std::filesystem::remove(table_test_file);
+}
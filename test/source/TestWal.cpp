@@ -0,0 +1,575 @@
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "backend/wal.hpp"
+#include "backend/wal_index.hpp"
+
+namespace
+{
+const std::string wal_test_file = "wal_test.db-wal";
+constexpr std::uint32_t page_size = 512;
+
+std::vector<std::byte> page_of(int value)
+{
+  return std::vector<std::byte>(page_size, static_cast<std::byte>(value));
+}
+
+int value_of(Wal& wal, std::uint32_t page_number)
+{
+  std::vector<std::byte> page(page_size);
+  if (!wal.read_page(page_number, page.data())) {
+    return -1;
+  }
+  return std::to_integer<int>(page[0]);
+}
+}  // namespace
+
+TEST_CASE("WAL commits and recovery", "[wal]")
+{
+  std::filesystem::remove(wal_test_file);
+  const auto one = page_of(1);
+  const auto two = page_of(2);
+  const auto three = page_of(3);
+  {
+    Wal wal(wal_test_file, page_size, {}, true);
+    REQUIRE(value_of(wal, 1) == -1);
+    REQUIRE(wal.commit({{1, one.data()}, {2, one.data()}}, 3) == 2);
+    REQUIRE(wal.commit({{2, two.data()}}, 3) == 3);
+    REQUIRE(wal.commit({}, 3) == 3);
+    REQUIRE(value_of(wal, 1) == 1);
+    REQUIRE(value_of(wal, 2) == 2);
+    REQUIRE(wal.commit({{5, three.data()}}, 6) == 4);
+    REQUIRE(wal.db_pages() == 6);
+
+    const auto stats = wal.stats();
+    REQUIRE(stats.commits == 3);
+    REQUIRE(stats.frames == 4);
+    REQUIRE(stats.syncs == 3);
+    REQUIRE(stats.commit_latency.count() == 3);
+  }
+
+  SECTION("Reopening rebuilds the index")
+  {
+    Wal wal(wal_test_file, page_size, {}, false);
+    REQUIRE(wal.last_commit() == 4);
+    REQUIRE(wal.db_pages() == 6);
+    REQUIRE(value_of(wal, 1) == 1);
+    REQUIRE(value_of(wal, 2) == 2);
+    REQUIRE(value_of(wal, 5) == 3);
+  }
+
+  SECTION("A torn commit is dropped and overwritten")
+  {
+    std::filesystem::resize_file(wal_test_file,
+                                 std::filesystem::file_size(wal_test_file) - 1);
+    {
+      Wal wal(wal_test_file, page_size, {}, false);
+      REQUIRE(wal.last_commit() == 3);
+      REQUIRE(wal.db_pages() == 3);
+      REQUIRE(value_of(wal, 5) == -1);
+      REQUIRE(wal.commit({{4, three.data()}}, 5) == 4);
+    }
+    Wal wal(wal_test_file, page_size, {}, false);
+    REQUIRE(wal.last_commit() == 4);
+    REQUIRE(value_of(wal, 4) == 3);
+    REQUIRE(value_of(wal, 5) == -1);
+  }
+
+  SECTION("Frames without a commit marker are not committed")
+  {
+    // Cut the log inside the first commit, after its first frame
+    std::filesystem::resize_file(wal_test_file, 32 + 24 + page_size + 10);
+    Wal wal(wal_test_file, page_size, {}, false);
+    REQUIRE(wal.last_commit() == 0);
+    REQUIRE(value_of(wal, 1) == -1);
+    REQUIRE(std::filesystem::file_size(wal_test_file) == 32);
+  }
+
+  SECTION("A new database discards the old log")
+  {
+    Wal wal(wal_test_file, page_size, {}, true);
+    REQUIRE(wal.last_commit() == 0);
+    REQUIRE(value_of(wal, 1) == -1);
+  }
+
+  SECTION("The page size must match")
+  {
+    REQUIRE_THROWS_AS(Wal(wal_test_file, page_size * 2, {}, false),
+                      std::runtime_error);
+  }
+
+  std::filesystem::remove(wal_test_file);
+}
+
+TEST_CASE("WAL group commit", "[wal]")
+{
+  std::filesystem::remove(wal_test_file);
+  constexpr unsigned threads = 8;
+  constexpr int commits_per_thread = 20;
+
+  // A leader waits until every thread has queued, so commits share syncs
+  WalOptions options;
+  options.max_commit_delay = std::chrono::milliseconds(50);
+  options.max_batch_frames = threads;
+  Wal wal(wal_test_file, page_size, options, true);
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back(
+        [&wal, t]
+        {
+          for (int i = 0; i < commits_per_thread; i++) {
+            const auto page = page_of(i);
+            wal.commit({{t, page.data()}}, threads);
+          }
+        });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  const auto stats = wal.stats();
+  REQUIRE(stats.commits == threads * commits_per_thread);
+  REQUIRE(stats.frames == threads * commits_per_thread);
+  REQUIRE(stats.syncs < stats.commits);
+  REQUIRE(wal.last_commit() == threads * commits_per_thread);
+  for (unsigned t = 0; t < threads; t++) {
+    REQUIRE(value_of(wal, t) == commits_per_thread - 1);
+  }
+
+  std::filesystem::remove(wal_test_file);
+}
+
+TEST_CASE("WAL index", "[wal]")
+{
+  WalIndex index;
+  REQUIRE(index.lookup(1, index.snapshot()) == 0);
+
+  index.append(1, 1);
+  index.append(2, 2);
+  index.publish(2);
+  auto first = index.snapshot();
+  REQUIRE(first.sequence() == 2);
+
+  // Indexed but not yet published
+  index.append(1, 3);
+  REQUIRE(index.lookup(1, index.snapshot()) == 1);
+  index.publish(3);
+  REQUIRE(index.lookup(1, first) == 1);
+  REQUIRE(index.lookup(1, index.snapshot()) == 3);
+  REQUIRE(index.lookup(2, index.snapshot()) == 2);
+  REQUIRE(index.lookup(3, index.snapshot()) == 0);
+
+  SECTION("Frames roll over into new segments")
+  {
+    constexpr std::uint64_t frames = 3 * WalIndex::SEGMENT_FRAMES;
+    for (std::uint64_t frame = 4; frame <= frames; frame++) {
+      index.append(static_cast<std::uint32_t>(frame % 100), frame);
+    }
+    index.publish(frames);
+    REQUIRE(index.segments() == 3);
+
+    const auto last = index.snapshot();
+    for (std::uint32_t page = 0; page < 100; page++) {
+      const std::uint64_t frame = index.lookup(page, last);
+      REQUIRE(frame % 100 == page);
+      REQUIRE(frame + 100 > frames);
+    }
+    REQUIRE(index.lookup(1, first) == 1);
+
+    // Frames of the newest segment, up to a limit, in page order
+    const std::uint64_t after = 2 * WalIndex::SEGMENT_FRAMES;
+    const auto changed = index.frames_between(last, after, frames - 1);
+    REQUIRE(changed.size() == 100);
+    for (std::uint32_t page = 0; page < 100; page++) {
+      const auto [found_page, frame] = changed[page];
+      REQUIRE(found_page == page);
+      REQUIRE(frame % 100 == page);
+      REQUIRE(frame > frames - 101);
+      REQUIRE(frame < frames);
+    }
+  }
+
+  SECTION("Snapshots bound the oldest visible commit")
+  {
+    REQUIRE(index.oldest_snapshot() == 2);
+    {
+      WalSnapshot moved = index.snapshot();
+      moved = std::move(first);
+      REQUIRE(moved.sequence() == 2);
+    }
+    REQUIRE(index.oldest_snapshot() == 3);
+  }
+
+  SECTION("Only pinned reads hold up a wait for readers")
+  {
+    index.wait_for_readers();
+
+    std::atomic<bool> pinned {false};
+    std::atomic<bool> unpinned {false};
+    std::thread reader(
+        [&]
+        {
+          const auto snapshot = index.snapshot();
+          const WalIndex::Pin pin(index, snapshot);
+          pinned = true;
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          unpinned = true;
+        });
+    while (!pinned) {
+      std::this_thread::yield();
+    }
+    index.wait_for_readers();
+    REQUIRE(unpinned);
+    reader.join();
+  }
+
+  SECTION("A reset forgets every frame but keeps the sequence")
+  {
+    index.reset();
+    REQUIRE(index.segments() == 0);
+    REQUIRE(index.global_sequence() == 3);
+    REQUIRE(index.lookup(1, first) == 0);
+    REQUIRE(index.lookup(1, index.snapshot()) == 0);
+    index.append(1, 4);
+    index.publish(4);
+    REQUIRE(index.lookup(1, index.snapshot()) == 4);
+    REQUIRE(index.lookup(1, first) == 0);
+  }
+}
+
+TEST_CASE("WAL index readers run alongside the writer", "[wal]")
+{
+  constexpr std::uint32_t page_count = 64;
+  constexpr std::uint64_t frames = 4 * WalIndex::SEGMENT_FRAMES;
+  constexpr unsigned readers = 4;
+
+  WalIndex index;
+  std::atomic<bool> done {false};
+  std::atomic<std::uint64_t> errors {0};
+  std::vector<std::thread> threads;
+  for (unsigned r = 0; r < readers; r++) {
+    threads.emplace_back(
+        [&]
+        {
+          while (!done) {
+            const auto snapshot = index.snapshot();
+            for (std::uint32_t page = 0; page < page_count; page++) {
+              const std::uint64_t frame = index.lookup(page, snapshot);
+              if (frame != 0
+                  && (frame % page_count != page
+                      || frame > snapshot.sequence()))
+              {
+                errors++;
+              }
+            }
+          }
+        });
+  }
+
+  // Commits of eight frames, with a reset every few segments
+  for (std::uint64_t frame = 1; frame <= frames; frame++) {
+    index.append(static_cast<std::uint32_t>(frame % page_count), frame);
+    if (frame % 8 == 0) {
+      index.publish(frame);
+    }
+    if (frame % (WalIndex::SEGMENT_FRAMES * 3 / 2) == 0) {
+      index.reset();
+    }
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(errors == 0);
+  REQUIRE(index.oldest_snapshot() == frames);
+}
+
+TEST_CASE("WAL checkpoints and restarts", "[wal]")
+{
+  std::filesystem::remove(wal_test_file);
+  const auto one = page_of(1);
+  const auto two = page_of(2);
+  const auto three = page_of(3);
+  constexpr std::uint64_t size_limit = 1U << 20U;
+
+  Wal wal(wal_test_file, page_size, {}, true);
+  wal.commit({{1, one.data()}, {2, one.data()}}, 3);
+  wal.commit({{1, two.data()}}, 3);
+  {
+    const auto reader = wal.snapshot();
+    wal.commit({{2, three.data()}}, 3);
+
+    // The reader holds the checkpoint back to the commit it sees
+    const auto checkpoint = wal.snapshot();
+    const std::uint64_t limit = wal.oldest_snapshot();
+    REQUIRE(limit == 3);
+    using Frames = std::vector<std::pair<std::uint32_t, std::uint64_t>>;
+    REQUIRE(wal.checkpoint_frames(checkpoint, limit)
+            == Frames {{1, 3}, {2, 2}});
+    std::vector<std::byte> images(2 * page_size);
+    wal.read_frames({3, 2}, images.data());
+    REQUIRE(images[0] == std::byte {2});
+    REQUIRE(images[page_size] == std::byte {1});
+
+    REQUIRE_FALSE(wal.finish_checkpoint(limit, size_limit));
+    REQUIRE(wal.backfilled() == 3);
+    REQUIRE(wal.checkpoint_frames(checkpoint, 4) == Frames {{2, 4}});
+  }
+
+  const auto full_size = std::filesystem::file_size(wal_test_file);
+  REQUIRE(wal.size() == full_size);
+
+  SECTION("The log restarts once every commit is copied")
+  {
+    REQUIRE(wal.finish_checkpoint(4, size_limit));
+    REQUIRE(wal.stats().restarts == 1);
+    REQUIRE(wal.size() == 32);
+    REQUIRE(std::filesystem::file_size(wal_test_file) == full_size);
+    REQUIRE(value_of(wal, 1) == -1);
+
+    // Frame numbers go on, and the frames are written from the start
+    REQUIRE(wal.last_commit() == 4);
+    REQUIRE(wal.commit({{5, three.data()}}, 6) == 5);
+    REQUIRE(value_of(wal, 5) == 3);
+    {
+      Wal reopened(wal_test_file, page_size, {}, false);
+      REQUIRE(reopened.last_commit() == 5);
+      REQUIRE(reopened.backfilled() == 4);
+      REQUIRE(value_of(reopened, 5) == 3);
+      REQUIRE(value_of(reopened, 1) == -1);
+    }
+    REQUIRE(std::filesystem::file_size(wal_test_file) == 32 + 24 + page_size);
+  }
+
+  SECTION("A log past the size limit is truncated on restart")
+  {
+    REQUIRE(wal.finish_checkpoint(4, 0));
+    REQUIRE(std::filesystem::file_size(wal_test_file) == 32);
+  }
+
+  std::filesystem::remove(wal_test_file);
+}
+
+TEST_CASE("WAL spilled pages wait for a commit", "[wal]")
+{
+  std::filesystem::remove(wal_test_file);
+  const auto one = page_of(1);
+  const auto two = page_of(2);
+  {
+    Wal wal(wal_test_file, page_size, {}, true);
+    wal.commit({{1, one.data()}}, 3);
+    wal.spill({{1, two.data()}, {2, two.data()}});
+    REQUIRE(wal.has_spilled());
+    REQUIRE(wal.stats().commits == 1);
+    REQUIRE(wal.stats().syncs == 1);
+
+    // Only the writer sees them
+    REQUIRE(value_of(wal, 1) == 1);
+    REQUIRE(value_of(wal, 2) == -1);
+    std::vector<std::byte> page(page_size);
+    REQUIRE(wal.read_spilled(2, wal.snapshot(), page.data()));
+    REQUIRE(page[0] == std::byte {2});
+
+    // Checkpoints leave them alone, and the log does not restart
+    const auto snapshot = wal.snapshot();
+    using Frames = std::vector<std::pair<std::uint32_t, std::uint64_t>>;
+    REQUIRE(wal.checkpoint_frames(snapshot, wal.oldest_snapshot())
+            == Frames {{1, 1}});
+    REQUIRE_FALSE(wal.finish_checkpoint(wal.last_commit(), 0));
+  }
+  {
+    // Without a commit behind them they are gone after a crash
+    Wal wal(wal_test_file, page_size, {}, false);
+    REQUIRE_FALSE(wal.has_spilled());
+    REQUIRE(value_of(wal, 1) == 1);
+    REQUIRE(value_of(wal, 2) == -1);
+
+    wal.spill({{2, two.data()}});
+    wal.commit({{3, one.data()}}, 4);
+    REQUIRE_FALSE(wal.has_spilled());
+    REQUIRE(value_of(wal, 2) == 2);
+  }
+  Wal wal(wal_test_file, page_size, {}, false);
+  REQUIRE(value_of(wal, 2) == 2);
+  REQUIRE(value_of(wal, 3) == 1);
+  std::filesystem::remove(wal_test_file);
+}
+
+namespace
+{
+// A log of random commits and the page contents each commit leaves behind
+class CrashHarness
+{
+public:
+  static constexpr std::uint32_t pages = 50;
+  static constexpr std::uint64_t frame_size = 24 + page_size;
+  const std::string log_file = "wal_crash_test.db-wal";
+  const std::string crash_file = "wal_crash_copy.db-wal";
+
+  CrashHarness(int commits, std::uint32_t seed)
+  {
+    std::filesystem::remove(log_file);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::uint32_t> page_dist(0, pages - 1);
+    std::uniform_int_distribution<std::size_t> size_dist(1, 12);
+
+    // Every page image holds the number of its commit
+    Wal wal(log_file, page_size, {}, true);
+    std::vector<std::byte> image(page_size);
+    for (int c = 1; c <= commits; c++) {
+      std::memcpy(image.data(), &c, sizeof(c));
+      std::vector<WalPage> commit(size_dist(rng));
+      m_pages.emplace_back();
+      for (auto& page : commit) {
+        page = {page_dist(rng), image.data()};
+        m_pages.back().push_back(page.page_number);
+      }
+      m_last_frames.push_back(
+          wal.commit(commit, static_cast<std::uint32_t>(c)));
+    }
+  }
+
+  ~CrashHarness()
+  {
+    std::filesystem::remove(log_file);
+    std::filesystem::remove(crash_file);
+  }
+
+  CrashHarness(const CrashHarness&) = delete;
+  CrashHarness& operator=(const CrashHarness&) = delete;
+  CrashHarness(CrashHarness&&) = delete;
+  CrashHarness& operator=(CrashHarness&&) = delete;
+
+  std::uint64_t frames() const { return m_last_frames.back(); }
+  static std::uint64_t offset_of(std::uint64_t frame)
+  {
+    return 32 + (frame - 1) * frame_size;
+  }
+
+  // A copy of the log, damaged by the caller
+  std::fstream crash_copy()
+  {
+    std::filesystem::copy_file(
+        log_file,
+        crash_file,
+        std::filesystem::copy_options::overwrite_existing);
+    return std::fstream(crash_file,
+                        std::ios::binary | std::ios::in | std::ios::out);
+  }
+
+  // Recover the copy and compare it with the commits ending before frame
+  void check_recovery(std::uint64_t first_lost_frame, WalOptions options)
+  {
+    std::size_t commits = 0;
+    while (commits < m_last_frames.size()
+           && m_last_frames[commits] < first_lost_frame)
+    {
+      commits++;
+    }
+    std::vector<int> expected(pages, -1);
+    for (std::size_t c = 0; c < commits; c++) {
+      for (const std::uint32_t page : m_pages[c]) {
+        expected[page] = static_cast<int>(c + 1);
+      }
+    }
+
+    const std::uint64_t last_commit =
+        commits == 0 ? 0 : m_last_frames[commits - 1];
+    {
+      Wal wal(crash_file, page_size, options, false);
+      REQUIRE(wal.last_commit() == last_commit);
+      REQUIRE(wal.db_pages() == commits);
+      std::vector<std::byte> image(page_size);
+      for (std::uint32_t page = 0; page < pages; page++) {
+        int found = -1;
+        if (wal.read_page(page, image.data())) {
+          std::memcpy(&found, image.data(), sizeof(found));
+        }
+        REQUIRE(found == expected[page]);
+      }
+    }
+    REQUIRE(std::filesystem::file_size(crash_file)
+            == offset_of(last_commit + 1));
+  }
+
+private:
+  // Commit marker and page numbers of each commit
+  std::vector<std::uint64_t> m_last_frames;
+  std::vector<std::vector<std::uint32_t>> m_pages;
+};
+}  // namespace
+
+TEST_CASE("WAL recovery after injected crashes", "[wal]")
+{
+  CrashHarness harness(1000, 17);
+  std::mt19937 rng(23);
+  std::uniform_int_distribution<unsigned> threads(1, 4);
+  std::uniform_int_distribution<std::size_t> segment_frames(16, 512);
+  const auto options = [&]
+  {
+    WalOptions result;
+    result.recovery_threads = threads(rng);
+    result.recovery_segment_frames = segment_frames(rng);
+    return result;
+  };
+  std::uniform_int_distribution<std::uint64_t> frame_dist(1, harness.frames());
+  const auto random_frame = [&] { return frame_dist(rng); };
+  std::uniform_int_distribution<std::uint64_t> in_frame(
+      0, CrashHarness::frame_size - 1);
+
+  SECTION("An intact log recovers every commit")
+  {
+    harness.crash_copy().close();
+    for (int i = 0; i < 4; i++) {
+      harness.check_recovery(harness.frames() + 1, options());
+    }
+  }
+
+  SECTION("A torn append loses the commits it did not finish")
+  {
+    for (int i = 0; i < 20; i++) {
+      const std::uint64_t frame = random_frame();
+      harness.crash_copy().close();
+      std::filesystem::resize_file(harness.crash_file,
+                                   harness.offset_of(frame) + in_frame(rng));
+      harness.check_recovery(frame, options());
+    }
+  }
+
+  SECTION("A corrupt frame ends the log")
+  {
+    for (int i = 0; i < 20; i++) {
+      const std::uint64_t frame = random_frame();
+      auto file = harness.crash_copy();
+      const auto offset =
+          static_cast<std::streamoff>(harness.offset_of(frame) + in_frame(rng));
+      file.seekg(offset);
+      const auto value = static_cast<char>(file.get() ^ 0x5a);
+      file.seekp(offset);
+      file.put(value);
+      file.close();
+      harness.check_recovery(frame, options());
+    }
+  }
+
+  SECTION("Blocks that never reached the disk read as zeros")
+  {
+    for (int i = 0; i < 20; i++) {
+      const std::uint64_t frame = random_frame();
+      const std::string zeros(CrashHarness::frame_size, '\0');
+      auto file = harness.crash_copy();
+      file.seekp(static_cast<std::streamoff>(harness.offset_of(frame)));
+      file.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+      file.close();
+      harness.check_recovery(frame, options());
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "backend/pager.hpp"
+#include "backend/record.hpp"
+
+// Pager of a new, empty file, replacing any earlier one
+inline std::unique_ptr<Pager> fresh_pager(const std::string& file_name,
+                                          std::uint32_t page_size)
+{
+  std::filesystem::remove(file_name);
+  std::ofstream(file_name, std::ios::binary).close();
+  PagerOptions options;
+  options.page_size = page_size;
+  return create_pager(file_name, options);
+}
+
+// Index key of a single value
+inline std::vector<std::byte> key_of(const Value& value)
+{
+  std::vector<std::byte> key;
+  append_key(key, value);
+  return key;
+}
+
+#endif  // TEST_HELPERS_HPP